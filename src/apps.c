@@ -0,0 +1,1184 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+/* For asprintf(), mkostemp(), memfd_create() and qsort_r() */
+#define _GNU_SOURCE
+
+#include "helpers.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "desktop.h"
+#include "match.h"
+#include "loop.h"
+#include "apps.h"
+
+#define WW_APPS_MAGIC 0x49415757
+#define WW_APPS_VERSION 1
+
+#define WW_APPS_QUERY_SIZE 256
+#define WW_APPS_MAX_WORDS 8
+
+typedef struct {
+    int64_t mtime;
+    uint32_t path;
+    uint32_t padding;
+} WwAppsIndexDir;
+
+typedef struct {
+    int64_t mtime;
+    /* ww_match_get_mask() of both search strings */
+    uint64_t mask;
+    uint32_t dir;
+    uint32_t id;
+    uint32_t name;
+    uint32_t exec;
+    uint32_t icon;
+    /* Folded, followed by WW_MATCH_PADDING zeroes */
+    uint32_t name_search;
+    uint32_t name_search_length;
+    uint32_t keywords_search;
+    uint32_t keywords_search_length;
+    uint32_t padding;
+} WwAppsIndexRecord;
+
+/*
+ * Followed by the records, then the strings
+ * All offsets are from the start of the file
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    /* Visible apps come first, hidden ones are kept to track their files */
+    uint32_t count;
+    uint32_t record_count;
+    uint32_t dir_count;
+    uint32_t locale;
+    uint64_t size;
+    WwAppsIndexDir dirs[];
+} WwAppsIndexHeader;
+
+typedef enum {
+    WW_APPS_STRING_ID,
+    WW_APPS_STRING_NAME,
+    WW_APPS_STRING_EXEC,
+    WW_APPS_STRING_ICON,
+    WW_APPS_STRING_NAME_SEARCH,
+    WW_APPS_STRING_KEYWORDS_SEARCH,
+#define WW_APPS_STRING_COUNT (WW_APPS_STRING_KEYWORDS_SEARCH + 1)
+} WwAppsString;
+
+typedef enum {
+    WW_APPS_KEY_TYPE,
+    WW_APPS_KEY_NO_DISPLAY,
+    WW_APPS_KEY_HIDDEN,
+    WW_APPS_KEY_NAME,
+    WW_APPS_KEY_GENERIC_NAME,
+    WW_APPS_KEY_KEYWORDS,
+    WW_APPS_KEY_EXEC,
+    WW_APPS_KEY_ICON,
+#define WW_APPS_KEY_COUNT (WW_APPS_KEY_ICON + 1)
+} WwAppsKey;
+
+static const char * const _ww_apps_keys[WW_APPS_KEY_COUNT] = {
+    [WW_APPS_KEY_TYPE] = "Type",
+    [WW_APPS_KEY_NO_DISPLAY] = "NoDisplay",
+    [WW_APPS_KEY_HIDDEN] = "Hidden",
+    [WW_APPS_KEY_NAME] = "Name",
+    [WW_APPS_KEY_GENERIC_NAME] = "GenericName",
+    [WW_APPS_KEY_KEYWORDS] = "Keywords",
+    [WW_APPS_KEY_EXEC] = "Exec",
+    [WW_APPS_KEY_ICON] = "Icon",
+};
+
+typedef struct {
+    int64_t mtime;
+    uint32_t dir;
+    bool hidden;
+    /* Strings are ours, or in the previous mapping */
+    bool parsed;
+    const char *strings[WW_APPS_STRING_COUNT];
+} WwAppsEntry;
+
+typedef struct {
+    WwAppsEntry *entries;
+    size_t count;
+    size_t size;
+} WwAppsEntries;
+
+struct _WwApps {
+    char **dirs;
+    size_t dir_count;
+    char *path;
+    /* “ll_CC”, empty for C */
+    char *locale;
+    size_t language_length;
+    uint8_t *data;
+    size_t size;
+    const WwAppsIndexHeader *header;
+    const WwAppsIndexRecord *records;
+    int inotify_fd;
+    int *watches;
+    WwLoopSource *source;
+    WwAppsChangedCallback callback;
+    void *user_data;
+};
+
+static int64_t
+_ww_apps_get_mtime(const struct stat *st)
+{
+    return (int64_t) st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+}
+
+static void
+_ww_apps_get_dir_mtimes(WwApps *self, int64_t *mtimes)
+{
+    struct stat st;
+    size_t i;
+
+    for ( i = 0 ; i < self->dir_count ; ++i )
+        mtimes[i] = ( stat(self->dirs[i], &st) == 0 ) ? _ww_apps_get_mtime(&st) : -1;
+}
+
+static char *
+_ww_apps_get_locale(size_t *language_length)
+{
+    static const char * const names[] = { "LC_ALL", "LC_MESSAGES", "LANG" };
+    const char *value = NULL;
+    char *locale;
+    size_t i;
+
+    for ( i = 0 ; ( value == NULL ) && ( i < sizeof(names) / sizeof(*names) ) ; ++i )
+    {
+        value = getenv(names[i]);
+        if ( ( value != NULL ) && ( value[0] == '\0' ) )
+            value = NULL;
+    }
+    if ( ( value == NULL ) || ( strcmp(value, "C") == 0 ) || ( strcmp(value, "POSIX") == 0 ) )
+        value = "";
+
+    locale = strndup(value, strcspn(value, ".@"));
+    if ( locale != NULL )
+        *language_length = strcspn(locale, "_");
+    return locale;
+}
+
+/* The general escapes, lists get their separators as spaces */
+static void
+_ww_apps_unescape(char *value, bool list)
+{
+    char *s, *d;
+
+    for ( s = d = value ; *s != '\0' ; ++s )
+    {
+        if ( list && ( *s == ';' ) )
+            *d++ = ' ';
+        else if ( ( *s != '\\' ) || ( s[1] == '\0' ) )
+            *d++ = *s;
+        else
+        {
+            switch ( *++s )
+            {
+            case 's': *d++ = ' '; break;
+            case 'n': *d++ = '\n'; break;
+            case 't': *d++ = '\t'; break;
+            case 'r': *d++ = '\r'; break;
+            default: *d++ = *s; break;
+            }
+        }
+    }
+    *d = '\0';
+}
+
+/*
+ * Index
+ */
+
+static void
+_ww_apps_unmap(WwApps *self)
+{
+    if ( self->data != NULL )
+        munmap(self->data, self->size);
+    self->data = NULL;
+    self->size = 0;
+    self->header = NULL;
+    self->records = NULL;
+}
+
+static bool
+_ww_apps_map(WwApps *self, int fd)
+{
+    struct stat st;
+    uint8_t *data;
+    size_t size, i;
+
+    if ( ( fstat(fd, &st) < 0 ) || ( (size_t) st.st_size < sizeof(WwAppsIndexHeader) ) )
+        return false;
+    size = st.st_size;
+
+    data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if ( data == MAP_FAILED )
+        return false;
+
+    const WwAppsIndexHeader *header = (const WwAppsIndexHeader *) data;
+    const WwAppsIndexRecord *records = (const WwAppsIndexRecord *) ( header->dirs + header->dir_count );
+    bool valid = ( header->magic == WW_APPS_MAGIC ) && ( header->version == WW_APPS_VERSION ) && ( header->size == size )
+        && ( header->count <= header->record_count ) && ( header->dir_count < size / sizeof(WwAppsIndexDir) ) && ( header->record_count < size / sizeof(WwAppsIndexRecord) )
+        && ( sizeof(WwAppsIndexHeader) + header->dir_count * sizeof(WwAppsIndexDir) + header->record_count * sizeof(WwAppsIndexRecord) < size )
+        /* Any string offset in the file is then NUL-terminated */
+        && ( data[size - 1] == '\0' ) && ( header->locale < size );
+    for ( i = 0 ; valid && ( i < header->dir_count ) ; ++i )
+        valid = ( header->dirs[i].path < size );
+    for ( i = 0 ; valid && ( i < header->record_count ) ; ++i )
+    {
+        const WwAppsIndexRecord *record = records + i;
+        valid = ( record->dir < header->dir_count ) && ( record->id < size ) && ( record->name < size ) && ( record->exec < size ) && ( record->icon < size )
+            && ( (uint64_t) record->name_search + record->name_search_length + WW_MATCH_PADDING <= size )
+            && ( (uint64_t) record->keywords_search + record->keywords_search_length + WW_MATCH_PADDING <= size );
+    }
+    if ( ! valid )
+    {
+        munmap(data, size);
+        return false;
+    }
+
+    _ww_apps_unmap(self);
+    self->data = data;
+    self->size = size;
+    self->header = header;
+    self->records = records;
+
+    return true;
+}
+
+/* Nothing changed since the index was written, no need to look further */
+static bool
+_ww_apps_is_fresh(WwApps *self, const int64_t *dir_mtimes)
+{
+    const char *data = (const char *) self->data;
+    size_t i;
+
+    if ( ( strcmp(data + self->header->locale, self->locale) != 0 ) || ( self->header->dir_count != self->dir_count ) )
+        return false;
+    for ( i = 0 ; i < self->dir_count ; ++i )
+    {
+        if ( ( self->header->dirs[i].mtime != dir_mtimes[i] ) || ( strcmp(data + self->header->dirs[i].path, self->dirs[i]) != 0 ) )
+            return false;
+    }
+
+    /* Files edited in place leave their directory alone */
+    int *dir_fds;
+    bool fresh = true;
+    dir_fds = ww_new0(int, self->dir_count);
+    if ( dir_fds == NULL )
+        return false;
+    for ( i = 0 ; i < self->dir_count ; ++i )
+        dir_fds[i] = open(self->dirs[i], O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    for ( i = 0 ; fresh && ( i < self->header->record_count ) ; ++i )
+    {
+        const WwAppsIndexRecord *record = self->records + i;
+        struct stat st;
+        fresh = ( fstatat(dir_fds[record->dir], data + record->id, &st, 0) == 0 ) && ( _ww_apps_get_mtime(&st) == record->mtime );
+    }
+    for ( i = 0 ; i < self->dir_count ; ++i )
+    {
+        if ( dir_fds[i] >= 0 )
+            close(dir_fds[i]);
+    }
+    free(dir_fds);
+
+    return fresh;
+}
+
+/*
+ * Entries
+ */
+
+static WwAppsEntry *
+_ww_apps_entries_add(WwAppsEntries *entries)
+{
+    if ( entries->count == entries->size )
+    {
+        size_t size = MAX(entries->size * 2, 64);
+        WwAppsEntry *new = realloc(entries->entries, size * sizeof(WwAppsEntry));
+        if ( new == NULL )
+            return NULL;
+        entries->entries = new;
+        entries->size = size;
+    }
+
+    WwAppsEntry *entry = entries->entries + entries->count++;
+    memset(entry, 0, sizeof(WwAppsEntry));
+    return entry;
+}
+
+static void
+_ww_apps_entries_clear(WwAppsEntries *entries)
+{
+    size_t i, s;
+
+    for ( i = 0 ; i < entries->count ; ++i )
+    {
+        if ( ! entries->entries[i].parsed )
+            continue;
+        for ( s = 0 ; s < WW_APPS_STRING_COUNT ; ++s )
+            free((char *) entries->entries[i].strings[s]);
+    }
+    free(entries->entries);
+}
+
+static void
+_ww_apps_entry_from_record(WwApps *self, size_t index, WwAppsEntry *entry)
+{
+    const WwAppsIndexRecord *record = self->records + index;
+    const char *data = (const char *) self->data;
+
+    entry->mtime = record->mtime;
+    entry->dir = record->dir;
+    entry->hidden = ( index >= self->header->count );
+    entry->strings[WW_APPS_STRING_ID] = data + record->id;
+    entry->strings[WW_APPS_STRING_NAME] = data + record->name;
+    entry->strings[WW_APPS_STRING_EXEC] = data + record->exec;
+    entry->strings[WW_APPS_STRING_ICON] = data + record->icon;
+    entry->strings[WW_APPS_STRING_NAME_SEARCH] = data + record->name_search;
+    entry->strings[WW_APPS_STRING_KEYWORDS_SEARCH] = data + record->keywords_search;
+}
+
+typedef struct {
+    WwApps *apps;
+    char *values[WW_APPS_KEY_COUNT];
+    int priorities[WW_APPS_KEY_COUNT];
+} WwAppsParser;
+
+static void
+_ww_apps_parse_entry(void *user_data, const char *key, const char *value)
+{
+    WwAppsParser *parser = user_data;
+    WwApps *self = parser->apps;
+    const char *bracket = strchr(key, '[');
+    size_t key_length = ( bracket != NULL ) ? (size_t) ( bracket - key ) : strlen(key);
+    int priority = 1;
+    size_t k;
+
+    if ( bracket != NULL )
+    {
+        const char *locale = bracket + 1;
+        size_t length = strcspn(locale, "]");
+
+        if ( ( length == 0 ) || ( locale[length] != ']' ) )
+            return;
+        if ( ( strncmp(locale, self->locale, length) == 0 ) && ( self->locale[length] == '\0' ) )
+            priority = 3;
+        else if ( ( length == self->language_length ) && ( strncmp(locale, self->locale, length) == 0 ) )
+            priority = 2;
+        else
+            return;
+    }
+
+    for ( k = 0 ; k < WW_APPS_KEY_COUNT ; ++k )
+    {
+        if ( ( strncmp(key, _ww_apps_keys[k], key_length) == 0 ) && ( _ww_apps_keys[k][key_length] == '\0' ) )
+            break;
+    }
+    if ( ( k == WW_APPS_KEY_COUNT ) || ( priority <= parser->priorities[k] ) )
+        return;
+
+    char *copy = strdup(value);
+    if ( copy == NULL )
+        return;
+    _ww_apps_unescape(copy, ( k == WW_APPS_KEY_KEYWORDS ));
+    free(parser->values[k]);
+    parser->values[k] = copy;
+    parser->priorities[k] = priority;
+}
+
+static char *
+_ww_apps_fold(const char *a, const char *b)
+{
+    size_t size = strlen(a) + 1 + strlen(b) + 1;
+    char *folded;
+
+    folded = malloc(size);
+    if ( folded == NULL )
+        return NULL;
+
+    size_t length = ww_match_fold(folded, a, size);
+    if ( ( length > 0 ) && ( b[0] != '\0' ) )
+        folded[length++] = ' ';
+    ww_match_fold(folded + length, b, size - length);
+
+    return folded;
+}
+
+static bool
+_ww_apps_parse(WwApps *self, uint32_t dir, const char *id, int64_t mtime, WwAppsEntry *entry)
+{
+    WwAppsParser parser = { .apps = self };
+    char *path;
+    bool ret = false;
+    size_t k, s;
+
+    if ( asprintf(&path, "%s/%s", self->dirs[dir], id) < 0 )
+        return false;
+    if ( ! ww_desktop_parse(path, _ww_apps_parse_entry, &parser) )
+        goto end;
+
+    const char *name = parser.values[WW_APPS_KEY_NAME];
+    const char *exec = parser.values[WW_APPS_KEY_EXEC];
+    entry->mtime = mtime;
+    entry->dir = dir;
+    entry->parsed = true;
+    entry->hidden = ( name == NULL ) || ( exec == NULL )
+        || ( parser.values[WW_APPS_KEY_TYPE] == NULL ) || ( strcmp(parser.values[WW_APPS_KEY_TYPE], "Application") != 0 )
+        || ( ( parser.values[WW_APPS_KEY_NO_DISPLAY] != NULL ) && ( strcmp(parser.values[WW_APPS_KEY_NO_DISPLAY], "true") == 0 ) )
+        || ( ( parser.values[WW_APPS_KEY_HIDDEN] != NULL ) && ( strcmp(parser.values[WW_APPS_KEY_HIDDEN], "true") == 0 ) );
+
+    if ( entry->hidden )
+    {
+        /* Only kept for the id and the mtime */
+        entry->strings[WW_APPS_STRING_ID] = strdup(id);
+        for ( s = WW_APPS_STRING_ID + 1 ; s < WW_APPS_STRING_COUNT ; ++s )
+            entry->strings[s] = strdup("");
+    }
+    else
+    {
+        const char *generic_name = parser.values[WW_APPS_KEY_GENERIC_NAME];
+        const char *keywords = parser.values[WW_APPS_KEY_KEYWORDS];
+        const char *icon = parser.values[WW_APPS_KEY_ICON];
+
+        entry->strings[WW_APPS_STRING_ID] = strdup(id);
+        entry->strings[WW_APPS_STRING_NAME] = strdup(name);
+        entry->strings[WW_APPS_STRING_EXEC] = strdup(exec);
+        entry->strings[WW_APPS_STRING_ICON] = strdup(( icon != NULL ) ? icon : "");
+        entry->strings[WW_APPS_STRING_NAME_SEARCH] = _ww_apps_fold(name, "");
+        entry->strings[WW_APPS_STRING_KEYWORDS_SEARCH] = _ww_apps_fold(( generic_name != NULL ) ? generic_name : "", ( keywords != NULL ) ? keywords : "");
+    }
+
+    ret = true;
+    for ( s = 0 ; s < WW_APPS_STRING_COUNT ; ++s )
+        ret = ret && ( entry->strings[s] != NULL );
+    if ( ! ret )
+    {
+        for ( s = 0 ; s < WW_APPS_STRING_COUNT ; ++s )
+            free((char *) entry->strings[s]);
+        entry->parsed = false;
+    }
+
+end:
+    for ( k = 0 ; k < WW_APPS_KEY_COUNT ; ++k )
+        free(parser.values[k]);
+    free(path);
+    return ret;
+}
+
+/*
+ * Writing
+ */
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t allocated;
+    bool failed;
+} WwAppsBuffer;
+
+static uint32_t
+_ww_apps_buffer_add(WwAppsBuffer *buffer, const char *string, size_t padding)
+{
+    size_t length = strlen(string) + 1;
+    size_t offset = buffer->size;
+
+    if ( offset + length + padding > buffer->allocated )
+    {
+        size_t allocated = MAX(buffer->allocated * 2, offset + length + padding);
+        uint8_t *new = realloc(buffer->data, allocated);
+        if ( new == NULL )
+        {
+            buffer->failed = true;
+            return 0;
+        }
+        buffer->data = new;
+        buffer->allocated = allocated;
+    }
+
+    memcpy(buffer->data + offset, string, length);
+    memset(buffer->data + offset + length, 0, padding);
+    buffer->size += length + padding;
+
+    return offset;
+}
+
+static int
+_ww_apps_entry_compare(const void *a_, const void *b_)
+{
+    const WwAppsEntry *a = a_, *b = b_;
+    int r;
+
+    if ( a->hidden != b->hidden )
+        return a->hidden ? 1 : -1;
+    r = strcasecmp(a->strings[WW_APPS_STRING_NAME], b->strings[WW_APPS_STRING_NAME]);
+    if ( r == 0 )
+        r = strcmp(a->strings[WW_APPS_STRING_ID], b->strings[WW_APPS_STRING_ID]);
+    return r;
+}
+
+/* Writes a new file next to the current one, then maps it instead */
+static bool
+_ww_apps_write(WwApps *self, WwAppsEntries *entries, const int64_t *dir_mtimes)
+{
+    size_t start = sizeof(WwAppsIndexHeader) + self->dir_count * sizeof(WwAppsIndexDir) + entries->count * sizeof(WwAppsIndexRecord);
+    WwAppsBuffer buffer = { .size = start };
+    WwAppsIndexHeader *header;
+    WwAppsIndexRecord *records;
+    uint32_t count = 0, locale;
+    size_t i;
+    bool ret = false;
+
+    qsort(entries->entries, entries->count, sizeof(WwAppsEntry), _ww_apps_entry_compare);
+
+    records = ww_new0(WwAppsIndexRecord, MAX(entries->count, 1));
+    if ( records == NULL )
+        return false;
+
+    /* Directory paths come right after the locale */
+    locale = _ww_apps_buffer_add(&buffer, self->locale, 0);
+    for ( i = 0 ; i < self->dir_count ; ++i )
+        _ww_apps_buffer_add(&buffer, self->dirs[i], 0);
+    for ( i = 0 ; i < entries->count ; ++i )
+    {
+        const WwAppsEntry *entry = entries->entries + i;
+        WwAppsIndexRecord *record = records + i;
+
+        if ( ! entry->hidden )
+            ++count;
+        record->mtime = entry->mtime;
+        record->dir = entry->dir;
+        record->id = _ww_apps_buffer_add(&buffer, entry->strings[WW_APPS_STRING_ID], 0);
+        record->name = _ww_apps_buffer_add(&buffer, entry->strings[WW_APPS_STRING_NAME], 0);
+        record->exec = _ww_apps_buffer_add(&buffer, entry->strings[WW_APPS_STRING_EXEC], 0);
+        record->icon = _ww_apps_buffer_add(&buffer, entry->strings[WW_APPS_STRING_ICON], 0);
+        record->name_search_length = strlen(entry->strings[WW_APPS_STRING_NAME_SEARCH]);
+        record->name_search = _ww_apps_buffer_add(&buffer, entry->strings[WW_APPS_STRING_NAME_SEARCH], WW_MATCH_PADDING);
+        record->keywords_search_length = strlen(entry->strings[WW_APPS_STRING_KEYWORDS_SEARCH]);
+        record->keywords_search = _ww_apps_buffer_add(&buffer, entry->strings[WW_APPS_STRING_KEYWORDS_SEARCH], WW_MATCH_PADDING);
+        record->mask = ww_match_get_mask(entry->strings[WW_APPS_STRING_NAME_SEARCH], record->name_search_length)
+            | ww_match_get_mask(entry->strings[WW_APPS_STRING_KEYWORDS_SEARCH], record->keywords_search_length);
+    }
+    if ( buffer.failed || ( buffer.size > UINT32_MAX ) )
+        goto end;
+
+    header = (WwAppsIndexHeader *) buffer.data;
+    memset(header, 0, sizeof(WwAppsIndexHeader));
+    header->magic = WW_APPS_MAGIC;
+    header->version = WW_APPS_VERSION;
+    header->count = count;
+    header->record_count = entries->count;
+    header->dir_count = self->dir_count;
+    header->locale = locale;
+    header->size = buffer.size;
+    uint32_t path = locale + strlen(self->locale) + 1;
+    for ( i = 0 ; i < self->dir_count ; ++i )
+    {
+        header->dirs[i].mtime = dir_mtimes[i];
+        header->dirs[i].path = path;
+        header->dirs[i].padding = 0;
+        path += strlen(self->dirs[i]) + 1;
+    }
+    memcpy(header->dirs + self->dir_count, records, entries->count * sizeof(WwAppsIndexRecord));
+
+    char *temp = NULL;
+    int fd = -1;
+    if ( asprintf(&temp, "%s.XXXXXX", self->path) >= 0 )
+        fd = mkostemp(temp, O_CLOEXEC);
+    if ( fd < 0 )
+    {
+        /* We can still work from memory */
+        ww_warning("Couldn’t create apps index %s: %s", self->path, strerror(errno));
+        free(temp);
+        temp = NULL;
+        fd = memfd_create(PACKAGE_NAME "-apps", MFD_CLOEXEC);
+        if ( fd < 0 )
+            goto end;
+    }
+
+    size_t written = 0;
+    ssize_t r = 0;
+    while ( ( written < buffer.size ) && ( ( r = write(fd, buffer.data + written, buffer.size - written) ) > 0 ) )
+        written += r;
+    if ( ( written == buffer.size ) && ( ( temp == NULL ) || ( rename(temp, self->path) == 0 ) ) )
+        ret = _ww_apps_map(self, fd);
+    else
+    {
+        ww_warning("Couldn’t write apps index %s: %s", self->path, strerror(errno));
+        if ( temp != NULL )
+            unlink(temp);
+    }
+    close(fd);
+    free(temp);
+
+end:
+    free(buffer.data);
+    free(records);
+    return ret;
+}
+
+/*
+ * Scanning
+ */
+
+typedef struct {
+    const char *id;
+    uint32_t dir;
+    int64_t mtime;
+} WwAppsFile;
+
+static int
+_ww_apps_file_compare(const void *a_, const void *b_)
+{
+    const WwAppsFile *a = a_, *b = b_;
+    int r;
+
+    r = strcmp(a->id, b->id);
+    if ( r == 0 )
+        r = ( a->dir > b->dir ) - ( a->dir < b->dir );
+    return r;
+}
+
+static int
+_ww_apps_record_compare(const void *a_, const void *b_, void *user_data)
+{
+    const uint32_t *a = a_, *b = b_;
+    WwApps *self = user_data;
+    const char *data = (const char *) self->data;
+    return strcmp(data + self->records[*a].id, data + self->records[*b].id);
+}
+
+static bool
+_ww_apps_is_desktop_file(const char *name)
+{
+    size_t length = strlen(name);
+    return ( length > strlen(".desktop") ) && ( strcmp(name + length - strlen(".desktop"), ".desktop") == 0 );
+}
+
+/* Every file is listed, only the ones with a new mtime are parsed */
+static bool
+_ww_apps_scan(WwApps *self, WwAppsEntries *entries)
+{
+    WwAppsFile *files = NULL;
+    size_t file_count = 0, file_size = 0, i;
+    uint32_t *old = NULL;
+    size_t old_count = 0;
+    bool ret = false;
+
+    for ( i = 0 ; i < self->dir_count ; ++i )
+    {
+        DIR *dir;
+        struct dirent *d;
+
+        dir = opendir(self->dirs[i]);
+        if ( dir == NULL )
+            continue;
+        while ( ( d = readdir(dir) ) != NULL )
+        {
+            struct stat st;
+
+            if ( ( d->d_type == DT_DIR ) || ( ! _ww_apps_is_desktop_file(d->d_name) ) )
+                continue;
+            if ( ( fstatat(dirfd(dir), d->d_name, &st, 0) < 0 ) || ( ! S_ISREG(st.st_mode) ) )
+                continue;
+
+            if ( file_count == file_size )
+            {
+                file_size = MAX(file_size * 2, 256);
+                WwAppsFile *new = realloc(files, file_size * sizeof(WwAppsFile));
+                if ( new == NULL )
+                {
+                    closedir(dir);
+                    goto end;
+                }
+                files = new;
+            }
+            files[file_count].id = strdup(d->d_name);
+            files[file_count].dir = i;
+            files[file_count].mtime = _ww_apps_get_mtime(&st);
+            if ( files[file_count++].id == NULL )
+            {
+                closedir(dir);
+                goto end;
+            }
+        }
+        closedir(dir);
+    }
+    qsort(files, file_count, sizeof(WwAppsFile), _ww_apps_file_compare);
+
+    if ( self->header != NULL )
+    {
+        old_count = self->header->record_count;
+        old = ww_new0(uint32_t, MAX(old_count, 1));
+        if ( old == NULL )
+            goto end;
+        for ( i = 0 ; i < old_count ; ++i )
+            old[i] = i;
+        qsort_r(old, old_count, sizeof(uint32_t), _ww_apps_record_compare, self);
+    }
+
+    const char *data = (const char *) self->data;
+    size_t o = 0;
+    for ( i = 0 ; i < file_count ; ++i )
+    {
+        const WwAppsFile *file = files + i;
+        WwAppsEntry *entry;
+
+        /* The first one is from the most important directory */
+        if ( ( i > 0 ) && ( strcmp(file->id, files[i - 1].id) == 0 ) )
+            continue;
+
+        /* Both lists are sorted by id */
+        while ( ( o < old_count ) && ( strcmp(data + self->records[old[o]].id, file->id) < 0 ) )
+            ++o;
+
+        entry = _ww_apps_entries_add(entries);
+        if ( entry == NULL )
+            goto end;
+
+        if ( ( o < old_count ) && ( strcmp(data + self->records[old[o]].id, file->id) == 0 ) )
+        {
+            const WwAppsIndexRecord *record = self->records + old[o];
+            if ( ( record->mtime == file->mtime ) && ( strcmp(data + self->header->dirs[record->dir].path, self->dirs[file->dir]) == 0 ) )
+            {
+                _ww_apps_entry_from_record(self, old[o], entry);
+                entry->dir = file->dir;
+                continue;
+            }
+        }
+
+        if ( ! _ww_apps_parse(self, file->dir, file->id, file->mtime, entry) )
+            --entries->count;
+    }
+
+    ret = true;
+
+end:
+    for ( i = 0 ; i < file_count ; ++i )
+        free((char *) files[i].id);
+    free(files);
+    free(old);
+    return ret;
+}
+
+static bool
+_ww_apps_is_changed(char **changed, size_t changed_count, const char *id)
+{
+    size_t i;
+
+    for ( i = 0 ; i < changed_count ; ++i )
+    {
+        if ( strcmp(changed[i], id) == 0 )
+            return true;
+    }
+    return false;
+}
+
+/* Only changed ids are resolved again, from the most important directory */
+static bool
+_ww_apps_rescan(WwApps *self, WwAppsEntries *entries, char **changed, size_t changed_count)
+{
+    const char *data = (const char *) self->data;
+    size_t i, d;
+
+    for ( i = 0 ; i < self->header->record_count ; ++i )
+    {
+        if ( _ww_apps_is_changed(changed, changed_count, data + self->records[i].id) )
+            continue;
+
+        WwAppsEntry *entry = _ww_apps_entries_add(entries);
+        if ( entry == NULL )
+            return false;
+        _ww_apps_entry_from_record(self, i, entry);
+    }
+
+    for ( i = 0 ; i < changed_count ; ++i )
+    {
+        for ( d = 0 ; d < self->dir_count ; ++d )
+        {
+            struct stat st;
+            char *path;
+            int r;
+
+            if ( asprintf(&path, "%s/%s", self->dirs[d], changed[i]) < 0 )
+                return false;
+            r = stat(path, &st);
+            free(path);
+            if ( ( r < 0 ) || ( ! S_ISREG(st.st_mode) ) )
+                continue;
+
+            WwAppsEntry *entry = _ww_apps_entries_add(entries);
+            if ( entry == NULL )
+                return false;
+            if ( ! _ww_apps_parse(self, d, changed[i], _ww_apps_get_mtime(&st), entry) )
+                --entries->count;
+            break;
+        }
+    }
+
+    return true;
+}
+
+/* changed NULL for a full scan */
+static bool
+_ww_apps_update(WwApps *self, const int64_t *dir_mtimes, char **changed, size_t changed_count)
+{
+    WwAppsEntries entries = { .entries = NULL };
+    uint8_t *old_data = self->data;
+    size_t old_size = self->size;
+    bool ret;
+
+    if ( ( changed != NULL ) && ( self->header != NULL ) )
+        ret = _ww_apps_rescan(self, &entries, changed, changed_count);
+    else
+        ret = _ww_apps_scan(self, &entries);
+
+    /* Reused entries point to the old mapping */
+    if ( ret )
+    {
+        self->data = NULL;
+        ret = _ww_apps_write(self, &entries, dir_mtimes);
+        if ( ! ret )
+            self->data = old_data;
+        else if ( old_data != NULL )
+            munmap(old_data, old_size);
+    }
+    _ww_apps_entries_clear(&entries);
+
+    return ret;
+}
+
+static void
+_ww_apps_watch_callback(void *user_data, uint32_t events)
+{
+    WwApps *self = user_data;
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    char **changed = NULL;
+    size_t changed_count = 0;
+    bool full = false;
+    ssize_t r;
+
+    /* Package managers touch many files at once, we update once for all of them */
+    while ( ( r = read(self->inotify_fd, buffer, sizeof(buffer)) ) > 0 )
+    {
+        const struct inotify_event *event;
+        char *p;
+        for ( p = buffer ; p < buffer + r ; p += sizeof(struct inotify_event) + event->len )
+        {
+            event = (const struct inotify_event *) p;
+            if ( event->mask & ( IN_Q_OVERFLOW | IN_DELETE_SELF | IN_MOVE_SELF ) )
+                full = true;
+            if ( full || ( event->len == 0 ) || ( event->mask & IN_ISDIR ) || ( ! _ww_apps_is_desktop_file(event->name) ) || _ww_apps_is_changed(changed, changed_count, event->name) )
+                continue;
+
+            char **new = realloc(changed, ( changed_count + 1 ) * sizeof(char *));
+            if ( new == NULL )
+            {
+                full = true;
+                continue;
+            }
+            changed = new;
+            changed[changed_count] = strdup(event->name);
+            if ( changed[changed_count] == NULL )
+                full = true;
+            else
+                ++changed_count;
+        }
+    }
+
+    if ( full || ( changed_count > 0 ) )
+    {
+        int64_t *dir_mtimes = ww_new0(int64_t, self->dir_count);
+        if ( dir_mtimes != NULL )
+        {
+            _ww_apps_get_dir_mtimes(self, dir_mtimes);
+            if ( _ww_apps_update(self, dir_mtimes, full ? NULL : changed, changed_count) )
+                self->callback(self->user_data);
+            free(dir_mtimes);
+        }
+    }
+
+    while ( changed_count > 0 )
+        free(changed[--changed_count]);
+    free(changed);
+}
+
+static bool
+_ww_apps_watch(WwApps *self, WwLoop *loop)
+{
+    size_t i;
+
+    self->watches = ww_new0(int, self->dir_count);
+    if ( self->watches == NULL )
+        return false;
+
+    self->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if ( self->inotify_fd < 0 )
+    {
+        ww_warning("Couldn’t create inotify fd: %s", strerror(errno));
+        return false;
+    }
+
+    /* Missing directories are not watched for their creation */
+    for ( i = 0 ; i < self->dir_count ; ++i )
+        self->watches[i] = inotify_add_watch(self->inotify_fd, self->dirs[i], IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+
+    self->source = ww_loop_add_fd(loop, self->inotify_fd, EPOLLIN, _ww_apps_watch_callback, self);
+    return ( self->source != NULL );
+}
+
+WwApps *
+ww_apps_new(const char * const *dirs, const char *path, WwLoop *loop, WwAppsChangedCallback callback, void *user_data)
+{
+    WwApps *self;
+    int64_t *dir_mtimes = NULL;
+    size_t i;
+    int fd;
+
+    self = ww_new0(WwApps, 1);
+    if ( self == NULL )
+        return NULL;
+    self->inotify_fd = -1;
+    self->callback = callback;
+    self->user_data = user_data;
+
+    if ( dirs != NULL )
+    {
+        while ( dirs[self->dir_count] != NULL )
+            ++self->dir_count;
+        self->dirs = ww_new0(char *, self->dir_count + 1);
+        for ( i = 0 ; ( self->dirs != NULL ) && ( i < self->dir_count ) ; ++i )
+        {
+            self->dirs[i] = strdup(dirs[i]);
+            if ( self->dirs[i] == NULL )
+                goto fail;
+        }
+    }
+    else
+    {
+        self->dirs = ww_desktop_get_data_dirs("applications");
+        while ( ( self->dirs != NULL ) && ( self->dirs[self->dir_count] != NULL ) )
+            ++self->dir_count;
+    }
+    self->path = ( path != NULL ) ? strdup(path) : ww_desktop_get_cache_path("apps.index");
+    self->locale = _ww_apps_get_locale(&self->language_length);
+    dir_mtimes = ww_new0(int64_t, MAX(self->dir_count, 1));
+    if ( ( self->dirs == NULL ) || ( self->path == NULL ) || ( self->locale == NULL ) || ( dir_mtimes == NULL ) )
+        goto fail;
+
+    /* Watch first, so that nothing happens unnoticed after the scan */
+    if ( ( loop != NULL ) && ( ! _ww_apps_watch(self, loop) ) )
+        goto fail;
+
+    _ww_apps_get_dir_mtimes(self, dir_mtimes);
+    fd = open(self->path, O_RDONLY | O_CLOEXEC);
+    if ( fd >= 0 )
+    {
+        _ww_apps_map(self, fd);
+        close(fd);
+    }
+    if ( ( ( self->data == NULL ) || ( ! _ww_apps_is_fresh(self, dir_mtimes) ) ) && ( ! _ww_apps_update(self, dir_mtimes, NULL, 0) ) )
+        goto fail;
+    free(dir_mtimes);
+
+    return self;
+
+fail:
+    free(dir_mtimes);
+    ww_apps_free(self);
+    return NULL;
+}
+
+void
+ww_apps_free(WwApps *self)
+{
+    if ( self == NULL )
+        return;
+
+    _ww_apps_unmap(self);
+    if ( self->source != NULL )
+        ww_loop_source_free(self->source);
+    if ( self->inotify_fd >= 0 )
+        close(self->inotify_fd);
+    free(self->watches);
+    free(self->locale);
+    free(self->path);
+    ww_desktop_free_data_dirs(self->dirs);
+
+    free(self);
+}
+
+size_t
+ww_apps_get_count(WwApps *self)
+{
+    return self->header->count;
+}
+
+void
+ww_apps_get(WwApps *self, size_t index, WwApp *app)
+{
+    const WwAppsIndexRecord *record = self->records + index;
+    const char *data = (const char *) self->data;
+
+    app->id = data + record->id;
+    app->name = data + record->name;
+    app->exec = data + record->exec;
+    app->icon = data + record->icon;
+}
+
+size_t
+ww_apps_match(WwApps *self, const char *query, size_t *indices, size_t count)
+{
+    char folded[WW_APPS_QUERY_SIZE];
+    const char *words[WW_APPS_MAX_WORDS];
+    size_t lengths[WW_APPS_MAX_WORDS];
+    size_t word_count = 0, n = 0, i, w;
+    uint64_t mask = 0;
+    int32_t *scores;
+    char *word;
+
+    if ( count == 0 )
+        return 0;
+
+    ww_match_fold(folded, query, sizeof(folded));
+    for ( word = folded ; ( word_count < WW_APPS_MAX_WORDS ) && ( *( word += strspn(word, " ") ) != '\0' ) ; word += lengths[word_count++] )
+    {
+        words[word_count] = word;
+        lengths[word_count] = strcspn(word, " ");
+        mask |= ww_match_get_mask(word, lengths[word_count]);
+    }
+
+    if ( word_count == 0 )
+    {
+        for ( n = 0 ; ( n < count ) && ( n < self->header->count ) ; ++n )
+            indices[n] = n;
+        return n;
+    }
+
+    scores = ww_new0(int32_t, count);
+    if ( scores == NULL )
+        return 0;
+
+    for ( i = 0 ; i < self->header->count ; ++i )
+    {
+        const WwAppsIndexRecord *record = self->records + i;
+        const char *data = (const char *) self->data;
+        int32_t score = 0;
+
+        if ( ( record->mask & mask ) != mask )
+            continue;
+
+        for ( w = 0 ; w < word_count ; ++w )
+        {
+            int32_t name = 2 * ww_match_score(data + record->name_search, record->name_search_length, words[w], lengths[w]);
+            int32_t keywords = ww_match_score(data + record->keywords_search, record->keywords_search_length, words[w], lengths[w]);
+            if ( ( name == 0 ) && ( keywords == 0 ) )
+                break;
+            score += MAX(name, keywords);
+        }
+        if ( ( w < word_count ) || ( ( n == count ) && ( score <= scores[n - 1] ) ) )
+            continue;
+
+        /* Ties keep the name order */
+        size_t j = ( n < count ) ? n++ : n - 1;
+        for ( ; ( j > 0 ) && ( scores[j - 1] < score ) ; --j )
+        {
+            scores[j] = scores[j - 1];
+            indices[j] = indices[j - 1];
+        }
+        scores[j] = score;
+        indices[j] = i;
+    }
+
+    free(scores);
+    return n;
+}
+
+bool
+ww_apps_launch(WwApps *self, size_t index)
+{
+    const char *exec = (const char *) self->data + self->records[index].exec;
+    char *command, *d;
+    const char *s;
+    pid_t pid;
+
+    command = malloc(strlen(exec) + 1);
+    if ( command == NULL )
+        return false;
+
+    /* Field codes expand to nothing, we never pass files or URLs */
+    for ( s = exec, d = command ; *s != '\0' ; ++s )
+    {
+        if ( *s != '%' )
+            *d++ = *s;
+        else if ( *++s == '%' )
+            *d++ = '%';
+        else if ( *s == '\0' )
+            break;
+    }
+    *d = '\0';
+
+    /* Double fork so that the app is neither our child nor in our session */
+    pid = fork();
+    if ( pid == 0 )
+    {
+        setsid();
+        pid = fork();
+        if ( pid == 0 )
+        {
+            /* Our SIGUSR1 is blocked for the stats signalfd, the app must not inherit that */
+            sigset_t mask;
+            sigemptyset(&mask);
+            sigprocmask(SIG_SETMASK, &mask, NULL);
+            execl("/bin/sh", "sh", "-c", command, (char *) NULL);
+            _exit(127);
+        }
+        _exit(( pid < 0 ) ? 1 : 0);
+    }
+    free(command);
+    if ( pid < 0 )
+    {
+        ww_warning("Couldn’t launch %s: %s", exec, strerror(errno));
+        return false;
+    }
+
+    int status;
+    if ( ( waitpid(pid, &status, 0) < 0 ) || ( ! WIFEXITED(status) ) || ( WEXITSTATUS(status) != 0 ) )
+    {
+        ww_warning("Couldn’t launch %s", exec);
+        return false;
+    }
+
+    return true;
+}
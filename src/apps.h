@@ -0,0 +1,65 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#ifndef __WW_APPS_H__
+#define __WW_APPS_H__
+
+#include "helpers.h"
+#include "loop.h"
+
+typedef struct _WwApps WwApps;
+
+typedef void (*WwAppsChangedCallback)(void *user_data);
+
+typedef struct {
+    const char *id;
+    const char *name;
+    const char *exec;
+    const char *icon;
+} WwApp;
+
+/*
+ * The desktop entries of dirs, most important first, in a mapped index file
+ * The index is used as is while the locale and the mtimes it recorded still
+ * hold, otherwise only the changed files are parsed again
+ * dirs NULL is the XDG “applications” dirs
+ * path NULL is $XDG_CACHE_HOME/wayland-wall/apps.index
+ * With a loop, dirs are watched and callback is called after each update
+ */
+WwApps *ww_apps_new(const char * const *dirs, const char *path, WwLoop *loop, WwAppsChangedCallback callback, void *user_data);
+void ww_apps_free(WwApps *self);
+
+/* Sorted by name, strings are valid until the next update */
+size_t ww_apps_get_count(WwApps *self);
+void ww_apps_get(WwApps *self, size_t index, WwApp *app);
+
+/*
+ * Fills indices with the best count matches, best first, and returns how many
+ * Each word of query must match the name or the keywords, names score double
+ * An empty query gives the first apps
+ */
+size_t ww_apps_match(WwApps *self, const char *query, size_t *indices, size_t count);
+
+/* Runs Exec without field codes, detached from us */
+bool ww_apps_launch(WwApps *self, size_t index);
+
+#endif /* __WW_APPS_H__ */
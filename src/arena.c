@@ -0,0 +1,272 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/* For memfd_create() and fallocate() */
+#define _GNU_SOURCE
+
+#include "helpers.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <pthread.h>
+
+#include "stats.h"
+#include "arena.h"
+
+typedef struct {
+    struct wl_list link;
+    size_t offset;
+    size_t size;
+} WwArenaRange;
+
+struct _WwArena {
+    pthread_mutex_t mutex;
+    struct wl_shm *shm;
+    int fd;
+    uint8_t *data;
+    size_t reserve;
+    size_t size;
+    size_t page_size;
+    struct wl_shm_pool *pool;
+    /* Sorted by offset, neighbours are always merged */
+    struct wl_list free_ranges;
+};
+
+WwArena *
+ww_arena_new(struct wl_shm *shm, size_t reserve)
+{
+    WwArena *self;
+
+    self = ww_new0(WwArena, 1);
+    if ( self == NULL )
+        return NULL;
+
+    pthread_mutex_init(&self->mutex, NULL);
+    self->shm = shm;
+    self->page_size = sysconf(_SC_PAGESIZE);
+    self->reserve = reserve;
+    wl_list_init(&self->free_ranges);
+
+    self->fd = memfd_create(PACKAGE_NAME "-arena", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if ( self->fd < 0 )
+    {
+        ww_warning("Couldn’t create arena file: %s", strerror(errno));
+        free(self);
+        return NULL;
+    }
+    /* The compositor must never see the file shrink under its feet */
+    fcntl(self->fd, F_ADD_SEALS, F_SEAL_SHRINK);
+
+    /* Address space only, we never touch it past the file size */
+    self->data = mmap(NULL, reserve, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE, self->fd, 0);
+    if ( self->data == MAP_FAILED )
+    {
+        ww_warning("Couldn’t reserve %zu B for the arena: %s", reserve, strerror(errno));
+        close(self->fd);
+        free(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+void
+ww_arena_free(WwArena *self)
+{
+    WwArenaRange *range, *tmp;
+    wl_list_for_each_safe(range, tmp, &self->free_ranges, link)
+        free(range);
+
+    if ( self->pool != NULL )
+        wl_shm_pool_destroy(self->pool);
+    munmap(self->data, self->reserve);
+    close(self->fd);
+    pthread_mutex_destroy(&self->mutex);
+
+    free(self);
+}
+
+static bool
+_ww_arena_grow(WwArena *self, size_t size)
+{
+    if ( size > self->reserve )
+    {
+        ww_warning("Arena full: %zu B needed, %zu B reserved", size, self->reserve);
+        return false;
+    }
+
+    if ( ftruncate(self->fd, size) < 0 )
+    {
+        ww_warning("Couldn’t grow arena to %zu B: %s", size, strerror(errno));
+        return false;
+    }
+
+    if ( self->pool == NULL )
+    {
+        self->pool = wl_shm_create_pool(self->shm, self->fd, size);
+        ww_stats_add(WW_STATS_POOLS_CREATED, 1);
+    }
+    else
+        wl_shm_pool_resize(self->pool, size);
+    self->size = size;
+
+    return true;
+}
+
+static void
+_ww_arena_range_take(WwArenaRange *range, size_t size, WwArenaBlock *block)
+{
+    block->offset = range->offset;
+    range->offset += size;
+    range->size -= size;
+    if ( range->size == 0 )
+    {
+        wl_list_remove(&range->link);
+        free(range);
+    }
+}
+
+static bool
+_ww_arena_alloc(WwArena *self, size_t size, WwArenaBlock *block)
+{
+    size = ( size + self->page_size - 1 ) & ~( self->page_size - 1 );
+
+    WwArenaRange *range, *last = NULL;
+    wl_list_for_each(range, &self->free_ranges, link)
+    {
+        last = range;
+        if ( range->size < size )
+            continue;
+
+        _ww_arena_range_take(range, size, block);
+        goto found;
+    }
+
+    /* Nothing fits, we grow the file, reusing a free tail */
+    if ( ( last != NULL ) && ( last->offset + last->size == self->size ) )
+    {
+        if ( ! _ww_arena_grow(self, last->offset + size) )
+            return false;
+        last->size = size;
+        _ww_arena_range_take(last, size, block);
+    }
+    else
+    {
+        block->offset = self->size;
+        if ( ! _ww_arena_grow(self, self->size + size) )
+            return false;
+    }
+
+found:
+    block->size = size;
+    block->data = self->data + block->offset;
+    ww_stats_add(WW_STATS_BYTES_MAPPED, size);
+
+    return true;
+}
+
+bool
+ww_arena_alloc(WwArena *self, size_t size, WwArenaBlock *block)
+{
+    bool ret;
+
+    pthread_mutex_lock(&self->mutex);
+    ret = _ww_arena_alloc(self, size, block);
+    pthread_mutex_unlock(&self->mutex);
+
+    return ret;
+}
+
+static void
+_ww_arena_release(WwArena *self, WwArenaBlock *block)
+{
+    if ( fallocate(self->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, block->offset, block->size) < 0 )
+        ww_warning("Couldn’t release arena pages: %s", strerror(errno));
+    ww_stats_add(WW_STATS_BYTES_MAPPED, -(int64_t) block->size);
+
+    WwArenaRange *range, *next = NULL;
+    wl_list_for_each(range, &self->free_ranges, link)
+    {
+        if ( range->offset > block->offset )
+        {
+            next = range;
+            break;
+        }
+    }
+
+    struct wl_list *prev_link = ( next != NULL ) ? next->link.prev : self->free_ranges.prev;
+    WwArenaRange *prev = ( prev_link != &self->free_ranges ) ? wl_container_of(prev_link, prev, link) : NULL;
+
+    if ( ( prev != NULL ) && ( prev->offset + prev->size == block->offset ) )
+    {
+        prev->size += block->size;
+        if ( ( next != NULL ) && ( prev->offset + prev->size == next->offset ) )
+        {
+            prev->size += next->size;
+            wl_list_remove(&next->link);
+            free(next);
+        }
+    }
+    else if ( ( next != NULL ) && ( block->offset + block->size == next->offset ) )
+    {
+        next->offset = block->offset;
+        next->size += block->size;
+    }
+    else
+    {
+        range = ww_new0(WwArenaRange, 1);
+        if ( range == NULL )
+            return;
+        range->offset = block->offset;
+        range->size = block->size;
+        wl_list_insert(prev_link, &range->link);
+    }
+}
+
+void
+ww_arena_release(WwArena *self, WwArenaBlock *block)
+{
+    pthread_mutex_lock(&self->mutex);
+    _ww_arena_release(self, block);
+    pthread_mutex_unlock(&self->mutex);
+
+    block->data = NULL;
+}
+
+struct wl_buffer *
+ww_arena_create_buffer(WwArena *self, WwArenaBlock *block, size_t offset, int32_t width, int32_t height, int32_t stride, uint32_t format, struct wl_event_queue *queue)
+{
+    if ( queue == NULL )
+        return wl_shm_pool_create_buffer(self->pool, block->offset + offset, width, height, stride, format);
+
+    /* The buffer is born on the queue, no release can be dispatched elsewhere */
+    struct wl_shm_pool *pool;
+    struct wl_buffer *buffer;
+
+    pool = wl_proxy_create_wrapper(self->pool);
+    wl_proxy_set_queue((struct wl_proxy *) pool, queue);
+    buffer = wl_shm_pool_create_buffer(pool, block->offset + offset, width, height, stride, format);
+    wl_proxy_wrapper_destroy(pool);
+
+    return buffer;
+}
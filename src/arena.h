@@ -0,0 +1,52 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef __WW_ARENA_H__
+#define __WW_ARENA_H__
+
+#include "helpers.h"
+
+typedef struct _WwArena WwArena;
+
+typedef struct {
+    size_t offset;
+    size_t size;
+    uint8_t *data;
+} WwArenaBlock;
+
+/*
+ * One memfd and wl_shm_pool for all our buffers
+ * We reserve the address space once and grow the file within it
+ * Safe to use from several threads
+ */
+WwArena *ww_arena_new(struct wl_shm *shm, size_t reserve);
+void ww_arena_free(WwArena *self);
+
+/* Blocks are page-aligned, freed blocks give their pages back to the system */
+bool ww_arena_alloc(WwArena *self, size_t size, WwArenaBlock *block);
+void ww_arena_release(WwArena *self, WwArenaBlock *block);
+
+/* queue is where the buffer events go, NULL for the default one */
+struct wl_buffer *ww_arena_create_buffer(WwArena *self, WwArenaBlock *block, size_t offset, int32_t width, int32_t height, int32_t stride, uint32_t format, struct wl_event_queue *queue);
+
+#endif /* __WW_ARENA_H__ */
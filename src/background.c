@@ -23,11 +23,13 @@
 
 #include "helpers.h"
 
-#include <sys/stat.h>
+#include <inttypes.h>
+#include <getopt.h>
 #include <fcntl.h>
-#include <sys/mman.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif /* __GLIBC__ */
 
-#include <wayland-cursor.h>
 #ifdef ENABLE_IMAGES
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #if ( ( GDK_PIXBUF_MAJOR < 2 ) || ( ( GDK_PIXBUF_MAJOR == 2 ) && ( GDK_PIXBUF_MINOR < 32 ) ) )
@@ -36,70 +38,96 @@ static inline const guchar *gdk_pixbuf_read_pixels(GdkPixbuf *pixbuf) { return g
 #endif /* ENABLE_IMAGES */
 #include "viewporter-client-protocol.h"
 #include "background-unstable-v2-client-protocol.h"
+#include "client.h"
+#include "loop.h"
+#include "settings.h"
+#include "format.h"
+#include "pattern.h"
+#include "stats.h"
+#include "role.h"
 
 /* Supported interface versions */
-#define WL_COMPOSITOR_INTERFACE_VERSION 3
 #define WL_SUBCOMPOSITOR_INTERFACE_VERSION 1
 #define WW_BACKGROUND_INTERFACE_VERSION 1
-#define WL_SHM_INTERFACE_VERSION 1
-#define WL_SEAT_INTERFACE_VERSION 5
-#define WL_OUTPUT_INTERFACE_VERSION 2
 #define WP_VIEWPORTER_INTERFACE_VERSION 1
 
+/* The median of these is printed for each thread count */
+#define WW_BACKGROUND_BENCH_RENDERS 9
+
 typedef enum {
-    WW_BACKGROUND_GLOBAL_COMPOSITOR,
-    WW_BACKGROUND_GLOBAL_SUBCOMPOSITOR,
-    WW_BACKGROUND_GLOBAL_BACKGROUND,
-    WW_BACKGROUND_GLOBAL_SHM,
-    WW_BACKGROUND_GLOBAL_VIEWPORTER,
-    _WW_BACKGROUND_GLOBAL_SIZE,
-} WwBackgroundGlobalName;
+    WW_BACKGROUND_RELEASE_NEVER,
+    WW_BACKGROUND_RELEASE_IDLE,
+    WW_BACKGROUND_RELEASE_PRESSURE,
+} WwBackgroundReleaseMode;
+
+static const char * const _ww_background_release_mode_names[] = {
+    [WW_BACKGROUND_RELEASE_NEVER] = "never",
+    [WW_BACKGROUND_RELEASE_IDLE] = "idle",
+    [WW_BACKGROUND_RELEASE_PRESSURE] = "pressure",
+};
 
 typedef struct {
+    WwClient *client;
     bool to_free;
+    WwArenaBlock block;
+    WwFormat format;
+    int32_t width;
+    int32_t height;
+    int32_t stride;
     struct wl_buffer *buffer;
     bool released;
+    int64_t attach_time;
 #ifdef ENABLE_IMAGES
+    WwFormat image_format;
+    int32_t image_width;
+    int32_t image_height;
+    int32_t image_stride;
     struct wl_buffer *image_buffer;
     bool image_released;
 #endif /* ENABLE_IMAGES */
 } WwBackgroundBuffer;
 
 typedef struct {
-    char runtime_dir[PATH_MAX];
-    struct wl_display *display;
-    struct wl_registry *registry;
-    uint32_t global_names[_WW_BACKGROUND_GLOBAL_SIZE];
-    struct wl_compositor *compositor;
+    WwColour colour;
+    char *gradient;
+    double noise;
+#ifdef ENABLE_IMAGES
+    char *image;
+#endif /* ENABLE_IMAGES */
+} WwBackgroundSettings;
+
+typedef struct {
+    WwClient *client;
     struct wl_subcompositor *subcompositor;
     struct zww_background_v2 *background;
-    struct wl_shm *shm;
+    bool low_memory;
+    WwBackgroundReleaseMode release_mode;
+    int pressure_fd;
+    WwLoopSource *pressure_source;
     struct wp_viewporter *viewporter;
-    struct {
-        char *theme_name;
-        char **name;
-        struct wl_cursor_theme *theme;
-        struct wl_cursor *cursor;
-        struct wl_cursor_image *image;
-        struct wl_surface *surface;
-        struct wl_callback *frame_cb;
-    } cursor;
-    struct wl_list seats;
-    struct wl_list outputs;
+    struct wl_list surfaces;
+    WwHash surfaces_by_output;
+    char *cursor_theme;
+    char *settings_path;
+    WwSettingsWatch *settings_watch;
+    WwBackgroundSettings defaults;
+    WwBackgroundSettings settings;
 #ifdef ENABLE_IMAGES
-    char *image;
     bool image_scalable;
     GdkPixbuf *pixbuf;
 #endif /* ENABLE_IMAGES */
     int32_t width;
     int32_t height;
-    WwColour colour;
+    size_t thread_count;
+    bool bench;
+    WwPattern *pattern;
     WwBackgroundBuffer *buffer;
 } WwBackgroundContext;
 
-typedef struct _WwBackgroundOutput WwBackgroundOutput;
-typedef struct  {
-    WwBackgroundOutput *output;
+typedef struct {
+    WwBackgroundContext *context;
+    struct wl_list link;
+    WwClientOutput *output;
     int32_t width;
     int32_t height;
     struct wl_surface *surface;
@@ -111,25 +139,6 @@ typedef struct  {
 #endif /* ENABLE_IMAGES */
 } WwBackgroundSurface;
 
-typedef struct {
-    WwBackgroundContext *context;
-    struct wl_list link;
-    uint32_t global_name;
-    struct wl_seat *seat;
-    struct wl_pointer *pointer;
-} WwBackgroundSeat;
-
-struct _WwBackgroundOutput {
-    WwBackgroundContext *context;
-    struct wl_list link;
-    uint32_t global_name;
-    struct wl_output *output;
-    int32_t width;
-    int32_t height;
-    int32_t scale;
-    WwBackgroundSurface *surface;
-};
-
 static void
 _ww_background_buffer_cleanup(WwBackgroundBuffer *self)
 {
@@ -157,6 +166,11 @@ _ww_background_buffer_cleanup(WwBackgroundBuffer *self)
     if ( count > 0 )
         return;
 
+    ww_stats_add(WW_STATS_BYTES_ARGB8888 + self->format, -(int64_t) self->height * self->stride);
+#ifdef ENABLE_IMAGES
+    ww_stats_add(WW_STATS_BYTES_ARGB8888 + self->image_format, -(int64_t) self->image_height * self->image_stride);
+#endif /* ENABLE_IMAGES */
+    ww_client_shm_release(self->client, &self->block);
     free(self);
 }
 
@@ -165,6 +179,7 @@ _ww_background_buffer_release(void *data, struct wl_buffer *buf)
 {
     WwBackgroundBuffer *self = data;
 
+    ww_stats_buffer_released(self->attach_time);
     if ( self->buffer == buf )
         self->released = true;
 #ifdef ENABLE_IMAGES
@@ -190,19 +205,21 @@ _ww_background_surface_update(WwBackgroundSurface *self, WwBackgroundBuffer *buf
 {
     struct wl_region *region;
 
+    buffer->attach_time = ww_stats_now();
     wl_surface_attach(self->surface, buffer->buffer, 0, 0);
+    wl_surface_damage(self->surface, 0, 0, INT32_MAX, INT32_MAX);
     if ( wl_surface_get_version(self->surface) >= WL_SURFACE_SET_BUFFER_SCALE_SINCE_VERSION )
         wl_surface_set_buffer_scale(self->surface, self->output->scale);
-    region = wl_compositor_create_region(self->output->context->compositor);
+    region = wl_compositor_create_region(self->context->client->compositor);
     wl_region_add(region, 0, 0, self->output->width, self->output->height);
     wl_surface_set_opaque_region(self->surface, region);
 
 #ifdef ENABLE_IMAGES
-    if ( self->output->context->pixbuf != NULL )
+    if ( buffer->image_buffer != NULL )
     {
         int image_width, image_height;
-        image_width = gdk_pixbuf_get_width(self->output->context->pixbuf);
-        image_height = gdk_pixbuf_get_height(self->output->context->pixbuf);
+        image_width = buffer->image_width;
+        image_height = buffer->image_height;
 
         if ( self->image_viewport != NULL )
         {
@@ -216,12 +233,14 @@ _ww_background_surface_update(WwBackgroundSurface *self, WwBackgroundBuffer *buf
         }
 
         wl_surface_attach(self->image_surface, buffer->image_buffer, 0, 0);
+        wl_surface_damage(self->image_surface, 0, 0, INT32_MAX, INT32_MAX);
         if ( wl_surface_get_version(self->image_surface) >= WL_SURFACE_SET_BUFFER_SCALE_SINCE_VERSION )
             wl_surface_set_buffer_scale(self->image_surface, self->output->scale);
 
         wl_subsurface_set_position(self->image_subsurface, self->output->width / 2 - image_width / 2, self->output->height / 2 - image_height / 2);
 
         wl_surface_commit(self->image_surface);
+        ww_stats_committed();
     }
 #endif /* ENABLE_IMAGES */
 
@@ -229,145 +248,212 @@ _ww_background_surface_update(WwBackgroundSurface *self, WwBackgroundBuffer *buf
         wp_viewport_set_source(self->viewport, 0, 0, wl_fixed_from_int(self->output->width), wl_fixed_from_int(self->output->height));
 
     wl_surface_commit(self->surface);
+    ww_stats_committed();
     wl_region_destroy(region);
 
-    zww_background_v2_set_background(self->output->context->background, self->surface, self->output->output);
+    zww_background_v2_set_background(self->context->background, self->surface, self->output->output);
 }
 
-#if BYTE_ORDER == BIG_ENDIAN
-#define RED_BYTE 1
-#define GREEN_BYTE 2
-#define BLUE_BYTE 3
-#define ALPHA_BYTE 0
-#else
-#define RED_BYTE 2
-#define GREEN_BYTE 1
-#define BLUE_BYTE 0
-#define ALPHA_BYTE 3
-#endif
-
-static bool
-_ww_background_create_buffer(WwBackgroundContext *self, int32_t width, int32_t height)
+static void
+_ww_background_draw_background(WwBackgroundContext *self, WwBackgroundBuffer *buffer)
 {
-    struct wl_shm_pool *pool;
-    struct wl_buffer *buffer;
-    int fd;
-    uint8_t *data;
-    int32_t stride;
-    size_t size;
-
-    stride = 4 * width;
-    size = stride * height;
+    ww_stats_add(WW_STATS_DRAWS, 1);
+    if ( self->pattern != NULL )
+        ww_pattern_render(self->pattern, buffer->format, buffer->block.data, buffer->width, buffer->height, buffer->stride);
+    else
+        ww_format_fill(buffer->format, buffer->block.data, buffer->width, buffer->height, buffer->stride, &self->settings.colour);
+}
 
 #ifdef ENABLE_IMAGES
-    struct wl_buffer *image_buffer;
-    const uint8_t *pdata = NULL;
-    int image_width, image_height;
+static void
+_ww_background_draw_image(WwBackgroundContext *self, WwBackgroundBuffer *buffer)
+{
+    const uint8_t *pdata;
     int cstride, bytes;
-    if ( self->pixbuf != NULL )
-    {
-        image_width = gdk_pixbuf_get_width(self->pixbuf);
-        image_height = gdk_pixbuf_get_height(self->pixbuf);
-        cstride = gdk_pixbuf_get_rowstride(self->pixbuf);
-        bytes = gdk_pixbuf_get_has_alpha(self->pixbuf) ? 4 : 3;
-        pdata = gdk_pixbuf_read_pixels(self->pixbuf);
 
-        size += image_height * image_width * 4;
-    }
+    pdata = gdk_pixbuf_read_pixels(self->pixbuf);
+    cstride = gdk_pixbuf_get_rowstride(self->pixbuf);
+    bytes = gdk_pixbuf_get_has_alpha(self->pixbuf) ? 4 : 3;
+
+    ww_stats_add(WW_STATS_DRAWS, 1);
+
+    ww_format_convert(buffer->image_format, buffer->block.data + buffer->height * buffer->stride, buffer->image_width, buffer->image_height, buffer->image_stride, pdata, cstride, bytes);
+}
 #endif /* ENABLE_IMAGES */
 
-    char filename[PATH_MAX];
-    snprintf(filename, PATH_MAX, "%s/%s", self->runtime_dir, "wayland-surface");
-    fd = open(filename, O_CREAT | O_RDWR | O_CLOEXEC, 0);
-    unlink(filename);
-    if ( fd < 0 )
-    {
-        ww_warning("creating a buffer file for %zu B failed: %s\n", size, strerror(errno));
-        return false;
-    }
-    if ( ftruncate(fd, size) < 0 )
+/*
+ * We pick the cheapest format that keeps the content intact,
+ * or the cheapest at all with dithering when asked to save memory
+ */
+static WwFormat
+_ww_background_pick_format(WwBackgroundContext *self)
+{
+    bool rgb565 = ( self->client->formats & WW_FORMAT_MASK(WW_FORMAT_RGB565) );
+
+    if ( rgb565 && self->low_memory )
+        return WW_FORMAT_RGB565;
+
+    if ( self->pattern != NULL )
     {
-        close(fd);
-        return false;
+        /* Same size as XRGB8888, with less banding */
+        if ( self->client->formats & WW_FORMAT_MASK(WW_FORMAT_XRGB2101010) )
+            return WW_FORMAT_XRGB2101010;
+        return WW_FORMAT_XRGB8888;
     }
 
-    data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-    if ( data == MAP_FAILED )
+    if ( rgb565 && ww_format_colour_is_exact(WW_FORMAT_RGB565, &self->settings.colour) )
+        return WW_FORMAT_RGB565;
+    return WW_FORMAT_XRGB8888;
+}
+
+#ifdef ENABLE_IMAGES
+static WwFormat
+_ww_background_pick_image_format(WwBackgroundContext *self)
+{
+    if ( self->low_memory && ( self->client->formats & WW_FORMAT_MASK(WW_FORMAT_RGB565) ) )
+        return WW_FORMAT_RGB565;
+    return WW_FORMAT_XRGB8888;
+}
+#endif /* ENABLE_IMAGES */
+
+static void
+_ww_background_update_surfaces(WwBackgroundContext *self)
+{
+    WwBackgroundSurface *surface;
+    wl_list_for_each(surface, &self->surfaces, link)
+        _ww_background_surface_update(surface, self->buffer);
+}
+
+/*
+ * The buffer pages are shared with the compositor and stay in the pool as
+ * long as they are displayed, unmapping our side would free nothing
+ * Only the decoded image and our heap can go until we need to redraw
+ */
+static void
+_ww_background_release_memory(WwBackgroundContext *self)
+{
+    bool released = false;
+
+#ifdef ENABLE_IMAGES
+    if ( self->pixbuf != NULL )
     {
-        ww_warning("mmap failed: %s\n", strerror(errno));
-        close(fd);
-        return false;
+        g_object_unref(self->pixbuf);
+        self->pixbuf = NULL;
+        released = true;
     }
+#endif /* ENABLE_IMAGES */
+
+    if ( ! released )
+        return;
+
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif /* __GLIBC__ */
+}
 
-    for ( int32_t y = 0 ; y < height ; ++y )
+static void
+_ww_background_check_release(WwBackgroundContext *self)
+{
+    if ( self->release_mode != WW_BACKGROUND_RELEASE_IDLE )
+        return;
+
+    WwClientOutput *output;
+    wl_list_for_each(output, &self->client->outputs, link)
     {
-        uint8_t *line = data + y * stride;
-        for ( int32_t x = 0 ; x < width ; ++x )
-        {
-            uint8_t *pixel = line + x * 4;
-            {
-                pixel[ALPHA_BYTE] = 0xff;
-                pixel[RED_BYTE]   = self->colour.r * 0xff;
-                pixel[GREEN_BYTE] = self->colour.g * 0xff;
-                pixel[BLUE_BYTE]  = self->colour.b * 0xff;
-            }
-        }
+        if ( ww_hash_lookup(&self->surfaces_by_output, (uintptr_t) output) == NULL )
+            return;
     }
+    _ww_background_release_memory(self);
+}
 
 #ifdef ENABLE_IMAGES
-    if ( pdata != NULL )
+static void _ww_background_load_image(WwBackgroundContext *self, const char *image);
+
+static void
+_ww_background_ensure_image(WwBackgroundContext *self)
+{
+    if ( ( self->pixbuf == NULL ) && ( self->settings.image != NULL ) )
+        _ww_background_load_image(self, self->settings.image);
+}
+#endif /* ENABLE_IMAGES */
+
+static bool
+_ww_background_create_buffer(WwBackgroundContext *self, int32_t width, int32_t height)
+{
+    WwBackgroundBuffer *buffer;
+    WwArenaBlock block;
+    WwFormat format;
+    int32_t stride;
+    size_t size;
+
+    format = _ww_background_pick_format(self);
+    stride = ww_format_get_stride(format, width);
+    size = stride * height;
+
+#ifdef ENABLE_IMAGES
+    _ww_background_ensure_image(self);
+
+    WwFormat image_format = _ww_background_pick_image_format(self);
+    int image_width = 0, image_height = 0, image_stride = 0;
+    if ( self->pixbuf != NULL )
     {
-        uint8_t *image_data = data + height * stride;
-        for ( int y = 0 ; y < image_height ; ++y )
-        {
-            uint8_t *line = image_data + y * image_width * 4;
-            for ( int32_t x = 0 ; x < image_width ; ++x )
-            {
-                uint8_t *pixel = line + x * 4;
-                const uint8_t *ppixel = pdata + y * cstride + x * bytes;
+        image_width = gdk_pixbuf_get_width(self->pixbuf);
+        image_height = gdk_pixbuf_get_height(self->pixbuf);
+        image_stride = ww_format_get_stride(image_format, image_width);
 
-                pixel[ALPHA_BYTE] = 0xff;
-                pixel[RED_BYTE]   = ppixel[0];
-                pixel[GREEN_BYTE] = ppixel[1];
-                pixel[BLUE_BYTE]  = ppixel[2];
-            }
-        }
+        size += image_height * image_stride;
     }
 #endif /* ENABLE_IMAGES */
 
-    munmap(data, size);
+    /* We keep the block to redraw in place when only the content changes */
+    if ( ! ww_client_shm_alloc(self->client, size, &block) )
+        return false;
+
+    buffer = ww_new0(WwBackgroundBuffer, 1);
+    buffer->client = self->client;
+    buffer->attach_time = ww_stats_now();
+    buffer->block = block;
+    buffer->format = format;
+    buffer->width = width;
+    buffer->height = height;
+    buffer->stride = stride;
+
+    _ww_background_draw_background(self, buffer);
 
-    pool = wl_shm_create_pool(self->shm, fd, size);
-    buffer = wl_shm_pool_create_buffer(pool, 0, width, height, stride, WL_SHM_FORMAT_XRGB8888);
 #ifdef ENABLE_IMAGES
-    if ( pdata != NULL )
-        image_buffer = wl_shm_pool_create_buffer(pool, height * stride, image_width, image_height, image_width * 4, WL_SHM_FORMAT_XRGB8888);
+    buffer->image_format = image_format;
+    buffer->image_width = image_width;
+    buffer->image_height = image_height;
+    buffer->image_stride = image_stride;
+    if ( self->pixbuf != NULL )
+        _ww_background_draw_image(self, buffer);
 #endif /* ENABLE_IMAGES */
-    wl_shm_pool_destroy(pool);
-    close(fd);
-
-    if ( self->buffer != NULL )
-        _ww_background_buffer_free(self->buffer);
 
-    self->buffer = ww_new0(WwBackgroundBuffer, 1);
-    self->buffer->buffer = buffer;
-    wl_buffer_add_listener(buffer, &_ww_background_buffer_listener, self->buffer);
+    buffer->buffer = ww_arena_create_buffer(self->client->arena, &block, 0, width, height, stride, ww_format_get_info(format)->shm_format, NULL);
+    wl_buffer_add_listener(buffer->buffer, &_ww_background_buffer_listener, buffer);
+    /* Our buffers are held until the compositor releases them */
+    ww_stats_add(WW_STATS_BUFFERS_CREATED, 1);
+    ww_stats_add(WW_STATS_BUFFERS_HELD, 1);
+    ww_stats_add(WW_STATS_BYTES_ARGB8888 + format, (int64_t) height * stride);
 #ifdef ENABLE_IMAGES
-    if ( pdata != NULL )
+    ww_stats_add(WW_STATS_BYTES_ARGB8888 + image_format, (int64_t) image_height * image_stride);
+    if ( self->pixbuf != NULL )
     {
-        self->buffer->image_buffer = image_buffer;
-        wl_buffer_add_listener(image_buffer, &_ww_background_buffer_listener, self->buffer);
+        buffer->image_buffer = ww_arena_create_buffer(self->client->arena, &block, height * stride, image_width, image_height, image_stride, ww_format_get_info(image_format)->shm_format, NULL);
+        wl_buffer_add_listener(buffer->image_buffer, &_ww_background_buffer_listener, buffer);
+        ww_stats_add(WW_STATS_BUFFERS_CREATED, 1);
+        ww_stats_add(WW_STATS_BUFFERS_HELD, 1);
     }
     else
-        self->buffer->image_released = true;
+        buffer->image_released = true;
 #endif /* ENABLE_IMAGES */
 
-    WwBackgroundOutput *output;
-    wl_list_for_each(output, &self->outputs, link)
-    {
-        if ( output->surface != NULL )
-            _ww_background_surface_update(output->surface, self->buffer);
-    }
+    if ( self->buffer != NULL )
+        _ww_background_buffer_free(self->buffer);
+    self->buffer = buffer;
+
+    _ww_background_update_surfaces(self);
+    _ww_background_check_release(self);
 
     return true;
 }
@@ -384,6 +470,8 @@ _ww_background_check_buffer(WwBackgroundContext *self, WwBackgroundSurface *surf
         int32_t new_width = MAX(self->width, width), new_height = MAX(self->height, height);
 
 #ifdef ENABLE_IMAGES
+        _ww_background_ensure_image(self);
+
         GdkPixbuf *pixbuf = self->pixbuf;
         if ( pixbuf != NULL )
         {
@@ -398,7 +486,7 @@ _ww_background_check_buffer(WwBackgroundContext *self, WwBackgroundSurface *surf
                  * If the image is scalable, we already loaded it at the biggest size we need
                  * so we use MAX() to get the biggest size again
                  */
-                self->pixbuf = gdk_pixbuf_new_from_file_at_size(self->image, MAX(pw, new_width), MAX(ph, new_height), &error);
+                self->pixbuf = gdk_pixbuf_new_from_file_at_size(self->settings.image, MAX(pw, new_width), MAX(ph, new_height), &error);
                 if ( self->pixbuf == NULL )
                 {
                     self->pixbuf = pixbuf;
@@ -424,39 +512,45 @@ _ww_background_check_buffer(WwBackgroundContext *self, WwBackgroundSurface *surf
 #endif /* ENABLE_IMAGES */
     }
     _ww_background_surface_update(surface, self->buffer);
+    _ww_background_check_release(self);
 }
 
 static WwBackgroundSurface *
-_ww_background_surface_new(WwBackgroundOutput *output)
+_ww_background_surface_new(WwBackgroundContext *context, WwClientOutput *output)
 {
     WwBackgroundSurface *self;
 
     self = ww_new0(WwBackgroundSurface, 1);
+    self->context = context;
     self->output = output;
-    self->width = self->output->width * self->output->scale;
-    self->height = self->output->height * self->output->scale;
 
-    self->surface = wl_compositor_create_surface(self->output->context->compositor);
+    self->surface = wl_compositor_create_surface(self->context->client->compositor);
 #ifdef ENABLE_IMAGES
-    self->image_surface = wl_compositor_create_surface(self->output->context->compositor);
-    self->image_subsurface = wl_subcompositor_get_subsurface(self->output->context->subcompositor, self->image_surface, self->surface);
+    self->image_surface = wl_compositor_create_surface(self->context->client->compositor);
+    self->image_subsurface = wl_subcompositor_get_subsurface(self->context->subcompositor, self->image_surface, self->surface);
 #endif /* ENABLE_IMAGES */
-    if ( self->output->context->viewporter != NULL )
+    if ( self->context->viewporter != NULL )
     {
-        self->viewport = wp_viewporter_get_viewport(self->output->context->viewporter, self->surface);
+        self->viewport = wp_viewporter_get_viewport(self->context->viewporter, self->surface);
 #ifdef ENABLE_IMAGES
-        self->image_viewport = wp_viewporter_get_viewport(self->output->context->viewporter, self->image_surface);
+        self->image_viewport = wp_viewporter_get_viewport(self->context->viewporter, self->image_surface);
 #endif /* ENABLE_IMAGES */
     }
     wl_surface_set_user_data(self->surface, self);
 
+    wl_list_insert(&self->context->surfaces, &self->link);
+    ww_hash_insert(&self->context->surfaces_by_output, (uintptr_t) output, self);
+
     return self;
 }
 
 static void
 _ww_background_surface_free(WwBackgroundSurface *self)
 {
-    if ( self->output->context->viewporter != NULL )
+    ww_hash_remove(&self->context->surfaces_by_output, (uintptr_t) self->output);
+    wl_list_remove(&self->link);
+
+    if ( self->viewport != NULL )
     {
 #ifdef ENABLE_IMAGES
         wp_viewport_destroy(self->image_viewport);
@@ -474,455 +568,400 @@ _ww_background_surface_free(WwBackgroundSurface *self)
 }
 
 static void
-_ww_background_cursor_set_image(WwBackgroundContext *self, int i)
+_ww_background_output_done(void *user_data, WwClientOutput *output)
 {
-    struct wl_buffer *buffer;
-    struct wl_cursor_image *image;
-    image = self->cursor.cursor->images[i];
+    WwBackgroundContext *self = user_data;
+    WwBackgroundSurface *surface;
 
-    self->cursor.image = image;
-    buffer = wl_cursor_image_get_buffer(self->cursor.image);
-    wl_surface_attach(self->cursor.surface, buffer, 0, 0);
-    wl_surface_damage(self->cursor.surface, 0, 0, self->cursor.image->width, self->cursor.image->height);
-    wl_surface_commit(self->cursor.surface);
-}
+    surface = ww_hash_lookup(&self->surfaces_by_output, (uintptr_t) output);
+    if ( surface == NULL )
+        surface = _ww_background_surface_new(self, output);
+    surface->width = output->width * output->scale;
+    surface->height = output->height * output->scale;
 
-static void _ww_background_cursor_frame_callback(void *data, struct wl_callback *callback, uint32_t time);
+    /* Initial outputs, our first buffer will be big enough for them */
+    if ( self->buffer == NULL )
+    {
+        self->width = MAX(self->width, surface->width);
+        self->height = MAX(self->height, surface->height);
+        return;
+    }
 
-static const struct wl_callback_listener _ww_background_cursor_frame_wl_callback_listener = {
-    .done = _ww_background_cursor_frame_callback,
-};
+    _ww_background_check_buffer(self, surface);
+}
 
 static void
-_ww_background_cursor_frame_callback(void *data, struct wl_callback *callback, uint32_t time)
+_ww_background_output_removed(void *user_data, WwClientOutput *output)
 {
-    WwBackgroundContext *self = data;
-    int i;
-
-    if ( self->cursor.frame_cb != NULL )
-        wl_callback_destroy(self->cursor.frame_cb);
-    self->cursor.frame_cb = wl_surface_frame(self->cursor.surface);
-    wl_callback_add_listener(self->cursor.frame_cb, &_ww_background_cursor_frame_wl_callback_listener, self);
+    WwBackgroundContext *self = user_data;
+    WwBackgroundSurface *surface;
 
-    i = wl_cursor_frame(self->cursor.cursor, time);
-    _ww_background_cursor_set_image(self, i);
+    surface = ww_hash_lookup(&self->surfaces_by_output, (uintptr_t) output);
+    if ( surface != NULL )
+        _ww_background_surface_free(surface);
 }
 
-static void
-_ww_background_pointer_enter(void *data, struct wl_pointer *pointer, uint32_t serial, struct wl_surface *surface, wl_fixed_t x, wl_fixed_t y)
+static int32_t
+_ww_background_surface_scale(void *user_data, struct wl_surface *wl_surface)
 {
-    WwBackgroundSeat *self = data;
-    WwBackgroundContext *context = self->context;
-
-    if ( context->cursor.surface == NULL )
-        return;
-
-    if ( context->cursor.cursor->image_count < 2 )
-        _ww_background_cursor_set_image(context, 0);
-    else
-        _ww_background_cursor_frame_callback(context, context->cursor.frame_cb, 0);
+    WwBackgroundContext *self = user_data;
 
-    wl_pointer_set_cursor(self->pointer, serial, context->cursor.surface, context->cursor.image->hotspot_x, context->cursor.image->hotspot_y);
+    WwBackgroundSurface *surface;
+    wl_list_for_each(surface, &self->surfaces, link)
+    {
+        if ( surface->surface == wl_surface )
+            return surface->output->scale;
+    }
+    return 0;
 }
 
-static void
-_ww_background_pointer_leave(void *data, struct wl_pointer *pointer, uint32_t serial, struct wl_surface *surface)
-{
-    WwBackgroundSeat *self = data;
-    WwBackgroundContext *context = self->context;
+static const WwClientListener _ww_background_client_listener = {
+    .output_done = _ww_background_output_done,
+    .output_removed = _ww_background_output_removed,
+    .surface_scale = _ww_background_surface_scale,
+};
 
-    if ( context->cursor.frame_cb != NULL )
-        wl_callback_destroy(context->cursor.frame_cb);
-}
+static const WwClientGlobal _ww_background_globals[] = {
+    WW_CLIENT_GLOBAL(WwBackgroundContext, subcompositor, wl_subcompositor_interface, WL_SUBCOMPOSITOR_INTERFACE_VERSION, wl_subcompositor_destroy),
+    WW_CLIENT_GLOBAL(WwBackgroundContext, background, zww_background_v2_interface, WW_BACKGROUND_INTERFACE_VERSION, zww_background_v2_destroy),
+    WW_CLIENT_GLOBAL(WwBackgroundContext, viewporter, wp_viewporter_interface, WP_VIEWPORTER_INTERFACE_VERSION, wp_viewporter_destroy),
+};
 
+#ifdef ENABLE_IMAGES
 static void
-_ww_background_pointer_motion(void *data, struct wl_pointer *pointer, uint32_t time, wl_fixed_t x, wl_fixed_t y)
+_ww_background_load_image(WwBackgroundContext *self, const char *image)
 {
-}
+    GError *error = NULL;
+    GdkPixbufFormat *format;
 
-static void
-_ww_background_pointer_button(void *data, struct wl_pointer *pointer, uint32_t serial, uint32_t time, uint32_t button, enum wl_pointer_button_state state)
-{
-}
+    if ( self->pixbuf != NULL )
+        g_object_unref(self->pixbuf);
+    self->pixbuf = NULL;
 
-static void
-_ww_background_pointer_axis(void *data, struct wl_pointer *pointer, uint32_t time, enum wl_pointer_axis axis, wl_fixed_t value)
-{
-}
+    if ( image == NULL )
+        return;
 
-static void
-_ww_background_pointer_frame(void *data, struct wl_pointer *pointer)
-{
-}
+    format = gdk_pixbuf_get_file_info(image, NULL, NULL);
+    if ( format == NULL )
+    {
+        ww_warning("Unknown image format: %s", image);
+        return;
+    }
 
-static void
-_ww_background_pointer_axis_source(void *data, struct wl_pointer *pointer, enum wl_pointer_axis_source axis_source)
-{
+    self->image_scalable = gdk_pixbuf_format_is_scalable(format);
+    self->pixbuf = gdk_pixbuf_new_from_file(image, &error);
+    if ( self->pixbuf == NULL )
+    {
+        ww_warning("Couldn’t load image: %s", error->message);
+        g_error_free(error);
+    }
 }
+#endif /* ENABLE_IMAGES */
 
 static void
-_ww_background_pointer_axis_stop(void *data, struct wl_pointer *pointer, uint32_t time, enum wl_pointer_axis axis)
+_ww_background_settings_init(WwBackgroundSettings *self, const WwBackgroundSettings *defaults)
 {
+    *self = *defaults;
+    if ( self->gradient != NULL )
+        self->gradient = strdup(self->gradient);
+#ifdef ENABLE_IMAGES
+    if ( self->image != NULL )
+        self->image = strdup(self->image);
+#endif /* ENABLE_IMAGES */
 }
 
 static void
-_ww_background_pointer_axis_discrete(void *data, struct wl_pointer *pointer, enum wl_pointer_axis axis, int32_t discrete)
+_ww_background_settings_clear(WwBackgroundSettings *self)
 {
+    free(self->gradient);
+#ifdef ENABLE_IMAGES
+    free(self->image);
+#endif /* ENABLE_IMAGES */
 }
 
-static const struct wl_pointer_listener _ww_background_pointer_listener = {
-    .enter = _ww_background_pointer_enter,
-    .leave = _ww_background_pointer_leave,
-    .motion = _ww_background_pointer_motion,
-    .button = _ww_background_pointer_button,
-    .axis = _ww_background_pointer_axis,
-    .frame = _ww_background_pointer_frame,
-    .axis_source = _ww_background_pointer_axis_source,
-    .axis_stop = _ww_background_pointer_axis_stop,
-    .axis_discrete = _ww_background_pointer_axis_discrete,
-};
-
 static void
-_ww_background_pointer_release(WwBackgroundSeat *self)
+_ww_background_settings_entry(void *user_data, const char *key, const char *value)
 {
-    if ( self->pointer == NULL )
-        return;
+    WwBackgroundSettings *self = user_data;
 
-    if ( wl_pointer_get_version(self->pointer) >= WL_POINTER_RELEASE_SINCE_VERSION )
-        wl_pointer_release(self->pointer);
+    if ( strcmp(key, "colour") == 0 )
+    {
+        if ( ! _ww_parse_colour(value, &self->colour) )
+            ww_warning("Invalid colour: %s", value);
+    }
+    else if ( strcmp(key, "gradient") == 0 )
+    {
+        free(self->gradient);
+        self->gradient = ( *value != '\0' ) ? strdup(value) : NULL;
+    }
+    else if ( strcmp(key, "noise") == 0 )
+        self->noise = MAX(strtod(value, NULL), 0);
+#ifdef ENABLE_IMAGES
+    else if ( strcmp(key, "image") == 0 )
+    {
+        free(self->image);
+        self->image = ( *value != '\0' ) ? strdup(value) : NULL;
+    }
+#endif /* ENABLE_IMAGES */
     else
-        wl_pointer_destroy(self->pointer);
-
-    self->pointer = NULL;
+        ww_warning("Unknown setting: %s", key);
 }
 
 static void
-_ww_background_seat_release(WwBackgroundSeat *self)
+_ww_background_apply_settings(WwBackgroundContext *self, WwBackgroundSettings *settings)
 {
-    _ww_background_pointer_release(self);
-
-    if ( wl_seat_get_version(self->seat) >= WL_SEAT_RELEASE_SINCE_VERSION )
-        wl_seat_release(self->seat);
-    else
-        wl_seat_destroy(self->seat);
+    bool colour_changed = ( memcmp(&self->settings.colour, &settings->colour, sizeof(WwColour)) != 0 );
+    bool pattern_changed = ( strcmp0(self->settings.gradient, settings->gradient) != 0 ) || ( self->settings.noise != settings->noise );
+    bool image_changed = false;
+    bool resize = false;
 
-    wl_list_remove(&self->link);
-
-    free(self);
-}
+    if ( pattern_changed )
+    {
+        ww_pattern_free(self->pattern);
+        self->pattern = NULL;
+        if ( settings->gradient != NULL )
+        {
+            self->pattern = ww_pattern_new(settings->gradient, settings->noise, self->thread_count);
+            if ( self->pattern == NULL )
+                ww_warning("Invalid gradient: %s", settings->gradient);
+        }
+    }
 
-static void
-_ww_background_seat_capabilities(void *data, struct wl_seat *seat, uint32_t capabilities)
-{
-    WwBackgroundSeat *self = data;
-    if ( ( capabilities & WL_SEAT_CAPABILITY_POINTER ) && ( self->pointer == NULL ) )
+#ifdef ENABLE_IMAGES
+    image_changed = ( strcmp0(self->settings.image, settings->image) != 0 );
+    if ( image_changed )
     {
-        self->pointer = wl_seat_get_pointer(self->seat);
-        wl_pointer_add_listener(self->pointer, &_ww_background_pointer_listener, self);
+        _ww_background_load_image(self, settings->image);
+        if ( self->buffer != NULL )
+        {
+            int32_t image_width = 0, image_height = 0;
+            if ( self->pixbuf != NULL )
+            {
+                image_width = gdk_pixbuf_get_width(self->pixbuf);
+                image_height = gdk_pixbuf_get_height(self->pixbuf);
+            }
+            resize = ( image_width != self->buffer->image_width ) || ( image_height != self->buffer->image_height );
+        }
     }
-    else if ( ( ! ( capabilities & WL_SEAT_CAPABILITY_POINTER ) ) && ( self->pointer != NULL ) )
-        _ww_background_pointer_release(self);
-}
+#endif /* ENABLE_IMAGES */
 
-static void
-_ww_background_seat_name(void *data, struct wl_seat *seat, const char *name)
-{
-}
+    _ww_background_settings_clear(&self->settings);
+    self->settings = *settings;
 
-static const struct wl_seat_listener _ww_background_seat_listener = {
-    .capabilities = _ww_background_seat_capabilities,
-    .name = _ww_background_seat_name,
-};
+    if ( self->buffer == NULL )
+        return;
 
-static void
-_ww_background_output_release(WwBackgroundOutput *self)
-{
-    _ww_background_surface_free(self->surface);
+    /* A new colour may not fit our current format */
+    if ( _ww_background_pick_format(self) != self->buffer->format )
+        resize = true;
 
-    if ( wl_output_get_version(self->output) >= WL_OUTPUT_RELEASE_SINCE_VERSION )
-        wl_output_release(self->output);
-    else
-        wl_output_destroy(self->output);
+    bool redraw = colour_changed || pattern_changed || image_changed;
 
-    wl_list_remove(&self->link);
+    if ( resize )
+    {
+        _ww_background_create_buffer(self, self->width, self->height);
+        return;
+    }
 
-    free(self);
-}
+    /* The pattern does not use the colour */
+    if ( colour_changed && ( self->pattern != NULL ) && ( ! pattern_changed ) )
+        colour_changed = false;
 
-static void
-_ww_background_output_done(void *data, struct wl_output *output)
-{
-    WwBackgroundOutput *self = data;
+    if ( ! redraw )
+        return;
 
-    if ( self->surface == NULL )
-        self->surface = _ww_background_surface_new(self);
-    _ww_background_check_buffer(self->context, self->surface);
-}
+    /* Same sizes, we redraw in our current mapping */
+    if ( colour_changed || pattern_changed )
+        _ww_background_draw_background(self, self->buffer);
+#ifdef ENABLE_IMAGES
+    if ( image_changed && ( self->pixbuf != NULL ) )
+        _ww_background_draw_image(self, self->buffer);
+#endif /* ENABLE_IMAGES */
 
-static void
-_ww_background_output_geometry(void *data, struct wl_output *output, int32_t x, int32_t y, int32_t width, int32_t height, int32_t subpixel, const char *make, const char *model, int32_t transform)
-{
+    _ww_background_update_surfaces(self);
+    _ww_background_check_release(self);
 }
 
 static void
-_ww_background_output_mode(void *data, struct wl_output *output, enum wl_output_mode flags, int32_t width, int32_t height, int32_t refresh)
+_ww_background_settings_load(WwBackgroundContext *self)
 {
-    WwBackgroundOutput *self = data;
-
-    if ( ! ( flags & WL_OUTPUT_MODE_CURRENT ) )
-        return;
-
-    self->width = width;
-    self->height = height;
+    WwBackgroundSettings settings;
 
-    if ( wl_output_get_version(self->output) < WL_OUTPUT_DONE_SINCE_VERSION )
-        _ww_background_output_done(self, self->output);
+    _ww_background_settings_init(&settings, &self->defaults);
+    if ( self->settings_path != NULL )
+        ww_settings_parse(self->settings_path, _ww_background_settings_entry, &settings);
+    _ww_background_apply_settings(self, &settings);
 }
 
 static void
-_ww_background_output_scale(void *data, struct wl_output *output, int32_t scale)
+_ww_background_settings_changed(void *user_data)
 {
-    WwBackgroundOutput *self = data;
+    WwBackgroundContext *self = user_data;
 
-    self->scale = scale;
+    _ww_background_settings_load(self);
 }
 
-static const struct wl_output_listener _ww_background_output_listener = {
-    .geometry = _ww_background_output_geometry,
-    .mode = _ww_background_output_mode,
-    .scale = _ww_background_output_scale,
-    .done = _ww_background_output_done,
-};
-
-static const char * const _ww_background_cursor_names[] = {
-    "left_ptr",
-    "default",
-    "top_left_arrow",
-    "left-arrow",
-    NULL
-};
-
 static void
-_ww_background_registry_handle_global(void *data, struct wl_registry *registry, uint32_t name, const char *interface, uint32_t version)
+_ww_background_pressure_callback(void *user_data, uint32_t events)
 {
-    WwBackgroundContext *self = data;
+    WwBackgroundContext *self = user_data;
 
-    if ( strcmp0(interface, "wl_compositor") == 0 )
-    {
-        self->global_names[WW_BACKGROUND_GLOBAL_COMPOSITOR] = name;
-        self->compositor = wl_registry_bind(registry, name, &wl_compositor_interface, MIN(version, WL_COMPOSITOR_INTERFACE_VERSION));
-    }
-    else if ( strcmp0(interface, "wl_subcompositor") == 0 )
-    {
-        self->global_names[WW_BACKGROUND_GLOBAL_SUBCOMPOSITOR] = name;
-        self->subcompositor = wl_registry_bind(registry, name, &wl_subcompositor_interface, MIN(version, WL_SUBCOMPOSITOR_INTERFACE_VERSION));
-    }
-    else if ( strcmp0(interface, "zww_background_v2") == 0 )
-    {
-        self->global_names[WW_BACKGROUND_GLOBAL_BACKGROUND] = name;
-        self->background = wl_registry_bind(registry, name, &zww_background_v2_interface, WW_BACKGROUND_INTERFACE_VERSION);
-    }
-    else if ( strcmp0(interface, "wl_shm") == 0 )
-    {
-        self->global_names[WW_BACKGROUND_GLOBAL_SHM] = name;
-        self->shm = wl_registry_bind(registry, name, &wl_shm_interface, MIN(version, WL_SHM_INTERFACE_VERSION));
-    }
-    else if ( strcmp0(interface, "wp_viewporter") == 0 )
+    if ( events & EPOLLERR )
     {
-        self->global_names[WW_BACKGROUND_GLOBAL_VIEWPORTER] = name;
-        self->viewporter = wl_registry_bind(registry, name, &wp_viewporter_interface, MIN(version, WP_VIEWPORTER_INTERFACE_VERSION));
+        ww_warning("Memory pressure monitoring stopped");
+        ww_loop_source_free(self->pressure_source);
+        self->pressure_source = NULL;
+        close(self->pressure_fd);
+        self->pressure_fd = -1;
+        return;
     }
-    else if ( strcmp0(interface, "wl_seat") == 0 )
-    {
-        WwBackgroundSeat *seat = ww_new0(WwBackgroundSeat, 1);
-        seat->context = self;
-        seat->global_name = name;
-        seat->seat = wl_registry_bind(registry, name, &wl_seat_interface, MIN(version, WL_SEAT_INTERFACE_VERSION));
-
-        wl_list_insert(&self->seats, &seat->link);
 
-        wl_seat_add_listener(seat->seat, &_ww_background_seat_listener, seat);
-    }
-    else if ( strcmp0(interface, "wl_output") == 0 )
-    {
-        WwBackgroundOutput *output = ww_new0(WwBackgroundOutput, 1);
-        output->context = self;
-        output->global_name = name;
-        output->output = wl_registry_bind(registry, name, &wl_output_interface, MIN(version, WL_OUTPUT_INTERFACE_VERSION));
-        output->scale = 1;
+    if ( events & EPOLLPRI )
+        _ww_background_release_memory(self);
+}
 
-        wl_list_insert(&self->outputs, &output->link);
+/*
+ * PSI trigger: 150ms of stall in a 2s window,
+ * unprivileged triggers need a window multiple of 2s
+ */
+static bool
+_ww_background_pressure_watch(WwBackgroundContext *self)
+{
+    static const char trigger[] = "some 150000 2000000";
 
-        wl_output_add_listener(output->output, &_ww_background_output_listener, output);
+    self->pressure_fd = open("/proc/pressure/memory", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if ( self->pressure_fd < 0 )
+    {
+        ww_warning("Couldn’t open memory pressure file: %s", strerror(errno));
+        return false;
     }
 
-    if ( ( self->cursor.theme == NULL ) && ( self->compositor != NULL ) && ( self->shm != NULL ) )
+    if ( write(self->pressure_fd, trigger, sizeof(trigger)) < 0 )
     {
-        self->cursor.theme = wl_cursor_theme_load(self->cursor.theme_name, 32, self->shm);
-        if ( self->cursor.theme != NULL )
-        {
-            const char * const *cname = (const char * const *) self->cursor.name;
-            for ( cname = ( cname != NULL ) ? cname : _ww_background_cursor_names ; ( self->cursor.cursor == NULL ) && ( *cname != NULL ) ; ++cname )
-                self->cursor.cursor = wl_cursor_theme_get_cursor(self->cursor.theme, *cname);
-            if ( self->cursor.cursor == NULL )
-            {
-                wl_cursor_theme_destroy(self->cursor.theme);
-                self->cursor.theme = NULL;
-            }
-            else
-                self->cursor.surface = wl_compositor_create_surface(self->compositor);
-        }
+        ww_warning("Couldn’t set memory pressure trigger: %s", strerror(errno));
+        close(self->pressure_fd);
+        self->pressure_fd = -1;
+        return false;
     }
+
+    self->pressure_source = ww_loop_add_fd(self->client->loop, self->pressure_fd, EPOLLPRI, _ww_background_pressure_callback, self);
+    return ( self->pressure_source != NULL );
 }
 
-static void
-_ww_background_registry_handle_global_remove(void *data, struct wl_registry *registry, uint32_t name)
+static int
+_ww_background_bench_compare(const void *a_, const void *b_)
 {
-    WwBackgroundContext *self = data;
+    int64_t a = *(const int64_t *) a_, b = *(const int64_t *) b_;
+    return ( a > b ) - ( a < b );
+}
 
-    WwBackgroundGlobalName i;
-    for ( i = 0 ; i < _WW_BACKGROUND_GLOBAL_SIZE ; ++i )
-    {
-        if ( self->global_names[i] != name )
-            continue;
-        self->global_names[i] = 0;
+/* Renders the gradient in one buffer with each thread count up to -j */
+static int
+_ww_background_bench_run(WwBackgroundContext *self)
+{
+    WwFormat format = self->low_memory ? WW_FORMAT_RGB565 : WW_FORMAT_XRGB8888;
+    int32_t stride = ww_format_get_stride(format, self->width);
+    size_t thread_count = self->thread_count, n, i;
+    int64_t times[WW_BACKGROUND_BENCH_RENDERS], single = 0;
+    uint8_t *data;
 
-        switch ( i )
-        {
-        case WW_BACKGROUND_GLOBAL_COMPOSITOR:
-            wl_compositor_destroy(self->compositor);
-            self->compositor = NULL;
-        break;
-        case WW_BACKGROUND_GLOBAL_SUBCOMPOSITOR:
-            wl_subcompositor_destroy(self->subcompositor);
-            self->subcompositor = NULL;
-        break;
-        case WW_BACKGROUND_GLOBAL_BACKGROUND:
-            zww_background_v2_destroy(self->background);
-            self->background = NULL;
-        break;
-        case WW_BACKGROUND_GLOBAL_SHM:
-            wl_shm_destroy(self->shm);
-            self->shm = NULL;
-        break;
-        case WW_BACKGROUND_GLOBAL_VIEWPORTER:
-            wp_viewporter_destroy(self->viewporter);
-            self->viewporter = NULL;
-        break;
-        case _WW_BACKGROUND_GLOBAL_SIZE:
-            assert_not_reached();
-        }
-        return;
-    }
-    if ( ( self->cursor.theme != NULL ) && ( ( self->compositor == NULL ) || ( self->shm == NULL ) ) )
+    if ( thread_count < 1 )
     {
-        if ( self->cursor.frame_cb != NULL )
-            wl_callback_destroy(self->cursor.frame_cb);
-        self->cursor.frame_cb = NULL;
-
-        wl_surface_destroy(self->cursor.surface);
-        wl_cursor_theme_destroy(self->cursor.theme);
-        self->cursor.surface = NULL;
-        self->cursor.image = NULL;
-        self->cursor.cursor = NULL;
-        self->cursor.theme = NULL;
+        long c = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = ( c > 0 ) ? c : 1;
     }
 
-    WwBackgroundSeat *seat, *tmp_seat;
-    wl_list_for_each_safe(seat, tmp_seat, &self->seats, link)
-    {
-        if ( seat->global_name != name )
-            continue;
-
-        _ww_background_seat_release(seat);
-        return;
-    }
+    data = malloc((size_t) stride * self->height);
+    if ( data == NULL )
+        return 2;
 
-    WwBackgroundOutput *output, *tmp_output;
-    wl_list_for_each_safe(output, tmp_output, &self->outputs, link)
+    printf("%s, %" PRId32 "x%" PRId32 ", %s\n", self->settings.gradient, self->width, self->height, self->low_memory ? "RGB565" : "XRGB8888");
+    for ( n = 1 ; n <= thread_count ; ++n )
     {
-        if ( output->global_name != name )
-            continue;
+        WwPattern *pattern = ww_pattern_new(self->settings.gradient, self->settings.noise, n);
+        if ( pattern == NULL )
+        {
+            free(data);
+            return 2;
+        }
+        for ( i = 0 ; i < WW_BACKGROUND_BENCH_RENDERS ; ++i )
+        {
+            int64_t start = ww_stats_now();
+            ww_pattern_render(pattern, format, data, self->width, self->height, stride);
+            times[i] = ww_stats_now() - start;
+        }
+        ww_pattern_free(pattern);
 
-        _ww_background_output_release(output);
-        return;
+        qsort(times, WW_BACKGROUND_BENCH_RENDERS, sizeof(*times), _ww_background_bench_compare);
+        int64_t median = times[WW_BACKGROUND_BENCH_RENDERS / 2];
+        if ( n == 1 )
+            single = median;
+        printf("-j %zu: median %" PRId64 " µs, min %" PRId64 " µs, %.2f× one thread\n", n, median, times[0], (double) single / MAX(median, 1));
     }
+    free(data);
+
+    return 0;
 }
 
-static const struct wl_registry_listener _ww_background_registry_listener = {
-    .global = _ww_background_registry_handle_global,
-    .global_remove = _ww_background_registry_handle_global_remove,
+enum {
+    WW_BACKGROUND_OPTION_BENCH = 256,
 };
 
+static const struct option _ww_background_options[] = {
+    { "bench", no_argument, NULL, WW_BACKGROUND_OPTION_BENCH },
+    { NULL, 0, NULL, 0 },
+};
 
-static void
-_ww_background_disconnect(WwBackgroundContext *self)
+static void *
+_ww_background_role_init(int argc, char *argv[], int *status)
 {
-    WwBackgroundSeat *seat, *tmp;
-    wl_list_for_each_safe(seat, tmp, &self->seats, link)
-        _ww_background_seat_release(seat);
+    WwBackgroundContext *self;
 
-    WwBackgroundGlobalName i;
-    for ( i = 0 ; i < _WW_BACKGROUND_GLOBAL_SIZE ; ++i )
+    self = ww_new0(WwBackgroundContext, 1);
+    if ( self == NULL )
     {
-        if ( self->global_names[i] != 0 )
-            _ww_background_registry_handle_global_remove(self, self->registry, self->global_names[i]);
+        *status = 2;
+        return NULL;
     }
 
-    wl_registry_destroy(self->registry);
-    self->registry = NULL;
-
-    wl_display_disconnect(self->display);
-    self->display = NULL;
-}
-
-int
-main(int argc, char *argv[])
-{
-    static WwBackgroundContext self_;
-    WwBackgroundContext *self = &self_;
-
     self->width = 1920;
     self->height = 1080;
+    self->pressure_fd = -1;
 
-    setlocale(LC_ALL, "");
-
-    const char *runtime_dir;
-    runtime_dir = getenv("XDG_RUNTIME_DIR");
-    if ( runtime_dir == NULL )
-        return 1;
-    snprintf(self->runtime_dir, PATH_MAX, "%s/" PACKAGE_NAME, runtime_dir);
-
-    if ( mkdir(self->runtime_dir, 0755) < 0 )
-    {
-        if ( errno == EEXIST )
-        {
-            struct stat buf;
-            if ( stat(self->runtime_dir, &buf) < 0 )
-                return 1;
-            if ( ! S_ISDIR(buf.st_mode) )
-                return 1;
-        }
-        else
-            return 1;
-    }
-
-    self->display = wl_display_connect(NULL);
-    if ( self->display == NULL )
-        return 2;
-
-    wl_list_init(&self->seats);
-    wl_list_init(&self->outputs);
+    wl_list_init(&self->surfaces);
+    ww_hash_init(&self->surfaces_by_output);
 
     int arg;
-    while ( ( arg = getopt(argc, argv, "c:w:h:f:C:") ) != -1 )
+    while ( ( arg = getopt_long(argc, argv, "c:g:n:j:w:h:lr:f:s:C:", _ww_background_options, NULL) ) != -1 )
     {
         bool good = false;
         switch ( arg )
         {
         case 'c':
-            if ( _ww_parse_colour(optarg, &self->colour) )
+            if ( _ww_parse_colour(optarg, &self->defaults.colour) )
+                good = true;
+        break;
+        case 'g':
+            self->defaults.gradient = optarg;
+            good = true;
+        break;
+        case 'n':
+        {
+            char *e;
+            errno = 0;
+            self->defaults.noise = strtod(optarg, &e);
+            if ( ( e != optarg ) && ( errno == 0 ) && ( self->defaults.noise >= 0 ) )
+                good = true;
+        }
+        break;
+        case 'j':
+        {
+            char *e;
+            errno = 0;
+            self->thread_count = strtoul(optarg, &e, 10);
+            if ( ( e != optarg ) && ( errno == 0 ) )
                 good = true;
+        }
         break;
         case 'w':
         {
@@ -942,28 +981,41 @@ main(int argc, char *argv[])
                 good = true;
         }
         break;
-#ifdef ENABLE_IMAGES
-        case 'f':
+        case 'l':
+            self->low_memory = true;
+            good = true;
+        break;
+        case 'r':
         {
-            GError *error = NULL;
-            GdkPixbufFormat *format;
-            format = gdk_pixbuf_get_file_info(optarg, NULL, NULL);
-            if ( format != NULL )
+            WwBackgroundReleaseMode mode;
+            for ( mode = WW_BACKGROUND_RELEASE_NEVER ; mode <= WW_BACKGROUND_RELEASE_PRESSURE ; ++mode )
             {
-                self->image = optarg;
-                self->image_scalable = gdk_pixbuf_format_is_scalable(format);
-                self->pixbuf = gdk_pixbuf_new_from_file(self->image, &error);
-                if ( self->pixbuf == NULL )
-                {
-                    ww_warning("Couldn’t load image: %s", error->message);
-                    g_error_free(error);
-                }
+                if ( strcmp(optarg, _ww_background_release_mode_names[mode]) != 0 )
+                    continue;
+                self->release_mode = mode;
                 good = true;
             }
         }
+        break;
+#ifdef ENABLE_IMAGES
+        case 'f':
+            if ( gdk_pixbuf_get_file_info(optarg, NULL, NULL) != NULL )
+            {
+                self->defaults.image = optarg;
+                good = true;
+            }
+        break;
 #endif /* ENABLE_IMAGES */
+        case 's':
+            self->settings_path = optarg;
+            good = true;
+        break;
         case 'C':
-            self->cursor.theme_name = optarg;
+            self->cursor_theme = optarg;
+            good = true;
+        break;
+        case WW_BACKGROUND_OPTION_BENCH:
+            self->bench = true;
             good = true;
         break;
         default:
@@ -977,33 +1029,89 @@ main(int argc, char *argv[])
                 "\n"
                 "\nOptions:"
                 "\n    -c <colour>      Colour to use as background, defaults to #000000"
+                "\n    -g <gradient>    Gradient to use as background, overrides -c"
+                "\n    -n <levels>      Noise to add to the gradient, in colour levels"
+                "\n    -j <count>       Number of threads rendering the gradient, defaults to the number of CPUs"
                 "\n    -w <size>        Width of the buffer to create"
                 "\n    -h <size>        Height of the buffer to create"
+                "\n    -l               Save memory with 16-bit buffers, dithered if needed"
+                "\n    -r <mode>        When to release the decoded image and trim the heap: never (default), idle or pressure"
 #ifdef ENABLE_IMAGES
                 "\n    -f <file>        File to use as background image"
 #endif /* ENABLE_IMAGES */
+                "\n    -s <file>        Settings file, reloaded when it changes"
                 "\n    -C <name>        The cursor theme to use"
                 "\n"
+                "\nWithout a compositor:"
+                "\n    --bench          Time the -g gradient in a -w×-h buffer with 1 to -j threads"
+                "\n"
                 "\nFormats:"
                 "\n    Colours options supports #RRGGBB(AA) and #RGB(A) formats"
+                "\n    Gradients are linear:<angle>:<colour>:<colour> or radial:<colour>:<colour>"
+                "\n    Settings files use “key = value” lines, with keys colour, gradient, noise"
+#ifdef ENABLE_IMAGES
+                " and image"
+#endif /* ENABLE_IMAGES */
                 "\n\n", argv[0]);
-            return 3;
+            *status = 3;
+            return NULL;
+        }
+    }
+
+    _ww_background_settings_load(self);
+    if ( ( self->settings.gradient != NULL ) && ( self->pattern == NULL ) )
+    {
+        *status = 3;
+        return NULL;
+    }
+
+    if ( self->bench )
+    {
+        if ( self->pattern == NULL )
+        {
+            ww_warning("No gradient to time, use -g");
+            *status = 3;
         }
+        else
+            *status = _ww_background_bench_run(self);
+        ww_pattern_free(self->pattern);
+        return NULL;
     }
 
-    self->registry = wl_display_get_registry(self->display);
-    wl_registry_add_listener(self->registry, &_ww_background_registry_listener, self);
-    wl_display_roundtrip(self->display);
+    return self;
+}
+
+static bool
+_ww_background_role_attach(void *data, WwClient *client)
+{
+    WwBackgroundContext *self = data;
+
+    self->client = client;
+    if ( self->cursor_theme != NULL )
+        self->client->cursor.theme_name = self->cursor_theme;
+
+    if ( self->settings_path != NULL )
+        self->settings_watch = ww_settings_watch_new(self->client->loop, self->settings_path, _ww_background_settings_changed, self);
+    if ( ( self->release_mode == WW_BACKGROUND_RELEASE_PRESSURE ) && ( ! _ww_background_pressure_watch(self) ) )
+        ww_warning("Memory pressure unavailable, keeping the decoded image and heap");
+
+    if ( ! ww_client_add_globals(self->client, _ww_background_globals, sizeof(_ww_background_globals) / sizeof(*_ww_background_globals), self) )
+        return false;
+    return ww_client_add_listener(self->client, &_ww_background_client_listener, self);
+}
+
+static int
+_ww_background_role_start(void *data)
+{
+    WwBackgroundContext *self = data;
 
-    if ( self->shm == NULL )
+    if ( self->client->shm == NULL )
     {
-        _ww_background_disconnect(self);
         ww_warning("No wl_shm interface provided by the compositor");
         return 3;
     }
     if ( self->background == NULL )
     {
-        _ww_background_disconnect(self);
         ww_warning("No ww_background interface provided by the compositor");
         return 3;
     }
@@ -1011,12 +1119,21 @@ main(int argc, char *argv[])
     if ( ! _ww_background_create_buffer(self, self->width, self->height) )
         return 4;
 
-    int ret;
-    do
-        ret = wl_display_dispatch(self->display);
-    while ( ret > 0 );
-    if ( ret < 0 )
-        ww_warning("Couldn’t dispatch events: %s", strerror(errno));
-
     return 0;
 }
+
+const WwRole ww_background_role = {
+    .name = "background",
+    .init = _ww_background_role_init,
+    .attach = _ww_background_role_attach,
+    .start = _ww_background_role_start,
+};
+
+#ifndef WW_SHELL
+int
+main(int argc, char *argv[])
+{
+    WwRoleInstance instance = { &ww_background_role, argc, argv, NULL };
+    return ww_role_run("ww-background", &instance, 1);
+}
+#endif /* ! WW_SHELL */
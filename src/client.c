@@ -0,0 +1,1052 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "helpers.h"
+
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/mman.h>
+
+#include <wayland-cursor.h>
+#include <xkbcommon/xkbcommon.h>
+#include "cursor-shape-v1-client-protocol.h"
+
+#include "arena.h"
+#include "hash.h"
+#include "loop.h"
+#include "stats.h"
+#include "format.h"
+#include "client.h"
+
+/* Supported interface versions */
+#define WL_COMPOSITOR_INTERFACE_VERSION 3
+#define WL_SHM_INTERFACE_VERSION 1
+#define WL_SEAT_INTERFACE_VERSION 5
+#define WL_OUTPUT_INTERFACE_VERSION 2
+#define WP_CURSOR_SHAPE_MANAGER_INTERFACE_VERSION 1
+
+/* Cursor size at scale 1 */
+#define WW_CLIENT_CURSOR_SIZE 32
+/* Address space only, pages are allocated as the arena grows */
+#define WW_CLIENT_ARENA_RESERVE ((size_t) 1 << 30)
+
+typedef struct {
+    struct wl_list link;
+    const WwClientGlobal *globals;
+    size_t count;
+    void *user_data;
+    uint32_t *names;
+    uint32_t *versions;
+} WwClientGlobals;
+
+typedef struct {
+    struct wl_list link;
+    const WwClientListener *listener;
+    void *user_data;
+} WwClientListenerEntry;
+
+static void _ww_client_shm_bound(void *user_data, void *proxy);
+
+static const WwClientGlobal _ww_client_globals[] = {
+    WW_CLIENT_GLOBAL(WwClient, compositor, wl_compositor_interface, WL_COMPOSITOR_INTERFACE_VERSION, wl_compositor_destroy),
+    { &wl_shm_interface, WL_SHM_INTERFACE_VERSION, offsetof(WwClient, shm), (WwClientProxyDestroyFunc) wl_shm_destroy, _ww_client_shm_bound, false },
+    WW_CLIENT_GLOBAL(WwClient, cursor_shape_manager, wp_cursor_shape_manager_v1_interface, WP_CURSOR_SHAPE_MANAGER_INTERFACE_VERSION, wp_cursor_shape_manager_v1_destroy),
+};
+
+static const char * const _ww_client_cursor_names[] = {
+    "left_ptr",
+    "default",
+    "top_left_arrow",
+    "left-arrow",
+    NULL
+};
+
+static inline void **
+_ww_client_global_proxy(const WwClientGlobals *globals, size_t i)
+{
+    return (void **) ( (char *) globals->user_data + globals->globals[i].offset );
+}
+
+static void
+_ww_client_cursor_set_image(WwClient *self, int i)
+{
+    struct wl_buffer *buffer;
+    struct wl_cursor_image *image;
+    image = self->cursor.cursor->images[i];
+
+    self->cursor.image = image;
+    buffer = wl_cursor_image_get_buffer(self->cursor.image);
+    wl_surface_attach(self->cursor.surface, buffer, 0, 0);
+    if ( wl_surface_get_version(self->cursor.surface) >= WL_SURFACE_SET_BUFFER_SCALE_SINCE_VERSION )
+        wl_surface_set_buffer_scale(self->cursor.surface, self->cursor.scale);
+    wl_surface_damage(self->cursor.surface, 0, 0, self->cursor.image->width, self->cursor.image->height);
+    wl_surface_commit(self->cursor.surface);
+    self->cursor.frame = i;
+}
+
+static void
+_ww_client_cursor_stop(WwClient *self)
+{
+    struct itimerspec spec = { .it_value = { 0, 0 } };
+
+    if ( self->cursor.timer_fd >= 0 )
+        timerfd_settime(self->cursor.timer_fd, 0, &spec, NULL);
+}
+
+/* We only commit when the frame changes, and sleep until the next one */
+static void
+_ww_client_cursor_animate(WwClient *self)
+{
+    uint32_t time = ( ww_stats_now() - self->cursor.start ) / 1000;
+    uint32_t duration = 0;
+    int i;
+
+    i = wl_cursor_frame_and_duration(self->cursor.cursor, time, &duration);
+    if ( i != self->cursor.frame )
+        _ww_client_cursor_set_image(self, i);
+
+    if ( ( self->cursor.timer_fd < 0 ) || ( duration == 0 ) )
+        return;
+
+    struct itimerspec spec = {
+        .it_value = {
+            .tv_sec = duration / 1000,
+            .tv_nsec = ( duration % 1000 ) * 1000000,
+        },
+    };
+    timerfd_settime(self->cursor.timer_fd, 0, &spec, NULL);
+}
+
+static void
+_ww_client_cursor_timer_callback(void *user_data, uint32_t events)
+{
+    WwClient *self = user_data;
+    uint64_t expirations;
+
+    if ( read(self->cursor.timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations) )
+        return;
+
+    if ( ( self->cursor.entered > 0 ) && ( self->cursor.cursor != NULL ) )
+        _ww_client_cursor_animate(self);
+}
+
+static void
+_ww_client_cursor_start(WwClient *self)
+{
+    self->cursor.frame = -1;
+    if ( self->cursor.cursor->image_count < 2 )
+    {
+        _ww_client_cursor_set_image(self, 0);
+        return;
+    }
+
+    if ( self->cursor.timer_fd < 0 )
+    {
+        self->cursor.timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if ( self->cursor.timer_fd >= 0 )
+            self->cursor.timer_source = ww_loop_add_fd(self->loop, self->cursor.timer_fd, EPOLLIN, _ww_client_cursor_timer_callback, self);
+        else
+            ww_warning("Couldn’t create cursor timer: %s", strerror(errno));
+    }
+
+    self->cursor.start = ww_stats_now();
+    _ww_client_cursor_animate(self);
+}
+
+static void _ww_client_cursor_unload(WwClient *self);
+
+/* We only load a theme once hovered, at the scale of the hovered output */
+static void
+_ww_client_cursor_load(WwClient *self, int32_t scale)
+{
+    if ( ( self->cursor.scale == scale ) || ( self->compositor == NULL ) || ( self->shm == NULL ) )
+        return;
+
+    _ww_client_cursor_unload(self);
+    self->cursor.scale = scale;
+
+    self->cursor.theme = wl_cursor_theme_load(self->cursor.theme_name, WW_CLIENT_CURSOR_SIZE * scale, self->shm);
+    if ( self->cursor.theme == NULL )
+        return;
+
+    const char * const *cname = (const char * const *) self->cursor.name;
+    for ( cname = ( cname != NULL ) ? cname : _ww_client_cursor_names ; ( self->cursor.cursor == NULL ) && ( *cname != NULL ) ; ++cname )
+        self->cursor.cursor = wl_cursor_theme_get_cursor(self->cursor.theme, *cname);
+    if ( self->cursor.cursor == NULL )
+    {
+        wl_cursor_theme_destroy(self->cursor.theme);
+        self->cursor.theme = NULL;
+    }
+    else
+        self->cursor.surface = wl_compositor_create_surface(self->compositor);
+}
+
+static void
+_ww_client_cursor_unload(WwClient *self)
+{
+    self->cursor.scale = 0;
+    if ( self->cursor.theme == NULL )
+        return;
+
+    _ww_client_cursor_stop(self);
+
+    wl_surface_destroy(self->cursor.surface);
+    wl_cursor_theme_destroy(self->cursor.theme);
+    self->cursor.surface = NULL;
+    self->cursor.image = NULL;
+    self->cursor.cursor = NULL;
+    self->cursor.theme = NULL;
+}
+
+static int32_t
+_ww_client_get_surface_scale(WwClient *self, struct wl_surface *surface)
+{
+    WwClientListenerEntry *entry;
+    wl_list_for_each(entry, &self->listeners, link)
+    {
+        int32_t scale;
+        if ( ( entry->listener->surface_scale != NULL ) && ( ( scale = entry->listener->surface_scale(entry->user_data, surface) ) > 0 ) )
+            return scale;
+    }
+    return 1;
+}
+
+static void
+_ww_client_pointer_enter(void *data, struct wl_pointer *pointer, uint32_t serial, struct wl_surface *surface, wl_fixed_t x, wl_fixed_t y)
+{
+    WwClientSeat *self = data;
+    WwClient *client = self->client;
+
+    self->pointer_surface = surface;
+    self->pointer_serial = serial;
+    self->pointer_x = wl_fixed_to_double(x);
+    self->pointer_y = wl_fixed_to_double(y);
+
+    /* The compositor draws the cursor, no theme to load at all */
+    if ( client->cursor_shape_manager != NULL )
+    {
+        if ( self->cursor_shape_device == NULL )
+            self->cursor_shape_device = wp_cursor_shape_manager_v1_get_pointer(client->cursor_shape_manager, self->pointer);
+        wp_cursor_shape_device_v1_set_shape(self->cursor_shape_device, serial, WP_CURSOR_SHAPE_DEVICE_V1_SHAPE_DEFAULT);
+        return;
+    }
+
+    _ww_client_cursor_load(client, _ww_client_get_surface_scale(client, surface));
+    if ( client->cursor.surface == NULL )
+        return;
+
+    if ( ! self->cursor_entered )
+        ++client->cursor.entered;
+    self->cursor_entered = true;
+    _ww_client_cursor_start(client);
+
+    wl_pointer_set_cursor(self->pointer, serial, client->cursor.surface, client->cursor.image->hotspot_x / client->cursor.scale, client->cursor.image->hotspot_y / client->cursor.scale);
+}
+
+static void
+_ww_client_pointer_cursor_leave(WwClientSeat *self)
+{
+    WwClient *client = self->client;
+
+    if ( ! self->cursor_entered )
+        return;
+    self->cursor_entered = false;
+
+    if ( --client->cursor.entered == 0 )
+        _ww_client_cursor_stop(client);
+}
+
+static void
+_ww_client_pointer_leave(void *data, struct wl_pointer *pointer, uint32_t serial, struct wl_surface *surface)
+{
+    WwClientSeat *self = data;
+
+    self->pointer_surface = NULL;
+    _ww_client_pointer_cursor_leave(self);
+}
+
+static void
+_ww_client_pointer_motion(void *data, struct wl_pointer *pointer, uint32_t time, wl_fixed_t x, wl_fixed_t y)
+{
+    WwClientSeat *self = data;
+
+    ww_stats_input_dispatched(time);
+
+    self->pointer_x = wl_fixed_to_double(x);
+    self->pointer_y = wl_fixed_to_double(y);
+}
+
+static void
+_ww_client_pointer_button(void *data, struct wl_pointer *pointer, uint32_t serial, uint32_t time, uint32_t button, enum wl_pointer_button_state state)
+{
+    WwClientSeat *self = data;
+
+    ww_stats_input_dispatched(time);
+
+    self->pointer_serial = serial;
+    if ( ( self->pointer_surface == NULL ) || ( state != WL_POINTER_BUTTON_STATE_PRESSED ) )
+        return;
+
+    WwClientListenerEntry *entry;
+    wl_list_for_each(entry, &self->client->listeners, link)
+    {
+        if ( entry->listener->pointer_button != NULL )
+            entry->listener->pointer_button(entry->user_data, self, self->pointer_surface, button);
+    }
+}
+
+static void
+_ww_client_pointer_axis(void *data, struct wl_pointer *pointer, uint32_t time, enum wl_pointer_axis axis, wl_fixed_t value)
+{
+    WwClientSeat *self = data;
+
+    ww_stats_input_dispatched(time);
+
+    if ( self->pointer_surface == NULL )
+        return;
+
+    WwClientListenerEntry *entry;
+    wl_list_for_each(entry, &self->client->listeners, link)
+    {
+        if ( entry->listener->pointer_axis != NULL )
+            entry->listener->pointer_axis(entry->user_data, self->pointer_surface, axis, value);
+    }
+}
+
+static void
+_ww_client_pointer_frame(void *data, struct wl_pointer *pointer)
+{
+}
+
+static void
+_ww_client_pointer_axis_source(void *data, struct wl_pointer *pointer, enum wl_pointer_axis_source axis_source)
+{
+}
+
+static void
+_ww_client_pointer_axis_stop(void *data, struct wl_pointer *pointer, uint32_t time, enum wl_pointer_axis axis)
+{
+}
+
+static void
+_ww_client_pointer_axis_discrete(void *data, struct wl_pointer *pointer, enum wl_pointer_axis axis, int32_t discrete)
+{
+}
+
+static const struct wl_pointer_listener _ww_client_pointer_listener = {
+    .enter = _ww_client_pointer_enter,
+    .leave = _ww_client_pointer_leave,
+    .motion = _ww_client_pointer_motion,
+    .button = _ww_client_pointer_button,
+    .axis = _ww_client_pointer_axis,
+    .frame = _ww_client_pointer_frame,
+    .axis_source = _ww_client_pointer_axis_source,
+    .axis_stop = _ww_client_pointer_axis_stop,
+    .axis_discrete = _ww_client_pointer_axis_discrete,
+};
+
+static void
+_ww_client_pointer_release(WwClientSeat *self)
+{
+    if ( self->pointer == NULL )
+        return;
+
+    self->pointer_surface = NULL;
+    _ww_client_pointer_cursor_leave(self);
+
+    if ( self->cursor_shape_device != NULL )
+        wp_cursor_shape_device_v1_destroy(self->cursor_shape_device);
+    self->cursor_shape_device = NULL;
+
+    if ( wl_pointer_get_version(self->pointer) >= WL_POINTER_RELEASE_SINCE_VERSION )
+        wl_pointer_release(self->pointer);
+    else
+        wl_pointer_destroy(self->pointer);
+
+    self->pointer = NULL;
+}
+
+static void
+_ww_client_keyboard_keymap(void *data, struct wl_keyboard *keyboard, uint32_t format, int32_t fd, uint32_t size)
+{
+    WwClientSeat *self = data;
+    WwClient *client = self->client;
+    char *keymap_string;
+
+    if ( format != WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1 )
+    {
+        close(fd);
+        return;
+    }
+
+    keymap_string = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if ( keymap_string == MAP_FAILED )
+        return;
+
+    if ( client->xkb_context == NULL )
+        client->xkb_context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+
+    struct xkb_keymap *keymap = NULL;
+    if ( client->xkb_context != NULL )
+        keymap = xkb_keymap_new_from_buffer(client->xkb_context, keymap_string, strnlen(keymap_string, size), XKB_KEYMAP_FORMAT_TEXT_V1, XKB_KEYMAP_COMPILE_NO_FLAGS);
+    munmap(keymap_string, size);
+    if ( keymap == NULL )
+    {
+        ww_warning("Couldn’t compile the keymap");
+        return;
+    }
+
+    struct xkb_state *state = xkb_state_new(keymap);
+    if ( state == NULL )
+    {
+        xkb_keymap_unref(keymap);
+        return;
+    }
+
+    if ( self->state != NULL )
+        xkb_state_unref(self->state);
+    if ( self->keymap != NULL )
+        xkb_keymap_unref(self->keymap);
+    self->keymap = keymap;
+    self->state = state;
+}
+
+static void
+_ww_client_keyboard_enter(void *data, struct wl_keyboard *keyboard, uint32_t serial, struct wl_surface *surface, struct wl_array *keys)
+{
+    WwClientSeat *self = data;
+
+    self->keyboard_surface = surface;
+}
+
+static void
+_ww_client_keyboard_leave(void *data, struct wl_keyboard *keyboard, uint32_t serial, struct wl_surface *surface)
+{
+    WwClientSeat *self = data;
+
+    self->keyboard_surface = NULL;
+}
+
+/* No key repeat, our clients only take short input */
+static void
+_ww_client_keyboard_key(void *data, struct wl_keyboard *keyboard, uint32_t serial, uint32_t time, uint32_t key, uint32_t state)
+{
+    WwClientSeat *self = data;
+
+    ww_stats_input_dispatched(time);
+
+    if ( ( self->keyboard_surface == NULL ) || ( self->state == NULL ) || ( state != WL_KEYBOARD_KEY_STATE_PRESSED ) )
+        return;
+
+    /* evdev to XKB keycodes */
+    xkb_keysym_t keysym = xkb_state_key_get_one_sym(self->state, key + 8);
+    char text[64];
+    xkb_state_key_get_utf8(self->state, key + 8, text, sizeof(text));
+
+    WwClientListenerEntry *entry;
+    wl_list_for_each(entry, &self->client->listeners, link)
+    {
+        if ( entry->listener->keyboard_key != NULL )
+            entry->listener->keyboard_key(entry->user_data, self, self->keyboard_surface, keysym, text);
+    }
+}
+
+static void
+_ww_client_keyboard_modifiers(void *data, struct wl_keyboard *keyboard, uint32_t serial, uint32_t mods_depressed, uint32_t mods_latched, uint32_t mods_locked, uint32_t group)
+{
+    WwClientSeat *self = data;
+
+    if ( self->state != NULL )
+        xkb_state_update_mask(self->state, mods_depressed, mods_latched, mods_locked, 0, 0, group);
+}
+
+static void
+_ww_client_keyboard_repeat_info(void *data, struct wl_keyboard *keyboard, int32_t rate, int32_t delay)
+{
+}
+
+static const struct wl_keyboard_listener _ww_client_keyboard_listener = {
+    .keymap = _ww_client_keyboard_keymap,
+    .enter = _ww_client_keyboard_enter,
+    .leave = _ww_client_keyboard_leave,
+    .key = _ww_client_keyboard_key,
+    .modifiers = _ww_client_keyboard_modifiers,
+    .repeat_info = _ww_client_keyboard_repeat_info,
+};
+
+static void
+_ww_client_keyboard_release(WwClientSeat *self)
+{
+    if ( self->keyboard == NULL )
+        return;
+
+    self->keyboard_surface = NULL;
+    if ( self->state != NULL )
+        xkb_state_unref(self->state);
+    if ( self->keymap != NULL )
+        xkb_keymap_unref(self->keymap);
+    self->state = NULL;
+    self->keymap = NULL;
+
+    if ( wl_keyboard_get_version(self->keyboard) >= WL_KEYBOARD_RELEASE_SINCE_VERSION )
+        wl_keyboard_release(self->keyboard);
+    else
+        wl_keyboard_destroy(self->keyboard);
+
+    self->keyboard = NULL;
+}
+
+static void
+_ww_client_seat_release(WwClientSeat *self)
+{
+    _ww_client_pointer_release(self);
+    _ww_client_keyboard_release(self);
+
+    ww_hash_remove(&self->client->seats_by_name, self->global_name);
+    ww_hash_remove(&self->client->seats_by_proxy, (uintptr_t) self->seat);
+
+    if ( wl_seat_get_version(self->seat) >= WL_SEAT_RELEASE_SINCE_VERSION )
+        wl_seat_release(self->seat);
+    else
+        wl_seat_destroy(self->seat);
+
+    wl_list_remove(&self->link);
+
+    free(self);
+}
+
+static void
+_ww_client_seat_capabilities(void *data, struct wl_seat *seat, uint32_t capabilities)
+{
+    WwClientSeat *self = data;
+    if ( ( capabilities & WL_SEAT_CAPABILITY_POINTER ) && ( self->pointer == NULL ) )
+    {
+        self->pointer = wl_seat_get_pointer(self->seat);
+        wl_pointer_add_listener(self->pointer, &_ww_client_pointer_listener, self);
+    }
+    else if ( ( ! ( capabilities & WL_SEAT_CAPABILITY_POINTER ) ) && ( self->pointer != NULL ) )
+        _ww_client_pointer_release(self);
+
+    if ( ( capabilities & WL_SEAT_CAPABILITY_KEYBOARD ) && ( self->keyboard == NULL ) )
+    {
+        self->keyboard = wl_seat_get_keyboard(self->seat);
+        wl_keyboard_add_listener(self->keyboard, &_ww_client_keyboard_listener, self);
+    }
+    else if ( ( ! ( capabilities & WL_SEAT_CAPABILITY_KEYBOARD ) ) && ( self->keyboard != NULL ) )
+        _ww_client_keyboard_release(self);
+}
+
+static void
+_ww_client_seat_name(void *data, struct wl_seat *seat, const char *name)
+{
+}
+
+static const struct wl_seat_listener _ww_client_seat_listener = {
+    .capabilities = _ww_client_seat_capabilities,
+    .name = _ww_client_seat_name,
+};
+
+static void
+_ww_client_seat_new(WwClient *self, uint32_t name, uint32_t version)
+{
+    WwClientSeat *seat = ww_new0(WwClientSeat, 1);
+    if ( seat == NULL )
+        return;
+
+    seat->client = self;
+    seat->global_name = name;
+    seat->seat = wl_registry_bind(self->registry, name, &wl_seat_interface, MIN(version, WL_SEAT_INTERFACE_VERSION));
+
+    wl_list_insert(&self->seats, &seat->link);
+    ww_hash_insert(&self->seats_by_name, name, seat);
+    ww_hash_insert(&self->seats_by_proxy, (uintptr_t) seat->seat, seat);
+
+    wl_seat_add_listener(seat->seat, &_ww_client_seat_listener, seat);
+}
+
+static void
+_ww_client_output_release(WwClientOutput *self)
+{
+    WwClientListenerEntry *entry;
+    wl_list_for_each(entry, &self->client->listeners, link)
+    {
+        if ( entry->listener->output_removed != NULL )
+            entry->listener->output_removed(entry->user_data, self);
+    }
+
+    ww_hash_remove(&self->client->outputs_by_name, self->global_name);
+    ww_hash_remove(&self->client->outputs_by_proxy, (uintptr_t) self->output);
+
+    if ( wl_output_get_version(self->output) >= WL_OUTPUT_RELEASE_SINCE_VERSION )
+        wl_output_release(self->output);
+    else
+        wl_output_destroy(self->output);
+
+    wl_list_remove(&self->link);
+
+    free(self);
+}
+
+static void
+_ww_client_output_done(void *data, struct wl_output *output)
+{
+    WwClientOutput *self = data;
+
+    WwClientListenerEntry *entry;
+    wl_list_for_each(entry, &self->client->listeners, link)
+    {
+        if ( entry->listener->output_done != NULL )
+            entry->listener->output_done(entry->user_data, self);
+    }
+}
+
+static void
+_ww_client_output_geometry(void *data, struct wl_output *output, int32_t x, int32_t y, int32_t width, int32_t height, int32_t subpixel, const char *make, const char *model, int32_t transform)
+{
+}
+
+static void
+_ww_client_output_mode(void *data, struct wl_output *output, enum wl_output_mode flags, int32_t width, int32_t height, int32_t refresh)
+{
+    WwClientOutput *self = data;
+
+    if ( ! ( flags & WL_OUTPUT_MODE_CURRENT ) )
+        return;
+
+    self->width = width;
+    self->height = height;
+
+    if ( wl_output_get_version(self->output) < WL_OUTPUT_DONE_SINCE_VERSION )
+        _ww_client_output_done(self, self->output);
+}
+
+static void
+_ww_client_output_scale(void *data, struct wl_output *output, int32_t scale)
+{
+    WwClientOutput *self = data;
+
+    self->scale = scale;
+}
+
+static const struct wl_output_listener _ww_client_output_listener = {
+    .geometry = _ww_client_output_geometry,
+    .mode = _ww_client_output_mode,
+    .scale = _ww_client_output_scale,
+    .done = _ww_client_output_done,
+};
+
+static void
+_ww_client_output_new(WwClient *self, uint32_t name, uint32_t version)
+{
+    WwClientOutput *output = ww_new0(WwClientOutput, 1);
+    if ( output == NULL )
+        return;
+
+    output->client = self;
+    output->global_name = name;
+    output->output = wl_registry_bind(self->registry, name, &wl_output_interface, MIN(version, WL_OUTPUT_INTERFACE_VERSION));
+    output->scale = 1;
+
+    wl_list_insert(&self->outputs, &output->link);
+    ww_hash_insert(&self->outputs_by_name, name, output);
+    ww_hash_insert(&self->outputs_by_proxy, (uintptr_t) output->output, output);
+
+    wl_output_add_listener(output->output, &_ww_client_output_listener, output);
+}
+
+static void
+_ww_client_shm_format(void *data, struct wl_shm *shm, uint32_t shm_format)
+{
+    WwClient *self = data;
+    WwFormat format;
+
+    if ( ww_format_from_shm(shm_format, &format) )
+        self->formats |= WW_FORMAT_MASK(format);
+}
+
+static const struct wl_shm_listener _ww_client_shm_listener = {
+    .format = _ww_client_shm_format,
+};
+
+static void
+_ww_client_shm_bound(void *user_data, void *proxy)
+{
+    WwClient *self = user_data;
+
+    self->formats = WW_FORMAT_MASK_DEFAULT;
+    wl_shm_add_listener(proxy, &_ww_client_shm_listener, self);
+
+    /* Created here so roles on other threads never race for it */
+    if ( self->arena == NULL )
+        self->arena = ww_arena_new(proxy, WW_CLIENT_ARENA_RESERVE);
+}
+
+static void
+_ww_client_global_bind(WwClient *self, WwClientGlobals *globals, size_t i)
+{
+    const WwClientGlobal *global = globals->globals + i;
+
+    void *proxy = wl_registry_bind(self->registry, globals->names[i], global->interface, MIN(globals->versions[i], global->version));
+    *_ww_client_global_proxy(globals, i) = proxy;
+    if ( global->bound != NULL )
+        global->bound(globals->user_data, proxy);
+}
+
+static bool
+_ww_client_global_needs_fallback(WwClient *self, WwClientGlobals *globals, size_t i)
+{
+    return self->globals_known && ( globals->names[i] != 0 ) && ( *_ww_client_global_proxy(globals, i) == NULL ) && ( globals->names[i - 1] == 0 );
+}
+
+static void
+_ww_client_registry_handle_global(void *data, struct wl_registry *registry, uint32_t name, const char *interface, uint32_t version)
+{
+    WwClient *self = data;
+
+    if ( strcmp(interface, wl_seat_interface.name) == 0 )
+        _ww_client_seat_new(self, name, version);
+    else if ( strcmp(interface, wl_output_interface.name) == 0 )
+        _ww_client_output_new(self, name, version);
+    else
+    {
+        /* Each table gets its own proxy, so that several clients can share our connection */
+        WwClientGlobals *globals;
+        wl_list_for_each(globals, &self->globals, link)
+        {
+            size_t i;
+            for ( i = 0 ; i < globals->count ; ++i )
+            {
+                const WwClientGlobal *global = globals->globals + i;
+                if ( ( globals->names[i] != 0 ) || ( strcmp(interface, global->interface->name) != 0 ) )
+                    continue;
+
+                globals->names[i] = name;
+                globals->versions[i] = version;
+                if ( ( ! global->fallback ) || _ww_client_global_needs_fallback(self, globals, i) )
+                    _ww_client_global_bind(self, globals, i);
+                break;
+            }
+        }
+    }
+}
+
+static void
+_ww_client_global_destroy(WwClientGlobals *globals, size_t i)
+{
+    void **proxy = _ww_client_global_proxy(globals, i);
+
+    globals->names[i] = 0;
+    if ( *proxy == NULL )
+        return;
+
+    if ( globals->globals[i].destroy != NULL )
+        globals->globals[i].destroy(*proxy);
+    else
+        wl_proxy_destroy(*proxy);
+    *proxy = NULL;
+}
+
+static void
+_ww_client_registry_handle_global_remove(void *data, struct wl_registry *registry, uint32_t name)
+{
+    WwClient *self = data;
+
+    WwClientSeat *seat = ww_hash_lookup(&self->seats_by_name, name);
+    if ( seat != NULL )
+    {
+        _ww_client_seat_release(seat);
+        return;
+    }
+
+    WwClientOutput *output = ww_hash_lookup(&self->outputs_by_name, name);
+    if ( output != NULL )
+    {
+        _ww_client_output_release(output);
+        return;
+    }
+
+    WwClientGlobals *globals;
+    wl_list_for_each(globals, &self->globals, link)
+    {
+        size_t i;
+        for ( i = 0 ; i < globals->count ; ++i )
+        {
+            if ( globals->names[i] == name )
+                _ww_client_global_destroy(globals, i);
+        }
+    }
+
+    if ( ( self->compositor == NULL ) || ( self->shm == NULL ) )
+        _ww_client_cursor_unload(self);
+}
+
+static const struct wl_registry_listener _ww_client_registry_listener = {
+    .global = _ww_client_registry_handle_global,
+    .global_remove = _ww_client_registry_handle_global_remove,
+};
+
+WwClient *
+ww_client_new(const char *name)
+{
+    WwClient *self;
+    const char *runtime_dir;
+
+    runtime_dir = getenv("XDG_RUNTIME_DIR");
+    if ( runtime_dir == NULL )
+        return NULL;
+
+    self = ww_new0(WwClient, 1);
+    if ( self == NULL )
+        return NULL;
+
+    self->cursor.timer_fd = -1;
+    wl_list_init(&self->globals);
+    wl_list_init(&self->listeners);
+    wl_list_init(&self->seats);
+    wl_list_init(&self->outputs);
+    ww_hash_init(&self->seats_by_name);
+    ww_hash_init(&self->seats_by_proxy);
+    ww_hash_init(&self->outputs_by_name);
+    ww_hash_init(&self->outputs_by_proxy);
+
+    snprintf(self->runtime_dir, PATH_MAX, "%s/" PACKAGE_NAME, runtime_dir);
+    if ( mkdir(self->runtime_dir, 0755) < 0 )
+    {
+        struct stat buf;
+        if ( ( errno != EEXIST ) || ( stat(self->runtime_dir, &buf) < 0 ) || ( ! S_ISDIR(buf.st_mode) ) )
+        {
+            ww_client_free(self);
+            return NULL;
+        }
+    }
+
+    self->display = wl_display_connect(NULL);
+    if ( self->display == NULL )
+    {
+        ww_client_free(self);
+        return NULL;
+    }
+
+    self->loop = ww_loop_new(self->display);
+    if ( self->loop == NULL )
+    {
+        ww_client_free(self);
+        return NULL;
+    }
+
+    if ( ! ww_client_add_globals(self, _ww_client_globals, sizeof(_ww_client_globals) / sizeof(*_ww_client_globals), self) )
+    {
+        ww_client_free(self);
+        return NULL;
+    }
+
+    self->stats = ww_stats_new(self->loop, self->runtime_dir, name);
+
+    return self;
+}
+
+void
+ww_client_free(WwClient *self)
+{
+    if ( self->display != NULL )
+        ww_client_disconnect(self);
+
+    WwClientGlobals *globals, *tmp_globals;
+    wl_list_for_each_safe(globals, tmp_globals, &self->globals, link)
+    {
+        free(globals->versions);
+        free(globals->names);
+        free(globals);
+    }
+
+    WwClientListenerEntry *entry, *tmp_entry;
+    wl_list_for_each_safe(entry, tmp_entry, &self->listeners, link)
+        free(entry);
+
+    ww_hash_clear(&self->outputs_by_proxy);
+    ww_hash_clear(&self->outputs_by_name);
+    ww_hash_clear(&self->seats_by_proxy);
+    ww_hash_clear(&self->seats_by_name);
+
+    if ( self->cursor.timer_source != NULL )
+        ww_loop_source_free(self->cursor.timer_source);
+    if ( self->cursor.timer_fd >= 0 )
+        close(self->cursor.timer_fd);
+
+    if ( self->xkb_context != NULL )
+        xkb_context_unref(self->xkb_context);
+
+    ww_stats_free(self->stats);
+    if ( self->loop != NULL )
+        ww_loop_free(self->loop);
+
+    free(self);
+}
+
+bool
+ww_client_add_globals(WwClient *self, const WwClientGlobal *globals, size_t count, void *user_data)
+{
+    WwClientGlobals *entry;
+
+    entry = ww_new0(WwClientGlobals, 1);
+    if ( entry == NULL )
+        return false;
+
+    entry->names = ww_new0(uint32_t, count);
+    entry->versions = ww_new0(uint32_t, count);
+    if ( ( entry->names == NULL ) || ( entry->versions == NULL ) )
+    {
+        free(entry->versions);
+        free(entry->names);
+        free(entry);
+        return false;
+    }
+
+    entry->globals = globals;
+    entry->count = count;
+    entry->user_data = user_data;
+    wl_list_insert(self->globals.prev, &entry->link);
+
+    return true;
+}
+
+bool
+ww_client_add_listener(WwClient *self, const WwClientListener *listener, void *user_data)
+{
+    WwClientListenerEntry *entry;
+
+    entry = ww_new0(WwClientListenerEntry, 1);
+    if ( entry == NULL )
+        return false;
+
+    entry->listener = listener;
+    entry->user_data = user_data;
+    wl_list_insert(self->listeners.prev, &entry->link);
+
+    return true;
+}
+
+bool
+ww_client_connect(WwClient *self)
+{
+    self->registry = wl_display_get_registry(self->display);
+    wl_registry_add_listener(self->registry, &_ww_client_registry_listener, self);
+    if ( wl_display_roundtrip(self->display) < 0 )
+        return false;
+
+    self->globals_known = true;
+    WwClientGlobals *globals;
+    wl_list_for_each(globals, &self->globals, link)
+    {
+        size_t i;
+        for ( i = 0 ; i < globals->count ; ++i )
+        {
+            if ( globals->globals[i].fallback && _ww_client_global_needs_fallback(self, globals, i) )
+                _ww_client_global_bind(self, globals, i);
+        }
+    }
+
+    /* Get the wl_shm formats and outputs state */
+    if ( wl_display_roundtrip(self->display) < 0 )
+        return false;
+
+    return true;
+}
+
+void
+ww_client_disconnect(WwClient *self)
+{
+    WwClientSeat *seat, *tmp_seat;
+    wl_list_for_each_safe(seat, tmp_seat, &self->seats, link)
+        _ww_client_seat_release(seat);
+
+    WwClientOutput *output, *tmp_output;
+    wl_list_for_each_safe(output, tmp_output, &self->outputs, link)
+        _ww_client_output_release(output);
+
+    _ww_client_cursor_unload(self);
+
+    if ( self->arena != NULL )
+        ww_arena_free(self->arena);
+    self->arena = NULL;
+
+    WwClientGlobals *globals;
+    wl_list_for_each(globals, &self->globals, link)
+    {
+        size_t i;
+        for ( i = 0 ; i < globals->count ; ++i )
+        {
+            if ( globals->names[i] != 0 )
+                _ww_client_global_destroy(globals, i);
+        }
+    }
+
+    if ( self->registry != NULL )
+        wl_registry_destroy(self->registry);
+    self->registry = NULL;
+    self->globals_known = false;
+
+    wl_display_disconnect(self->display);
+    self->display = NULL;
+}
+
+WwClientSeat *
+ww_client_get_seat(WwClient *self, struct wl_seat *seat)
+{
+    return ww_hash_lookup(&self->seats_by_proxy, (uintptr_t) seat);
+}
+
+WwClientSeat *
+ww_client_get_seat_by_name(WwClient *self, uint32_t name)
+{
+    return ww_hash_lookup(&self->seats_by_name, name);
+}
+
+WwClientOutput *
+ww_client_get_output(WwClient *self, struct wl_output *output)
+{
+    return ww_hash_lookup(&self->outputs_by_proxy, (uintptr_t) output);
+}
+
+WwClientOutput *
+ww_client_get_output_by_name(WwClient *self, uint32_t name)
+{
+    return ww_hash_lookup(&self->outputs_by_name, name);
+}
+
+bool
+ww_client_shm_alloc(WwClient *self, size_t size, WwArenaBlock *block)
+{
+    if ( self->arena == NULL )
+        return false;
+
+    return ww_arena_alloc(self->arena, size, block);
+}
+
+void
+ww_client_shm_release(WwClient *self, WwArenaBlock *block)
+{
+    if ( ( self->arena != NULL ) && ( block->data != NULL ) )
+        ww_arena_release(self->arena, block);
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef __WW_CLIENT_H__
+#define __WW_CLIENT_H__
+
+#include "helpers.h"
+
+#include <stddef.h>
+#include <wayland-cursor.h>
+
+#include "arena.h"
+#include "hash.h"
+#include "loop.h"
+#include "stats.h"
+
+typedef struct _WwClient WwClient;
+typedef struct _WwClientSeat WwClientSeat;
+typedef struct _WwClientOutput WwClientOutput;
+
+typedef void (*WwClientProxyDestroyFunc)(void *proxy);
+typedef void (*WwClientProxyBoundFunc)(void *user_data, void *proxy);
+
+/*
+ * A singleton global, bound at most once per table to the proxy
+ * pointer at offset in user_data, and destroyed on removal
+ * A fallback is only bound, once all the globals are known,
+ * if the one of the previous entry was not advertised
+ */
+typedef struct {
+    const struct wl_interface *interface;
+    uint32_t version;
+    size_t offset;
+    WwClientProxyDestroyFunc destroy;
+    WwClientProxyBoundFunc bound;
+    bool fallback;
+} WwClientGlobal;
+
+#define WW_CLIENT_GLOBAL(type, member, interface, version, destroy) { &interface, version, offsetof(type, member), (WwClientProxyDestroyFunc) destroy, NULL, false }
+
+typedef struct {
+    void (*output_done)(void *user_data, WwClientOutput *output);
+    void (*output_removed)(void *user_data, WwClientOutput *output);
+    /* Integer scale of the output showing the surface, 0 if it is not ours */
+    int32_t (*surface_scale)(void *user_data, struct wl_surface *surface);
+    /* Scrolling over the surface, ignore it if it is not ours */
+    void (*pointer_axis)(void *user_data, struct wl_surface *surface, enum wl_pointer_axis axis, wl_fixed_t value);
+    /* A button press, the position is in the seat */
+    void (*pointer_button)(void *user_data, WwClientSeat *seat, struct wl_surface *surface, uint32_t button);
+    /* A key press in the focused surface, with its keysym and text, which may be empty */
+    void (*keyboard_key)(void *user_data, WwClientSeat *seat, struct wl_surface *surface, uint32_t keysym, const char *text);
+} WwClientListener;
+
+typedef struct {
+    char *theme_name;
+    char **name;
+    struct wl_cursor_theme *theme;
+    struct wl_cursor *cursor;
+    struct wl_cursor_image *image;
+    struct wl_surface *surface;
+    int32_t scale;
+    int frame;
+    int64_t start;
+    size_t entered;
+    int timer_fd;
+    WwLoopSource *timer_source;
+} WwClientCursor;
+
+struct _WwClientSeat {
+    WwClient *client;
+    struct wl_list link;
+    uint32_t global_name;
+    struct wl_seat *seat;
+    struct wl_pointer *pointer;
+    struct wl_surface *pointer_surface;
+    /* Of the last enter or button event, for requests wanting one */
+    uint32_t pointer_serial;
+    double pointer_x;
+    double pointer_y;
+    struct wp_cursor_shape_device_v1 *cursor_shape_device;
+    bool cursor_entered;
+    struct wl_keyboard *keyboard;
+    struct wl_surface *keyboard_surface;
+    struct xkb_keymap *keymap;
+    struct xkb_state *state;
+};
+
+struct _WwClientOutput {
+    WwClient *client;
+    struct wl_list link;
+    uint32_t global_name;
+    struct wl_output *output;
+    int32_t width;
+    int32_t height;
+    int32_t scale;
+};
+
+/* Fields are read-only outside of client.c, except cursor names */
+struct _WwClient {
+    char runtime_dir[PATH_MAX];
+    struct wl_display *display;
+    WwLoop *loop;
+    WwStats *stats;
+    struct wl_registry *registry;
+    bool globals_known;
+    struct wl_compositor *compositor;
+    struct wl_shm *shm;
+    uint32_t formats;
+    WwArena *arena;
+    struct wp_cursor_shape_manager_v1 *cursor_shape_manager;
+    WwClientCursor cursor;
+    struct xkb_context *xkb_context;
+    struct wl_list globals;
+    struct wl_list listeners;
+    struct wl_list seats;
+    struct wl_list outputs;
+    WwHash seats_by_name;
+    WwHash seats_by_proxy;
+    WwHash outputs_by_name;
+    WwHash outputs_by_proxy;
+};
+
+/* name is used for the stats socket */
+WwClient *ww_client_new(const char *name);
+void ww_client_free(WwClient *self);
+
+/* To call before ww_client_connect() */
+bool ww_client_add_globals(WwClient *self, const WwClientGlobal *globals, size_t count, void *user_data);
+bool ww_client_add_listener(WwClient *self, const WwClientListener *listener, void *user_data);
+
+/* Binds globals and waits for their initial state */
+bool ww_client_connect(WwClient *self);
+void ww_client_disconnect(WwClient *self);
+
+WwClientSeat *ww_client_get_seat(WwClient *self, struct wl_seat *seat);
+WwClientSeat *ww_client_get_seat_by_name(WwClient *self, uint32_t name);
+WwClientOutput *ww_client_get_output(WwClient *self, struct wl_output *output);
+WwClientOutput *ww_client_get_output_by_name(WwClient *self, uint32_t name);
+
+/* Blocks of the shm arena shared by all our buffers, create them with ww_arena_create_buffer() */
+bool ww_client_shm_alloc(WwClient *self, size_t size, WwArenaBlock *block);
+void ww_client_shm_release(WwClient *self, WwArenaBlock *block);
+
+#endif /* __WW_CLIENT_H__ */
@@ -0,0 +1,178 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/* For asprintf() */
+#define _GNU_SOURCE
+
+#include "helpers.h"
+
+#include <ctype.h>
+#include <sys/stat.h>
+
+#include "desktop.h"
+
+bool
+ww_desktop_parse(const char *path, WwDesktopEntryCallback callback, void *user_data)
+{
+    FILE *f;
+
+    f = fopen(path, "re");
+    if ( f == NULL )
+        return false;
+
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t length;
+    bool in_entry = false;
+    while ( ( length = getline(&line, &size, f) ) >= 0 )
+    {
+        while ( ( length > 0 ) && isspace((unsigned char) line[length - 1]) )
+            line[--length] = '\0';
+        if ( ( length == 0 ) || ( line[0] == '#' ) )
+            continue;
+
+        if ( line[0] == '[' )
+        {
+            /* The main group comes first, we are done */
+            if ( in_entry )
+                break;
+            in_entry = ( strcmp(line, "[Desktop Entry]") == 0 );
+            continue;
+        }
+        if ( ! in_entry )
+            continue;
+
+        char *value = strchr(line, '=');
+        if ( value == NULL )
+            continue;
+
+        char *e = value;
+        while ( ( e > line ) && isspace((unsigned char) e[-1]) )
+            --e;
+        *e = '\0';
+        ++value;
+        while ( isspace((unsigned char) *value) )
+            ++value;
+
+        callback(user_data, line, value);
+    }
+
+    free(line);
+    fclose(f);
+
+    return true;
+}
+
+char **
+ww_desktop_get_data_dirs(const char *suffix)
+{
+    const char *home = getenv("XDG_DATA_HOME");
+    const char *dirs = getenv("XDG_DATA_DIRS");
+    char *home_default = NULL;
+    size_t count = 2, i = 0;
+    const char *p;
+
+    if ( ( home == NULL ) || ( home[0] != '/' ) )
+    {
+        const char *user_home = getenv("HOME");
+        if ( ( user_home == NULL ) || ( asprintf(&home_default, "%s/.local/share", user_home) < 0 ) )
+            home_default = NULL;
+        home = home_default;
+    }
+    if ( ( dirs == NULL ) || ( dirs[0] == '\0' ) )
+        dirs = "/usr/local/share:/usr/share";
+    for ( p = dirs ; *p != '\0' ; ++p )
+    {
+        if ( *p == ':' )
+            ++count;
+    }
+
+    char **list = ww_new0(char *, count + 1);
+    if ( list == NULL )
+    {
+        free(home_default);
+        return NULL;
+    }
+
+    if ( ( home != NULL ) && ( asprintf(&list[i], "%s/%s", home, suffix) >= 0 ) )
+        ++i;
+    for ( p = dirs ; *p != '\0' ; )
+    {
+        size_t length = strcspn(p, ":");
+        /* Relative paths are invalid and ignored */
+        if ( ( length > 0 ) && ( p[0] == '/' ) && ( asprintf(&list[i], "%.*s/%s", (int) length, p, suffix) >= 0 ) )
+            ++i;
+        p += length;
+        if ( *p == ':' )
+            ++p;
+    }
+    list[i] = NULL;
+
+    free(home_default);
+    return list;
+}
+
+void
+ww_desktop_free_data_dirs(char **dirs)
+{
+    char **dir;
+
+    if ( dirs == NULL )
+        return;
+    for ( dir = dirs ; *dir != NULL ; ++dir )
+        free(*dir);
+    free(dirs);
+}
+
+char *
+ww_desktop_get_cache_path(const char *name)
+{
+    const char *cache_home = getenv("XDG_CACHE_HOME");
+    char *dir = NULL, *path = NULL;
+
+    if ( ( cache_home != NULL ) && ( cache_home[0] == '/' ) )
+    {
+        if ( asprintf(&dir, "%s/" PACKAGE_NAME, cache_home) < 0 )
+            return NULL;
+    }
+    else
+    {
+        const char *home = getenv("HOME");
+        if ( home == NULL )
+            return NULL;
+        if ( asprintf(&dir, "%s/.cache", home) < 0 )
+            return NULL;
+        mkdir(dir, 0700);
+        free(dir);
+        if ( asprintf(&dir, "%s/.cache/" PACKAGE_NAME, home) < 0 )
+            return NULL;
+    }
+
+    if ( ( mkdir(dir, 0700) < 0 ) && ( errno != EEXIST ) )
+        ww_warning("Couldn’t create cache directory %s: %s", dir, strerror(errno));
+    if ( asprintf(&path, "%s/%s", dir, name) < 0 )
+        path = NULL;
+    free(dir);
+
+    return path;
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef __WW_DESKTOP_H__
+#define __WW_DESKTOP_H__
+
+#include "helpers.h"
+
+typedef void (*WwDesktopEntryCallback)(void *user_data, const char *key, const char *value);
+
+/*
+ * Calls callback for each key of the [Desktop Entry] group of a .desktop
+ * file, localized keys (“Name[fr]”) included, values are not unescaped
+ */
+bool ww_desktop_parse(const char *path, WwDesktopEntryCallback callback, void *user_data);
+
+/*
+ * “<dir>/<suffix>” for XDG_DATA_HOME then each of XDG_DATA_DIRS, with
+ * their defaults, most important first, NULL-terminated
+ */
+char **ww_desktop_get_data_dirs(const char *suffix);
+void ww_desktop_free_data_dirs(char **dirs);
+
+/* “$XDG_CACHE_HOME/wayland-wall/<name>”, creating the directories */
+char *ww_desktop_get_cache_path(const char *name);
+
+#endif /* __WW_DESKTOP_H__ */
@@ -23,112 +23,214 @@
 
 #include "helpers.h"
 
-#include <sys/stat.h>
-#include <fcntl.h>
-#include <sys/mman.h>
+#include <inttypes.h>
+#include <getopt.h>
 #include <poll.h>
-
-#include <wayland-cursor.h>
+#include <pthread.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <cairo.h>
 #include <pango/pango.h>
 #include <pango/pangocairo.h>
+#include "viewporter-client-protocol.h"
+#include "fractional-scale-v1-client-protocol.h"
+#include "presentation-time-client-protocol.h"
 #include "dock-manager-unstable-v2-client-protocol.h"
+#include "client.h"
+#include "loop.h"
+#include "settings.h"
+#include "format.h"
+#include "stats.h"
+#include "queue.h"
+#include "role.h"
+#include "metrics.h"
+#include "feed.h"
+#include "widget.h"
 
 /* Supported interface versions */
-#define WL_COMPOSITOR_INTERFACE_VERSION 3
 #define WW_DOCK_MANAGER_INTERFACE_VERSION 1
-#define WL_SHM_INTERFACE_VERSION 1
-#define WL_SEAT_INTERFACE_VERSION 5
-#define WL_OUTPUT_INTERFACE_VERSION 2
+#define WP_VIEWPORTER_INTERFACE_VERSION 1
+#define WP_FRACTIONAL_SCALE_MANAGER_INTERFACE_VERSION 1
+#define WP_PRESENTATION_INTERFACE_VERSION 1
 
-typedef enum {
-    WW_DOCK_GLOBAL_COMPOSITOR,
-    WW_DOCK_GLOBAL_DOCK_MANAGER,
-    WW_DOCK_GLOBAL_SHM,
-    _WW_DOCK_GLOBAL_SIZE,
-} WwDockGlobalName;
+/* wp_fractional_scale_v1 scales are expressed in 120ths */
+#define WW_DOCK_SCALE_DENOMINATOR 120
+
+/* Offscreen rendering defaults */
+#define WW_DOCK_OFFSCREEN_FRAMES 60
+
+/* Messages only carry output and settings changes, we never get close */
+#define WW_DOCK_MESSAGES_CAPACITY 64
+
+#define WW_DOCK_WIDGETS_MAX 32
+
+/* A widget due this close after the vblank we aim for is shown in it, in µs */
+#define WW_DOCK_UPDATE_SLACK 2000
 
 typedef struct {
-    char runtime_dir[PATH_MAX];
-    struct wl_display *display;
-    struct wl_registry *registry;
-    uint32_t global_names[_WW_DOCK_GLOBAL_SIZE];
-    struct wl_compositor *compositor;
-    struct zww_dock_manager_v2 *dock_manager;
-    struct wl_shm *shm;
-    size_t buffer_count;
-    struct {
-        char *theme_name;
-        char **name;
-        struct wl_cursor_theme *theme;
-        struct wl_cursor *cursor;
-        struct wl_cursor_image *image;
-        struct wl_surface *surface;
-        struct wl_callback *frame_cb;
-    } cursor;
-    struct wl_list seats;
-    struct wl_list outputs;
     WwColour background_colour;
     WwColour text_colour;
-} WwDockContext;
+} WwDockSettings;
 
-typedef struct {
-    WwDockContext *context;
-    struct wl_list link;
-    uint32_t global_name;
-    struct wl_seat *seat;
-    struct wl_pointer *pointer;
-} WwDockSeat;
+typedef enum {
+    WW_DOCK_MESSAGE_OUTPUT,
+    WW_DOCK_MESSAGE_OUTPUT_REMOVED,
+    WW_DOCK_MESSAGE_SETTINGS,
+    WW_DOCK_MESSAGE_PRODUCER,
+} WwDockMessageType;
 
+typedef struct _WwDockProducer WwDockProducer;
+
+/* From the main thread to the render thread */
+typedef struct {
+    WwDockMessageType type;
+    union {
+        struct {
+            struct wl_output *output;
+            int32_t scale;
+        } output;
+        WwDockSettings settings;
+        WwDockProducer *producer;
+    };
+} WwDockMessage;
+
+/* The render thread copy of a WwClientOutput */
 typedef struct {
-    WwDockContext *context;
-    struct wl_list link;
-    uint32_t global_name;
     struct wl_output *output;
     int32_t scale;
 } WwDockOutput;
 
+typedef struct {
+    bool enabled;
+    int32_t width;
+    int32_t height;
+    uint32_t scale;
+    size_t frames;
+    const char *png_prefix;
+} WwDockOffscreen;
+
+typedef struct {
+    WwClient *client;
+    struct zww_dock_manager_v2 *dock_manager;
+    bool low_memory;
+    struct wp_viewporter *viewporter;
+    struct wp_fractional_scale_manager_v1 *fractional_scale_manager;
+    struct wp_presentation *presentation;
+    clockid_t presentation_clock;
+    size_t buffer_count;
+    struct wl_list docks;
+    WwDockOffscreen offscreen;
+    const char *widgets[WW_DOCK_WIDGETS_MAX];
+    size_t widget_count;
+    WwMetrics *metrics;
+    bool feed;
+    const char *feed_path;
+    int feed_socket_fd;
+    WwLoopSource *feed_source;
+    /* Shared by all producers, so the render thread polls a single fd */
+    int feed_event_fd;
+    /*
+     * Hung up producers, handed to the render thread through the feed
+     * eventfd since a full message queue must not leak them
+     */
+    pthread_mutex_t removed_mutex;
+    struct wl_list removed_producers;
+    char *cursor_theme;
+    char *settings_path;
+    WwSettingsWatch *settings_watch;
+    WwDockSettings defaults;
+    WwDockSettings settings;
+    WwQueue *messages;
+    /*
+     * Owned by the render thread once started, our dock proxies live
+     * on its queue so the main thread only dispatches input and globals
+     */
+    pthread_t render_thread;
+    struct wl_event_queue *render_queue;
+    struct wl_compositor *render_compositor;
+    struct zww_dock_manager_v2 *render_dock_manager;
+    struct wp_viewporter *render_viewporter;
+    struct wp_fractional_scale_manager_v1 *render_fractional_scale_manager;
+    struct wp_presentation *render_presentation;
+    int render_timer_fd;
+    WwDockSettings render_settings;
+    WwHash render_outputs;
+    struct wl_list render_producers;
+} WwDockContext;
+
+/* The main thread watches the connection, the render thread reads the ring */
+struct _WwDockProducer {
+    WwDockContext *context;
+    struct wl_list link;
+    struct wl_list removed_link;
+    int fd;
+    WwLoopSource *source;
+    WwFeedRing *ring;
+};
+
+typedef struct _WwDock WwDock;
+
 typedef struct {
     struct wl_buffer *buffer;
     uint8_t *data;
     bool released;
+    int64_t attach_time;
+    /* The dock frame we hold, 0 if we need a full redraw */
+    uint64_t frame;
 } WwBuffer;
 typedef struct {
     WwDockContext *context;
-    uint8_t *data;
-    size_t size;
+    WwDock *dock;
+    WwArenaBlock block;
+    WwFormat format;
+    int32_t width;
+    int32_t height;
+    int32_t stride;
+    uint32_t scale;
     bool to_free;
     WwBuffer *buffers;
 } WwBufferPool;
 
 typedef struct {
+    struct wl_list link;
+    WwDockOutput *output;
+} WwDockSurfaceOutput;
+
+struct _WwDock {
     WwDockContext *context;
     struct wl_list link;
     struct wl_surface *surface;
+    struct wp_viewport *viewport;
+    struct wp_fractional_scale_v1 *fractional_scale;
     struct zww_dock_v2 *dock;
-    PangoLayout *text;
+    struct wl_list widgets;
+    bool vertical;
     WwBufferPool *pool;
     int32_t width;
     int32_t height;
-    size_t scales[3];
-    int32_t scale;
-    int32_t text_width;
-    int32_t text_height;
-    time_t time;
-    struct wl_callback *frame_cb;
-} WwDock;
+    struct wl_list outputs;
+    uint32_t preferred_scale;
+    uint64_t frame;
+    /* Some widget changed since our last commit, or everything did */
+    bool dirty;
+    bool invalidated;
+    /* Earliest due time of the changes, and the vblank of our last commit, in µs of wall-clock time */
+    int64_t due;
+    int64_t target;
+    /* Last vblank in the presentation clock and refresh period, in ns, 0 if unknown */
+    int64_t presented;
+    uint32_t refresh;
+    /* Read by the main thread for the cursor */
+    int32_t cursor_scale;
+};
 
-static WwDockOutput *
-_ww_dock_get_output(WwDockContext *self, struct wl_output *wl_output)
-{
-    WwDockOutput *output;
-    wl_list_for_each(output, &self->outputs, link)
-    {
-        if ( output->output == wl_output )
-            return output;
-    }
-    return NULL;
-}
+typedef struct {
+    WwDock *dock;
+    struct wp_presentation_feedback *feedback;
+    int64_t due;
+} WwDockFeedback;
 
 static void
 _ww_dock_buffer_cleanup(WwBufferPool *self)
@@ -151,10 +253,14 @@ _ww_dock_buffer_cleanup(WwBufferPool *self)
     if ( count < self->context->buffer_count )
         return;
 
-    munmap(self->data, self->size);
+    ww_stats_add(WW_STATS_BYTES_ARGB8888 + self->format, -(int64_t) self->block.size);
+    ww_client_shm_release(self->context->client, &self->block);
+    free(self->buffers);
     free(self);
 }
 
+static void _ww_dock_redraw(WwDock *self);
+
 static void
 _ww_dock_buffer_release(void *data, struct wl_buffer *buffer)
 {
@@ -163,11 +269,18 @@ _ww_dock_buffer_release(void *data, struct wl_buffer *buffer)
     size_t i;
     for ( i = 0 ; i < self->context->buffer_count ; ++i )
     {
-        if ( self->buffers[i].buffer == buffer )
+        if ( ( self->buffers[i].buffer == buffer ) && ( ! self->buffers[i].released ) )
+        {
             self->buffers[i].released = true;
+            ww_stats_buffer_released(self->buffers[i].attach_time);
+        }
     }
 
-    _ww_dock_buffer_cleanup(self);
+    if ( self->to_free )
+        _ww_dock_buffer_cleanup(self);
+    else if ( self->dock->dirty )
+        /* We were waiting for this buffer */
+        _ww_dock_redraw(self->dock);
 }
 
 static void
@@ -181,102 +294,196 @@ static const struct wl_buffer_listener _ww_dock_buffer_listener = {
     _ww_dock_buffer_release
 };
 
+static cairo_format_t
+_ww_dock_get_cairo_format(WwFormat format)
+{
+    switch ( format )
+    {
+    case WW_FORMAT_ARGB8888:
+        return CAIRO_FORMAT_ARGB32;
+    case WW_FORMAT_XRGB8888:
+        return CAIRO_FORMAT_RGB24;
+    case WW_FORMAT_RGB565:
+        return CAIRO_FORMAT_RGB16_565;
+    case WW_FORMAT_XRGB2101010:
+        return CAIRO_FORMAT_RGB30;
+    case _WW_FORMAT_SIZE:
+    break;
+    }
+    return CAIRO_FORMAT_INVALID;
+}
+
+/* cairo draws directly in all our formats, so we go as cheap as the content allows */
+static WwFormat
+_ww_dock_pick_format(WwDockContext *self)
+{
+    if ( self->render_settings.background_colour.a < 1.0 )
+        return WW_FORMAT_ARGB8888;
+    /* Offscreen, we have no compositor to please */
+    if ( self->low_memory && ( ( self->client == NULL ) || ( self->client->formats & WW_FORMAT_MASK(WW_FORMAT_RGB565) ) ) )
+        return WW_FORMAT_RGB565;
+    return WW_FORMAT_XRGB8888;
+}
+
+/* Rounding half away from zero, as wp_fractional_scale_v1 mandates */
+static int32_t
+_ww_dock_scale_size(int32_t size, uint32_t scale)
+{
+    return ( size * scale + WW_DOCK_SCALE_DENOMINATOR / 2 ) / WW_DOCK_SCALE_DENOMINATOR;
+}
+
 static WwBufferPool *
-_ww_dock_create_buffer_pool(WwDock *dock)
+_ww_dock_create_buffer_pool(WwDock *dock, uint32_t scale)
 {
-    struct wl_shm_pool *pool;
-    struct wl_buffer *buffer;
-    int fd;
-    uint8_t *data;
-    int32_t width = dock->width * dock->scale;
-    int32_t height = dock->height * dock->scale;
+    WwArenaBlock block;
+    int32_t width = _ww_dock_scale_size(dock->width, scale);
+    int32_t height = _ww_dock_scale_size(dock->height, scale);
     int32_t stride;
     size_t size;
     size_t pool_size;
+    WwFormat format = _ww_dock_pick_format(dock->context);
 
-    stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, width);
+    stride = cairo_format_stride_for_width(_ww_dock_get_cairo_format(format), width);
     size = stride * height;
     pool_size = size * dock->context->buffer_count;
 
-    char filename[PATH_MAX];
-    snprintf(filename, PATH_MAX, "%s/%s", dock->context->runtime_dir, "wayland-surface");
-    fd = open(filename, O_CREAT | O_RDWR | O_CLOEXEC, 0);
-    unlink(filename);
-    if ( fd < 0 )
-    {
-        ww_warning("creating a buffer file for %zu B failed: %s\n", pool_size, strerror(errno));
-        return NULL;
-    }
-    if ( ftruncate(fd, pool_size) < 0 )
-    {
-        close(fd);
-        return NULL;
-    }
-
-    data = mmap(NULL, pool_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-    if ( data == MAP_FAILED )
-    {
-        ww_warning("mmap failed: %s\n", strerror(errno));
-        close(fd);
+    if ( ! ww_client_shm_alloc(dock->context->client, pool_size, &block) )
         return NULL;
-    }
 
     WwBufferPool *self;
     self = ww_new0(WwBufferPool, 1);
     if ( self == NULL )
     {
-        wl_buffer_destroy(buffer);
+        ww_client_shm_release(dock->context->client, &block);
         return NULL;
     }
 
     self->context = dock->context;
+    self->dock = dock;
+    self->block = block;
+    self->format = format;
+    self->width = width;
+    self->height = height;
+    self->stride = stride;
+    self->scale = scale;
     self->buffers = ww_new0(WwBuffer, self->context->buffer_count);
     if ( self->buffers == NULL )
     {
-        wl_buffer_destroy(buffer);
+        ww_client_shm_release(self->context->client, &block);
         free(self);
         return NULL;
     }
 
-    pool = wl_shm_create_pool(dock->context->shm, fd, pool_size);
     size_t i;
     for ( i = 0 ; i < self->context->buffer_count ; ++i )
     {
-        self->buffers[i].buffer = wl_shm_pool_create_buffer(pool, size * i, width, height, stride, WL_SHM_FORMAT_ARGB8888);
-        self->buffers[i].data = data + size * i;
+        self->buffers[i].buffer = ww_arena_create_buffer(self->context->client->arena, &block, size * i, width, height, stride, ww_format_get_info(format)->shm_format, self->context->render_queue);
+        self->buffers[i].data = block.data + size * i;
         self->buffers[i].released = true;
         wl_buffer_add_listener(self->buffers[i].buffer, &_ww_dock_buffer_listener, self);
     }
-    wl_shm_pool_destroy(pool);
-    close(fd);
+
+    ww_stats_add(WW_STATS_BUFFERS_CREATED, self->context->buffer_count);
+    ww_stats_add(WW_STATS_BYTES_ARGB8888 + format, block.size);
 
     return self;
 }
 
+static uint32_t
+_ww_dock_get_scale(WwDock *self)
+{
+    if ( self->preferred_scale > 0 )
+        return self->preferred_scale;
+
+    int32_t scale = 1;
+    WwDockSurfaceOutput *output;
+    wl_list_for_each(output, &self->outputs, link)
+        scale = MAX(scale, output->output->scale);
+
+    return scale * WW_DOCK_SCALE_DENOMINATOR;
+}
+
+/* Redraws everything, for when our size or settings change */
+static void
+_ww_dock_invalidate(WwDock *self)
+{
+    size_t i;
+    for ( i = 0 ; i < self->context->buffer_count ; ++i )
+        self->pool->buffers[i].frame = 0;
+
+    self->invalidated = true;
+    self->dirty = true;
+    _ww_dock_redraw(self);
+}
+
+/* Returns true if we have new buffers, already drawn */
+static bool
+_ww_dock_update_pool(WwDock *self)
+{
+    uint32_t scale;
+
+    scale = _ww_dock_get_scale(self);
+    __atomic_store_n(&self->cursor_scale, ( scale + WW_DOCK_SCALE_DENOMINATOR - 1 ) / WW_DOCK_SCALE_DENOMINATOR, __ATOMIC_RELAXED);
+
+    if ( self->pool == NULL )
+        return false;
+
+    if ( ( self->pool->scale == scale ) && ( self->pool->format == _ww_dock_pick_format(self->context) ) && ( self->pool->width == _ww_dock_scale_size(self->width, scale) ) && ( self->pool->height == _ww_dock_scale_size(self->height, scale) ) )
+        return false;
+
+    WwBufferPool *pool;
+    pool = _ww_dock_create_buffer_pool(self, scale);
+    if ( pool == NULL )
+        return false;
+
+    _ww_dock_buffer_pool_free(self->pool);
+    self->pool = pool;
+
+    _ww_dock_invalidate(self);
+    return true;
+}
+
 static void
 _ww_dock_surface_protocol_enter(void *data, struct wl_surface *wl_surface, struct wl_output *wl_output)
 {
     WwDock *self = data;
     WwDockOutput *output;
 
-    output = _ww_dock_get_output(self->context, wl_output);
+    output = ww_hash_lookup(&self->context->render_outputs, (uintptr_t) wl_output);
     if ( output == NULL )
         return;
-    if ( ( output->scale < 1 ) || ( output->scale > 3 ) )
+
+    WwDockSurfaceOutput *surface_output;
+    surface_output = ww_new0(WwDockSurfaceOutput, 1);
+    if ( surface_output == NULL )
         return;
 
-    ++self->scales[output->scale - 1];
-    if ( self->scale < output->scale )
+    surface_output->output = output;
+    wl_list_insert(&self->outputs, &surface_output->link);
+
+    _ww_dock_update_pool(self);
+}
+
+static void
+_ww_dock_surface_output_free(WwDockSurfaceOutput *self)
+{
+    wl_list_remove(&self->link);
+    free(self);
+}
+
+static bool
+_ww_dock_surface_remove_output(WwDock *self, WwDockOutput *output)
+{
+    WwDockSurfaceOutput *surface_output, *tmp;
+    wl_list_for_each_safe(surface_output, tmp, &self->outputs, link)
     {
-        WwBufferPool *pool;
-        self->scale = output->scale;
-        pool = _ww_dock_create_buffer_pool(self);
-        if ( pool != NULL )
-        {
-            _ww_dock_buffer_pool_free(self->pool);
-            self->pool = pool;
-        }
+        if ( surface_output->output != output )
+            continue;
+
+        _ww_dock_surface_output_free(surface_output);
+        return true;
     }
+    return false;
 }
 
 static void
@@ -285,44 +492,86 @@ _ww_dock_surface_protocol_leave(void *data, struct wl_surface *wl_surface, struc
     WwDock *self = data;
     WwDockOutput *output;
 
-    output = _ww_dock_get_output(self->context, wl_output);
+    output = ww_hash_lookup(&self->context->render_outputs, (uintptr_t) wl_output);
     if ( output == NULL )
         return;
-    if ( ( output->scale < 1 ) || ( output->scale > 3 ) )
-        return;
 
-    if ( ( --self->scales[output->scale - 1] < 1 ) && ( self->scale == output->scale ) )
+    if ( _ww_dock_surface_remove_output(self, output) )
+        _ww_dock_update_pool(self);
+}
+
+static void
+_ww_dock_fractional_scale_preferred_scale(void *data, struct wp_fractional_scale_v1 *fractional_scale, uint32_t scale)
+{
+    WwDock *self = data;
+
+    self->preferred_scale = scale;
+    _ww_dock_update_pool(self);
+}
+
+/* Widgets are packed along the dock and centred as a group, each box spans the dock thickness */
+static void
+_ww_dock_layout(WwDock *self)
+{
+    WwWidget *widget;
+    int32_t length = 0, position;
+
+    wl_list_for_each(widget, &self->widgets, link)
+        length += self->vertical ? widget->natural_height : widget->natural_width;
+
+    position = ( ( self->vertical ? self->height : self->width ) - length ) / 2;
+    wl_list_for_each(widget, &self->widgets, link)
     {
-        int32_t i;
-        for ( i = 0 ; i < 3 ; ++i )
+        if ( self->vertical )
+        {
+            widget->x = 0;
+            widget->y = position;
+            widget->width = self->width;
+            widget->height = widget->natural_height;
+            position += widget->height;
+        }
+        else
         {
-            if ( self->scales[i] > 0 )
-                self->scale = i + 1;
+            widget->x = position;
+            widget->y = 0;
+            widget->width = widget->natural_width;
+            widget->height = self->height;
+            position += widget->width;
         }
     }
-
 }
 
 static void
 _ww_dock_dock_protocol_configure(void *data, struct zww_dock_v2 *dock, int32_t min_width, int32_t min_height, int32_t max_width, int32_t max_height, enum zww_dock_manager_v2_position position)
 {
     WwDock *self = data;
+    WwWidget *widget;
+    int32_t thickness = 0;
 
     switch ( position )
     {
     case ZWW_DOCK_MANAGER_V2_POSITION_TOP:
     case ZWW_DOCK_MANAGER_V2_POSITION_BOTTOM:
+        wl_list_for_each(widget, &self->widgets, link)
+            thickness = MAX(thickness, widget->natural_height);
+        self->vertical = false;
         self->width = max_width;
-        self->height = MAX(min_height, self->text_height + 10);
+        self->height = MAX(min_height, thickness);
     break;
     case ZWW_DOCK_MANAGER_V2_POSITION_LEFT:
     case ZWW_DOCK_MANAGER_V2_POSITION_RIGHT:
-        self->width = MAX(min_width, self->text_width + 10);
+        wl_list_for_each(widget, &self->widgets, link)
+            thickness = MAX(thickness, widget->natural_width);
+        self->vertical = true;
+        self->width = MAX(min_width, thickness);
         self->height = max_height;
     break;
     case ZWW_DOCK_MANAGER_V2_POSITION_DEFAULT:
         assert_not_reached();
     }
+
+    _ww_dock_layout(self);
+    _ww_dock_update_pool(self);
 }
 
 static const struct wl_surface_listener _ww_dock_surface_interface = {
@@ -334,593 +583,1126 @@ static const struct zww_dock_v2_listener _ww_dock_dock_interface = {
     .configure = _ww_dock_dock_protocol_configure,
 };
 
-static PangoLayout *
-_ww_dock_create_text(WwDock *self)
+static const struct wp_fractional_scale_v1_listener _ww_dock_fractional_scale_interface = {
+    .preferred_scale = _ww_dock_fractional_scale_preferred_scale,
+};
+
+static void
+_ww_dock_free_widgets(WwDock *self)
+{
+    WwWidget *widget, *tmp;
+    wl_list_for_each_safe(widget, tmp, &self->widgets, link)
+        ww_widget_free(widget);
+}
+
+static bool
+_ww_dock_create_widgets(WwDock *self)
 {
     PangoContext *pango_context;
     PangoFontDescription *font;
-    PangoLayout *text;
+    bool ret = true;
 
     pango_context = pango_context_new();
     pango_context_set_font_map(pango_context, pango_cairo_font_map_get_default());
 
     font = pango_font_description_from_string("Sans 15");
 
-    text = pango_layout_new(pango_context);
-    pango_layout_set_font_description(text, font);
-    pango_layout_set_text(text, "9999-99-99 99:99:99", -1);
-    pango_layout_get_pixel_size(text, &self->text_width, &self->text_height);
+    size_t i;
+    for ( i = 0 ; ret && ( i < self->context->widget_count ) ; ++i )
+    {
+        WwWidget *widget;
+
+        widget = ww_widget_new(self->context->widgets[i], self->context->metrics, pango_context, font);
+        if ( widget != NULL )
+            wl_list_insert(self->widgets.prev, &widget->link);
+        else
+            ret = false;
+    }
 
     pango_font_description_free(font);
     g_object_unref(pango_context);
 
-    return text;
+    return ret;
 }
 
-static void _ww_dock_frame_callback(void *data, struct wl_callback *callback, uint32_t time);
-
-static const struct wl_callback_listener _ww_dock_frame_wl_callback_listener = {
-    .done = _ww_dock_frame_callback,
-};
-
-static int
-_ww_dock_trigger_drawing(WwDock *self, time_t t)
+/* Updates the widgets due at now, in µs of wall-clock time */
+static void
+_ww_dock_update_widgets(WwDock *self, int64_t now)
 {
-    WwBuffer *buffer = NULL;
-    size_t i;
-    for ( i = 0 ; ( buffer == NULL ) && ( i < self->context->buffer_count ) ; ++i )
+    WwWidget *widget;
+    wl_list_for_each(widget, &self->widgets, link)
     {
-        buffer = self->pool->buffers + i;
-        if ( ! buffer->released )
-            buffer = NULL;
-    }
-    if ( buffer == NULL )
-        return 1;
-
-    struct tm *tmp;
-    char text[20];
-    int32_t text_width;
-    int32_t text_height;
+        int64_t due = widget->next_update;
+        if ( ! ww_widget_update(widget, now) )
+            continue;
 
-    self->time = t;
-    tmp = localtime(&t);
-    strftime(text, sizeof(text), "%Y-%m-%d %T", tmp);
-    pango_layout_set_text(self->text, text, -1);
-    pango_layout_get_pixel_size(self->text, &text_width, &text_height);
+        widget->changed = self->frame + 1;
+        self->due = MIN(self->due, due);
+        self->dirty = true;
+    }
+}
 
-    int32_t width = self->width * self->scale;
-    int32_t height = self->height * self->scale;
-    int32_t stride;
+/*
+ * Draws in data, laid out as our pool buffers, the widgets changed
+ * since the given frame, or everything if 0
+ */
+static void
+_ww_dock_draw(WwDock *self, uint8_t *data, uint64_t frame)
+{
+    const WwColour *background = &self->context->render_settings.background_colour;
+    const WwColour *text = &self->context->render_settings.text_colour;
+    double scale = (double) self->pool->scale / WW_DOCK_SCALE_DENOMINATOR;
     cairo_surface_t *surface;
     cairo_t *cr;
 
-    stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, width);
-    surface = cairo_image_surface_create_for_data(buffer->data, CAIRO_FORMAT_ARGB32, width, height, stride);
-    cairo_surface_set_device_scale(surface, self->scale, self->scale);
+    surface = cairo_image_surface_create_for_data(data, _ww_dock_get_cairo_format(self->pool->format), self->pool->width, self->pool->height, self->pool->stride);
+    cairo_surface_set_device_scale(surface, scale, scale);
     cr = cairo_create(surface);
 
-    cairo_set_source_rgba(cr, self->context->background_colour.r, self->context->background_colour.g, self->context->background_colour.b, self->context->background_colour.a);
-    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
-    cairo_paint(cr);
-
-    cairo_set_source_rgba(cr, self->context->text_colour.r, self->context->text_colour.g, self->context->text_colour.b, self->context->text_colour.a);
-    cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
-    cairo_move_to(cr, self->width / 2 - text_width / 2, self->height / 2 - text_height / 2);
-    pango_cairo_layout_path(cr, self->text);
-    cairo_fill(cr);
-
-    cairo_destroy(cr);
-    cairo_surface_destroy(surface);
+    if ( frame == 0 )
+    {
+        cairo_set_source_rgba(cr, background->r, background->g, background->b, background->a);
+        cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+        cairo_paint(cr);
+    }
 
-    wl_surface_damage(self->surface, 0, 0, self->width, self->height);
-    wl_surface_attach(self->surface, buffer->buffer, 0, 0);
-    if ( wl_surface_get_version(self->surface) >= WL_SURFACE_SET_BUFFER_SCALE_SINCE_VERSION )
-        wl_surface_set_buffer_scale(self->surface, self->scale);
-    buffer->released = false;
+    /* Text is clipped to its box in both cases, so a partial redraw leaves nothing stale behind */
+    WwWidget *widget;
+    wl_list_for_each(widget, &self->widgets, link)
+    {
+        if ( ( frame != 0 ) && ( widget->changed <= frame ) )
+            continue;
 
-    return 1;
-}
+        cairo_save(cr);
+        cairo_rectangle(cr, widget->x, widget->y, widget->width, widget->height);
+        cairo_clip(cr);
 
-static void
-_ww_dock_frame_callback(void *data, struct wl_callback *callback, uint32_t timestamp)
-{
-    WwDock *self = data;
+        if ( frame != 0 )
+        {
+            cairo_set_source_rgba(cr, background->r, background->g, background->b, background->a);
+            cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+            cairo_paint(cr);
+        }
 
-    if ( self->frame_cb != NULL )
-        wl_callback_destroy(self->frame_cb);
-    self->frame_cb = wl_surface_frame(self->surface);
-    wl_callback_add_listener(self->frame_cb, &_ww_dock_frame_wl_callback_listener, self);
+        cairo_set_source_rgba(cr, text->r, text->g, text->b, text->a);
+        cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+        ww_widget_draw(widget, cr);
 
-    time_t current;
-    current = time(NULL);
-    if ( current > self->time )
-        _ww_dock_trigger_drawing(self, current);
+        cairo_restore(cr);
+    }
 
-    wl_surface_commit(self->surface);
+    cairo_destroy(cr);
+    cairo_surface_destroy(surface);
 }
 
-static WwDock *
-_ww_dock_create(WwDockContext *context, time_t t)
+static WwBuffer *
+_ww_dock_get_free_buffer(WwDock *self)
 {
-    WwDock *self;
-    self = ww_new0(WwDock, 1);
-    if ( self == NULL )
-        return NULL;
-
-    self->context = context;
-    self->surface = wl_compositor_create_surface(self->context->compositor);
-    if ( self->surface == NULL )
+    size_t i;
+    for ( i = 0 ; i < self->context->buffer_count ; ++i )
     {
-        free(self);
-        return NULL;
+        if ( self->pool->buffers[i].released )
+            return self->pool->buffers + i;
     }
+    return NULL;
+}
 
-    self->dock = zww_dock_manager_v2_create_dock(self->context->dock_manager, self->surface, NULL, ZWW_DOCK_MANAGER_V2_POSITION_DEFAULT);
-    if ( self->dock == NULL )
+/* Returns false if we have no buffer, we retry when one is released */
+static bool
+_ww_dock_trigger_drawing(WwDock *self)
+{
+    WwBuffer *buffer;
+
+    buffer = _ww_dock_get_free_buffer(self);
+    if ( buffer == NULL )
     {
-        wl_surface_destroy(self->surface);
-        free(self);
-        return NULL;
+        ww_stats_add(WW_STATS_SKIPPED_DRAWS, 1);
+        return false;
     }
 
-    self->scale = 1;
-    self->text = _ww_dock_create_text(self);
+    ww_stats_add(WW_STATS_DRAWS, 1);
 
-    wl_surface_add_listener(self->surface, &_ww_dock_surface_interface, self);
-    zww_dock_v2_add_listener(self->dock, &_ww_dock_dock_interface, self);
-    wl_display_roundtrip(self->context->display);
+    /* The buffer may be a few frames old, we catch up with everything it missed */
+    ++self->frame;
+    _ww_dock_draw(self, buffer->data, buffer->frame);
+    buffer->frame = self->frame;
 
-    if ( ( self->width < 1 ) || ( self->height < 1 ) )
+    /* Damage is against our last commit only */
+    WwWidget *widget;
+    if ( self->invalidated )
+        wl_surface_damage(self->surface, 0, 0, self->width, self->height);
+    else
     {
-        zww_dock_v2_destroy(self->dock);
-        wl_surface_destroy(self->surface);
-        free(self);
-        return NULL;
+        wl_list_for_each(widget, &self->widgets, link)
+        {
+            if ( widget->changed == self->frame )
+                wl_surface_damage(self->surface, widget->x, widget->y, widget->width, widget->height);
+        }
     }
 
-    self->pool = _ww_dock_create_buffer_pool(self);
-    if ( self->pool == NULL )
-    {
-        zww_dock_v2_destroy(self->dock);
-        wl_surface_destroy(self->surface);
-        free(self);
-        return NULL;
-    }
+    wl_surface_attach(self->surface, buffer->buffer, 0, 0);
+    if ( self->viewport != NULL )
+        wp_viewport_set_destination(self->viewport, self->width, self->height);
+    else if ( wl_surface_get_version(self->surface) >= WL_SURFACE_SET_BUFFER_SCALE_SINCE_VERSION )
+        wl_surface_set_buffer_scale(self->surface, self->pool->scale / WW_DOCK_SCALE_DENOMINATOR);
+    buffer->released = false;
+    buffer->attach_time = ww_stats_now();
+    ww_stats_add(WW_STATS_BUFFERS_HELD, 1);
 
-    _ww_dock_frame_callback(self, self->frame_cb, 0);
+    return true;
+}
 
-    return self;
+static int64_t
+_ww_dock_clock_now(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
 }
 
 static void
-_ww_dock_free(WwDock *self)
+_ww_dock_feedback_free(WwDockFeedback *self)
 {
-    zww_dock_v2_destroy(self->dock);
-    wl_surface_destroy(self->surface);
-    _ww_dock_buffer_pool_free(self->pool);
+    wp_presentation_feedback_destroy(self->feedback);
     free(self);
 }
 
 static void
-_ww_dock_cursor_set_image(WwDockContext *self, int i)
+_ww_dock_feedback_sync_output(void *data, struct wp_presentation_feedback *feedback, struct wl_output *output)
 {
-    struct wl_buffer *buffer;
-    struct wl_cursor_image *image;
-    image = self->cursor.cursor->images[i];
-
-    self->cursor.image = image;
-    buffer = wl_cursor_image_get_buffer(self->cursor.image);
-    wl_surface_attach(self->cursor.surface, buffer, 0, 0);
-    wl_surface_damage(self->cursor.surface, 0, 0, self->cursor.image->width, self->cursor.image->height);
-    wl_surface_commit(self->cursor.surface);
 }
 
-static void _ww_dock_cursor_frame_callback(void *data, struct wl_callback *callback, uint32_t time);
+static void
+_ww_dock_feedback_presented(void *data, struct wp_presentation_feedback *feedback, uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec, uint32_t refresh, uint32_t seq_hi, uint32_t seq_lo, uint32_t flags)
+{
+    WwDockFeedback *self = data;
+    WwDock *dock = self->dock;
+    clockid_t clock = dock->context->presentation_clock;
+    int64_t presented = (int64_t) ( ( (uint64_t) tv_sec_hi << 32 ) | tv_sec_lo ) * 1000000000 + tv_nsec;
+
+    /* Without vsync there is no phase to follow */
+    dock->presented = presented;
+    dock->refresh = ( flags & WP_PRESENTATION_FEEDBACK_KIND_VSYNC ) ? refresh : 0;
+
+    /* Back to wall-clock time, to compare with the widget due time */
+    int64_t now = _ww_dock_clock_now(clock);
+    int64_t latency = ( presented + ( _ww_dock_clock_now(CLOCK_REALTIME) - now ) ) / 1000 - self->due;
+    if ( latency < 0 )
+        ww_stats_add(WW_STATS_PRESENTED_EARLY, 1);
+    else
+        ww_stats_histogram_add(WW_STATS_PRESENT_LATENCY, latency);
 
-static const struct wl_callback_listener _ww_dock_cursor_frame_wl_callback_listener = {
-    .done = _ww_dock_cursor_frame_callback,
-};
+    _ww_dock_feedback_free(self);
+}
 
 static void
-_ww_dock_cursor_frame_callback(void *data, struct wl_callback *callback, uint32_t time)
+_ww_dock_feedback_discarded(void *data, struct wp_presentation_feedback *feedback)
 {
-    WwDockContext *self = data;
-    int i;
+    WwDockFeedback *self = data;
 
-    if ( self->cursor.frame_cb != NULL )
-        wl_callback_destroy(self->cursor.frame_cb);
-    self->cursor.frame_cb = wl_surface_frame(self->cursor.surface);
-    wl_callback_add_listener(self->cursor.frame_cb, &_ww_dock_cursor_frame_wl_callback_listener, self);
-
-    i = wl_cursor_frame(self->cursor.cursor, time);
-    _ww_dock_cursor_set_image(self, i);
+    _ww_dock_feedback_free(self);
 }
 
+static const struct wp_presentation_feedback_listener _ww_dock_feedback_listener = {
+    .sync_output = _ww_dock_feedback_sync_output,
+    .presented = _ww_dock_feedback_presented,
+    .discarded = _ww_dock_feedback_discarded,
+};
+
 static void
-_ww_dock_pointer_enter(void *data, struct wl_pointer *pointer, uint32_t serial, struct wl_surface *surface, wl_fixed_t x, wl_fixed_t y)
+_ww_dock_request_feedback(WwDock *self)
 {
-    WwDockSeat *self = data;
-    WwDockContext *context = self->context;
+    WwDockFeedback *feedback;
 
-    if ( context->cursor.surface == NULL )
+    feedback = ww_new0(WwDockFeedback, 1);
+    if ( feedback == NULL )
         return;
 
-    if ( context->cursor.cursor->image_count < 2 )
-        _ww_dock_cursor_set_image(context, 0);
-    else
-        _ww_dock_cursor_frame_callback(context, context->cursor.frame_cb, 0);
+    feedback->dock = self;
+    feedback->due = self->due;
+    feedback->feedback = wp_presentation_feedback(self->context->render_presentation, self->surface);
+    wp_presentation_feedback_add_listener(feedback->feedback, &_ww_dock_feedback_listener, feedback);
+}
 
-    wl_pointer_set_cursor(self->pointer, serial, context->cursor.surface, context->cursor.image->hotspot_x, context->cursor.image->hotspot_y);
+static int64_t
+_ww_dock_now(void)
+{
+    return _ww_dock_clock_now(CLOCK_REALTIME) / 1000;
 }
 
-static void
-_ww_dock_pointer_leave(void *data, struct wl_pointer *pointer, uint32_t serial, struct wl_surface *surface)
+/* The first vblank at or after t, in µs of wall-clock time, or t itself if we don't know the phase */
+static int64_t
+_ww_dock_next_vblank(WwDock *self, int64_t t)
 {
-    WwDockSeat *self = data;
-    WwDockContext *context = self->context;
+    if ( self->refresh == 0 )
+        return t;
+
+    clockid_t clock = self->context->presentation_clock;
+    int64_t presented = self->presented + ( _ww_dock_clock_now(CLOCK_REALTIME) - _ww_dock_clock_now(clock) );
+    t *= 1000;
+    if ( t <= presented )
+        return t / 1000;
 
-    if ( context->cursor.frame_cb != NULL )
-        wl_callback_destroy(context->cursor.frame_cb);
+    return ( presented + ( ( t - presented + self->refresh - 1 ) / self->refresh ) * self->refresh ) / 1000;
 }
 
-static void
-_ww_dock_pointer_motion(void *data, struct wl_pointer *pointer, uint32_t time, wl_fixed_t x, wl_fixed_t y)
+/* The vblank our next commit can show at, we commit at most once per frame */
+static int64_t
+_ww_dock_display_time(WwDock *self, int64_t t)
 {
+    return MAX(_ww_dock_next_vblank(self, t), self->target + self->refresh / 1000);
 }
 
+/*
+ * A single timer for all the widgets of all our docks, half a frame before
+ * the first vblank to show the earliest due one, so a change is drawn just
+ * before its due time rather than one frame after it
+ * Pushed changes are due now, unless we wait for a buffer anyway
+ */
 static void
-_ww_dock_pointer_button(void *data, struct wl_pointer *pointer, uint32_t serial, uint32_t time, uint32_t button, enum wl_pointer_button_state state)
+_ww_dock_schedule(WwDockContext *self)
 {
-}
+    int64_t wakeup = INT64_MAX;
 
-static void
-_ww_dock_pointer_axis(void *data, struct wl_pointer *pointer, uint32_t time, enum wl_pointer_axis axis, wl_fixed_t value)
-{
+    WwDock *dock;
+    wl_list_for_each(dock, &self->docks, link)
+    {
+        int64_t due = ( dock->dirty && ( _ww_dock_get_free_buffer(dock) != NULL ) ) ? _ww_dock_now() : INT64_MAX;
+        WwWidget *widget;
+        wl_list_for_each(widget, &dock->widgets, link)
+            due = MIN(due, widget->next_update);
+        if ( due == INT64_MAX )
+            continue;
+
+        wakeup = MIN(wakeup, _ww_dock_display_time(dock, due - WW_DOCK_UPDATE_SLACK) - dock->refresh / 2000);
+    }
+    if ( wakeup == INT64_MAX )
+        return;
+
+    struct itimerspec spec = {
+        .it_value.tv_sec = wakeup / 1000000,
+        .it_value.tv_nsec = ( wakeup % 1000000 ) * 1000,
+    };
+    timerfd_settime(self->render_timer_fd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &spec, NULL);
 }
 
 static void
-_ww_dock_pointer_frame(void *data, struct wl_pointer *pointer)
+_ww_dock_redraw(WwDock *self)
 {
+    int64_t now = _ww_dock_now();
+    int64_t display = _ww_dock_display_time(self, now);
+
+    /* We already committed for the next vblank, the timer brings us back for the one after */
+    if ( display > _ww_dock_next_vblank(self, now) )
+    {
+        _ww_dock_schedule(self->context);
+        return;
+    }
+
+    _ww_dock_update_widgets(self, display + WW_DOCK_UPDATE_SLACK);
+
+    if ( self->dirty && _ww_dock_trigger_drawing(self) )
+    {
+        /* Forced redraws are not due at any particular time, they would only skew the histogram */
+        if ( ( self->context->render_presentation != NULL ) && ( ! self->invalidated ) && ( self->due != INT64_MAX ) )
+            _ww_dock_request_feedback(self);
+
+        self->dirty = false;
+        self->invalidated = false;
+        self->due = INT64_MAX;
+        self->target = display;
+
+        wl_surface_commit(self->surface);
+        ww_stats_committed();
+    }
+
+    _ww_dock_schedule(self->context);
 }
 
 static void
-_ww_dock_pointer_axis_source(void *data, struct wl_pointer *pointer, enum wl_pointer_axis_source axis_source)
+_ww_dock_free(WwDock *self)
 {
+    WwDockSurfaceOutput *surface_output, *tmp;
+    wl_list_for_each_safe(surface_output, tmp, &self->outputs, link)
+        _ww_dock_surface_output_free(surface_output);
+
+    if ( self->fractional_scale != NULL )
+        wp_fractional_scale_v1_destroy(self->fractional_scale);
+    if ( self->viewport != NULL )
+        wp_viewport_destroy(self->viewport);
+    zww_dock_v2_destroy(self->dock);
+    wl_surface_destroy(self->surface);
+    if ( self->pool != NULL )
+        _ww_dock_buffer_pool_free(self->pool);
+    _ww_dock_free_widgets(self);
+    wl_list_remove(&self->link);
+    free(self);
 }
 
-static void
-_ww_dock_pointer_axis_stop(void *data, struct wl_pointer *pointer, uint32_t time, enum wl_pointer_axis axis)
+static WwDock *
+_ww_dock_create(WwDockContext *context)
 {
+    WwDock *self;
+    self = ww_new0(WwDock, 1);
+    if ( self == NULL )
+        return NULL;
+
+    self->context = context;
+    self->surface = wl_compositor_create_surface(self->context->render_compositor);
+    if ( self->surface == NULL )
+    {
+        free(self);
+        return NULL;
+    }
+
+    self->dock = zww_dock_manager_v2_create_dock(self->context->render_dock_manager, self->surface, NULL, ZWW_DOCK_MANAGER_V2_POSITION_DEFAULT);
+    if ( self->dock == NULL )
+    {
+        wl_surface_destroy(self->surface);
+        free(self);
+        return NULL;
+    }
+
+    wl_list_init(&self->link);
+    wl_list_init(&self->outputs);
+    wl_list_init(&self->widgets);
+    self->due = INT64_MAX;
+    if ( ! _ww_dock_create_widgets(self) )
+    {
+        _ww_dock_free(self);
+        return NULL;
+    }
+
+    /*
+     * Fractional scaling needs a viewport to map our exactly-sized buffer
+     * back to the surface size, so we only use it if we have both
+     */
+    if ( ( self->context->render_viewporter != NULL ) && ( self->context->render_fractional_scale_manager != NULL ) )
+    {
+        self->viewport = wp_viewporter_get_viewport(self->context->render_viewporter, self->surface);
+        self->fractional_scale = wp_fractional_scale_manager_v1_get_fractional_scale(self->context->render_fractional_scale_manager, self->surface);
+        wp_fractional_scale_v1_add_listener(self->fractional_scale, &_ww_dock_fractional_scale_interface, self);
+    }
+
+    wl_surface_add_listener(self->surface, &_ww_dock_surface_interface, self);
+    zww_dock_v2_add_listener(self->dock, &_ww_dock_dock_interface, self);
+    wl_display_roundtrip_queue(self->context->client->display, self->context->render_queue);
+
+    if ( ( self->width < 1 ) || ( self->height < 1 ) )
+    {
+        _ww_dock_free(self);
+        return NULL;
+    }
+
+    self->pool = _ww_dock_create_buffer_pool(self, _ww_dock_get_scale(self));
+    if ( self->pool == NULL )
+    {
+        _ww_dock_free(self);
+        return NULL;
+    }
+
+    wl_list_insert(&self->context->docks, &self->link);
+    _ww_dock_update_pool(self);
+
+    /* Our first draw happens once the render thread runs */
+    self->invalidated = true;
+    self->dirty = true;
+
+    return self;
 }
 
 static void
-_ww_dock_pointer_axis_discrete(void *data, struct wl_pointer *pointer, enum wl_pointer_axis axis, int32_t discrete)
+_ww_dock_feed_wake(WwDockContext *self)
 {
-}
+    uint64_t one = 1;
 
-static const struct wl_pointer_listener _ww_dock_pointer_listener = {
-    .enter = _ww_dock_pointer_enter,
-    .leave = _ww_dock_pointer_leave,
-    .motion = _ww_dock_pointer_motion,
-    .button = _ww_dock_pointer_button,
-    .axis = _ww_dock_pointer_axis,
-    .frame = _ww_dock_pointer_frame,
-    .axis_source = _ww_dock_pointer_axis_source,
-    .axis_stop = _ww_dock_pointer_axis_stop,
-    .axis_discrete = _ww_dock_pointer_axis_discrete,
-};
+    if ( write(self->feed_event_fd, &one, sizeof(one)) < 0 )
+        ww_warning("Couldn’t wake the render thread: %s", strerror(errno));
+}
 
+/*
+ * Only the last text of each segment matters, we apply them once all rings are drained
+ * A ring gives at most its capacity per wake-up, so a busy producer cannot starve the others
+ */
 static void
-_ww_dock_pointer_release(WwDockSeat *self)
+_ww_dock_render_feeds(WwDockContext *self)
 {
-    if ( self->pointer == NULL )
+    WwFeedEntry entries[WW_FEED_SEGMENTS];
+    WwFeedEntry entry;
+    uint32_t seen = 0;
+    bool more = false;
+    uint64_t count;
+
+    if ( ( read(self->feed_event_fd, &count, sizeof(count)) < 0 ) && ( errno != EAGAIN ) )
+        ww_warning("Couldn’t clear feed eventfd: %s", strerror(errno));
+
+    WwDockProducer *producer;
+    wl_list_for_each(producer, &self->render_producers, link)
+    {
+        size_t n;
+        for ( n = 0 ; ( n < WW_FEED_CAPACITY ) && ww_feed_pop(producer->ring, &entry) ; ++n )
+        {
+            ww_stats_add(WW_STATS_FEED_UPDATES, 1);
+            if ( entry.segment >= WW_FEED_SEGMENTS )
+                continue;
+            entries[entry.segment] = entry;
+            seen |= ( 1 << entry.segment );
+        }
+        if ( n == WW_FEED_CAPACITY )
+            more = true;
+    }
+    if ( more )
+        _ww_dock_feed_wake(self);
+    if ( seen == 0 )
         return;
 
-    if ( wl_pointer_get_version(self->pointer) >= WL_POINTER_RELEASE_SINCE_VERSION )
-        wl_pointer_release(self->pointer);
-    else
-        wl_pointer_destroy(self->pointer);
+    WwDock *dock;
+    wl_list_for_each(dock, &self->docks, link)
+    {
+        WwWidget *widget;
+        wl_list_for_each(widget, &dock->widgets, link)
+        {
+            if ( ( widget->segment < 0 ) || ( ( seen & ( 1 << widget->segment ) ) == 0 ) )
+                continue;
+            if ( ! ww_widget_set_text(widget, entries[widget->segment].text) )
+                continue;
+
+            /* So the present latency is from the producer to the pixels */
+            widget->changed = dock->frame + 1;
+            dock->due = MIN(dock->due, entries[widget->segment].time);
+            dock->dirty = true;
+        }
+    }
 
-    self->pointer = NULL;
+    _ww_dock_schedule(self);
 }
 
 static void
-_ww_dock_seat_release(WwDockSeat *self)
+_ww_dock_render_handle_messages(WwDockContext *self)
 {
-    _ww_dock_pointer_release(self);
+    WwDockMessage message;
+    WwDockOutput *output;
+    WwDock *dock;
 
-    if ( wl_seat_get_version(self->seat) >= WL_SEAT_RELEASE_SINCE_VERSION )
-        wl_seat_release(self->seat);
-    else
-        wl_seat_destroy(self->seat);
+    while ( ww_queue_pop(self->messages, &message) )
+    {
+        switch ( message.type )
+        {
+        case WW_DOCK_MESSAGE_OUTPUT:
+            output = ww_hash_lookup(&self->render_outputs, (uintptr_t) message.output.output);
+            if ( output == NULL )
+            {
+                output = ww_new0(WwDockOutput, 1);
+                if ( output == NULL )
+                    break;
+                output->output = message.output.output;
+                if ( ! ww_hash_insert(&self->render_outputs, (uintptr_t) output->output, output) )
+                {
+                    free(output);
+                    break;
+                }
+            }
+            output->scale = message.output.scale;
 
-    wl_list_remove(&self->link);
+            /* Our scale may have changed */
+            wl_list_for_each(dock, &self->docks, link)
+                _ww_dock_update_pool(dock);
+        break;
+        case WW_DOCK_MESSAGE_OUTPUT_REMOVED:
+            output = ww_hash_remove(&self->render_outputs, (uintptr_t) message.output.output);
+            if ( output == NULL )
+                break;
 
-    free(self);
+            wl_list_for_each(dock, &self->docks, link)
+            {
+                if ( _ww_dock_surface_remove_output(dock, output) )
+                    _ww_dock_update_pool(dock);
+            }
+            free(output);
+        break;
+        case WW_DOCK_MESSAGE_SETTINGS:
+            self->render_settings = message.settings;
+
+            /* Unless the format changed, we redraw in our current buffers */
+            wl_list_for_each(dock, &self->docks, link)
+            {
+                if ( ! _ww_dock_update_pool(dock) )
+                    _ww_dock_invalidate(dock);
+            }
+        break;
+        case WW_DOCK_MESSAGE_PRODUCER:
+            wl_list_insert(&self->render_producers, &message.producer->link);
+
+            /* It may have pushed before we knew it */
+            _ww_dock_render_feeds(self);
+        break;
+        }
+    }
 }
 
 static void
-_ww_dock_seat_capabilities(void *data, struct wl_seat *seat, uint32_t capabilities)
+_ww_dock_render_collect_producers(WwDockContext *self)
 {
-    WwDockSeat *self = data;
-    if ( ( capabilities & WL_SEAT_CAPABILITY_POINTER ) && ( self->pointer == NULL ) )
+    struct wl_list removed;
+
+    wl_list_init(&removed);
+    pthread_mutex_lock(&self->removed_mutex);
+    wl_list_insert_list(&removed, &self->removed_producers);
+    wl_list_init(&self->removed_producers);
+    pthread_mutex_unlock(&self->removed_mutex);
+
+    if ( wl_list_empty(&removed) )
+        return;
+
+    /* Their addition was queued before, we need it and their last texts */
+    _ww_dock_render_handle_messages(self);
+    _ww_dock_render_feeds(self);
+
+    WwDockProducer *producer, *tmp;
+    wl_list_for_each_safe(producer, tmp, &removed, removed_link)
     {
-        self->pointer = wl_seat_get_pointer(self->seat);
-        wl_pointer_add_listener(self->pointer, &_ww_dock_pointer_listener, self);
+        wl_list_remove(&producer->link);
+        ww_feed_ring_free(producer->ring);
+        free(producer);
     }
-    else if ( ( ! ( capabilities & WL_SEAT_CAPABILITY_POINTER ) ) && ( self->pointer != NULL ) )
-        _ww_dock_pointer_release(self);
 }
 
 static void
-_ww_dock_seat_name(void *data, struct wl_seat *seat, const char *name)
+_ww_dock_render_timer(WwDockContext *self)
 {
+    uint64_t expirations;
+    WwDock *dock;
+
+    /* The wall clock jumped, our due times mean nothing anymore */
+    if ( ( read(self->render_timer_fd, &expirations, sizeof(expirations)) < 0 ) && ( errno == ECANCELED ) )
+    {
+        wl_list_for_each(dock, &self->docks, link)
+        {
+            WwWidget *widget;
+            wl_list_for_each(widget, &dock->widgets, link)
+                widget->next_update = 0;
+        }
+    }
+
+    wl_list_for_each(dock, &self->docks, link)
+        _ww_dock_redraw(dock);
 }
 
-static const struct wl_seat_listener _ww_dock_seat_listener = {
-    .capabilities = _ww_dock_seat_capabilities,
-    .name = _ww_dock_seat_name,
-};
+static void *
+_ww_dock_render_thread(void *user_data)
+{
+    WwDockContext *self = user_data;
+    struct wl_display *display = self->client->display;
+    struct pollfd fds[] = {
+        { .fd = wl_display_get_fd(display), .events = POLLIN },
+        { .fd = ww_queue_get_fd(self->messages), .events = POLLIN },
+        { .fd = self->render_timer_fd, .events = POLLIN },
+        { .fd = self->feed_event_fd, .events = POLLIN },
+    };
 
-static void
-_ww_dock_output_release(WwDockOutput *self)
+    WwDock *dock;
+    wl_list_for_each(dock, &self->docks, link)
+        _ww_dock_redraw(dock);
+
+    /* Same read protocol as WwLoop, whichever thread reads last fills both queues */
+    for ( ;; )
+    {
+        while ( wl_display_prepare_read_queue(display, self->render_queue) != 0 )
+        {
+            if ( wl_display_dispatch_queue_pending(display, self->render_queue) < 0 )
+                goto error;
+        }
+        if ( ( wl_display_flush(display) < 0 ) && ( errno != EAGAIN ) )
+        {
+            wl_display_cancel_read(display);
+            goto error;
+        }
+
+        if ( poll(fds, sizeof(fds) / sizeof(*fds), -1) < 0 )
+        {
+            wl_display_cancel_read(display);
+            if ( errno == EINTR )
+                continue;
+            goto error;
+        }
+
+        if ( fds[0].revents & POLLIN )
+        {
+            if ( wl_display_read_events(display) < 0 )
+                goto error;
+        }
+        else
+            wl_display_cancel_read(display);
+
+        if ( wl_display_dispatch_queue_pending(display, self->render_queue) < 0 )
+            goto error;
+        if ( fds[1].revents & POLLIN )
+            _ww_dock_render_handle_messages(self);
+        if ( fds[2].revents & POLLIN )
+            _ww_dock_render_timer(self);
+        if ( fds[3].revents & POLLIN )
+        {
+            _ww_dock_render_feeds(self);
+            _ww_dock_render_collect_producers(self);
+        }
+    }
+
+error:
+    ww_warning("Render thread stopped: %s", strerror(errno));
+    return NULL;
+}
+
+static void *
+_ww_dock_render_wrap(WwDockContext *self, void *proxy)
 {
-    if ( wl_output_get_version(self->output) >= WL_OUTPUT_RELEASE_SINCE_VERSION )
-        wl_output_release(self->output);
-    else
-        wl_output_destroy(self->output);
+    void *wrapper;
 
-    wl_list_remove(&self->link);
+    if ( proxy == NULL )
+        return NULL;
 
-    free(self);
+    wrapper = wl_proxy_create_wrapper(proxy);
+    if ( wrapper != NULL )
+        wl_proxy_set_queue(wrapper, self->render_queue);
+    return wrapper;
 }
 
-static void
-_ww_dock_output_done(void *data, struct wl_output *output)
+static bool
+_ww_dock_render_init(WwDockContext *self)
 {
+    self->render_queue = wl_display_create_queue(self->client->display);
+    if ( self->render_queue == NULL )
+        return false;
+
+    self->render_timer_fd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+    if ( self->render_timer_fd < 0 )
+        return false;
+
+    /* Objects created from these wrappers are born on the render queue */
+    self->render_compositor = _ww_dock_render_wrap(self, self->client->compositor);
+    self->render_dock_manager = _ww_dock_render_wrap(self, self->dock_manager);
+    self->render_viewporter = _ww_dock_render_wrap(self, self->viewporter);
+    self->render_fractional_scale_manager = _ww_dock_render_wrap(self, self->fractional_scale_manager);
+    self->render_presentation = _ww_dock_render_wrap(self, self->presentation);
+
+    return ( self->render_compositor != NULL ) && ( self->render_dock_manager != NULL );
 }
 
-static void
-_ww_dock_output_geometry(void *data, struct wl_output *output, int32_t x, int32_t y, int32_t width, int32_t height, int32_t subpixel, const char *make, const char *model, int32_t transform)
+static bool
+_ww_dock_send(WwDockContext *self, const WwDockMessage *message)
 {
+    if ( ww_queue_push(self->messages, message) )
+        return true;
+
+    ww_warning("Render thread queue full, dropping message %d", message->type);
+    return false;
 }
 
 static void
-_ww_dock_output_mode(void *data, struct wl_output *output, enum wl_output_mode flags, int32_t width, int32_t height, int32_t refresh)
+_ww_dock_producer_callback(void *user_data, uint32_t events)
 {
+    WwDockProducer *self = user_data;
+    char buffer[64];
+    ssize_t r;
+
+    /* Producers have nothing to tell us, we only wait for them to hang up */
+    while ( ( r = recv(self->fd, buffer, sizeof(buffer), MSG_DONTWAIT) ) > 0 );
+    if ( ( r < 0 ) && ( ( errno == EAGAIN ) || ( errno == EINTR ) ) )
+        return;
+
+    ww_loop_source_free(self->source);
+    close(self->fd);
+
+    /* The render thread owns it from now on */
+    pthread_mutex_lock(&self->context->removed_mutex);
+    wl_list_insert(&self->context->removed_producers, &self->removed_link);
+    pthread_mutex_unlock(&self->context->removed_mutex);
+    _ww_dock_feed_wake(self->context);
 }
 
 static void
-_ww_dock_output_scale(void *data, struct wl_output *output, int32_t scale)
+_ww_dock_feed_accept(void *user_data, uint32_t events)
 {
-    WwDockOutput *self = data;
+    WwDockContext *self = user_data;
+    WwDockProducer *producer;
+    WwFeedRing *ring;
+    int fd;
 
-    self->scale = scale;
-}
+    fd = ww_feed_accept(self->feed_socket_fd, self->feed_event_fd, &ring);
+    if ( fd < 0 )
+        return;
 
-static const struct wl_output_listener _ww_dock_output_listener = {
-    .geometry = _ww_dock_output_geometry,
-    .mode = _ww_dock_output_mode,
-    .scale = _ww_dock_output_scale,
-    .done = _ww_dock_output_done,
-};
+    producer = ww_new0(WwDockProducer, 1);
+    if ( producer == NULL )
+        goto error;
+
+    producer->context = self;
+    producer->fd = fd;
+    producer->ring = ring;
+    producer->source = ww_loop_add_fd(self->client->loop, fd, EPOLLIN, _ww_dock_producer_callback, producer);
+    if ( producer->source == NULL )
+        goto error;
+
+    WwDockMessage message = {
+        .type = WW_DOCK_MESSAGE_PRODUCER,
+        .producer = producer,
+    };
+    if ( _ww_dock_send(self, &message) )
+        return;
 
-static const char * const _ww_dock_cursor_names[] = {
-    "left_ptr",
-    "default",
-    "top_left_arrow",
-    "left-arrow",
-    NULL
-};
+error:
+    if ( ( producer != NULL ) && ( producer->source != NULL ) )
+        ww_loop_source_free(producer->source);
+    free(producer);
+    ww_feed_ring_free(ring);
+    close(fd);
+}
 
-static void
-_ww_dock_registry_handle_global(void *data, struct wl_registry *registry, uint32_t name, const char *interface, uint32_t version)
+/* Producers find us at <runtime_dir>/dock.feed unless told otherwise */
+static bool
+_ww_dock_feed_init(WwDockContext *self)
 {
-    WwDockContext *self = data;
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    int length;
 
-    if ( strcmp0(interface, "wl_compositor") == 0 )
-    {
-        self->global_names[WW_DOCK_GLOBAL_COMPOSITOR] = name;
-        self->compositor = wl_registry_bind(registry, name, &wl_compositor_interface, MIN(version, WL_COMPOSITOR_INTERFACE_VERSION));
-    }
-    else if ( strcmp0(interface, "zww_dock_manager_v2") == 0 )
-    {
-        self->global_names[WW_DOCK_GLOBAL_DOCK_MANAGER] = name;
-        self->dock_manager = wl_registry_bind(registry, name, &zww_dock_manager_v2_interface, WW_DOCK_MANAGER_INTERFACE_VERSION);
-    }
-    else if ( strcmp0(interface, "wl_shm") == 0 )
+    if ( self->feed_path != NULL )
+        length = snprintf(address.sun_path, sizeof(address.sun_path), "%s", self->feed_path);
+    else
+        length = snprintf(address.sun_path, sizeof(address.sun_path), "%s/dock.feed", self->client->runtime_dir);
+    if ( (size_t) length >= sizeof(address.sun_path) )
     {
-        self->global_names[WW_DOCK_GLOBAL_SHM] = name;
-        self->shm = wl_registry_bind(registry, name, &wl_shm_interface, MIN(version, WL_SHM_INTERFACE_VERSION));
+        errno = ENAMETOOLONG;
+        return false;
     }
-    else if ( strcmp0(interface, "wl_seat") == 0 )
-    {
-        WwDockSeat *seat = ww_new0(WwDockSeat, 1);
-        seat->context = self;
-        seat->global_name = name;
-        seat->seat = wl_registry_bind(registry, name, &wl_seat_interface, MIN(version, WL_SEAT_INTERFACE_VERSION));
 
-        wl_list_insert(&self->seats, &seat->link);
+    self->feed_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if ( self->feed_event_fd < 0 )
+        return false;
 
-        wl_seat_add_listener(seat->seat, &_ww_dock_seat_listener, seat);
-    }
-    else if ( strcmp0(interface, "wl_output") == 0 )
-    {
-        WwDockOutput *output = ww_new0(WwDockOutput, 1);
-        output->context = self;
-        output->global_name = name;
-        output->output = wl_registry_bind(registry, name, &wl_output_interface, MIN(version, WL_OUTPUT_INTERFACE_VERSION));
-        output->scale = 1;
+    self->feed_socket_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if ( self->feed_socket_fd < 0 )
+        return false;
 
-        wl_list_insert(&self->outputs, &output->link);
+    unlink(address.sun_path);
+    if ( bind(self->feed_socket_fd, (struct sockaddr *) &address, sizeof(address)) < 0 )
+        return false;
+    if ( listen(self->feed_socket_fd, 4) < 0 )
+        return false;
 
-        wl_output_add_listener(output->output, &_ww_dock_output_listener, output);
-    }
+    self->feed_source = ww_loop_add_fd(self->client->loop, self->feed_socket_fd, EPOLLIN, _ww_dock_feed_accept, self);
+    return ( self->feed_source != NULL );
+}
+
+static void
+_ww_dock_output_done(void *user_data, WwClientOutput *output)
+{
+    WwDockContext *self = user_data;
+    WwDockMessage message = {
+        .type = WW_DOCK_MESSAGE_OUTPUT,
+        .output = { output->output, output->scale },
+    };
+
+    _ww_dock_send(self, &message);
+}
+
+static void
+_ww_dock_output_removed(void *user_data, WwClientOutput *output)
+{
+    WwDockContext *self = user_data;
+    WwDockMessage message = {
+        .type = WW_DOCK_MESSAGE_OUTPUT_REMOVED,
+        .output = { output->output, 0 },
+    };
+
+    _ww_dock_send(self, &message);
+}
+
+static int32_t
+_ww_dock_surface_scale(void *user_data, struct wl_surface *surface)
+{
+    WwDockContext *self = user_data;
 
-    if ( ( self->cursor.theme == NULL ) && ( self->compositor != NULL ) && ( self->shm != NULL ) )
+    /* The list is fixed once the render thread runs */
+    WwDock *dock;
+    wl_list_for_each(dock, &self->docks, link)
     {
-        self->cursor.theme = wl_cursor_theme_load(self->cursor.theme_name, 32, self->shm);
-        if ( self->cursor.theme != NULL )
-        {
-            const char * const *cname = (const char * const *) self->cursor.name;
-            for ( cname = ( cname != NULL ) ? cname : _ww_dock_cursor_names ; ( self->cursor.cursor == NULL ) && ( *cname != NULL ) ; ++cname )
-                self->cursor.cursor = wl_cursor_theme_get_cursor(self->cursor.theme, *cname);
-            if ( self->cursor.cursor == NULL )
-            {
-                wl_cursor_theme_destroy(self->cursor.theme);
-                self->cursor.theme = NULL;
-            }
-            else
-                self->cursor.surface = wl_compositor_create_surface(self->compositor);
-        }
+        if ( dock->surface == surface )
+            return __atomic_load_n(&dock->cursor_scale, __ATOMIC_RELAXED);
     }
+    return 0;
 }
 
+static const WwClientListener _ww_dock_client_listener = {
+    .output_done = _ww_dock_output_done,
+    .output_removed = _ww_dock_output_removed,
+    .surface_scale = _ww_dock_surface_scale,
+};
+
 static void
-_ww_dock_registry_handle_global_remove(void *data, struct wl_registry *registry, uint32_t name)
+_ww_dock_presentation_clock_id(void *data, struct wp_presentation *presentation, uint32_t clk_id)
 {
     WwDockContext *self = data;
 
-    WwDockGlobalName i;
-    for ( i = 0 ; i < _WW_DOCK_GLOBAL_SIZE ; ++i )
-    {
-        if ( self->global_names[i] != name )
-            continue;
-        self->global_names[i] = 0;
+    self->presentation_clock = clk_id;
+}
 
-        switch ( i )
-        {
-        case WW_DOCK_GLOBAL_COMPOSITOR:
-            wl_compositor_destroy(self->compositor);
-            self->compositor = NULL;
-        break;
-        case WW_DOCK_GLOBAL_DOCK_MANAGER:
-            zww_dock_manager_v2_destroy(self->dock_manager);
-            self->dock_manager = NULL;
-        break;
-        case WW_DOCK_GLOBAL_SHM:
-            wl_shm_destroy(self->shm);
-            self->shm = NULL;
-        break;
-        case _WW_DOCK_GLOBAL_SIZE:
-            assert_not_reached();
-        }
-        return;
-    }
-    if ( ( self->cursor.theme != NULL ) && ( ( self->compositor == NULL ) || ( self->shm == NULL ) ) )
-    {
-        if ( self->cursor.frame_cb != NULL )
-            wl_callback_destroy(self->cursor.frame_cb);
-        self->cursor.frame_cb = NULL;
+static const struct wp_presentation_listener _ww_dock_presentation_listener = {
+    .clock_id = _ww_dock_presentation_clock_id,
+};
 
-        wl_surface_destroy(self->cursor.surface);
-        wl_cursor_theme_destroy(self->cursor.theme);
-        self->cursor.surface = NULL;
-        self->cursor.image = NULL;
-        self->cursor.cursor = NULL;
-        self->cursor.theme = NULL;
-    }
+static void
+_ww_dock_presentation_bound(void *user_data, void *proxy)
+{
+    wp_presentation_add_listener(proxy, &_ww_dock_presentation_listener, user_data);
+}
 
-    WwDockSeat *seat, *tmp_seat;
-    wl_list_for_each_safe(seat, tmp_seat, &self->seats, link)
-    {
-        if ( seat->global_name != name )
-            continue;
+static const WwClientGlobal _ww_dock_globals[] = {
+    WW_CLIENT_GLOBAL(WwDockContext, dock_manager, zww_dock_manager_v2_interface, WW_DOCK_MANAGER_INTERFACE_VERSION, zww_dock_manager_v2_destroy),
+    WW_CLIENT_GLOBAL(WwDockContext, viewporter, wp_viewporter_interface, WP_VIEWPORTER_INTERFACE_VERSION, wp_viewporter_destroy),
+    WW_CLIENT_GLOBAL(WwDockContext, fractional_scale_manager, wp_fractional_scale_manager_v1_interface, WP_FRACTIONAL_SCALE_MANAGER_INTERFACE_VERSION, wp_fractional_scale_manager_v1_destroy),
+    /* The clock is only sent on bind, so we need our listener before any dispatch */
+    { &wp_presentation_interface, WP_PRESENTATION_INTERFACE_VERSION, offsetof(WwDockContext, presentation), (WwClientProxyDestroyFunc) wp_presentation_destroy, _ww_dock_presentation_bound, false },
+};
 
-        _ww_dock_seat_release(seat);
-        return;
-    }
+static void
+_ww_dock_settings_entry(void *user_data, const char *key, const char *value)
+{
+    WwDockSettings *self = user_data;
+    WwColour *colour = NULL;
 
-    WwDockOutput *output, *tmp_output;
-    wl_list_for_each_safe(output, tmp_output, &self->outputs, link)
+    if ( strcmp(key, "background") == 0 )
+        colour = &self->background_colour;
+    else if ( strcmp(key, "text") == 0 )
+        colour = &self->text_colour;
+    else
     {
-        if ( output->global_name != name )
-            continue;
-
-        _ww_dock_output_release(output);
+        ww_warning("Unknown setting: %s", key);
         return;
     }
+
+    if ( ! _ww_parse_colour(value, colour) )
+        ww_warning("Invalid colour: %s", value);
 }
 
-static const struct wl_registry_listener _ww_dock_registry_listener = {
-    .global = _ww_dock_registry_handle_global,
-    .global_remove = _ww_dock_registry_handle_global_remove,
-};
+static void
+_ww_dock_settings_load(WwDockContext *self)
+{
+    WwDockSettings settings = self->defaults;
 
+    if ( self->settings_path != NULL )
+        ww_settings_parse(self->settings_path, _ww_dock_settings_entry, &settings);
+
+    if ( memcmp(&self->settings, &settings, sizeof(WwDockSettings)) == 0 )
+        return;
+    self->settings = settings;
+
+    WwDockMessage message = {
+        .type = WW_DOCK_MESSAGE_SETTINGS,
+        .settings = settings,
+    };
+    _ww_dock_send(self, &message);
+}
 
 static void
-_ww_dock_disconnect(WwDockContext *self)
+_ww_dock_settings_changed(void *user_data)
+{
+    WwDockContext *self = user_data;
+
+    _ww_dock_settings_load(self);
+}
+
+static int
+_ww_dock_offscreen_compare(const void *a_, const void *b_)
 {
-    WwDockSeat *seat, *tmp;
-    wl_list_for_each_safe(seat, tmp, &self->seats, link)
-        _ww_dock_seat_release(seat);
+    const int64_t *a = a_, *b = b_;
+    return ( *a > *b ) - ( *a < *b );
+}
 
-    WwDockGlobalName i;
-    for ( i = 0 ; i < _WW_DOCK_GLOBAL_SIZE ; ++i )
+static bool
+_ww_dock_offscreen_parse_size(WwDockOffscreen *self, const char *spec)
+{
+    double scale = 1.0;
+    char *e;
+
+    errno = 0;
+    self->width = strtol(spec, &e, 10);
+    if ( ( e == spec ) || ( *e != 'x' ) )
+        return false;
+    spec = e + 1;
+    self->height = strtol(spec, &e, 10);
+    if ( e == spec )
+        return false;
+    if ( *e == '@' )
     {
-        if ( self->global_names[i] != 0 )
-            _ww_dock_registry_handle_global_remove(self, self->registry, self->global_names[i]);
+        spec = e + 1;
+        scale = strtod(spec, &e);
+        if ( e == spec )
+            return false;
     }
+    if ( ( *e != '\0' ) || ( errno != 0 ) )
+        return false;
+    if ( ( self->width < 1 ) || ( self->height < 1 ) || ( scale <= 0 ) )
+        return false;
 
-    wl_registry_destroy(self->registry);
-    self->registry = NULL;
-
-    wl_display_disconnect(self->display);
-    self->display = NULL;
+    self->scale = scale * WW_DOCK_SCALE_DENOMINATOR + 0.5;
+    return ( self->scale > 0 );
 }
 
-int
-main(int argc, char *argv[])
+/*
+ * Renders with the same update and drawing code in plain memory, and prints the time of each frame
+ * Frame n shows the bar n seconds after the epoch, set TZ for reproducible images
+ * Like on screen, a frame only repaints the widgets that changed since the previous one
+ */
+static int
+_ww_dock_offscreen_run(WwDockContext *context)
 {
-    static WwDockContext self_;
-    WwDockContext *self = &self_;
+    WwDock dock = { .context = context };
+    WwBufferPool pool = { .context = context };
+    WwDock *self = &dock;
+    uint8_t *data = NULL;
+    int64_t *times = NULL;
+    int ret = 0;
+    size_t i;
 
-    setlocale(LC_ALL, "");
+    /* We are the only consumer, and need the settings */
+    _ww_dock_render_handle_messages(context);
 
-    const char *runtime_dir;
-    runtime_dir = getenv("XDG_RUNTIME_DIR");
-    if ( runtime_dir == NULL )
-        return 1;
-    snprintf(self->runtime_dir, PATH_MAX, "%s/" PACKAGE_NAME, runtime_dir);
+    self->width = context->offscreen.width;
+    self->height = context->offscreen.height;
+    self->vertical = ( self->height > self->width );
+    wl_list_init(&self->outputs);
+    wl_list_init(&self->widgets);
+    self->pool = &pool;
 
-    if ( mkdir(self->runtime_dir, 0755) < 0 )
+    if ( ! _ww_dock_create_widgets(self) )
     {
-        if ( errno == EEXIST )
+        ret = 3;
+        goto out;
+    }
+    _ww_dock_layout(self);
+
+    WwWidget *widget;
+    wl_list_for_each(widget, &self->widgets, link)
+        widget->next_update = 0;
+
+    pool.format = _ww_dock_pick_format(context);
+    pool.scale = context->offscreen.scale;
+    pool.width = _ww_dock_scale_size(self->width, pool.scale);
+    pool.height = _ww_dock_scale_size(self->height, pool.scale);
+    pool.stride = cairo_format_stride_for_width(_ww_dock_get_cairo_format(pool.format), pool.width);
+
+    data = calloc(pool.stride, pool.height);
+    times = ww_new0(int64_t, context->offscreen.frames);
+    if ( ( data == NULL ) || ( times == NULL ) )
+    {
+        ret = 2;
+        goto out;
+    }
+
+    for ( i = 0 ; i < context->offscreen.frames ; ++i )
+    {
+        int64_t start = ww_stats_now();
+        _ww_dock_update_widgets(self, (int64_t) i * 1000000);
+        _ww_dock_draw(self, data, self->frame++);
+        times[i] = ww_stats_now() - start;
+        printf("frame %zu %" PRId64 " µs\n", i, times[i]);
+
+#ifdef CAIRO_HAS_PNG_FUNCTIONS
+        if ( context->offscreen.png_prefix == NULL )
+            continue;
+
+        char filename[PATH_MAX];
+        snprintf(filename, PATH_MAX, "%s%04zu.png", context->offscreen.png_prefix, i);
+        cairo_surface_t *surface = cairo_image_surface_create_for_data(data, _ww_dock_get_cairo_format(pool.format), pool.width, pool.height, pool.stride);
+        cairo_status_t status = cairo_surface_write_to_png(surface, filename);
+        cairo_surface_destroy(surface);
+        if ( status != CAIRO_STATUS_SUCCESS )
         {
-            struct stat buf;
-            if ( stat(self->runtime_dir, &buf) < 0 )
-                return 1;
-            if ( ! S_ISDIR(buf.st_mode) )
-                return 1;
+            ww_warning("Couldn’t write %s: %s", filename, cairo_status_to_string(status));
+            ret = 4;
+            goto out;
         }
-        else
-            return 1;
+#endif /* CAIRO_HAS_PNG_FUNCTIONS */
     }
-    self->display = wl_display_connect(NULL);
-    if ( self->display == NULL )
-        return 2;
 
+    qsort(times, context->offscreen.frames, sizeof(*times), _ww_dock_offscreen_compare);
+    printf("%zu frames %dx%d %s, %zu widgets: min %" PRId64 " µs, median %" PRId64 " µs, max %" PRId64 " µs\n",
+        context->offscreen.frames, pool.width, pool.height, ww_format_get_info(pool.format)->name, context->widget_count,
+        times[0], times[context->offscreen.frames / 2], times[context->offscreen.frames - 1]);
+
+    int64_t samples = ww_stats_counters[WW_STATS_METRIC_SAMPLES];
+    if ( samples > 0 )
+        printf("%" PRId64 " metric samples: mean %" PRId64 " µs, max %" PRId64 " µs\n",
+            samples, ww_stats_counters[WW_STATS_METRIC_SAMPLE_TIME] / samples, ww_stats_counters[WW_STATS_MAX_METRIC_SAMPLE_TIME]);
+
+out:
+    free(times);
+    free(data);
+    _ww_dock_free_widgets(self);
+    return ret;
+}
+
+enum {
+    WW_DOCK_OPTION_RENDER_OFFSCREEN = 256,
+    WW_DOCK_OPTION_FRAMES,
+    WW_DOCK_OPTION_PNG,
+};
+
+static const struct option _ww_dock_options[] = {
+    { "render-offscreen", required_argument, NULL, WW_DOCK_OPTION_RENDER_OFFSCREEN },
+    { "frames", required_argument, NULL, WW_DOCK_OPTION_FRAMES },
+    { "png", required_argument, NULL, WW_DOCK_OPTION_PNG },
+    { NULL, 0, NULL, 0 },
+};
+
+static void *
+_ww_dock_role_init(int argc, char *argv[], int *status)
+{
+    WwDockContext *self;
+
+    self = ww_new0(WwDockContext, 1);
+    if ( self == NULL )
+    {
+        *status = 2;
+        return NULL;
+    }
 
     self->buffer_count = 3;
+    self->offscreen.frames = WW_DOCK_OFFSCREEN_FRAMES;
+    self->presentation_clock = CLOCK_MONOTONIC;
+    self->feed_socket_fd = -1;
+    self->feed_event_fd = -1;
+    ww_hash_init(&self->render_outputs);
+    wl_list_init(&self->render_producers);
+    pthread_mutex_init(&self->removed_mutex, NULL);
+    wl_list_init(&self->removed_producers);
+
+    /* Created now to carry the outputs we get while connecting */
+    self->messages = ww_queue_new(sizeof(WwDockMessage), WW_DOCK_MESSAGES_CAPACITY);
+    if ( self->messages == NULL )
+    {
+        free(self);
+        *status = 2;
+        return NULL;
+    }
 
-    self->background_colour.a = 1.0;
-    self->text_colour.r = 1.0;
-    self->text_colour.g = 1.0;
-    self->text_colour.b = 1.0;
-    self->text_colour.a = 1.0;
+    self->defaults.background_colour.a = 1.0;
+    self->defaults.text_colour.r = 1.0;
+    self->defaults.text_colour.g = 1.0;
+    self->defaults.text_colour.b = 1.0;
+    self->defaults.text_colour.a = 1.0;
 
     int arg;
-    while ( ( arg = getopt(argc, argv, "b:t:c:C:") ) != -1 )
+    while ( ( arg = getopt_long(argc, argv, "b:t:c:ls:C:w:F:", _ww_dock_options, NULL) ) != -1 )
     {
         bool good = false;
         switch ( arg )
         {
         case 'b':
-            if ( _ww_parse_colour(optarg, &self->background_colour) )
+            if ( _ww_parse_colour(optarg, &self->defaults.background_colour) )
                 good = true;
         break;
         case 't':
-            if ( _ww_parse_colour(optarg, &self->text_colour) )
+            if ( _ww_parse_colour(optarg, &self->defaults.text_colour) )
                 good = true;
         break;
         case 'c':
@@ -932,10 +1714,53 @@ main(int argc, char *argv[])
                 good = true;
         }
         break;
+        case 'l':
+            self->low_memory = true;
+            good = true;
+        break;
+        case 's':
+            self->settings_path = optarg;
+            good = true;
+        break;
         case 'C':
-            self->cursor.theme_name = optarg;
+            self->cursor_theme = optarg;
+            good = true;
+        break;
+        case 'w':
+            if ( self->widget_count < WW_DOCK_WIDGETS_MAX )
+            {
+                if ( strncmp(optarg, "feed:", strlen("feed:")) == 0 )
+                    self->feed = true;
+                self->widgets[self->widget_count++] = optarg;
+                good = true;
+            }
+        break;
+        case 'F':
+            self->feed_path = optarg;
+            good = true;
+        break;
+        case WW_DOCK_OPTION_RENDER_OFFSCREEN:
+            if ( _ww_dock_offscreen_parse_size(&self->offscreen, optarg) )
+            {
+                self->offscreen.enabled = true;
+                good = true;
+            }
+        break;
+        case WW_DOCK_OPTION_FRAMES:
+        {
+            char *e;
+            errno = 0;
+            self->offscreen.frames = strtoul(optarg, &e, 10);
+            if ( ( e != optarg ) && ( errno == 0 ) && ( self->offscreen.frames > 0 ) )
+                good = true;
+        }
+        break;
+#ifdef CAIRO_HAS_PNG_FUNCTIONS
+        case WW_DOCK_OPTION_PNG:
+            self->offscreen.png_prefix = optarg;
             good = true;
         break;
+#endif /* CAIRO_HAS_PNG_FUNCTIONS */
         default:
         break;
         }
@@ -949,52 +1774,125 @@ main(int argc, char *argv[])
                 "\n    -b <colour>      Colour to use as background, defaults to #000000"
                 "\n    -t <colour>      Colour to use for the text, defaults to #FFFFFF"
                 "\n    -c <count>       Number of buffers to use, defaults to 3"
+                "\n    -l               Save memory with 16-bit buffers for opaque backgrounds"
+                "\n    -s <file>        Settings file, reloaded when it changes"
                 "\n    -C <name>        The cursor theme to use"
+                "\n    -w <widget>      Add a widget to the bar, in order, defaults to a single clock"
+                "\n    -F <socket>      Socket for feed producers, defaults to dock.feed in the runtime directory"
+                "\n"
+                "\nOffscreen rendering, without a compositor:"
+                "\n    --render-offscreen <width>x<height>[@<scale>]"
+                "\n                     Render frames in memory and print their timings"
+                "\n    --frames <count> Number of frames to render, defaults to 60"
+#ifdef CAIRO_HAS_PNG_FUNCTIONS
+                "\n    --png <prefix>   Write each frame to <prefix><frame>.png"
+#endif /* CAIRO_HAS_PNG_FUNCTIONS */
                 "\n"
                 "\nFormats:"
                 "\n    Colours options supports #RRGGBB(AA) and #RGB(A) formats"
+                "\n    Settings files use “key = value” lines, with keys background and text"
+                "\n    Widgets are clock[:<strftime format>], defaulting to “%%Y-%%m-%%d %%T”,"
+                "\n    load, cpu, memory, net, battery or feed:<segment>, pushed by ww-feed"
+                "\n    Offscreen frame n shows the bar n seconds after the epoch, in the TZ timezone"
                 "\n\n", argv[0]);
-            return 3;
+            *status = 3;
+            return NULL;
         }
     }
 
+    if ( self->widget_count == 0 )
+        self->widgets[self->widget_count++] = "clock";
 
-    wl_list_init(&self->seats);
-    wl_list_init(&self->outputs);
+    /* Shared by all the widgets of all the docks, on the render thread */
+    self->metrics = ww_metrics_new();
+    if ( self->metrics == NULL )
+    {
+        *status = 2;
+        return NULL;
+    }
 
-    self->registry = wl_display_get_registry(self->display);
-    wl_registry_add_listener(self->registry, &_ww_dock_registry_listener, self);
-    wl_display_roundtrip(self->display);
+    _ww_dock_settings_load(self);
+    wl_list_init(&self->docks);
 
-    if ( self->shm == NULL )
+    if ( self->offscreen.enabled )
+    {
+        *status = _ww_dock_offscreen_run(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+static bool
+_ww_dock_role_attach(void *data, WwClient *client)
+{
+    WwDockContext *self = data;
+
+    self->client = client;
+    if ( self->cursor_theme != NULL )
+        self->client->cursor.theme_name = self->cursor_theme;
+
+    if ( self->settings_path != NULL )
+        self->settings_watch = ww_settings_watch_new(self->client->loop, self->settings_path, _ww_dock_settings_changed, self);
+
+    /* Feed widgets just stay empty without it */
+    if ( self->feed && ( ! _ww_dock_feed_init(self) ) )
+        ww_warning("Couldn’t create feed socket: %s", strerror(errno));
+
+    if ( ! ww_client_add_globals(self->client, _ww_dock_globals, sizeof(_ww_dock_globals) / sizeof(*_ww_dock_globals), self) )
+        return false;
+    return ww_client_add_listener(self->client, &_ww_dock_client_listener, self);
+}
+
+static int
+_ww_dock_role_start(void *data)
+{
+    WwDockContext *self = data;
+
+    if ( self->client->shm == NULL )
     {
-        _ww_dock_disconnect(self);
         ww_warning("No wl_shm interface provided by the compositor");
         return 4;
     }
     if ( self->dock_manager == NULL )
     {
-        _ww_dock_disconnect(self);
         ww_warning("No ww_dock_manager interface provided by the compositor");
         return 4;
     }
 
+    if ( ! _ww_dock_render_init(self) )
+        return 5;
+
+    /* The render thread is not running yet, we are the consumer until it does */
+    _ww_dock_render_handle_messages(self);
+
     WwDock *dock;
-    time_t current;
-    current = time(NULL);
-    dock = _ww_dock_create(self, current);
+    dock = _ww_dock_create(self);
     if ( dock == NULL )
         return 5;
 
-    int ret;
-    do
+    int error = pthread_create(&self->render_thread, NULL, _ww_dock_render_thread, self);
+    if ( error != 0 )
     {
-        wl_display_flush(self->display);
-        ret = wl_display_dispatch(self->display);
+        ww_warning("Couldn’t start the render thread: %s", strerror(error));
+        return 5;
     }
-    while ( ret > 0 );
-    if ( ret < 0 )
-        ww_warning("Couldn’t dispatch events: %s", strerror(errno));
 
     return 0;
 }
+
+const WwRole ww_dock_role = {
+    .name = "dock",
+    .init = _ww_dock_role_init,
+    .attach = _ww_dock_role_attach,
+    .start = _ww_dock_role_start,
+};
+
+#ifndef WW_SHELL
+int
+main(int argc, char *argv[])
+{
+    WwRoleInstance instance = { &ww_dock_role, argc, argv, NULL };
+    return ww_role_run("ww-dock", &instance, 1);
+}
+#endif /* ! WW_SHELL */
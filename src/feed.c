@@ -0,0 +1,291 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/* For memfd_create() and accept4() */
+#define _GNU_SOURCE
+
+#include "helpers.h"
+
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "feed.h"
+
+typedef struct {
+    uint32_t version;
+    uint32_t capacity;
+    /* Free-running, each written by one side only, on their own cache line */
+    uint32_t head __attribute__((aligned(64)));
+    uint32_t tail __attribute__((aligned(64)));
+    uint32_t signaled;
+    WwFeedEntry entries[] __attribute__((aligned(64)));
+} WwFeedShared;
+
+struct _WwFeedRing {
+    WwFeedShared *shared;
+    size_t size;
+    /* Our own head or tail, the other side can write anything in the shared one */
+    uint32_t index;
+    int event_fd;
+    int socket_fd;
+};
+
+static WwFeedRing *
+_ww_feed_ring_map(int fd, size_t size)
+{
+    WwFeedRing *self;
+
+    self = ww_new0(WwFeedRing, 1);
+    if ( self == NULL )
+        return NULL;
+
+    self->shared = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if ( self->shared == MAP_FAILED )
+    {
+        free(self);
+        return NULL;
+    }
+    self->size = size;
+    self->event_fd = -1;
+    self->socket_fd = -1;
+
+    return self;
+}
+
+void
+ww_feed_ring_free(WwFeedRing *self)
+{
+    munmap(self->shared, self->size);
+    if ( self->event_fd >= 0 )
+        close(self->event_fd);
+    if ( self->socket_fd >= 0 )
+        close(self->socket_fd);
+    free(self);
+}
+
+int
+ww_feed_accept(int socket_fd, int event_fd, WwFeedRing **ring)
+{
+    size_t size = sizeof(WwFeedShared) + WW_FEED_CAPACITY * sizeof(WwFeedEntry);
+    WwFeedRing *self = NULL;
+    int fd, ring_fd;
+
+    fd = accept4(socket_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if ( fd < 0 )
+        return -1;
+
+    /* Sealed, so the producer cannot truncate it under our feet */
+    ring_fd = memfd_create(PACKAGE_NAME "-feed", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if ( ring_fd < 0 )
+        goto error;
+    if ( ftruncate(ring_fd, size) < 0 )
+        goto error;
+    if ( fcntl(ring_fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0 )
+        goto error;
+
+    self = _ww_feed_ring_map(ring_fd, size);
+    if ( self == NULL )
+        goto error;
+    self->shared->version = WW_FEED_VERSION;
+    self->shared->capacity = WW_FEED_CAPACITY;
+
+    char byte = 0;
+    struct iovec iov = { .iov_base = &byte, .iov_len = sizeof(byte) };
+    union {
+        struct cmsghdr header;
+        char buffer[CMSG_SPACE(2 * sizeof(int))];
+    } control = { .buffer = { 0 } };
+    struct msghdr message = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control.buffer,
+        .msg_controllen = sizeof(control.buffer),
+    };
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(2 * sizeof(int));
+    memcpy(CMSG_DATA(header), (int[]) { ring_fd, event_fd }, 2 * sizeof(int));
+
+    if ( sendmsg(fd, &message, MSG_NOSIGNAL | MSG_DONTWAIT) < 0 )
+        goto error;
+
+    close(ring_fd);
+    *ring = self;
+    return fd;
+
+error:
+    ww_warning("Couldn’t hand out a feed: %s", strerror(errno));
+    if ( self != NULL )
+        ww_feed_ring_free(self);
+    if ( ring_fd >= 0 )
+        close(ring_fd);
+    close(fd);
+    return -1;
+}
+
+WwFeedRing *
+ww_feed_connect(const char *path)
+{
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    WwFeedRing *self = NULL;
+    int fds[2] = { -1, -1 };
+    int fd;
+
+    if ( strlen(path) >= sizeof(address.sun_path) )
+    {
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+    strcpy(address.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if ( fd < 0 )
+        return NULL;
+    if ( connect(fd, (struct sockaddr *) &address, sizeof(address)) < 0 )
+        goto error;
+
+    char byte;
+    struct iovec iov = { .iov_base = &byte, .iov_len = sizeof(byte) };
+    union {
+        struct cmsghdr header;
+        char buffer[CMSG_SPACE(2 * sizeof(int))];
+    } control;
+    struct msghdr message = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control.buffer,
+        .msg_controllen = sizeof(control.buffer),
+    };
+    if ( recvmsg(fd, &message, MSG_CMSG_CLOEXEC) < 1 )
+        goto error;
+
+    struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+    if ( ( header == NULL ) || ( header->cmsg_type != SCM_RIGHTS ) || ( header->cmsg_len != CMSG_LEN(2 * sizeof(int)) ) )
+    {
+        errno = EPROTO;
+        goto error;
+    }
+    memcpy(fds, CMSG_DATA(header), 2 * sizeof(int));
+
+    struct stat buf;
+    if ( fstat(fds[0], &buf) < 0 )
+        goto error;
+    if ( (size_t) buf.st_size < sizeof(WwFeedShared) + WW_FEED_CAPACITY * sizeof(WwFeedEntry) )
+    {
+        errno = EPROTO;
+        goto error;
+    }
+
+    self = _ww_feed_ring_map(fds[0], buf.st_size);
+    if ( self == NULL )
+        goto error;
+    if ( ( self->shared->version != WW_FEED_VERSION ) || ( self->shared->capacity != WW_FEED_CAPACITY ) )
+    {
+        errno = EPROTO;
+        goto error;
+    }
+
+    close(fds[0]);
+    self->index = __atomic_load_n(&self->shared->tail, __ATOMIC_RELAXED);
+    self->event_fd = fds[1];
+    /* The consumer drops the ring when we hang up */
+    self->socket_fd = fd;
+    return self;
+
+error:
+    if ( self != NULL )
+        ww_feed_ring_free(self);
+    if ( fds[1] >= 0 )
+        close(fds[1]);
+    if ( fds[0] >= 0 )
+        close(fds[0]);
+    close(fd);
+    return NULL;
+}
+
+bool
+ww_feed_push(WwFeedRing *self, uint32_t segment, const char *text)
+{
+    WwFeedShared *shared = self->shared;
+    uint32_t tail = self->index;
+    uint32_t head = __atomic_load_n(&shared->head, __ATOMIC_ACQUIRE);
+
+    if ( tail - head >= WW_FEED_CAPACITY )
+        return false;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    WwFeedEntry *entry = shared->entries + ( tail % WW_FEED_CAPACITY );
+    entry->segment = segment;
+    entry->time = (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    strncpy(entry->text, text, WW_FEED_TEXT_SIZE - 1);
+    entry->text[WW_FEED_TEXT_SIZE - 1] = '\0';
+
+    self->index = tail + 1;
+    __atomic_store_n(&shared->tail, self->index, __ATOMIC_SEQ_CST);
+
+    /* Only wake the consumer once per batch */
+    if ( ! __atomic_exchange_n(&shared->signaled, 1, __ATOMIC_SEQ_CST) )
+    {
+        uint64_t one = 1;
+        if ( write(self->event_fd, &one, sizeof(one)) < 0 )
+            ww_warning("Couldn’t wake feed consumer: %s", strerror(errno));
+    }
+
+    return true;
+}
+
+bool
+ww_feed_pop(WwFeedRing *self, WwFeedEntry *entry)
+{
+    WwFeedShared *shared = self->shared;
+    uint32_t head = self->index;
+    uint32_t tail = __atomic_load_n(&shared->tail, __ATOMIC_ACQUIRE);
+
+    if ( head == tail )
+    {
+        /* Same dance as WwQueue, a late wake-up only costs a spurious one */
+        __atomic_store_n(&shared->signaled, 0, __ATOMIC_SEQ_CST);
+        tail = __atomic_load_n(&shared->tail, __ATOMIC_SEQ_CST);
+        if ( head == tail )
+            return false;
+    }
+
+    /* A broken producer, we stop listening to it */
+    if ( tail - head > WW_FEED_CAPACITY )
+        return false;
+
+    memcpy(entry, shared->entries + ( head % WW_FEED_CAPACITY ), sizeof(*entry));
+    entry->text[WW_FEED_TEXT_SIZE - 1] = '\0';
+
+    self->index = head + 1;
+    __atomic_store_n(&shared->head, self->index, __ATOMIC_RELEASE);
+
+    return true;
+}
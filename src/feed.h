@@ -0,0 +1,67 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef __WW_FEED_H__
+#define __WW_FEED_H__
+
+#include "helpers.h"
+
+/* Bumped on any change of the shared layout */
+#define WW_FEED_VERSION 1
+#define WW_FEED_SEGMENTS 16
+#define WW_FEED_TEXT_SIZE 64
+#define WW_FEED_CAPACITY 256
+
+typedef struct {
+    uint32_t segment;
+    /* Wall-clock time of the push, in µs, for latency stats */
+    int64_t time;
+    char text[WW_FEED_TEXT_SIZE];
+} WwFeedEntry;
+
+typedef struct _WwFeedRing WwFeedRing;
+
+/*
+ * A single-producer single-consumer ring of text segments in a sealed memfd
+ * The consumer hands it out on a Unix socket with an eventfd to wake it,
+ * the eventfd can be shared by many rings
+ */
+
+/* Consumer side, returns the connection fd, the ring is gone once it hangs up */
+int ww_feed_accept(int socket_fd, int event_fd, WwFeedRing **ring);
+
+/* Producer side */
+WwFeedRing *ww_feed_connect(const char *path);
+
+void ww_feed_ring_free(WwFeedRing *self);
+
+/* Producer side, returns false if the ring is full */
+bool ww_feed_push(WwFeedRing *self, uint32_t segment, const char *text);
+
+/*
+ * Consumer side, pops until empty, read the eventfd before popping so no wake-up is lost
+ * Entries are checked, a producer cannot get us out of the ring
+ */
+bool ww_feed_pop(WwFeedRing *self, WwFeedEntry *entry);
+
+#endif /* __WW_FEED_H__ */
@@ -0,0 +1,179 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "helpers.h"
+
+#include <time.h>
+#include <inttypes.h>
+
+#include "feed.h"
+
+/* Before retrying a push to a full ring, in µs */
+#define WW_FEEDER_RETRY_DELAY 1000
+
+static int64_t
+_ww_feeder_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int
+_ww_feeder_lines(WwFeedRing *ring, uint32_t segment)
+{
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t length;
+
+    while ( ( length = getline(&line, &size, stdin) ) >= 0 )
+    {
+        if ( ( length > 0 ) && ( line[length - 1] == '\n' ) )
+            line[length - 1] = '\0';
+
+        /* The dock is busy, lines are rare enough to wait for it */
+        while ( ! ww_feed_push(ring, segment, line) )
+            usleep(WW_FEEDER_RETRY_DELAY);
+    }
+
+    free(line);
+    return 0;
+}
+
+/* Pushes a counter at a steady rate, the dock stats give the latency to the pixels */
+static int
+_ww_feeder_benchmark(WwFeedRing *ring, uint32_t segment, unsigned long rate, unsigned long count)
+{
+    int64_t start = _ww_feeder_now();
+    unsigned long i, dropped = 0;
+    char text[WW_FEED_TEXT_SIZE];
+
+    for ( i = 0 ; i < count ; ++i )
+    {
+        int64_t deadline = start + (int64_t) i * 1000000 / rate;
+        struct timespec ts = {
+            .tv_sec = deadline / 1000000,
+            .tv_nsec = ( deadline % 1000000 ) * 1000,
+        };
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+
+        snprintf(text, sizeof(text), "%lu", i);
+        if ( ! ww_feed_push(ring, segment, text) )
+            ++dropped;
+    }
+
+    int64_t elapsed = _ww_feeder_now() - start;
+    printf("%lu pushes in %" PRId64 " ms, %.0f/s, %lu dropped on a full ring\n", count, elapsed / 1000, count * 1000000.0 / MAX(elapsed, 1), dropped);
+
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    char path[PATH_MAX];
+    const char *socket_path = NULL;
+    unsigned long rate = 0, count = 0;
+    WwFeedRing *ring;
+    int ret;
+
+    setlocale(LC_ALL, "");
+
+    int arg;
+    while ( ( arg = getopt(argc, argv, "s:r:n:") ) != -1 )
+    {
+        bool good = false;
+        char *e;
+        switch ( arg )
+        {
+        case 's':
+            socket_path = optarg;
+            good = true;
+        break;
+        case 'r':
+            errno = 0;
+            rate = strtoul(optarg, &e, 10);
+            if ( ( e != optarg ) && ( *e == '\0' ) && ( errno == 0 ) && ( rate > 0 ) )
+                good = true;
+        break;
+        case 'n':
+            errno = 0;
+            count = strtoul(optarg, &e, 10);
+            if ( ( e != optarg ) && ( *e == '\0' ) && ( errno == 0 ) && ( count > 0 ) )
+                good = true;
+        break;
+        default:
+        break;
+        }
+        if ( ! good )
+            goto usage;
+    }
+
+    if ( optind + 1 != argc )
+        goto usage;
+
+    char *e;
+    errno = 0;
+    unsigned long segment = strtoul(argv[optind], &e, 10);
+    if ( ( e == argv[optind] ) || ( *e != '\0' ) || ( errno != 0 ) || ( segment >= WW_FEED_SEGMENTS ) )
+        goto usage;
+
+    if ( socket_path == NULL )
+    {
+        const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+        if ( runtime_dir == NULL )
+        {
+            ww_warning("XDG_RUNTIME_DIR is not set, use -s");
+            return 1;
+        }
+        snprintf(path, PATH_MAX, "%s/" PACKAGE_NAME "/dock.feed", runtime_dir);
+        socket_path = path;
+    }
+
+    ring = ww_feed_connect(socket_path);
+    if ( ring == NULL )
+    {
+        ww_warning("Couldn’t connect to %s: %s", socket_path, strerror(errno));
+        return 2;
+    }
+
+    if ( rate > 0 )
+        ret = _ww_feeder_benchmark(ring, segment, rate, ( count > 0 ) ? count : rate * 10);
+    else
+        ret = _ww_feeder_lines(ring, segment);
+
+    ww_feed_ring_free(ring);
+    return ret;
+
+usage:
+    fprintf(stderr, ""
+        "Usage:"
+        "\n    %s [OPTION...] <segment> - Pushes lines from stdin to a ww-dock feed:<segment> widget"
+        "\n"
+        "\nOptions:"
+        "\n    -s <socket>      The dock feed socket, defaults to dock.feed in the runtime directory"
+        "\n    -r <rate>        Benchmark, push a counter <rate> times per second instead"
+        "\n    -n <count>       Number of benchmark pushes, defaults to ten seconds worth"
+        "\n\n", argv[0]);
+    return 3;
+}
@@ -0,0 +1,250 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "helpers.h"
+
+#include <math.h>
+
+#include "format.h"
+
+const uint8_t ww_format_bayer[8][8] = {
+    {  0, 32,  8, 40,  2, 34, 10, 42 },
+    { 48, 16, 56, 24, 50, 18, 58, 26 },
+    { 12, 44,  4, 36, 14, 46,  6, 38 },
+    { 60, 28, 52, 20, 62, 30, 54, 22 },
+    {  3, 35, 11, 43,  1, 33,  9, 41 },
+    { 51, 19, 59, 27, 49, 17, 57, 25 },
+    { 15, 47,  7, 39, 13, 45,  5, 37 },
+    { 63, 31, 55, 23, 61, 29, 53, 21 },
+};
+
+static const WwFormatInfo _ww_formats[_WW_FORMAT_SIZE] = {
+    [WW_FORMAT_ARGB8888] = { WL_SHM_FORMAT_ARGB8888, "ARGB8888", 4, { 8, 8, 8 } },
+    [WW_FORMAT_XRGB8888] = { WL_SHM_FORMAT_XRGB8888, "XRGB8888", 4, { 8, 8, 8 } },
+    [WW_FORMAT_RGB565] = { WL_SHM_FORMAT_RGB565, "RGB565", 2, { 5, 6, 5 } },
+    [WW_FORMAT_XRGB2101010] = { WL_SHM_FORMAT_XRGB2101010, "XRGB2101010", 4, { 10, 10, 10 } },
+};
+
+/*
+ * For each 8-bits value, the lower representable level and
+ * the Bayer threshold (out of 64) above which we take the upper one
+ */
+typedef struct {
+    uint16_t level;
+    uint8_t threshold;
+} WwFormatQuant;
+
+const WwFormatInfo *
+ww_format_get_info(WwFormat format)
+{
+    return &_ww_formats[format];
+}
+
+bool
+ww_format_from_shm(uint32_t shm_format, WwFormat *format)
+{
+    WwFormat i;
+    for ( i = 0 ; i < _WW_FORMAT_SIZE ; ++i )
+    {
+        if ( _ww_formats[i].shm_format != shm_format )
+            continue;
+        *format = i;
+        return true;
+    }
+    return false;
+}
+
+static inline uint32_t
+_ww_format_expand(uint32_t level, uint8_t bits)
+{
+    /* Replicate the high bits, as compositors do when sampling */
+    return ( level << ( 8 - bits ) ) | ( level >> ( 2 * bits - 8 ) );
+}
+
+static void
+_ww_format_quant_init(WwFormatQuant *quant, uint8_t bits)
+{
+    uint32_t v;
+    for ( v = 0 ; v < 256 ; ++v )
+    {
+        if ( bits >= 8 )
+        {
+            /* Expand, this is exact */
+            quant[v].level = ( v << ( bits - 8 ) ) | ( v >> ( 16 - bits ) );
+            quant[v].threshold = 0;
+            continue;
+        }
+
+        uint32_t level = v >> ( 8 - bits );
+        uint32_t lo = _ww_format_expand(level, bits);
+        if ( lo > v )
+            lo = _ww_format_expand(--level, bits);
+        quant[v].level = level;
+        if ( lo == v )
+            quant[v].threshold = 0;
+        else
+        {
+            uint32_t hi = _ww_format_expand(level + 1, bits);
+            quant[v].threshold = ( ( v - lo ) * 64 + ( hi - lo ) / 2 ) / ( hi - lo );
+        }
+    }
+}
+
+static inline uint32_t
+_ww_format_quant(const WwFormatQuant *quant, uint8_t v, uint8_t d)
+{
+    return quant[v].level + ( d < quant[v].threshold );
+}
+
+static inline void
+_ww_format_store(WwFormat format, uint8_t *pixel, uint32_t r, uint32_t g, uint32_t b)
+{
+    switch ( format )
+    {
+    case WW_FORMAT_ARGB8888:
+    case WW_FORMAT_XRGB8888:
+        *(uint32_t *) pixel = 0xff000000 | ( r << 16 ) | ( g << 8 ) | b;
+    break;
+    case WW_FORMAT_RGB565:
+        *(uint16_t *) pixel = ( r << 11 ) | ( g << 5 ) | b;
+    break;
+    case WW_FORMAT_XRGB2101010:
+        *(uint32_t *) pixel = 0xc0000000 | ( r << 20 ) | ( g << 10 ) | b;
+    break;
+    case _WW_FORMAT_SIZE:
+        assert(0 && "Should never be reached");
+    }
+}
+
+static inline uint8_t
+_ww_format_colour_channel(double c)
+{
+    return lround(CLAMP(c, 0., 1.) * 0xff);
+}
+
+bool
+ww_format_colour_is_exact(WwFormat format, const WwColour *colour)
+{
+    const WwFormatInfo *info = &_ww_formats[format];
+    uint8_t c[3] = {
+        _ww_format_colour_channel(colour->r),
+        _ww_format_colour_channel(colour->g),
+        _ww_format_colour_channel(colour->b),
+    };
+
+    int i;
+    for ( i = 0 ; i < 3 ; ++i )
+    {
+        if ( info->bits[i] >= 8 )
+            continue;
+        if ( _ww_format_expand(c[i] >> ( 8 - info->bits[i] ), info->bits[i]) != c[i] )
+            return false;
+    }
+    return true;
+}
+
+void
+ww_format_fill(WwFormat format, uint8_t *data, int32_t width, int32_t height, int32_t stride, const WwColour *colour)
+{
+    const WwFormatInfo *info = &_ww_formats[format];
+    WwFormatQuant quant[3][256];
+    uint8_t c[3] = {
+        _ww_format_colour_channel(colour->r),
+        _ww_format_colour_channel(colour->g),
+        _ww_format_colour_channel(colour->b),
+    };
+    int i;
+
+    for ( i = 0 ; i < 3 ; ++i )
+        _ww_format_quant_init(quant[i], info->bits[i]);
+
+    /* The dither pattern repeats every 8 pixels, so we compute one tile */
+    uint8_t tile[8][8 * 4];
+    int32_t x, y;
+    for ( y = 0 ; y < 8 ; ++y )
+    {
+        for ( x = 0 ; x < 8 ; ++x )
+        {
+            uint8_t d = ww_format_bayer[y][x];
+            _ww_format_store(format, tile[y] + x * info->bytes, _ww_format_quant(quant[0], c[0], d), _ww_format_quant(quant[1], c[1], d), _ww_format_quant(quant[2], c[2], d));
+        }
+    }
+
+    for ( y = 0 ; y < height ; ++y )
+    {
+        uint8_t *line = data + y * stride;
+        const uint8_t *tile_line = tile[y & 7];
+        size_t tile_size = 8 * info->bytes;
+        size_t line_size = width * info->bytes;
+        size_t done;
+
+        for ( done = 0 ; done + tile_size <= line_size ; done += tile_size )
+            memcpy(line + done, tile_line, tile_size);
+        memcpy(line + done, tile_line, line_size - done);
+    }
+}
+
+void
+ww_format_convert(WwFormat format, uint8_t *data, int32_t width, int32_t height, int32_t stride, const uint8_t *source, int32_t source_stride, int32_t source_bytes)
+{
+    const WwFormatInfo *info = &_ww_formats[format];
+    WwFormatQuant quant[3][256];
+    int i;
+
+    for ( i = 0 ; i < 3 ; ++i )
+        _ww_format_quant_init(quant[i], info->bits[i]);
+
+    int32_t x, y;
+    for ( y = 0 ; y < height ; ++y )
+    {
+        uint8_t *line = data + y * stride;
+        const uint8_t *source_line = source + y * source_stride;
+        const uint8_t *bayer = ww_format_bayer[y & 7];
+        for ( x = 0 ; x < width ; ++x )
+        {
+            const uint8_t *p = source_line + x * source_bytes;
+            uint8_t d = bayer[x & 7];
+            _ww_format_store(format, line + x * info->bytes, _ww_format_quant(quant[0], p[0], d), _ww_format_quant(quant[1], p[1], d), _ww_format_quant(quant[2], p[2], d));
+        }
+    }
+}
+
+void
+ww_format_premultiply(uint8_t *data, int32_t width, int32_t height, int32_t stride, const uint8_t *source, int32_t source_stride)
+{
+    int32_t x, y;
+    for ( y = 0 ; y < height ; ++y )
+    {
+        uint32_t *line = (uint32_t *) ( data + y * stride );
+        const uint8_t *p = source + y * source_stride;
+        for ( x = 0 ; x < width ; ++x, p += 4 )
+        {
+            /* Exact rounding of c * a / 255 */
+            uint32_t a = p[3], r = p[0] * a + 128, g = p[1] * a + 128, b = p[2] * a + 128;
+            r = ( r + ( r >> 8 ) ) >> 8;
+            g = ( g + ( g >> 8 ) ) >> 8;
+            b = ( b + ( b >> 8 ) ) >> 8;
+            line[x] = a << 24 | r << 16 | g << 8 | b;
+        }
+    }
+}
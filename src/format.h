@@ -0,0 +1,74 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef __WW_FORMAT_H__
+#define __WW_FORMAT_H__
+
+#include "helpers.h"
+
+typedef enum {
+    WW_FORMAT_ARGB8888,
+    WW_FORMAT_XRGB8888,
+    WW_FORMAT_RGB565,
+    WW_FORMAT_XRGB2101010,
+    _WW_FORMAT_SIZE
+} WwFormat;
+
+#define WW_FORMAT_MASK(format) (1 << (format))
+/* wl_shm guarantees these two */
+#define WW_FORMAT_MASK_DEFAULT ( WW_FORMAT_MASK(WW_FORMAT_ARGB8888) | WW_FORMAT_MASK(WW_FORMAT_XRGB8888) )
+
+typedef struct {
+    uint32_t shm_format;
+    const char *name;
+    uint8_t bytes;
+    uint8_t bits[3];
+} WwFormatInfo;
+
+/* 8x8 Bayer matrix, values from 0 to 63 */
+extern const uint8_t ww_format_bayer[8][8];
+
+const WwFormatInfo *ww_format_get_info(WwFormat format);
+bool ww_format_from_shm(uint32_t shm_format, WwFormat *format);
+
+static inline int32_t
+ww_format_get_stride(WwFormat format, int32_t width)
+{
+    /* Keep lines 4-bytes aligned, as cairo does */
+    return ( ( ww_format_get_info(format)->bytes * width ) + 3 ) & ~3;
+}
+
+/* Whether the colour survives the format quantization untouched */
+bool ww_format_colour_is_exact(WwFormat format, const WwColour *colour);
+
+/*
+ * Both kernels dither (ordered) to the nearest representable values when
+ * the format cannot hold the colours exactly
+ */
+void ww_format_fill(WwFormat format, uint8_t *data, int32_t width, int32_t height, int32_t stride, const WwColour *colour);
+/* Source pixels are 8-bits R, G, B bytes, with bytes per pixel given */
+void ww_format_convert(WwFormat format, uint8_t *data, int32_t width, int32_t height, int32_t stride, const uint8_t *source, int32_t source_stride, int32_t source_bytes);
+/* Source pixels are 8-bits R, G, B, A bytes, straight alpha, to premultiplied ARGB8888 */
+void ww_format_premultiply(uint8_t *data, int32_t width, int32_t height, int32_t stride, const uint8_t *source, int32_t source_stride);
+
+#endif /* __WW_FORMAT_H__ */
@@ -0,0 +1,152 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "helpers.h"
+
+#include "hash.h"
+
+#define WW_HASH_MIN_SIZE 8
+
+/* Fibonacci hashing, pointers and names both have poor low bits */
+static inline size_t
+_ww_hash_index(const WwHash *self, uintptr_t key)
+{
+    return ( (uint64_t) key * UINT64_C(0x9E3779B97F4A7C15) ) >> 32 & ( self->size - 1 );
+}
+
+void
+ww_hash_init(WwHash *self)
+{
+    self->entries = NULL;
+    self->size = 0;
+    self->count = 0;
+}
+
+void
+ww_hash_clear(WwHash *self)
+{
+    free(self->entries);
+    ww_hash_init(self);
+}
+
+static bool
+_ww_hash_resize(WwHash *self, size_t size)
+{
+    WwHashEntry *entries = self->entries;
+    size_t old_size = self->size;
+
+    self->entries = ww_new0(WwHashEntry, size);
+    if ( self->entries == NULL )
+    {
+        self->entries = entries;
+        return false;
+    }
+    self->size = size;
+
+    size_t i;
+    for ( i = 0 ; i < old_size ; ++i )
+    {
+        if ( entries[i].key == 0 )
+            continue;
+
+        size_t j = _ww_hash_index(self, entries[i].key);
+        while ( self->entries[j].key != 0 )
+            j = ( j + 1 ) & ( size - 1 );
+        self->entries[j] = entries[i];
+    }
+    free(entries);
+
+    return true;
+}
+
+static size_t
+_ww_hash_find(const WwHash *self, uintptr_t key)
+{
+    size_t i = _ww_hash_index(self, key);
+    while ( ( self->entries[i].key != 0 ) && ( self->entries[i].key != key ) )
+        i = ( i + 1 ) & ( self->size - 1 );
+    return i;
+}
+
+bool
+ww_hash_insert(WwHash *self, uintptr_t key, void *value)
+{
+    assert(key != 0);
+
+    /* Keep the load factor under 3/4 */
+    if ( ( ( self->count + 1 ) * 4 > self->size * 3 ) && ( ! _ww_hash_resize(self, MAX(self->size * 2, WW_HASH_MIN_SIZE)) ) )
+        return false;
+
+    size_t i = _ww_hash_find(self, key);
+    if ( self->entries[i].key == 0 )
+        ++self->count;
+    self->entries[i].key = key;
+    self->entries[i].value = value;
+
+    return true;
+}
+
+void *
+ww_hash_lookup(const WwHash *self, uintptr_t key)
+{
+    if ( self->size == 0 )
+        return NULL;
+
+    return self->entries[_ww_hash_find(self, key)].value;
+}
+
+void *
+ww_hash_remove(WwHash *self, uintptr_t key)
+{
+    if ( self->size == 0 )
+        return NULL;
+
+    size_t i = _ww_hash_find(self, key);
+    if ( self->entries[i].key == 0 )
+        return NULL;
+
+    void *value = self->entries[i].value;
+    --self->count;
+
+    /* Backward shift deletion, so that we never need tombstones */
+    size_t j = i;
+    for (;;)
+    {
+        self->entries[i].key = 0;
+        self->entries[i].value = NULL;
+        for (;;)
+        {
+            j = ( j + 1 ) & ( self->size - 1 );
+            if ( self->entries[j].key == 0 )
+                return value;
+
+            size_t k = _ww_hash_index(self, self->entries[j].key);
+            /* Stays if its home slot is cyclically in ]i, j] */
+            if ( ( i <= j ) ? ( ( i < k ) && ( k <= j ) ) : ( ( i < k ) || ( k <= j ) ) )
+                continue;
+            break;
+        }
+        self->entries[i] = self->entries[j];
+        i = j;
+    }
+}
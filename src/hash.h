@@ -0,0 +1,51 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef __WW_HASH_H__
+#define __WW_HASH_H__
+
+#include "helpers.h"
+
+/*
+ * Open addressing with linear probing, keyed by pointers or Wayland names
+ * 0 is reserved as the empty key
+ */
+typedef struct {
+    uintptr_t key;
+    void *value;
+} WwHashEntry;
+
+typedef struct {
+    WwHashEntry *entries;
+    size_t size;
+    size_t count;
+} WwHash;
+
+void ww_hash_init(WwHash *self);
+void ww_hash_clear(WwHash *self);
+
+bool ww_hash_insert(WwHash *self, uintptr_t key, void *value);
+void *ww_hash_lookup(const WwHash *self, uintptr_t key);
+void *ww_hash_remove(WwHash *self, uintptr_t key);
+
+#endif /* __WW_HASH_H__ */
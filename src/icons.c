@@ -0,0 +1,745 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/* For asprintf() and mkostemp() */
+#define _GNU_SOURCE
+
+#include "helpers.h"
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef ENABLE_IMAGES
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#if ( ( GDK_PIXBUF_MAJOR < 2 ) || ( ( GDK_PIXBUF_MAJOR == 2 ) && ( GDK_PIXBUF_MINOR < 32 ) ) )
+static inline const guchar *gdk_pixbuf_read_pixels(GdkPixbuf *pixbuf) { return gdk_pixbuf_get_pixels(pixbuf); }
+#endif /* gdk-pixbux < 2.32 */
+#endif /* ENABLE_IMAGES */
+
+#include "format.h"
+#include "desktop.h"
+#include "icons.h"
+
+#define WW_ICON_CACHE_MAGIC 0x43495757
+#define WW_ICON_CACHE_VERSION 1
+
+/* Address space for the file, which grows within it */
+#define WW_ICON_CACHE_RESERVE ( (size_t) 256 << 20 )
+#define WW_ICON_CACHE_BUCKETS 1024
+#define WW_ICON_CACHE_MISS_TTL ( 24 * 60 * 60 )
+
+/* Best first after the exact one, scaling down looks better than up */
+static const int32_t _ww_icon_cache_sizes[] = { 512, 256, 192, 128, 96, 72, 64, 48, 36, 32, 24, 22, 16 };
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    /* A power of two, the file is rebuilt at 3/4 load */
+    uint32_t bucket_count;
+    uint32_t entry_count;
+    uint64_t size;
+    /* Set once a rebuilt file replaced this one */
+    uint32_t stale;
+    uint32_t padding;
+    /* Entry offsets, 0 for an empty bucket */
+    uint64_t buckets[];
+} WwIconCacheHeader;
+
+typedef struct {
+    uint32_t hash;
+    int32_t size;
+    /* 0 for a missing icon */
+    int32_t width;
+    int32_t height;
+    int64_t time;
+    uint64_t pixels;
+    uint32_t name_length;
+    char name[];
+} WwIconCacheEntry;
+
+typedef struct _WwIconCacheMapping WwIconCacheMapping;
+struct _WwIconCacheMapping {
+    WwIconCacheMapping *next;
+    uint8_t *data;
+};
+
+struct _WwIconCache {
+    char *path;
+    char *themes[2];
+    char **icon_dirs;
+    char **pixmap_dirs;
+    char **application_dirs;
+    int fd;
+    uint8_t *data;
+    WwIconCacheHeader *header;
+    /* Mappings of replaced files, icons may still point there */
+    WwIconCacheMapping *retired;
+    struct wl_shm_pool *pool;
+    size_t pool_size;
+};
+
+static inline uint64_t
+_ww_icon_cache_align(uint64_t offset, uint64_t alignment)
+{
+    return ( offset + alignment - 1 ) & ~( alignment - 1 );
+}
+
+/* FNV-1a */
+static uint32_t
+_ww_icon_cache_hash(const char *name, size_t length, int32_t size)
+{
+    uint32_t hash = 2166136261u;
+    size_t i;
+
+    for ( i = 0 ; i < length ; ++i )
+        hash = ( hash ^ (uint8_t) name[i] ) * 16777619u;
+    return ( hash ^ (uint32_t) size ) * 16777619u;
+}
+
+static size_t
+_ww_icon_cache_get_index_size(uint32_t bucket_count)
+{
+    return sizeof(WwIconCacheHeader) + bucket_count * sizeof(uint64_t);
+}
+
+/* Another client may have corrupted the file, nothing may point out of our mapping */
+static uint64_t
+_ww_icon_cache_get_end(const WwIconCacheHeader *header)
+{
+    return MIN(__atomic_load_n(&header->size, __ATOMIC_ACQUIRE), WW_ICON_CACHE_RESERVE);
+}
+
+static bool
+_ww_icon_cache_pixels_are_valid(const WwIconCacheEntry *entry, uint64_t start, uint64_t end)
+{
+    if ( entry->width == 0 )
+        return true;
+    if ( ( entry->width < 0 ) || ( entry->height <= 0 ) || ( entry->pixels < start ) || ( entry->pixels > end ) || ( ( entry->pixels % 4 ) != 0 ) )
+        return false;
+
+    uint64_t stride = (uint64_t) entry->width * 4;
+    return ( stride <= end - entry->pixels ) && ( stride * entry->height <= end - entry->pixels );
+}
+
+static const WwIconCacheEntry *
+_ww_icon_cache_get_entry(const WwIconCacheHeader *header, uint64_t offset, uint64_t end)
+{
+    if ( ( offset < _ww_icon_cache_get_index_size(header->bucket_count) ) || ( ( offset % 8 ) != 0 ) || ( offset + sizeof(WwIconCacheEntry) > end ) )
+        return NULL;
+
+    const WwIconCacheEntry *entry = (const WwIconCacheEntry *) ( (const uint8_t *) header + offset );
+    uint64_t name_end = offset + sizeof(WwIconCacheEntry) + entry->name_length;
+    if ( ( name_end > end ) || ( ! _ww_icon_cache_pixels_are_valid(entry, name_end, end) ) )
+        return NULL;
+
+    return entry;
+}
+
+/*
+ * Writers fill the entry, then bump the size, then publish the bucket,
+ * so readers never need the lock
+ * bucket is set to the matching or the empty bucket
+ */
+static const WwIconCacheEntry *
+_ww_icon_cache_find(WwIconCacheHeader *header, uint32_t hash, const char *name, size_t length, int32_t size, uint64_t **bucket)
+{
+    uint32_t mask = header->bucket_count - 1, i, n;
+
+    for ( i = hash & mask, n = 0 ; n < header->bucket_count ; i = ( i + 1 ) & mask, ++n )
+    {
+        uint64_t offset = __atomic_load_n(&header->buckets[i], __ATOMIC_ACQUIRE);
+        *bucket = &header->buckets[i];
+        if ( offset == 0 )
+            return NULL;
+
+        const WwIconCacheEntry *entry = _ww_icon_cache_get_entry(header, offset, _ww_icon_cache_get_end(header));
+        if ( entry == NULL )
+            break;
+        if ( ( entry->hash == hash ) && ( entry->size == size ) && ( entry->name_length == length ) && ( memcmp(entry->name, name, length) == 0 ) )
+            return entry;
+    }
+
+    /* Corrupted, or full which we never let happen */
+    *bucket = NULL;
+    return NULL;
+}
+
+static bool
+_ww_icon_cache_init_file(WwIconCache *self)
+{
+    size_t size = _ww_icon_cache_get_index_size(WW_ICON_CACHE_BUCKETS);
+
+    if ( ( ftruncate(self->fd, 0) < 0 ) || ( ftruncate(self->fd, size) < 0 ) )
+        return false;
+
+    self->header->version = WW_ICON_CACHE_VERSION;
+    self->header->bucket_count = WW_ICON_CACHE_BUCKETS;
+    self->header->size = size;
+    __atomic_store_n(&self->header->magic, WW_ICON_CACHE_MAGIC, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+static bool
+_ww_icon_cache_open(WwIconCache *self)
+{
+    struct stat st;
+
+retry:
+    self->fd = open(self->path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if ( self->fd < 0 )
+    {
+        ww_warning("Couldn’t open icon cache %s: %s", self->path, strerror(errno));
+        return false;
+    }
+
+    self->data = mmap(NULL, WW_ICON_CACHE_RESERVE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE, self->fd, 0);
+    if ( self->data == MAP_FAILED )
+    {
+        ww_warning("Couldn’t map icon cache %s: %s", self->path, strerror(errno));
+        close(self->fd);
+        self->data = NULL;
+        return false;
+    }
+    self->header = (WwIconCacheHeader *) self->data;
+
+    flock(self->fd, LOCK_EX);
+    bool readable = ( fstat(self->fd, &st) == 0 ) && ( (size_t) st.st_size >= sizeof(WwIconCacheHeader) );
+
+    /*
+     * A rebuild replaced the file between our open() and flock()
+     * Other clients and the compositor still map this one, it must stay as is
+     */
+    if ( readable && ( self->header->magic == WW_ICON_CACHE_MAGIC ) && self->header->stale )
+    {
+        flock(self->fd, LOCK_UN);
+        munmap(self->data, WW_ICON_CACHE_RESERVE);
+        close(self->fd);
+        goto retry;
+    }
+
+    bool valid = readable
+        && ( self->header->magic == WW_ICON_CACHE_MAGIC ) && ( self->header->version == WW_ICON_CACHE_VERSION )
+        && ( self->header->bucket_count > 0 ) && ( ( self->header->bucket_count & ( self->header->bucket_count - 1 ) ) == 0 )
+        && ( _ww_icon_cache_get_index_size(self->header->bucket_count) <= self->header->size ) && ( self->header->size <= (uint64_t) st.st_size ) && ( self->header->size <= WW_ICON_CACHE_RESERVE );
+    if ( ( ! valid ) && ( ! _ww_icon_cache_init_file(self) ) )
+    {
+        ww_warning("Couldn’t initialize icon cache %s: %s", self->path, strerror(errno));
+        flock(self->fd, LOCK_UN);
+        munmap(self->data, WW_ICON_CACHE_RESERVE);
+        close(self->fd);
+        self->data = NULL;
+        return false;
+    }
+    flock(self->fd, LOCK_UN);
+
+    return true;
+}
+
+static void
+_ww_icon_cache_close(WwIconCache *self)
+{
+    WwIconCacheMapping *mapping;
+
+    mapping = ww_new0(WwIconCacheMapping, 1);
+    if ( mapping != NULL )
+    {
+        mapping->data = self->data;
+        mapping->next = self->retired;
+        self->retired = mapping;
+    }
+    else
+        munmap(self->data, WW_ICON_CACHE_RESERVE);
+    self->data = NULL;
+    self->header = NULL;
+
+    /* Buffers outlive their pool */
+    if ( self->pool != NULL )
+        wl_shm_pool_destroy(self->pool);
+    self->pool = NULL;
+    self->pool_size = 0;
+    close(self->fd);
+}
+
+static bool
+_ww_icon_cache_reopen(WwIconCache *self)
+{
+    _ww_icon_cache_close(self);
+    return _ww_icon_cache_open(self);
+}
+
+WwIconCache *
+ww_icon_cache_new(const char *path, const char *theme)
+{
+    WwIconCache *self;
+
+    self = ww_new0(WwIconCache, 1);
+    if ( self == NULL )
+        return NULL;
+
+    self->path = ( path != NULL ) ? strdup(path) : ww_desktop_get_cache_path("icons.cache");
+    if ( ( theme != NULL ) && ( strcmp(theme, "hicolor") != 0 ) )
+        self->themes[0] = strdup(theme);
+    self->themes[( self->themes[0] != NULL ) ? 1 : 0] = strdup("hicolor");
+    self->icon_dirs = ww_desktop_get_data_dirs("icons");
+    self->pixmap_dirs = ww_desktop_get_data_dirs("pixmaps");
+    self->application_dirs = ww_desktop_get_data_dirs("applications");
+    if ( ( self->path == NULL ) || ( self->icon_dirs == NULL ) || ( self->pixmap_dirs == NULL ) || ( self->application_dirs == NULL ) || ( ! _ww_icon_cache_open(self) ) )
+    {
+        ww_icon_cache_free(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+void
+ww_icon_cache_free(WwIconCache *self)
+{
+    WwIconCacheMapping *mapping, *next;
+
+    if ( self->data != NULL )
+    {
+        if ( self->pool != NULL )
+            wl_shm_pool_destroy(self->pool);
+        munmap(self->data, WW_ICON_CACHE_RESERVE);
+        close(self->fd);
+    }
+    for ( mapping = self->retired ; mapping != NULL ; mapping = next )
+    {
+        next = mapping->next;
+        munmap(mapping->data, WW_ICON_CACHE_RESERVE);
+        free(mapping);
+    }
+
+    ww_desktop_free_data_dirs(self->application_dirs);
+    ww_desktop_free_data_dirs(self->pixmap_dirs);
+    ww_desktop_free_data_dirs(self->icon_dirs);
+    free(self->themes[1]);
+    free(self->themes[0]);
+    free(self->path);
+
+    free(self);
+}
+
+static bool
+_ww_icon_cache_get_icon(WwIconCache *self, const WwIconCacheEntry *entry, WwIcon *icon)
+{
+    uint64_t start = (const uint8_t *) entry - self->data + sizeof(WwIconCacheEntry) + entry->name_length;
+
+    if ( entry->width == 0 )
+        return false;
+    if ( ! _ww_icon_cache_pixels_are_valid(entry, start, _ww_icon_cache_get_end(self->header)) )
+        return false;
+
+    icon->width = entry->width;
+    icon->height = entry->height;
+    icon->stride = entry->width * 4;
+    icon->offset = entry->pixels;
+    icon->data = self->data + entry->pixels;
+
+    return true;
+}
+
+/*
+ * Copies the indexed entries to a new file with twice the buckets,
+ * then replaces ours, other clients will notice the stale flag
+ * Called with the lock held, returns with the new file locked
+ */
+static bool
+_ww_icon_cache_rebuild(WwIconCache *self)
+{
+    WwIconCacheHeader *old = self->header, *header;
+    uint32_t bucket_count = old->bucket_count * 2, entry_count = 0, i;
+    uint64_t old_end = _ww_icon_cache_get_end(old);
+    uint64_t size = _ww_icon_cache_get_index_size(bucket_count);
+    char *path;
+    int fd;
+
+    for ( i = 0 ; i < old->bucket_count ; ++i )
+    {
+        const WwIconCacheEntry *entry = _ww_icon_cache_get_entry(old, old->buckets[i], old_end);
+        if ( entry == NULL )
+            continue;
+        size = _ww_icon_cache_align(size, 8) + sizeof(WwIconCacheEntry) + entry->name_length;
+        if ( entry->width > 0 )
+            size = _ww_icon_cache_align(size, 64) + (uint64_t) entry->width * 4 * entry->height;
+    }
+    if ( size > WW_ICON_CACHE_RESERVE )
+    {
+        errno = ENOSPC;
+        return false;
+    }
+
+    if ( asprintf(&path, "%s.XXXXXX", self->path) < 0 )
+        return false;
+    fd = mkostemp(path, O_CLOEXEC);
+    if ( fd < 0 )
+    {
+        free(path);
+        return false;
+    }
+    if ( ( fchmod(fd, 0644) < 0 ) || ( ftruncate(fd, size) < 0 ) )
+        goto fail;
+    header = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if ( header == MAP_FAILED )
+        goto fail;
+
+    header->version = WW_ICON_CACHE_VERSION;
+    header->bucket_count = bucket_count;
+    header->magic = WW_ICON_CACHE_MAGIC;
+
+    header->size = size;
+
+    uint8_t *data = (uint8_t *) header;
+    uint64_t end = _ww_icon_cache_get_index_size(bucket_count), *bucket;
+    for ( i = 0 ; i < old->bucket_count ; ++i )
+    {
+        const WwIconCacheEntry *entry = _ww_icon_cache_get_entry(old, old->buckets[i], old_end);
+        if ( entry == NULL )
+            continue;
+        uint64_t offset = _ww_icon_cache_align(end, 8);
+        WwIconCacheEntry *copy = (WwIconCacheEntry *) ( data + offset );
+
+        memcpy(copy, entry, sizeof(WwIconCacheEntry) + entry->name_length);
+        end = offset + sizeof(WwIconCacheEntry) + entry->name_length;
+        if ( entry->width > 0 )
+        {
+            copy->pixels = _ww_icon_cache_align(end, 64);
+            end = copy->pixels + (uint64_t) entry->width * 4 * entry->height;
+            memcpy(data + copy->pixels, self->data + entry->pixels, (uint64_t) entry->width * 4 * entry->height);
+        }
+
+        _ww_icon_cache_find(header, entry->hash, entry->name, entry->name_length, entry->size, &bucket);
+        *bucket = offset;
+        ++entry_count;
+    }
+    header->entry_count = entry_count;
+    munmap(header, size);
+
+    if ( rename(path, self->path) < 0 )
+        goto fail;
+    free(path);
+    close(fd);
+
+    __atomic_store_n(&old->stale, 1, __ATOMIC_RELEASE);
+    flock(self->fd, LOCK_UN);
+    if ( ! _ww_icon_cache_reopen(self) )
+        return false;
+    flock(self->fd, LOCK_EX);
+
+    return true;
+
+fail:
+    unlink(path);
+    free(path);
+    close(fd);
+    return false;
+}
+
+/*
+ * Appends an entry with room for the pixels, under the lock
+ * A previous entry for the same key is left for the next rebuild
+ */
+static WwIconCacheEntry *
+_ww_icon_cache_append(WwIconCache *self, uint32_t hash, const char *name, size_t length, int32_t size, int32_t width, int32_t height)
+{
+    uint64_t *bucket;
+    const WwIconCacheEntry *found = _ww_icon_cache_find(self->header, hash, name, length, size, &bucket);
+
+    /* A rebuild also leaves corrupted entries behind */
+    if ( ( found == NULL ) && ( ( bucket == NULL ) || ( ( self->header->entry_count + 1 ) * 4 > self->header->bucket_count * 3 ) ) )
+    {
+        if ( ! _ww_icon_cache_rebuild(self) )
+            return NULL;
+        found = _ww_icon_cache_find(self->header, hash, name, length, size, &bucket);
+    }
+    if ( bucket == NULL )
+        return NULL;
+
+    uint64_t offset = _ww_icon_cache_align(self->header->size, 8);
+    uint64_t end = offset + sizeof(WwIconCacheEntry) + length;
+    uint64_t pixels = 0;
+    if ( width > 0 )
+    {
+        pixels = _ww_icon_cache_align(end, 64);
+        end = pixels + (uint64_t) width * 4 * height;
+    }
+    if ( end > WW_ICON_CACHE_RESERVE )
+    {
+        errno = ENOSPC;
+        return NULL;
+    }
+    if ( ftruncate(self->fd, end) < 0 )
+        return NULL;
+
+    WwIconCacheEntry *entry = (WwIconCacheEntry *) ( self->data + offset );
+    entry->hash = hash;
+    entry->size = size;
+    entry->width = width;
+    entry->height = height;
+    entry->time = time(NULL);
+    entry->pixels = pixels;
+    entry->name_length = length;
+    memcpy(entry->name, name, length);
+
+    /* The caller fills the pixels before we publish */
+    return entry;
+}
+
+static void
+_ww_icon_cache_publish(WwIconCache *self, WwIconCacheEntry *entry)
+{
+    uint64_t *bucket;
+    uint64_t offset = (uint8_t *) entry - self->data;
+    uint64_t end = ( entry->width > 0 ) ? ( entry->pixels + (uint64_t) entry->width * 4 * entry->height ) : ( offset + sizeof(WwIconCacheEntry) + entry->name_length );
+
+    if ( _ww_icon_cache_find(self->header, entry->hash, entry->name, entry->name_length, entry->size, &bucket) == NULL )
+        ++self->header->entry_count;
+    if ( bucket == NULL )
+        return;
+    __atomic_store_n(&self->header->size, end, __ATOMIC_RELEASE);
+    __atomic_store_n(bucket, offset, __ATOMIC_RELEASE);
+}
+
+static void
+_ww_icon_cache_desktop_entry(void *user_data, const char *key, const char *value)
+{
+    char **icon = user_data;
+
+    if ( ( *icon == NULL ) && ( strcmp(key, "Icon") == 0 ) )
+        *icon = strdup(value);
+}
+
+/* The Icon key of <app_id>.desktop, or the app_id itself */
+static char *
+_ww_icon_cache_resolve_name(WwIconCache *self, const char *app_id)
+{
+    char *icon = NULL, *lower, *path, **dir;
+
+    lower = strdup(app_id);
+    if ( lower == NULL )
+        return NULL;
+    for ( path = lower ; *path != '\0' ; ++path )
+        *path = tolower((unsigned char) *path);
+
+    for ( dir = self->application_dirs ; ( icon == NULL ) && ( *dir != NULL ) ; ++dir )
+    {
+        if ( asprintf(&path, "%s/%s.desktop", *dir, app_id) >= 0 )
+        {
+            ww_desktop_parse(path, _ww_icon_cache_desktop_entry, &icon);
+            free(path);
+        }
+        if ( ( icon == NULL ) && ( strcmp(lower, app_id) != 0 ) && ( asprintf(&path, "%s/%s.desktop", *dir, lower) >= 0 ) )
+        {
+            ww_desktop_parse(path, _ww_icon_cache_desktop_entry, &icon);
+            free(path);
+        }
+    }
+
+    if ( ( icon == NULL ) || ( icon[0] == '\0' ) )
+    {
+        free(icon);
+        return lower;
+    }
+    free(lower);
+    return icon;
+}
+
+static char *
+_ww_icon_cache_try(char *path)
+{
+    if ( access(path, R_OK) == 0 )
+        return path;
+    free(path);
+    return NULL;
+}
+
+/*
+ * The hicolor layout, where applications install their icons
+ * Themes with another one need their index.theme, which we do not read
+ */
+static char *
+_ww_icon_cache_find_file(WwIconCache *self, const char *name, int32_t size)
+{
+    char *path = NULL, **dir;
+    size_t t, i;
+
+    if ( name[0] == '/' )
+        return _ww_icon_cache_try(strdup(name));
+
+    for ( t = 0 ; ( t < 2 ) && ( self->themes[t] != NULL ) ; ++t )
+    {
+        for ( dir = self->icon_dirs ; *dir != NULL ; ++dir )
+        {
+            if ( ( asprintf(&path, "%s/%s/%dx%d/apps/%s.png", *dir, self->themes[t], size, size, name) >= 0 ) && ( ( path = _ww_icon_cache_try(path) ) != NULL ) )
+                return path;
+            if ( ( asprintf(&path, "%s/%s/scalable/apps/%s.svg", *dir, self->themes[t], name) >= 0 ) && ( ( path = _ww_icon_cache_try(path) ) != NULL ) )
+                return path;
+        }
+        for ( i = 0 ; i < sizeof(_ww_icon_cache_sizes) / sizeof(*_ww_icon_cache_sizes) ; ++i )
+        {
+            if ( _ww_icon_cache_sizes[i] == size )
+                continue;
+            for ( dir = self->icon_dirs ; *dir != NULL ; ++dir )
+            {
+                if ( ( asprintf(&path, "%s/%s/%dx%d/apps/%s.png", *dir, self->themes[t], _ww_icon_cache_sizes[i], _ww_icon_cache_sizes[i], name) >= 0 ) && ( ( path = _ww_icon_cache_try(path) ) != NULL ) )
+                    return path;
+            }
+        }
+    }
+
+    for ( dir = self->pixmap_dirs ; *dir != NULL ; ++dir )
+    {
+        if ( ( asprintf(&path, "%s/%s.png", *dir, name) >= 0 ) && ( ( path = _ww_icon_cache_try(path) ) != NULL ) )
+            return path;
+        if ( ( asprintf(&path, "%s/%s.svg", *dir, name) >= 0 ) && ( ( path = _ww_icon_cache_try(path) ) != NULL ) )
+            return path;
+    }
+
+    return NULL;
+}
+
+#ifdef ENABLE_IMAGES
+/* SVGs are rendered straight at the size, the others scaled */
+static GdkPixbuf *
+_ww_icon_cache_load(WwIconCache *self, const char *app_id, int32_t size)
+{
+    GdkPixbuf *pixbuf = NULL;
+    char *name, *path;
+
+    name = _ww_icon_cache_resolve_name(self, app_id);
+    if ( name == NULL )
+        return NULL;
+    path = _ww_icon_cache_find_file(self, name, size);
+    free(name);
+    if ( path == NULL )
+        return NULL;
+
+    pixbuf = gdk_pixbuf_new_from_file_at_size(path, size, size, NULL);
+    free(path);
+    if ( ( pixbuf != NULL ) && ( ! gdk_pixbuf_get_has_alpha(pixbuf) ) )
+    {
+        GdkPixbuf *alpha = gdk_pixbuf_add_alpha(pixbuf, FALSE, 0, 0, 0);
+        g_object_unref(pixbuf);
+        pixbuf = alpha;
+    }
+
+    return pixbuf;
+}
+#endif /* ENABLE_IMAGES */
+
+bool
+ww_icon_cache_lookup(WwIconCache *self, const char *app_id, int32_t size, WwIcon *icon)
+{
+    size_t length = strlen(app_id);
+    uint32_t hash = _ww_icon_cache_hash(app_id, length, size);
+    const WwIconCacheEntry *found;
+    uint64_t *bucket;
+
+    if ( ( size <= 0 ) || ( size > 4096 ) )
+        return false;
+
+    if ( __atomic_load_n(&self->header->stale, __ATOMIC_ACQUIRE) && ( ! _ww_icon_cache_reopen(self) ) )
+        return false;
+
+    found = _ww_icon_cache_find(self->header, hash, app_id, length, size, &bucket);
+    if ( ( found != NULL ) && ( ( found->width > 0 ) || ( time(NULL) - found->time < WW_ICON_CACHE_MISS_TTL ) ) )
+        return _ww_icon_cache_get_icon(self, found, icon);
+
+#ifdef ENABLE_IMAGES
+    /* Decoding is the slow part, we do it before taking the lock */
+    GdkPixbuf *pixbuf = _ww_icon_cache_load(self, app_id, size);
+    int32_t width = 0, height = 0;
+    if ( pixbuf != NULL )
+    {
+        width = gdk_pixbuf_get_width(pixbuf);
+        height = gdk_pixbuf_get_height(pixbuf);
+    }
+
+    flock(self->fd, LOCK_EX);
+    while ( __atomic_load_n(&self->header->stale, __ATOMIC_ACQUIRE) )
+    {
+        flock(self->fd, LOCK_UN);
+        if ( ! _ww_icon_cache_reopen(self) )
+        {
+            if ( pixbuf != NULL )
+                g_object_unref(pixbuf);
+            return false;
+        }
+        flock(self->fd, LOCK_EX);
+    }
+
+    /* Another client may have been faster */
+    WwIconCacheEntry *entry = NULL;
+    found = _ww_icon_cache_find(self->header, hash, app_id, length, size, &bucket);
+    if ( ( found == NULL ) || ( ( found->width == 0 ) && ( time(NULL) - found->time >= WW_ICON_CACHE_MISS_TTL ) ) )
+    {
+        entry = _ww_icon_cache_append(self, hash, app_id, length, size, width, height);
+        if ( entry == NULL )
+            ww_warning("Couldn’t store icon for %s in %s: %s", app_id, self->path, strerror(errno));
+        else
+        {
+            if ( pixbuf != NULL )
+                ww_format_premultiply(self->data + entry->pixels, width, height, width * 4, gdk_pixbuf_read_pixels(pixbuf), gdk_pixbuf_get_rowstride(pixbuf));
+            _ww_icon_cache_publish(self, entry);
+        }
+        found = entry;
+    }
+    flock(self->fd, LOCK_UN);
+
+    if ( pixbuf != NULL )
+        g_object_unref(pixbuf);
+
+    return ( found != NULL ) && _ww_icon_cache_get_icon(self, found, icon);
+#else /* ! ENABLE_IMAGES */
+    /* Nothing we can decode, but other clients may */
+    return false;
+#endif /* ! ENABLE_IMAGES */
+}
+
+struct wl_buffer *
+ww_icon_cache_create_buffer(WwIconCache *self, struct wl_shm *shm, const WwIcon *icon)
+{
+    size_t size = __atomic_load_n(&self->header->size, __ATOMIC_ACQUIRE);
+
+    /* From a replaced file */
+    if ( icon->data != self->data + icon->offset )
+        return NULL;
+
+    if ( self->pool == NULL )
+    {
+        self->pool = wl_shm_create_pool(shm, self->fd, size);
+        self->pool_size = size;
+    }
+    else if ( size > self->pool_size )
+    {
+        wl_shm_pool_resize(self->pool, size);
+        self->pool_size = size;
+    }
+
+    return wl_shm_pool_create_buffer(self->pool, icon->offset, icon->width, icon->height, icon->stride, WL_SHM_FORMAT_ARGB8888);
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef __WW_ICONS_H__
+#define __WW_ICONS_H__
+
+#include "helpers.h"
+
+typedef struct _WwIconCache WwIconCache;
+
+typedef struct {
+    int32_t width;
+    int32_t height;
+    int32_t stride;
+    /* In the cache file */
+    size_t offset;
+    /* Premultiplied ARGB8888, straight from the file mapping */
+    const uint8_t *data;
+} WwIcon;
+
+/*
+ * One file shared by all our clients and mapped once: an open-addressing
+ * index on app_id and size, followed by the decoded icons
+ * path NULL is $XDG_CACHE_HOME/wayland-wall/icons.cache
+ * theme is searched before hicolor, NULL for hicolor only
+ */
+WwIconCache *ww_icon_cache_new(const char *path, const char *theme);
+void ww_icon_cache_free(WwIconCache *self);
+
+/*
+ * A hit is a hash and a compare, a miss resolves the icon through the
+ * .desktop file and decodes it to fit in size×size, then stores it
+ * Missing icons are stored too, and retried after a day
+ * Icon data stays valid until the cache is freed
+ */
+bool ww_icon_cache_lookup(WwIconCache *self, const char *app_id, int32_t size, WwIcon *icon);
+
+/* A buffer on the cache file itself, no copy */
+struct wl_buffer *ww_icon_cache_create_buffer(WwIconCache *self, struct wl_shm *shm, const WwIcon *icon);
+
+#endif /* __WW_ICONS_H__ */
@@ -0,0 +1,1033 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+#include "helpers.h"
+
+#include <inttypes.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <linux/input-event-codes.h>
+#include <xkbcommon/xkbcommon.h>
+#include <cairo.h>
+#include <pango/pango.h>
+#include <pango/pangocairo.h>
+#include "launcher-menu-unstable-v1-client-protocol.h"
+#include "client.h"
+#include "loop.h"
+#include "format.h"
+#include "stats.h"
+#include "role.h"
+#include "apps.h"
+
+/* Supported interface versions */
+#define WW_LAUNCHER_MENU_INTERFACE_VERSION 1
+
+/* In surface coordinates */
+#define WW_LAUNCHER_WIDTH 480
+#define WW_LAUNCHER_PADDING 8
+#define WW_LAUNCHER_LINES 8
+#define WW_LAUNCHER_MAX_LINES 64
+
+/* Longer queries are cut */
+#define WW_LAUNCHER_QUERY_SIZE 256
+
+/* A trigger is empty or carries its CLOCK_MONOTONIC time in µs */
+#define WW_LAUNCHER_MESSAGE_SIZE 32
+
+typedef struct _WwLauncherContext WwLauncherContext;
+
+typedef struct {
+    WwLauncherContext *context;
+    WwArenaBlock block;
+    struct wl_buffer *buffer;
+    bool released;
+    int64_t attach_time;
+} WwLauncherBuffer;
+
+struct _WwLauncherContext {
+    WwClient *client;
+    struct zww_launcher_menu_v1 *launcher_menu;
+    WwApps *apps;
+    WwColour background_colour;
+    WwColour text_colour;
+    WwColour selection_colour;
+    int32_t width;
+    int32_t lines;
+    const char *font;
+    bool timing;
+    /* Of the process, or of the trigger in resident mode */
+    int64_t start_time;
+    const char *start_name;
+    bool resident;
+    const char *socket_path;
+    bool trigger;
+    int socket_fd;
+    WwLoopSource *socket_source;
+    unsigned long bench;
+    char query[WW_LAUNCHER_QUERY_SIZE];
+    size_t query_length;
+    size_t matches[WW_LAUNCHER_MAX_LINES];
+    size_t match_count;
+    size_t selected;
+    PangoContext *pango_context;
+    PangoFontDescription *font_description;
+    PangoLayout *layout;
+    int32_t line_height;
+    int32_t height;
+    struct wl_surface *surface;
+    struct wl_callback *frame;
+    /* One on screen, one to draw the next keystroke in */
+    WwLauncherBuffer buffers[2];
+    /* Attached but not committed yet, the compositor never saw it */
+    WwLauncherBuffer *pending;
+    bool shown;
+    bool dirty;
+};
+
+static WwFormat
+_ww_launcher_get_format(WwLauncherContext *self)
+{
+    return ( self->background_colour.a < 1.0 ) ? WW_FORMAT_ARGB8888 : WW_FORMAT_XRGB8888;
+}
+
+static void
+_ww_launcher_update(WwLauncherContext *self)
+{
+    self->match_count = ww_apps_match(self->apps, self->query, self->matches, self->lines);
+    self->selected = 0;
+}
+
+static void
+_ww_launcher_paint(WwLauncherContext *self, uint8_t *data)
+{
+    WwFormat format = _ww_launcher_get_format(self);
+    cairo_surface_t *surface;
+    cairo_t *cr;
+    char line[WW_LAUNCHER_QUERY_SIZE + 8];
+    size_t i;
+
+    surface = cairo_image_surface_create_for_data(data, ( format == WW_FORMAT_ARGB8888 ) ? CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24, self->width, self->height, ww_format_get_stride(format, self->width));
+    cr = cairo_create(surface);
+
+    cairo_set_source_rgba(cr, self->background_colour.r, self->background_colour.g, self->background_colour.b, self->background_colour.a);
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    cairo_paint(cr);
+    cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+
+    snprintf(line, sizeof(line), "> %s", self->query);
+    pango_layout_set_text(self->layout, line, -1);
+    cairo_set_source_rgba(cr, self->text_colour.r, self->text_colour.g, self->text_colour.b, self->text_colour.a);
+    cairo_move_to(cr, WW_LAUNCHER_PADDING, WW_LAUNCHER_PADDING);
+    pango_cairo_show_layout(cr, self->layout);
+
+    for ( i = 0 ; i < self->match_count ; ++i )
+    {
+        int32_t y = WW_LAUNCHER_PADDING + ( i + 1 ) * self->line_height;
+        WwApp app;
+
+        if ( i == self->selected )
+        {
+            cairo_set_source_rgba(cr, self->selection_colour.r, self->selection_colour.g, self->selection_colour.b, self->selection_colour.a);
+            cairo_rectangle(cr, 0, y, self->width, self->line_height);
+            cairo_fill(cr);
+        }
+
+        ww_apps_get(self->apps, self->matches[i], &app);
+        pango_layout_set_text(self->layout, app.name, -1);
+        cairo_set_source_rgba(cr, self->text_colour.r, self->text_colour.g, self->text_colour.b, self->text_colour.a);
+        cairo_move_to(cr, WW_LAUNCHER_PADDING, y);
+        pango_cairo_show_layout(cr, self->layout);
+    }
+
+    cairo_destroy(cr);
+    cairo_surface_destroy(surface);
+}
+
+static void _ww_launcher_redraw(WwLauncherContext *self);
+
+static void
+_ww_launcher_buffer_release(void *data, struct wl_buffer *buffer)
+{
+    WwLauncherBuffer *self = data;
+
+    self->released = true;
+    ww_stats_buffer_released(self->attach_time);
+
+    /* We were waiting for this buffer */
+    if ( self->context->dirty && ( self->context->frame == NULL ) )
+    {
+        self->context->dirty = false;
+        _ww_launcher_redraw(self->context);
+    }
+}
+
+static const struct wl_buffer_listener _ww_launcher_buffer_listener = {
+    _ww_launcher_buffer_release
+};
+
+static WwLauncherBuffer *
+_ww_launcher_get_buffer(WwLauncherContext *self)
+{
+    WwFormat format = _ww_launcher_get_format(self);
+    int32_t stride = ww_format_get_stride(format, self->width);
+    size_t i;
+
+    for ( i = 0 ; i < sizeof(self->buffers) / sizeof(*self->buffers) ; ++i )
+    {
+        WwLauncherBuffer *buffer = &self->buffers[i];
+
+        if ( buffer->buffer != NULL )
+        {
+            if ( buffer->released || ( buffer == self->pending ) )
+                return buffer;
+            continue;
+        }
+
+        if ( ! ww_client_shm_alloc(self->client, (size_t) stride * self->height, &buffer->block) )
+            return NULL;
+        buffer->buffer = ww_arena_create_buffer(self->client->arena, &buffer->block, 0, self->width, self->height, stride, ww_format_get_info(format)->shm_format, NULL);
+        if ( buffer->buffer == NULL )
+        {
+            ww_client_shm_release(self->client, &buffer->block);
+            return NULL;
+        }
+        wl_buffer_add_listener(buffer->buffer, &_ww_launcher_buffer_listener, buffer);
+        ww_stats_add(WW_STATS_BUFFERS_CREATED, 1);
+        buffer->context = self;
+        buffer->released = true;
+        return buffer;
+    }
+
+    return NULL;
+}
+
+/* Attaches a new frame, without committing it */
+static bool
+_ww_launcher_draw(WwLauncherContext *self)
+{
+    WwLauncherBuffer *buffer;
+
+    buffer = _ww_launcher_get_buffer(self);
+    if ( buffer == NULL )
+    {
+        /* Both are held, redrawn on the next frame */
+        ww_stats_add(WW_STATS_SKIPPED_DRAWS, 1);
+        self->dirty = true;
+        return false;
+    }
+    ww_stats_add(WW_STATS_DRAWS, 1);
+
+    _ww_launcher_paint(self, buffer->block.data);
+
+    wl_surface_attach(self->surface, buffer->buffer, 0, 0);
+    wl_surface_damage(self->surface, 0, 0, INT32_MAX, INT32_MAX);
+
+    if ( buffer != self->pending )
+        ww_stats_add(WW_STATS_BUFFERS_HELD, 1);
+    buffer->released = false;
+    buffer->attach_time = ww_stats_now();
+    self->pending = buffer;
+    return true;
+}
+
+static void
+_ww_launcher_frame(void *data, struct wl_callback *callback, uint32_t time)
+{
+    WwLauncherContext *self = data;
+
+    wl_callback_destroy(self->frame);
+    self->frame = NULL;
+
+    if ( self->timing && ( self->start_time > 0 ) )
+    {
+        printf("First frame presented %" PRId64 " µs after %s\n", ww_stats_now() - self->start_time, self->start_name);
+        fflush(stdout);
+        self->start_time = 0;
+    }
+
+    if ( ! self->dirty )
+        return;
+    self->dirty = false;
+    _ww_launcher_redraw(self);
+}
+
+static const struct wl_callback_listener _ww_launcher_frame_listener = {
+    .done = _ww_launcher_frame,
+};
+
+static void
+_ww_launcher_commit(WwLauncherContext *self)
+{
+    self->frame = wl_surface_frame(self->surface);
+    wl_callback_add_listener(self->frame, &_ww_launcher_frame_listener, self);
+    wl_surface_commit(self->surface);
+    ww_stats_committed();
+    self->pending = NULL;
+}
+
+/* At most once per frame, keystrokes in between are coalesced */
+static void
+_ww_launcher_redraw(WwLauncherContext *self)
+{
+    if ( self->surface == NULL )
+        return;
+    if ( ! self->shown )
+    {
+        /* The ready frame, replaced in place until shown */
+        if ( _ww_launcher_draw(self) )
+            self->dirty = false;
+        return;
+    }
+    if ( self->frame != NULL )
+    {
+        self->dirty = true;
+        return;
+    }
+
+    if ( _ww_launcher_draw(self) )
+        _ww_launcher_commit(self);
+}
+
+/* A new surface with the idle frame attached, for the next trigger to only commit */
+static void
+_ww_launcher_prepare(WwLauncherContext *self)
+{
+    self->query[0] = '\0';
+    self->query_length = 0;
+    _ww_launcher_update(self);
+
+    self->surface = wl_compositor_create_surface(self->client->compositor);
+    self->shown = false;
+    _ww_launcher_redraw(self);
+}
+
+/* The surface cannot be shown again, only destroyed */
+static void
+_ww_launcher_hide(WwLauncherContext *self)
+{
+    if ( self->frame != NULL )
+        wl_callback_destroy(self->frame);
+    self->frame = NULL;
+    if ( self->surface != NULL )
+        wl_surface_destroy(self->surface);
+    self->surface = NULL;
+    self->shown = false;
+    self->pending = NULL;
+    self->dirty = false;
+
+    if ( self->resident )
+        _ww_launcher_prepare(self);
+    else
+        ww_loop_quit(self->client->loop);
+}
+
+static void
+_ww_launcher_show(WwLauncherContext *self)
+{
+    WwClientSeat *seat, *pointer_seat = NULL;
+
+    if ( self->surface == NULL )
+        _ww_launcher_prepare(self);
+    if ( self->pending == NULL )
+        ww_warning("Couldn’t draw the first frame, showing an empty launcher");
+
+    /*
+     * A serial only comes with an event on one of our surfaces, and must be the
+     * seat’s last one: a resident instance cannot know that its serial still is
+     */
+    if ( ! self->resident )
+    {
+        wl_list_for_each(seat, &self->client->seats, link)
+        {
+            if ( ( seat->pointer != NULL ) && ( seat->pointer_serial != 0 ) )
+                pointer_seat = seat;
+        }
+    }
+    if ( pointer_seat != NULL )
+        zww_launcher_menu_v1_show_at_pointer(self->launcher_menu, self->surface, pointer_seat->seat, pointer_seat->pointer_serial);
+    else
+        zww_launcher_menu_v1_show(self->launcher_menu, self->surface);
+
+    self->shown = true;
+    _ww_launcher_commit(self);
+    wl_display_flush(self->client->display);
+
+    if ( self->timing )
+    {
+        printf("First frame committed %" PRId64 " µs after %s\n", ww_stats_now() - self->start_time, self->start_name);
+        fflush(stdout);
+    }
+}
+
+static void
+_ww_launcher_launch(WwLauncherContext *self, size_t index)
+{
+    if ( index >= self->match_count )
+        return;
+
+    ww_apps_launch(self->apps, self->matches[index]);
+    _ww_launcher_hide(self);
+}
+
+static void
+_ww_launcher_dismiss(void *data, struct zww_launcher_menu_v1 *launcher_menu)
+{
+    WwLauncherContext *self = data;
+
+    _ww_launcher_hide(self);
+}
+
+static const struct zww_launcher_menu_v1_listener _ww_launcher_launcher_menu_listener = {
+    .dismiss = _ww_launcher_dismiss,
+};
+
+static void
+_ww_launcher_launcher_menu_bound(void *user_data, void *proxy)
+{
+    zww_launcher_menu_v1_add_listener(proxy, &_ww_launcher_launcher_menu_listener, user_data);
+}
+
+static const WwClientGlobal _ww_launcher_globals[] = {
+    { &zww_launcher_menu_v1_interface, WW_LAUNCHER_MENU_INTERFACE_VERSION, offsetof(WwLauncherContext, launcher_menu), (WwClientProxyDestroyFunc) zww_launcher_menu_v1_destroy, _ww_launcher_launcher_menu_bound, false },
+};
+
+static bool
+_ww_launcher_get_address(WwLauncherContext *self, const char *runtime_dir, struct sockaddr_un *address)
+{
+    char path[PATH_MAX];
+    int length;
+
+    if ( self->socket_path == NULL )
+    {
+        if ( runtime_dir == NULL )
+        {
+            errno = ENOENT;
+            return false;
+        }
+        snprintf(path, PATH_MAX, "%s/launcher.sock", runtime_dir);
+    }
+
+    address->sun_family = AF_UNIX;
+    length = snprintf(address->sun_path, sizeof(address->sun_path), "%s", ( self->socket_path != NULL ) ? self->socket_path : path);
+    if ( (size_t) length >= sizeof(address->sun_path) )
+    {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    return true;
+}
+
+/* Each trigger toggles the launcher */
+static void
+_ww_launcher_receive(void *user_data, uint32_t events)
+{
+    WwLauncherContext *self = user_data;
+    char message[WW_LAUNCHER_MESSAGE_SIZE + 1];
+    ssize_t length;
+
+    while ( ( length = recv(self->socket_fd, message, WW_LAUNCHER_MESSAGE_SIZE, MSG_DONTWAIT) ) >= 0 )
+    {
+        if ( self->shown )
+        {
+            _ww_launcher_hide(self);
+            continue;
+        }
+
+        char *e;
+        message[length] = '\0';
+        self->start_time = strtoll(message, &e, 10);
+        if ( ( e == message ) || ( self->start_time <= 0 ) )
+            self->start_time = ww_stats_now();
+        self->start_name = "trigger";
+        _ww_launcher_show(self);
+    }
+}
+
+static bool
+_ww_launcher_socket_init(WwLauncherContext *self)
+{
+    struct sockaddr_un address;
+
+    if ( ! _ww_launcher_get_address(self, self->client->runtime_dir, &address) )
+        return false;
+
+    self->socket_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if ( self->socket_fd < 0 )
+        return false;
+
+    unlink(address.sun_path);
+    if ( bind(self->socket_fd, (struct sockaddr *) &address, sizeof(address)) < 0 )
+        return false;
+
+    self->socket_source = ww_loop_add_fd(self->client->loop, self->socket_fd, EPOLLIN, _ww_launcher_receive, self);
+    return ( self->socket_source != NULL );
+}
+
+/* Sends the trigger time, so that a resident instance can time itself */
+static int
+_ww_launcher_trigger_run(WwLauncherContext *self)
+{
+    struct sockaddr_un address;
+    char runtime_dir[PATH_MAX];
+    char message[WW_LAUNCHER_MESSAGE_SIZE];
+    const char *xdg_runtime_dir = getenv("XDG_RUNTIME_DIR");
+    int fd, length;
+
+    if ( xdg_runtime_dir != NULL )
+        snprintf(runtime_dir, PATH_MAX, "%s/" PACKAGE_NAME, xdg_runtime_dir);
+    if ( ! _ww_launcher_get_address(self, ( xdg_runtime_dir != NULL ) ? runtime_dir : NULL, &address) )
+    {
+        ww_warning("No socket to send to: %s", strerror(errno));
+        return 1;
+    }
+
+    fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if ( fd < 0 )
+        return 2;
+
+    length = snprintf(message, sizeof(message), "%" PRId64, ww_stats_now());
+    if ( sendto(fd, message, length, 0, (struct sockaddr *) &address, sizeof(address)) < 0 )
+    {
+        ww_warning("Couldn’t trigger %s: %s", address.sun_path, strerror(errno));
+        close(fd);
+        return 2;
+    }
+    close(fd);
+
+    return 0;
+}
+
+static void
+_ww_launcher_pointer_button(void *user_data, WwClientSeat *seat, struct wl_surface *surface, uint32_t button)
+{
+    WwLauncherContext *self = user_data;
+
+    if ( ( surface == NULL ) || ( surface != self->surface ) || ( button != BTN_LEFT ) )
+        return;
+
+    int32_t line = ( (int32_t) seat->pointer_y - WW_LAUNCHER_PADDING ) / self->line_height;
+    if ( line > 0 )
+        _ww_launcher_launch(self, line - 1);
+}
+
+static void
+_ww_launcher_keyboard_key(void *user_data, WwClientSeat *seat, struct wl_surface *surface, uint32_t keysym, const char *text)
+{
+    WwLauncherContext *self = user_data;
+
+    if ( ( surface == NULL ) || ( surface != self->surface ) )
+        return;
+
+    switch ( keysym )
+    {
+    case XKB_KEY_Escape:
+        _ww_launcher_hide(self);
+        return;
+    case XKB_KEY_Return:
+    case XKB_KEY_KP_Enter:
+        _ww_launcher_launch(self, self->selected);
+        return;
+    case XKB_KEY_Up:
+        if ( self->selected == 0 )
+            return;
+        --self->selected;
+    break;
+    case XKB_KEY_Down:
+    case XKB_KEY_Tab:
+        if ( self->selected + 1 >= self->match_count )
+            return;
+        ++self->selected;
+    break;
+    case XKB_KEY_BackSpace:
+        if ( self->query_length == 0 )
+            return;
+        /* A whole UTF-8 character */
+        while ( ( self->query_length > 0 ) && ( ( self->query[--self->query_length] & 0xc0 ) == 0x80 ) );
+        self->query[self->query_length] = '\0';
+        _ww_launcher_update(self);
+    break;
+    default:
+    {
+        size_t length = strlen(text);
+        if ( ( length == 0 ) || ( (unsigned char) text[0] < 0x20 ) || ( text[0] == 0x7f ) || ( self->query_length + length >= sizeof(self->query) ) )
+            return;
+        memcpy(self->query + self->query_length, text, length + 1);
+        self->query_length += length;
+        _ww_launcher_update(self);
+    }
+    break;
+    }
+
+    _ww_launcher_redraw(self);
+}
+
+static const WwClientListener _ww_launcher_client_listener = {
+    .pointer_button = _ww_launcher_pointer_button,
+    .keyboard_key = _ww_launcher_keyboard_key,
+};
+
+static void
+_ww_launcher_apps_changed(void *user_data)
+{
+    WwLauncherContext *self = user_data;
+
+    _ww_launcher_update(self);
+    _ww_launcher_redraw(self);
+}
+
+static bool
+_ww_launcher_text_init(WwLauncherContext *self)
+{
+    self->pango_context = pango_context_new();
+    pango_context_set_font_map(self->pango_context, pango_cairo_font_map_get_default());
+    self->font_description = pango_font_description_from_string(self->font);
+    self->layout = pango_layout_new(self->pango_context);
+    if ( ( self->font_description == NULL ) || ( self->layout == NULL ) )
+        return false;
+
+    pango_layout_set_font_description(self->layout, self->font_description);
+    pango_layout_set_width(self->layout, ( self->width - 2 * WW_LAUNCHER_PADDING ) * PANGO_SCALE);
+    pango_layout_set_ellipsize(self->layout, PANGO_ELLIPSIZE_END);
+
+    pango_layout_set_text(self->layout, "Ag", -1);
+    pango_layout_get_pixel_size(self->layout, NULL, &self->line_height);
+    self->line_height = MAX(self->line_height, 1);
+    self->height = ( self->lines + 1 ) * self->line_height + 2 * WW_LAUNCHER_PADDING;
+
+    return true;
+}
+
+static const char * const _ww_launcher_bench_words[] = {
+    "text", "editor", "image", "viewer", "music", "player", "terminal", "mail",
+    "web", "browser", "office", "writer", "system", "monitor", "file", "manager",
+    "video", "chat", "photo", "paint", "archive", "disk", "network", "settings",
+};
+
+static const char * const _ww_launcher_bench_queries[] = {
+    "terminal",
+    "image viewer",
+    "wrtr",
+    "zzz",
+};
+
+static int
+_ww_launcher_bench_compare(const void *a_, const void *b_)
+{
+    const int64_t *a = a_, *b = b_;
+    return ( *a > *b ) - ( *a < *b );
+}
+
+static bool
+_ww_launcher_bench_write(const char *dir, unsigned long i, unsigned int *seed)
+{
+    size_t word_count = sizeof(_ww_launcher_bench_words) / sizeof(*_ww_launcher_bench_words);
+    char path[PATH_MAX];
+    FILE *f;
+
+    snprintf(path, sizeof(path), "%s/org.example.App%lu.desktop", dir, i);
+    f = fopen(path, "we");
+    if ( f == NULL )
+        return false;
+    fprintf(f, "[Desktop Entry]\nType=Application\nName=%s %s %lu\nGenericName=%s %s\nKeywords=%s;%s;\nExec=app%lu %%U\nIcon=app%lu\n",
+        _ww_launcher_bench_words[rand_r(seed) % word_count], _ww_launcher_bench_words[rand_r(seed) % word_count], i,
+        _ww_launcher_bench_words[rand_r(seed) % word_count], _ww_launcher_bench_words[rand_r(seed) % word_count],
+        _ww_launcher_bench_words[rand_r(seed) % word_count], _ww_launcher_bench_words[rand_r(seed) % word_count],
+        i, i);
+    return ( fclose(f) == 0 );
+}
+
+static int64_t
+_ww_launcher_bench_open(WwLauncherContext *self, const char * const *dirs, const char *index)
+{
+    int64_t start = ww_stats_now();
+
+    ww_apps_free(self->apps);
+    self->apps = ww_apps_new(dirs, index, NULL, NULL, NULL);
+    return ( self->apps != NULL ) ? ww_stats_now() - start : -1;
+}
+
+/*
+ * Synthetic .desktop files in a temporary directory:
+ * the index build, the open with an index, typing, and the first frame
+ * in memory, which is all a trigger costs us before the compositor
+ */
+static int
+_ww_launcher_bench_run(WwLauncherContext *self)
+{
+    char root[] = "/tmp/ww-launcher-bench-XXXXXX";
+    char dir[PATH_MAX], index[PATH_MAX], path[PATH_MAX];
+    const char *dirs[] = { dir, NULL };
+    unsigned int seed = 1;
+    int64_t elapsed;
+    uint8_t *data = NULL;
+    size_t q, k;
+    unsigned long i;
+    int status = 2;
+
+    if ( mkdtemp(root) == NULL )
+        return 2;
+    /* Writing the index must not change the scanned directory */
+    snprintf(dir, sizeof(dir), "%s/applications", root);
+    snprintf(index, sizeof(index), "%s/apps.index", root);
+    if ( mkdir(dir, 0700) < 0 )
+        goto out;
+
+    for ( i = 0 ; i < self->bench ; ++i )
+    {
+        if ( ! _ww_launcher_bench_write(dir, i, &seed) )
+            goto out;
+    }
+
+    elapsed = _ww_launcher_bench_open(self, dirs, index);
+    if ( elapsed < 0 )
+        goto out;
+    printf("%zu apps indexed in %" PRId64 " µs\n", ww_apps_get_count(self->apps), elapsed);
+
+    elapsed = _ww_launcher_bench_open(self, dirs, index);
+    if ( elapsed < 0 )
+        goto out;
+    printf("Index opened in %" PRId64 " µs\n", elapsed);
+    int64_t open_time = elapsed;
+
+    /* Edited in place, the directory does not change */
+    if ( ! _ww_launcher_bench_write(dir, 0, &seed) )
+        goto out;
+    elapsed = _ww_launcher_bench_open(self, dirs, index);
+    if ( elapsed < 0 )
+        goto out;
+    printf("Index updated for one changed file in %" PRId64 " µs\n", elapsed);
+
+    for ( q = 0 ; q < sizeof(_ww_launcher_bench_queries) / sizeof(*_ww_launcher_bench_queries) ; ++q )
+    {
+        const char *query = _ww_launcher_bench_queries[q];
+        size_t length = strlen(query);
+        int64_t times[WW_LAUNCHER_QUERY_SIZE];
+
+        for ( k = 0 ; k < length ; ++k )
+        {
+            memcpy(self->query, query, k + 1);
+            self->query[k + 1] = '\0';
+            int64_t start = ww_stats_now();
+            _ww_launcher_update(self);
+            times[k] = ww_stats_now() - start;
+        }
+        qsort(times, length, sizeof(*times), _ww_launcher_bench_compare);
+        printf("“%s”: %zu keystrokes, median %" PRId64 " µs, max %" PRId64 " µs, %zu results\n", query, length, times[length / 2], times[length - 1], self->match_count);
+    }
+
+    data = malloc((size_t) ww_format_get_stride(_ww_launcher_get_format(self), self->width) * self->height);
+    if ( data == NULL )
+        goto out;
+    self->query[0] = '\0';
+    int64_t start = ww_stats_now();
+    _ww_launcher_update(self);
+    _ww_launcher_paint(self, data);
+    elapsed = ww_stats_now() - start;
+    printf("First frame painted in %" PRId64 " µs, %" PRId64 " µs from an index open\n", elapsed, elapsed + open_time);
+    int64_t cold_time = elapsed + open_time;
+
+    /* A resident instance has this frame ready, a trigger only costs the datagram */
+    int fds[2];
+    if ( socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, fds) < 0 )
+        goto out;
+    int64_t times[WW_LAUNCHER_QUERY_SIZE];
+    for ( k = 0 ; k < WW_LAUNCHER_QUERY_SIZE ; ++k )
+    {
+        char message[WW_LAUNCHER_MESSAGE_SIZE + 1];
+        int length = snprintf(message, sizeof(message), "%" PRId64, ww_stats_now());
+        if ( ( send(fds[0], message, length, 0) < 0 ) || ( ( length = recv(fds[1], message, WW_LAUNCHER_MESSAGE_SIZE, 0) ) < 0 ) )
+            break;
+        message[length] = '\0';
+        times[k] = ww_stats_now() - strtoll(message, NULL, 10);
+    }
+    close(fds[1]);
+    close(fds[0]);
+    if ( k == WW_LAUNCHER_QUERY_SIZE )
+    {
+        qsort(times, k, sizeof(*times), _ww_launcher_bench_compare);
+        printf("Resident trigger received in median %" PRId64 " µs, max %" PRId64 " µs, against %" PRId64 " µs for a cold start before connecting\n", times[k / 2], times[k - 1], cold_time);
+    }
+
+    status = 0;
+
+out:
+    free(data);
+    ww_apps_free(self->apps);
+    self->apps = NULL;
+    for ( i = 0 ; i < self->bench ; ++i )
+    {
+        snprintf(path, sizeof(path), "%s/org.example.App%lu.desktop", dir, i);
+        unlink(path);
+    }
+    unlink(index);
+    rmdir(dir);
+    rmdir(root);
+    return status;
+}
+
+enum {
+    WW_LAUNCHER_OPTION_TIMING = 256,
+    WW_LAUNCHER_OPTION_TRIGGER,
+    WW_LAUNCHER_OPTION_BENCH,
+};
+
+static const struct option _ww_launcher_options[] = {
+    { "background", required_argument, NULL, 'b' },
+    { "text", required_argument, NULL, 't' },
+    { "selection", required_argument, NULL, 's' },
+    { "width", required_argument, NULL, 'w' },
+    { "lines", required_argument, NULL, 'l' },
+    { "font", required_argument, NULL, 'f' },
+    { "resident", no_argument, NULL, 'r' },
+    { "socket", required_argument, NULL, 'S' },
+    { "timing", no_argument, NULL, WW_LAUNCHER_OPTION_TIMING },
+    { "trigger", no_argument, NULL, WW_LAUNCHER_OPTION_TRIGGER },
+    { "bench", required_argument, NULL, WW_LAUNCHER_OPTION_BENCH },
+    { NULL, 0, NULL, 0 },
+};
+
+static void *
+_ww_launcher_role_init(int argc, char *argv[], int *status)
+{
+    WwLauncherContext *self;
+
+    self = ww_new0(WwLauncherContext, 1);
+    if ( self == NULL )
+    {
+        *status = 2;
+        return NULL;
+    }
+
+    self->start_time = ww_stats_now();
+    self->start_name = "start";
+    self->socket_fd = -1;
+#ifdef WW_SHELL
+    /* Hiding must not end the other roles */
+    self->resident = true;
+#endif /* WW_SHELL */
+    self->width = WW_LAUNCHER_WIDTH;
+    self->lines = WW_LAUNCHER_LINES;
+    self->font = "Sans 12";
+    self->background_colour.r = 0.1;
+    self->background_colour.g = 0.1;
+    self->background_colour.b = 0.1;
+    self->background_colour.a = 1.0;
+    self->text_colour.r = 1.0;
+    self->text_colour.g = 1.0;
+    self->text_colour.b = 1.0;
+    self->text_colour.a = 1.0;
+    self->selection_colour.r = 0.2;
+    self->selection_colour.g = 0.4;
+    self->selection_colour.b = 0.8;
+    self->selection_colour.a = 1.0;
+
+    int arg;
+    while ( ( arg = getopt_long(argc, argv, "b:t:s:w:l:f:rS:", _ww_launcher_options, NULL) ) != -1 )
+    {
+        bool good = false;
+        switch ( arg )
+        {
+        case 'b':
+            if ( _ww_parse_colour(optarg, &self->background_colour) )
+                good = true;
+        break;
+        case 't':
+            if ( _ww_parse_colour(optarg, &self->text_colour) )
+                good = true;
+        break;
+        case 's':
+            if ( _ww_parse_colour(optarg, &self->selection_colour) )
+                good = true;
+        break;
+        case 'w':
+        {
+            char *e;
+            errno = 0;
+            self->width = strtol(optarg, &e, 10);
+            if ( ( e != optarg ) && ( errno == 0 ) && ( self->width > 2 * WW_LAUNCHER_PADDING ) )
+                good = true;
+        }
+        break;
+        case 'l':
+        {
+            char *e;
+            errno = 0;
+            self->lines = strtol(optarg, &e, 10);
+            if ( ( e != optarg ) && ( errno == 0 ) && ( self->lines > 0 ) && ( self->lines <= WW_LAUNCHER_MAX_LINES ) )
+                good = true;
+        }
+        break;
+        case 'f':
+            self->font = optarg;
+            good = true;
+        break;
+        case 'r':
+            self->resident = true;
+            good = true;
+        break;
+        case 'S':
+            self->socket_path = optarg;
+            good = true;
+        break;
+        case WW_LAUNCHER_OPTION_TIMING:
+            self->timing = true;
+            good = true;
+        break;
+        case WW_LAUNCHER_OPTION_TRIGGER:
+            self->trigger = true;
+            good = true;
+        break;
+        case WW_LAUNCHER_OPTION_BENCH:
+        {
+            char *e;
+            errno = 0;
+            self->bench = strtoul(optarg, &e, 10);
+            if ( ( e != optarg ) && ( errno == 0 ) && ( self->bench > 0 ) )
+                good = true;
+        }
+        break;
+        default:
+        break;
+        }
+        if ( ! good )
+        {
+            fprintf(stderr, ""
+                "Usage:"
+                "\n    %s [OPTION...] - Demo client for Wayland Wall launcher menu protocol"
+                "\n"
+                "\nOptions:"
+                "\n    -b, --background <colour>  Background colour, defaults to #1A1A1A"
+                "\n    -t, --text <colour>        Text colour, defaults to #FFFFFF"
+                "\n    -s, --selection <colour>   Selected line colour, defaults to #3366CC"
+                "\n    -w, --width <width>        Width of the launcher, defaults to %d"
+                "\n    -l, --lines <lines>        Matches shown, defaults to %d, at most %d"
+                "\n    -f, --font <font>          Pango font description, defaults to “Sans 12”"
+                "\n    -r, --resident             Stay connected with a frame ready, shown on each trigger"
+                "\n    -S, --socket <socket>      Socket to receive triggers on, defaults to launcher.sock in the runtime directory"
+                "\n    --timing                   Print the time from start, or trigger, to the first frame"
+                "\n"
+                "\nAgainst a resident instance:"
+                "\n    --trigger                  Show it, or hide it if shown"
+                "\n"
+                "\nWithout a compositor:"
+                "\n    --bench <count>            Time the index, matching and a trigger with count synthetic applications"
+                "\n"
+                "\nApplications are indexed in $XDG_CACHE_HOME/" PACKAGE_NAME "/apps.index"
+                "\nType to match their name, generic name and keywords, all the words must match"
+                "\n\n", argv[0], WW_LAUNCHER_WIDTH, WW_LAUNCHER_LINES, WW_LAUNCHER_MAX_LINES);
+            *status = 3;
+            return NULL;
+        }
+    }
+
+    if ( self->trigger )
+    {
+        *status = _ww_launcher_trigger_run(self);
+        free(self);
+        return NULL;
+    }
+
+    if ( ! _ww_launcher_text_init(self) )
+    {
+        *status = 2;
+        return NULL;
+    }
+
+    if ( self->bench > 0 )
+    {
+        *status = _ww_launcher_bench_run(self);
+        free(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+static bool
+_ww_launcher_role_attach(void *data, WwClient *client)
+{
+    WwLauncherContext *self = data;
+
+    self->client = client;
+
+    /* Read while we connect, most of the time straight from the index */
+    self->apps = ww_apps_new(NULL, NULL, self->client->loop, _ww_launcher_apps_changed, self);
+    if ( self->apps == NULL )
+    {
+        ww_warning("Couldn’t index applications: %s", strerror(errno));
+        return false;
+    }
+    _ww_launcher_update(self);
+
+    if ( self->resident && ( ! _ww_launcher_socket_init(self) ) )
+    {
+        ww_warning("Couldn’t create trigger socket: %s", strerror(errno));
+        return false;
+    }
+
+    if ( ! ww_client_add_globals(self->client, _ww_launcher_globals, sizeof(_ww_launcher_globals) / sizeof(*_ww_launcher_globals), self) )
+        return false;
+    return ww_client_add_listener(self->client, &_ww_launcher_client_listener, self);
+}
+
+static int
+_ww_launcher_role_start(void *data)
+{
+    WwLauncherContext *self = data;
+
+    if ( self->client->shm == NULL )
+    {
+        ww_warning("No wl_shm interface provided by the compositor");
+        return 4;
+    }
+    if ( self->launcher_menu == NULL )
+    {
+        ww_warning("No ww_launcher_menu interface provided by the compositor");
+        return 4;
+    }
+
+    if ( self->resident )
+        _ww_launcher_prepare(self);
+    else
+        _ww_launcher_show(self);
+
+    return 0;
+}
+
+const WwRole ww_launcher_role = {
+    .name = "launcher",
+    .init = _ww_launcher_role_init,
+    .attach = _ww_launcher_role_attach,
+    .start = _ww_launcher_role_start,
+};
+
+#ifndef WW_SHELL
+int
+main(int argc, char *argv[])
+{
+    WwRoleInstance instance = { &ww_launcher_role, argc, argv, NULL };
+    return ww_role_run("ww-launcher", &instance, 1);
+}
+#endif /* ! WW_SHELL */
@@ -0,0 +1,228 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "helpers.h"
+
+#include <sys/epoll.h>
+
+#include "loop.h"
+
+#define WW_LOOP_MAX_EVENTS 16
+
+struct _WwLoopSource {
+    WwLoop *loop;
+    struct wl_list link;
+    int fd;
+    WwLoopCallback callback;
+    void *user_data;
+    bool removed;
+};
+
+struct _WwLoop {
+    struct wl_display *display;
+    int epoll_fd;
+    struct wl_list sources;
+    bool dispatching;
+    bool quit;
+};
+
+WwLoop *
+ww_loop_new(struct wl_display *display)
+{
+    WwLoop *self;
+
+    self = ww_new0(WwLoop, 1);
+    if ( self == NULL )
+        return NULL;
+
+    self->display = display;
+    wl_list_init(&self->sources);
+
+    self->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if ( self->epoll_fd < 0 )
+    {
+        ww_warning("Couldn’t create epoll fd: %s", strerror(errno));
+        free(self);
+        return NULL;
+    }
+
+    struct epoll_event event = {
+        .events = EPOLLIN,
+        .data.ptr = NULL,
+    };
+    if ( epoll_ctl(self->epoll_fd, EPOLL_CTL_ADD, wl_display_get_fd(self->display), &event) < 0 )
+    {
+        ww_warning("Couldn’t watch display fd: %s", strerror(errno));
+        close(self->epoll_fd);
+        free(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+static void
+_ww_loop_source_destroy(WwLoopSource *self)
+{
+    wl_list_remove(&self->link);
+    free(self);
+}
+
+void
+ww_loop_free(WwLoop *self)
+{
+    WwLoopSource *source, *tmp;
+    wl_list_for_each_safe(source, tmp, &self->sources, link)
+        _ww_loop_source_destroy(source);
+
+    close(self->epoll_fd);
+    free(self);
+}
+
+WwLoopSource *
+ww_loop_add_fd(WwLoop *self, int fd, uint32_t events, WwLoopCallback callback, void *user_data)
+{
+    WwLoopSource *source;
+
+    source = ww_new0(WwLoopSource, 1);
+    if ( source == NULL )
+        return NULL;
+
+    source->loop = self;
+    source->fd = fd;
+    source->callback = callback;
+    source->user_data = user_data;
+
+    struct epoll_event event = {
+        .events = events,
+        .data.ptr = source,
+    };
+    if ( epoll_ctl(self->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0 )
+    {
+        ww_warning("Couldn’t watch fd %d: %s", fd, strerror(errno));
+        free(source);
+        return NULL;
+    }
+
+    wl_list_insert(&self->sources, &source->link);
+
+    return source;
+}
+
+void
+ww_loop_source_free(WwLoopSource *self)
+{
+    if ( self == NULL )
+        return;
+
+    epoll_ctl(self->loop->epoll_fd, EPOLL_CTL_DEL, self->fd, NULL);
+
+    /* We may still have pending events for this source in the current batch */
+    if ( self->loop->dispatching )
+        self->removed = true;
+    else
+        _ww_loop_source_destroy(self);
+}
+
+void
+ww_loop_quit(WwLoop *self)
+{
+    self->quit = true;
+}
+
+int
+ww_loop_run(WwLoop *self)
+{
+    struct epoll_event events[WW_LOOP_MAX_EVENTS];
+
+    self->quit = false;
+    while ( ! self->quit )
+    {
+        while ( wl_display_prepare_read(self->display) != 0 )
+        {
+            if ( wl_display_dispatch_pending(self->display) < 0 )
+                return -1;
+        }
+
+        if ( ( wl_display_flush(self->display) < 0 ) && ( errno != EAGAIN ) )
+        {
+            wl_display_cancel_read(self->display);
+            return -1;
+        }
+
+        int n;
+        n = epoll_wait(self->epoll_fd, events, WW_LOOP_MAX_EVENTS, -1);
+        if ( n < 0 )
+        {
+            wl_display_cancel_read(self->display);
+            if ( errno == EINTR )
+                continue;
+            return -1;
+        }
+
+        /*
+         * We must finish our read before dispatching anything,
+         * callbacks may want to roundtrip
+         */
+        bool display_readable = false;
+        int i;
+        for ( i = 0 ; i < n ; ++i )
+        {
+            if ( events[i].data.ptr == NULL )
+                display_readable = true;
+        }
+        if ( display_readable )
+        {
+            if ( wl_display_read_events(self->display) < 0 )
+                return -1;
+        }
+        else
+            wl_display_cancel_read(self->display);
+
+        /* Listeners may free sources that have events in this batch too */
+        self->dispatching = true;
+        if ( wl_display_dispatch_pending(self->display) < 0 )
+        {
+            self->dispatching = false;
+            return -1;
+        }
+
+        for ( i = 0 ; i < n ; ++i )
+        {
+            WwLoopSource *source = events[i].data.ptr;
+            if ( ( source == NULL ) || source->removed )
+                continue;
+            source->callback(source->user_data, events[i].events);
+        }
+        self->dispatching = false;
+
+        WwLoopSource *source, *tmp;
+        wl_list_for_each_safe(source, tmp, &self->sources, link)
+        {
+            if ( source->removed )
+                _ww_loop_source_destroy(source);
+        }
+    }
+
+    return 0;
+}
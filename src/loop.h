@@ -0,0 +1,47 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef __WW_LOOP_H__
+#define __WW_LOOP_H__
+
+#include "helpers.h"
+
+#include <sys/epoll.h>
+
+typedef struct _WwLoop WwLoop;
+typedef struct _WwLoopSource WwLoopSource;
+
+typedef void (*WwLoopCallback)(void *user_data, uint32_t events);
+
+WwLoop *ww_loop_new(struct wl_display *display);
+void ww_loop_free(WwLoop *self);
+
+/* Dispatches Wayland events and sources until ww_loop_quit() or an error */
+int ww_loop_run(WwLoop *self);
+void ww_loop_quit(WwLoop *self);
+
+/* events are EPOLL* flags, the fd stays owned by the caller */
+WwLoopSource *ww_loop_add_fd(WwLoop *self, int fd, uint32_t events, WwLoopCallback callback, void *user_data);
+void ww_loop_source_free(WwLoopSource *source);
+
+#endif /* __WW_LOOP_H__ */
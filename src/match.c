@@ -0,0 +1,147 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/* For memmem() */
+#define _GNU_SOURCE
+
+#include "helpers.h"
+
+#include <ctype.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif /* __SSE2__ */
+
+#include "match.h"
+
+#define WW_MATCH_SUBSTRING_SCORE 4096
+
+size_t
+ww_match_fold(char *dest, const char *source, size_t size)
+{
+    size_t i;
+    for ( i = 0 ; ( i + 1 < size ) && ( source[i] != '\0' ) ; ++i )
+        dest[i] = tolower((unsigned char) source[i]);
+    dest[i] = '\0';
+    return i;
+}
+
+uint64_t
+ww_match_get_mask(const char *string, size_t length)
+{
+    uint64_t mask = 0;
+    size_t i;
+
+    for ( i = 0 ; i < length ; ++i )
+        mask |= (uint64_t) 1 << ( (uint8_t) string[i] & 63 );
+    return mask;
+}
+
+#ifdef __SSE2__
+/*
+ * Compares the first and last bytes of the needle at 16 offsets at once,
+ * only the offsets where both match get a full compare
+ */
+ssize_t
+ww_match_find(const char *haystack, size_t length, const char *needle, size_t needle_length)
+{
+    if ( needle_length == 0 )
+        return 0;
+    if ( needle_length > length )
+        return -1;
+
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[needle_length - 1]);
+    size_t end = length - needle_length + 1, i;
+
+    for ( i = 0 ; i < end ; i += 16 )
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *) ( haystack + i ));
+        __m128i b = _mm_loadu_si128((const __m128i *) ( haystack + i + needle_length - 1 ));
+        uint32_t mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        if ( end - i < 16 )
+            mask &= ( 1u << ( end - i ) ) - 1;
+
+        while ( mask != 0 )
+        {
+            size_t offset = i + __builtin_ctz(mask);
+            if ( ( needle_length < 3 ) || ( memcmp(haystack + offset + 1, needle + 1, needle_length - 2) == 0 ) )
+                return offset;
+            mask &= mask - 1;
+        }
+    }
+
+    return -1;
+}
+#else /* ! __SSE2__ */
+ssize_t
+ww_match_find(const char *haystack, size_t length, const char *needle, size_t needle_length)
+{
+    const char *found = memmem(haystack, length, needle, needle_length);
+    return ( found != NULL ) ? found - haystack : -1;
+}
+#endif /* ! __SSE2__ */
+
+static inline bool
+_ww_match_is_word_start(const char *haystack, size_t offset)
+{
+    return ( offset == 0 ) || ( ! isalnum((unsigned char) haystack[offset - 1]) );
+}
+
+int32_t
+ww_match_score(const char *haystack, size_t length, const char *needle, size_t needle_length)
+{
+    ssize_t offset = ww_match_find(haystack, length, needle, needle_length);
+    int32_t score;
+
+    if ( offset >= 0 )
+    {
+        score = WW_MATCH_SUBSTRING_SCORE + 16 * needle_length - MIN(offset, 64);
+        if ( _ww_match_is_word_start(haystack, offset) )
+            score += 512;
+        if ( offset == 0 )
+            score += 256;
+        return score;
+    }
+
+    /* Greedy subsequence, consecutive bytes and word starts score more */
+    size_t h = 0, last = SIZE_MAX, n;
+    score = 0;
+    for ( n = 0 ; n < needle_length ; ++n, ++h )
+    {
+        while ( ( h < length ) && ( haystack[h] != needle[n] ) )
+            ++h;
+        if ( h == length )
+            return 0;
+
+        score += 16;
+        if ( ( last != SIZE_MAX ) && ( h == last + 1 ) )
+            score += 32;
+        if ( _ww_match_is_word_start(haystack, h) )
+            score += 24;
+        if ( last != SIZE_MAX )
+            score -= MIN(h - last - 1, 8);
+        last = h;
+    }
+
+    return MAX(score, 1);
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef __WW_MATCH_H__
+#define __WW_MATCH_H__
+
+#include "helpers.h"
+
+#include <sys/types.h>
+
+/* Haystacks must be readable this far past their end, for wide loads */
+#define WW_MATCH_PADDING 16
+
+/* Lowercase ASCII, returns the length like strlen() */
+size_t ww_match_fold(char *dest, const char *source, size_t size);
+
+/* One bit per byte value modulo 64, a query can only match a superset */
+uint64_t ww_match_get_mask(const char *string, size_t length);
+
+/* Offset of the first occurrence, -1 if none */
+ssize_t ww_match_find(const char *haystack, size_t length, const char *needle, size_t needle_length);
+
+/*
+ * Higher is better, 0 for no match
+ * A substring always beats a subsequence, word starts and early matches score more
+ */
+int32_t ww_match_score(const char *haystack, size_t length, const char *needle, size_t needle_length);
+
+#endif /* __WW_MATCH_H__ */
@@ -0,0 +1,416 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "helpers.h"
+
+#include <fcntl.h>
+#include <dirent.h>
+
+#include "stats.h"
+#include "metrics.h"
+
+#define WW_METRICS_INTERVAL ((int64_t) 1000000)
+/* Reading a battery can go through ACPI and take milliseconds */
+#define WW_METRICS_BATTERY_INTERVAL ((int64_t) 30000000)
+
+#define WW_METRICS_NET_MAX 16
+#define WW_METRICS_BATTERY_MAX 4
+
+/* Enough for the lines we want, the aggregated cpu line comes first in /proc/stat */
+#define WW_METRICS_BUFFER_SIZE 4096
+
+typedef struct {
+    int rx_fd;
+    int tx_fd;
+} WwMetricsInterface;
+
+typedef struct {
+    int capacity_fd;
+    int status_fd;
+} WwMetricsBattery;
+
+struct _WwMetrics {
+    WwMetricsSource sources;
+    int64_t last_sample;
+    int64_t next_sample;
+    int64_t next_battery_sample;
+    int stat_fd;
+    int meminfo_fd;
+    WwMetricsInterface interfaces[WW_METRICS_NET_MAX];
+    size_t interface_count;
+    WwMetricsBattery batteries[WW_METRICS_BATTERY_MAX];
+    size_t battery_count;
+    uint64_t cpu_total;
+    uint64_t cpu_idle;
+    bool net_primed;
+    uint64_t net_rx;
+    uint64_t net_tx;
+    WwMetricsValues values;
+    char buffer[WW_METRICS_BUFFER_SIZE];
+};
+
+WwMetrics *
+ww_metrics_new(void)
+{
+    WwMetrics *self;
+
+    self = ww_new0(WwMetrics, 1);
+    if ( self == NULL )
+        return NULL;
+
+    self->stat_fd = -1;
+    self->meminfo_fd = -1;
+    self->values.cpu = -1;
+    self->values.memory = -1;
+    self->values.net_rx = -1;
+    self->values.net_tx = -1;
+    self->values.battery = -1;
+
+    return self;
+}
+
+void
+ww_metrics_free(WwMetrics *self)
+{
+    size_t i;
+    for ( i = 0 ; i < self->battery_count ; ++i )
+    {
+        close(self->batteries[i].status_fd);
+        close(self->batteries[i].capacity_fd);
+    }
+    for ( i = 0 ; i < self->interface_count ; ++i )
+    {
+        close(self->interfaces[i].tx_fd);
+        close(self->interfaces[i].rx_fd);
+    }
+    if ( self->meminfo_fd >= 0 )
+        close(self->meminfo_fd);
+    if ( self->stat_fd >= 0 )
+        close(self->stat_fd);
+
+    free(self);
+}
+
+static int
+_ww_metrics_open(const char *directory, const char *name, const char *file)
+{
+    char path[PATH_MAX];
+
+    if ( snprintf(path, PATH_MAX, "%s/%s/%s", directory, name, file) >= PATH_MAX )
+        return -1;
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+/* The whole file from the start in our buffer, NUL-terminated */
+static ssize_t
+_ww_metrics_read(WwMetrics *self, int fd)
+{
+    ssize_t length;
+
+    if ( fd < 0 )
+        return -1;
+
+    length = pread(fd, self->buffer, sizeof(self->buffer) - 1, 0);
+    if ( length < 0 )
+        return -1;
+    self->buffer[length] = '\0';
+    return length;
+}
+
+static uint64_t
+_ww_metrics_scan(const char **p)
+{
+    uint64_t value = 0;
+
+    while ( **p == ' ' )
+        ++*p;
+    while ( ( **p >= '0' ) && ( **p <= '9' ) )
+        value = value * 10 + ( *(*p)++ - '0' );
+
+    return value;
+}
+
+/* The value of a “key: value” line, 0 if missing */
+static uint64_t
+_ww_metrics_scan_field(const char *buffer, const char *key)
+{
+    size_t length = strlen(key);
+    const char *line;
+
+    for ( line = buffer ; line != NULL ; line = strchr(line, '\n') )
+    {
+        if ( *line == '\n' )
+            ++line;
+        if ( ( strncmp(line, key, length) == 0 ) && ( line[length] == ':' ) )
+        {
+            line += length + 1;
+            return _ww_metrics_scan(&line);
+        }
+    }
+    return 0;
+}
+
+static void
+_ww_metrics_open_interfaces(WwMetrics *self)
+{
+    const char *directory = "/sys/class/net";
+    struct dirent *entry;
+    DIR *dir;
+
+    dir = opendir(directory);
+    if ( dir == NULL )
+        return;
+
+    /* Only physical interfaces, virtual ones would count the same traffic twice */
+    while ( ( self->interface_count < WW_METRICS_NET_MAX ) && ( ( entry = readdir(dir) ) != NULL ) )
+    {
+        if ( entry->d_name[0] == '.' )
+            continue;
+
+        char path[PATH_MAX];
+        if ( ( snprintf(path, PATH_MAX, "%s/%s/device", directory, entry->d_name) >= PATH_MAX ) || ( access(path, F_OK) < 0 ) )
+            continue;
+
+        WwMetricsInterface *interface = self->interfaces + self->interface_count;
+        interface->rx_fd = _ww_metrics_open(directory, entry->d_name, "statistics/rx_bytes");
+        interface->tx_fd = _ww_metrics_open(directory, entry->d_name, "statistics/tx_bytes");
+        if ( ( interface->rx_fd >= 0 ) && ( interface->tx_fd >= 0 ) )
+        {
+            ++self->interface_count;
+            continue;
+        }
+
+        if ( interface->rx_fd >= 0 )
+            close(interface->rx_fd);
+        if ( interface->tx_fd >= 0 )
+            close(interface->tx_fd);
+    }
+
+    closedir(dir);
+}
+
+static void
+_ww_metrics_open_batteries(WwMetrics *self)
+{
+    const char *directory = "/sys/class/power_supply";
+    struct dirent *entry;
+    DIR *dir;
+
+    dir = opendir(directory);
+    if ( dir == NULL )
+        return;
+
+    while ( ( self->battery_count < WW_METRICS_BATTERY_MAX ) && ( ( entry = readdir(dir) ) != NULL ) )
+    {
+        if ( entry->d_name[0] == '.' )
+            continue;
+
+        int fd = _ww_metrics_open(directory, entry->d_name, "type");
+        ssize_t length = _ww_metrics_read(self, fd);
+        if ( fd >= 0 )
+            close(fd);
+        if ( ( length < 0 ) || ( strncmp(self->buffer, "Battery", strlen("Battery")) != 0 ) )
+            continue;
+
+        WwMetricsBattery *battery = self->batteries + self->battery_count;
+        battery->capacity_fd = _ww_metrics_open(directory, entry->d_name, "capacity");
+        battery->status_fd = _ww_metrics_open(directory, entry->d_name, "status");
+        if ( ( battery->capacity_fd >= 0 ) && ( battery->status_fd >= 0 ) )
+        {
+            ++self->battery_count;
+            continue;
+        }
+
+        if ( battery->capacity_fd >= 0 )
+            close(battery->capacity_fd);
+        if ( battery->status_fd >= 0 )
+            close(battery->status_fd);
+    }
+
+    closedir(dir);
+}
+
+void
+ww_metrics_enable(WwMetrics *self, WwMetricsSource source)
+{
+    if ( self->sources & source )
+        return;
+    self->sources |= source;
+
+    switch ( source )
+    {
+    case WW_METRICS_CPU:
+        self->stat_fd = open("/proc/stat", O_RDONLY | O_CLOEXEC);
+    break;
+    case WW_METRICS_MEMORY:
+        self->meminfo_fd = open("/proc/meminfo", O_RDONLY | O_CLOEXEC);
+    break;
+    case WW_METRICS_NET:
+        _ww_metrics_open_interfaces(self);
+    break;
+    case WW_METRICS_BATTERY:
+        _ww_metrics_open_batteries(self);
+    break;
+    }
+
+    /* The new source gets its first values on the next call */
+    self->next_sample = 0;
+    self->next_battery_sample = 0;
+}
+
+static void
+_ww_metrics_sample_cpu(WwMetrics *self)
+{
+    if ( ( _ww_metrics_read(self, self->stat_fd) < 0 ) || ( strncmp(self->buffer, "cpu ", strlen("cpu ")) != 0 ) )
+    {
+        self->values.cpu = -1;
+        return;
+    }
+
+    /* user nice system idle iowait irq softirq steal, guest time is already in user */
+    const char *p = self->buffer + strlen("cpu ");
+    uint64_t fields[8], total = 0;
+    size_t i;
+    for ( i = 0 ; i < 8 ; ++i )
+        total += fields[i] = _ww_metrics_scan(&p);
+    uint64_t idle = fields[3] + fields[4];
+
+    /* iowait is known to go backwards */
+    if ( ( self->cpu_total != 0 ) && ( total > self->cpu_total ) )
+        self->values.cpu = CLAMP(100.0 * ( 1.0 - (double) ( (int64_t) ( idle - self->cpu_idle ) ) / ( total - self->cpu_total ) ), 0.0, 100.0);
+    self->cpu_total = total;
+    self->cpu_idle = idle;
+}
+
+static void
+_ww_metrics_sample_memory(WwMetrics *self)
+{
+    uint64_t total, available;
+
+    if ( _ww_metrics_read(self, self->meminfo_fd) < 0 )
+    {
+        self->values.memory = -1;
+        return;
+    }
+
+    total = _ww_metrics_scan_field(self->buffer, "MemTotal");
+    available = _ww_metrics_scan_field(self->buffer, "MemAvailable");
+    if ( ( total == 0 ) || ( available > total ) )
+        self->values.memory = -1;
+    else
+        self->values.memory = 100.0 * ( total - available ) / total;
+}
+
+static uint64_t
+_ww_metrics_read_number(WwMetrics *self, int fd)
+{
+    const char *p = self->buffer;
+
+    if ( _ww_metrics_read(self, fd) < 0 )
+        return 0;
+    return _ww_metrics_scan(&p);
+}
+
+static void
+_ww_metrics_sample_net(WwMetrics *self, int64_t elapsed)
+{
+    uint64_t rx = 0, tx = 0;
+
+    size_t i;
+    for ( i = 0 ; i < self->interface_count ; ++i )
+    {
+        rx += _ww_metrics_read_number(self, self->interfaces[i].rx_fd);
+        tx += _ww_metrics_read_number(self, self->interfaces[i].tx_fd);
+    }
+
+    /* Counters reset when an interface goes away */
+    if ( self->net_primed && ( elapsed > 0 ) && ( rx >= self->net_rx ) && ( tx >= self->net_tx ) )
+    {
+        self->values.net_rx = (double) ( rx - self->net_rx ) * WW_METRICS_INTERVAL / elapsed;
+        self->values.net_tx = (double) ( tx - self->net_tx ) * WW_METRICS_INTERVAL / elapsed;
+    }
+    else
+    {
+        self->values.net_rx = -1;
+        self->values.net_tx = -1;
+    }
+    self->net_primed = ( self->interface_count > 0 );
+    self->net_rx = rx;
+    self->net_tx = tx;
+}
+
+static void
+_ww_metrics_sample_batteries(WwMetrics *self)
+{
+    uint64_t capacity = 0;
+    bool charging = false;
+
+    size_t i;
+    for ( i = 0 ; i < self->battery_count ; ++i )
+    {
+        capacity += _ww_metrics_read_number(self, self->batteries[i].capacity_fd);
+        if ( ( _ww_metrics_read(self, self->batteries[i].status_fd) > 0 ) && ( strncmp(self->buffer, "Charging", strlen("Charging")) == 0 ) )
+            charging = true;
+    }
+
+    self->values.battery = ( self->battery_count > 0 ) ? (double) capacity / self->battery_count : -1;
+    self->values.charging = charging;
+}
+
+void
+ww_metrics_sample(WwMetrics *self, int64_t now)
+{
+    /* Going back in time is a wall-clock jump, we start over */
+    bool back = ( now < self->last_sample );
+    if ( ( now < self->next_sample ) && ( ! back ) )
+        return;
+
+    int64_t start = ww_stats_now();
+    int64_t elapsed = ( ( self->last_sample == 0 ) || back ) ? 0 : now - self->last_sample;
+
+    if ( self->sources & WW_METRICS_CPU )
+        _ww_metrics_sample_cpu(self);
+    if ( self->sources & WW_METRICS_MEMORY )
+        _ww_metrics_sample_memory(self);
+    if ( self->sources & WW_METRICS_NET )
+        _ww_metrics_sample_net(self, elapsed);
+    if ( ( self->sources & WW_METRICS_BATTERY ) && ( ( now >= self->next_battery_sample ) || back ) )
+    {
+        _ww_metrics_sample_batteries(self);
+        self->next_battery_sample = ( now / WW_METRICS_BATTERY_INTERVAL + 1 ) * WW_METRICS_BATTERY_INTERVAL;
+    }
+
+    self->last_sample = now;
+    self->next_sample = ( now / WW_METRICS_INTERVAL + 1 ) * WW_METRICS_INTERVAL;
+
+    int64_t time = ww_stats_now() - start;
+    ww_stats_add(WW_STATS_METRIC_SAMPLES, 1);
+    ww_stats_add(WW_STATS_METRIC_SAMPLE_TIME, time);
+    ww_stats_max(WW_STATS_MAX_METRIC_SAMPLE_TIME, time);
+}
+
+const WwMetricsValues *
+ww_metrics_get_values(WwMetrics *self)
+{
+    return &self->values;
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef __WW_METRICS_H__
+#define __WW_METRICS_H__
+
+#include "helpers.h"
+
+typedef enum {
+    WW_METRICS_CPU = (1 << 0),
+    WW_METRICS_MEMORY = (1 << 1),
+    WW_METRICS_NET = (1 << 2),
+    WW_METRICS_BATTERY = (1 << 3),
+} WwMetricsSource;
+
+/* Negative values are unknown */
+typedef struct {
+    /* In percent */
+    double cpu;
+    double memory;
+    /* In bytes per second, summed over physical interfaces */
+    double net_rx;
+    double net_tx;
+    /* In percent, averaged over batteries */
+    double battery;
+    bool charging;
+} WwMetricsValues;
+
+typedef struct _WwMetrics WwMetrics;
+
+WwMetrics *ww_metrics_new(void);
+void ww_metrics_free(WwMetrics *self);
+
+/* Opens the files of the source, they stay open for all the later samples */
+void ww_metrics_enable(WwMetrics *self, WwMetricsSource source);
+
+/*
+ * Reads all the enabled sources in one go, at most once per second
+ * so any number of widgets can call it on the same tick
+ */
+void ww_metrics_sample(WwMetrics *self, int64_t now);
+const WwMetricsValues *ww_metrics_get_values(WwMetrics *self);
+
+#endif /* __WW_METRICS_H__ */
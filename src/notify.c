@@ -0,0 +1,1071 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "helpers.h"
+
+#include <inttypes.h>
+#include <getopt.h>
+#include <sys/timerfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <cairo.h>
+#include <pango/pango.h>
+#include <pango/pangocairo.h>
+#include "notification-area-unstable-v1-client-protocol.h"
+#include "notification-area-unstable-v2-client-protocol.h"
+#include "client.h"
+#include "loop.h"
+#include "format.h"
+#include "stats.h"
+#include "role.h"
+#include "stack.h"
+
+/* Supported interface versions */
+#define WW_NOTIFICATION_AREA_INTERFACE_VERSION 1
+
+/* In surface coordinates */
+#define WW_NOTIFY_WIDTH 300
+#define WW_NOTIFY_MARGIN 10
+#define WW_NOTIFY_PADDING 8
+#define WW_NOTIFY_BODY_LINES 5
+
+/* In ms */
+#define WW_NOTIFY_TIMEOUT 5000
+
+/* Longer datagrams are truncated */
+#define WW_NOTIFY_MESSAGE_SIZE 4096
+
+/* Changes of each kind timed by --stack-bench, on a 1080p-like area */
+#define WW_NOTIFY_STACK_BENCH_CHANGES 1000
+#define WW_NOTIFY_STACK_BENCH_HEIGHT 1060
+
+/* Per wakeup, so a flood of notifications cannot starve the compositor events */
+#define WW_NOTIFY_BATCH_MAX 256
+
+typedef struct {
+    WwClient *client;
+    struct zww_notification_area_v2 *notification_area;
+    /* Only bound without v2, each move then shows on its own */
+    struct zww_notification_area_v1 *notification_area_v1;
+    int32_t area_width;
+    int32_t area_height;
+    int32_t scale;
+    int32_t width;
+    int64_t timeout;
+    WwColour background_colour;
+    WwColour text_colour;
+    const char *socket_path;
+    unsigned long burst;
+    bool stack_bench;
+    int socket_fd;
+    WwLoopSource *socket_source;
+    int timer_fd;
+    WwLoopSource *timer_source;
+    PangoContext *pango_context;
+    PangoFontDescription *summary_font;
+    PangoFontDescription *body_font;
+    struct wl_list notifications;
+    /* Newest on top */
+    WwStack *stack;
+    /* Soonest first, the timeout is the same for all */
+    struct wl_list expiring;
+    /* To draw or commit on the next flush */
+    struct wl_list pending;
+} WwNotifyContext;
+
+typedef struct {
+    WwNotifyContext *context;
+    struct wl_list link;
+    char *id;
+    PangoLayout *summary;
+    PangoLayout *body;
+    int32_t height;
+    int64_t expire;
+    struct wl_list expire_link;
+    WwStackEntry stack_entry;
+    struct wl_list pending_link;
+    struct wl_surface *surface;
+    struct zww_notification_v2 *notification;
+    struct zww_notification_v1 *notification_v1;
+    WwArenaBlock block;
+    struct wl_buffer *buffer;
+    int32_t buffer_width;
+    int32_t buffer_height;
+    bool released;
+    int64_t attach_time;
+    bool dirty;
+    /* Placed in the area, moved since the last flush */
+    bool placed;
+    bool moved;
+    int32_t x;
+    int32_t y;
+    /* By the compositor, we skip drawing then */
+    bool hidden;
+} WwNotification;
+
+static WwFormat
+_ww_notify_get_format(WwNotifyContext *self)
+{
+    return ( self->background_colour.a < 1.0 ) ? WW_FORMAT_ARGB8888 : WW_FORMAT_XRGB8888;
+}
+
+static int32_t
+_ww_notify_get_width(WwNotifyContext *self)
+{
+    return MIN(self->width, self->area_width - 2 * WW_NOTIFY_MARGIN);
+}
+
+static void
+_ww_notify_buffer_free(WwNotification *self)
+{
+    if ( self->buffer == NULL )
+        return;
+
+    if ( ! self->released )
+        ww_stats_add(WW_STATS_BUFFERS_HELD, -1);
+    wl_buffer_destroy(self->buffer);
+    ww_client_shm_release(self->context->client, &self->block);
+    self->buffer = NULL;
+}
+
+static bool _ww_notify_draw(WwNotification *self);
+
+static void
+_ww_notify_buffer_release(void *data, struct wl_buffer *buffer)
+{
+    WwNotification *self = data;
+
+    self->released = true;
+    ww_stats_buffer_released(self->attach_time);
+
+    /* We were waiting for this buffer */
+    if ( self->dirty && self->placed && ( ! self->hidden ) && _ww_notify_draw(self) )
+    {
+        wl_surface_commit(self->surface);
+        ww_stats_committed();
+    }
+}
+
+static const struct wl_buffer_listener _ww_notify_buffer_listener = {
+    _ww_notify_buffer_release
+};
+
+static bool
+_ww_notify_buffer_init(WwNotification *self, int32_t width, int32_t height)
+{
+    WwFormat format = _ww_notify_get_format(self->context);
+    int32_t stride = ww_format_get_stride(format, width);
+    WwArenaBlock block;
+
+    if ( ! ww_client_shm_alloc(self->context->client, (size_t) stride * height, &block) )
+        return false;
+
+    /* The surface keeps showing the old buffer until the commit of the new one */
+    _ww_notify_buffer_free(self);
+
+    self->block = block;
+    self->buffer = ww_arena_create_buffer(self->context->client->arena, &self->block, 0, width, height, stride, ww_format_get_info(format)->shm_format, NULL);
+    if ( self->buffer == NULL )
+    {
+        ww_client_shm_release(self->context->client, &self->block);
+        return false;
+    }
+    wl_buffer_add_listener(self->buffer, &_ww_notify_buffer_listener, self);
+    ww_stats_add(WW_STATS_BUFFERS_CREATED, 1);
+
+    self->buffer_width = width;
+    self->buffer_height = height;
+    self->released = true;
+    return true;
+}
+
+static bool
+_ww_notify_draw(WwNotification *self)
+{
+    WwNotifyContext *context = self->context;
+    int32_t width = _ww_notify_get_width(context) * context->scale;
+    int32_t height = self->height * context->scale;
+
+    if ( ( self->buffer == NULL ) || ( self->buffer_width != width ) || ( self->buffer_height != height ) )
+    {
+        if ( ! _ww_notify_buffer_init(self, width, height) )
+            return false;
+    }
+    else if ( ! self->released )
+    {
+        /* Redrawn on release */
+        ww_stats_add(WW_STATS_SKIPPED_DRAWS, 1);
+        return false;
+    }
+    ww_stats_add(WW_STATS_DRAWS, 1);
+
+    WwFormat format = _ww_notify_get_format(context);
+    cairo_surface_t *surface;
+    cairo_t *cr;
+
+    surface = cairo_image_surface_create_for_data(self->block.data, ( format == WW_FORMAT_ARGB8888 ) ? CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24, width, height, ww_format_get_stride(format, width));
+    cairo_surface_set_device_scale(surface, context->scale, context->scale);
+    cr = cairo_create(surface);
+
+    cairo_set_source_rgba(cr, context->background_colour.r, context->background_colour.g, context->background_colour.b, context->background_colour.a);
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    cairo_paint(cr);
+
+    int32_t summary_height;
+    pango_layout_get_pixel_size(self->summary, NULL, &summary_height);
+
+    cairo_set_source_rgba(cr, context->text_colour.r, context->text_colour.g, context->text_colour.b, context->text_colour.a);
+    cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+    cairo_move_to(cr, WW_NOTIFY_PADDING, WW_NOTIFY_PADDING);
+    pango_cairo_show_layout(cr, self->summary);
+    cairo_move_to(cr, WW_NOTIFY_PADDING, WW_NOTIFY_PADDING + summary_height);
+    pango_cairo_show_layout(cr, self->body);
+
+    cairo_destroy(cr);
+    cairo_surface_destroy(surface);
+
+    if ( wl_surface_get_version(self->surface) >= WL_SURFACE_SET_BUFFER_SCALE_SINCE_VERSION )
+        wl_surface_set_buffer_scale(self->surface, context->scale);
+    wl_surface_attach(self->surface, self->buffer, 0, 0);
+    wl_surface_damage(self->surface, 0, 0, INT32_MAX, INT32_MAX);
+
+    self->released = false;
+    self->attach_time = ww_stats_now();
+    ww_stats_add(WW_STATS_BUFFERS_HELD, 1);
+    self->dirty = false;
+    return true;
+}
+
+static void
+_ww_notify_queue(WwNotification *self)
+{
+    if ( wl_list_empty(&self->pending_link) )
+        wl_list_insert(self->context->pending.prev, &self->pending_link);
+}
+
+/* Layouts only change with the width, every text update re-uses them */
+static void
+_ww_notify_measure(WwNotification *self)
+{
+    int32_t width = _ww_notify_get_width(self->context) - 2 * WW_NOTIFY_PADDING;
+    int32_t summary_height, body_height = 0;
+
+    width = MAX(width, 1) * PANGO_SCALE;
+    if ( pango_layout_get_width(self->summary) != width )
+    {
+        pango_layout_set_width(self->summary, width);
+        pango_layout_set_width(self->body, width);
+    }
+
+    pango_layout_get_pixel_size(self->summary, NULL, &summary_height);
+    if ( *pango_layout_get_text(self->body) != '\0' )
+        pango_layout_get_pixel_size(self->body, NULL, &body_height);
+
+    self->height = summary_height + body_height + 2 * WW_NOTIFY_PADDING;
+    ww_stack_resize(self->context->stack, &self->stack_entry, self->height + WW_NOTIFY_MARGIN);
+    self->dirty = true;
+    _ww_notify_queue(self);
+}
+
+static bool
+_ww_notify_set_text(PangoLayout *layout, const char *text)
+{
+    if ( strcmp(pango_layout_get_text(layout), text) == 0 )
+        return false;
+    pango_layout_set_text(layout, text, -1);
+    return true;
+}
+
+static void
+_ww_notify_visibility(void *data, struct zww_notification_v2 *notification, uint32_t visibility)
+{
+    WwNotification *self = data;
+
+    self->hidden = ( visibility == ZWW_NOTIFICATION_V2_VISIBILITY_HIDDEN );
+    if ( self->hidden || ( ! self->dirty ) || ( ! self->placed ) )
+        return;
+
+    /* Skipped while hidden */
+    if ( _ww_notify_draw(self) )
+    {
+        wl_surface_commit(self->surface);
+        ww_stats_committed();
+    }
+}
+
+static const struct zww_notification_v2_listener _ww_notify_notification_listener = {
+    .visibility = _ww_notify_visibility,
+};
+
+static WwNotification *
+_ww_notify_find(WwNotifyContext *self, const char *id)
+{
+    WwNotification *notification;
+
+    if ( *id == '\0' )
+        return NULL;
+
+    wl_list_for_each(notification, &self->notifications, link)
+    {
+        if ( strcmp0(notification->id, id) == 0 )
+            return notification;
+    }
+    return NULL;
+}
+
+static WwNotification *
+_ww_notify_create(WwNotifyContext *self, const char *id)
+{
+    WwNotification *notification;
+
+    notification = ww_new0(WwNotification, 1);
+    if ( notification == NULL )
+        return NULL;
+
+    notification->context = self;
+    if ( *id != '\0' )
+    {
+        notification->id = strdup(id);
+        if ( notification->id == NULL )
+        {
+            free(notification);
+            return NULL;
+        }
+    }
+
+    notification->summary = pango_layout_new(self->pango_context);
+    pango_layout_set_font_description(notification->summary, self->summary_font);
+    pango_layout_set_ellipsize(notification->summary, PANGO_ELLIPSIZE_END);
+
+    notification->body = pango_layout_new(self->pango_context);
+    pango_layout_set_font_description(notification->body, self->body_font);
+    pango_layout_set_wrap(notification->body, PANGO_WRAP_WORD_CHAR);
+    pango_layout_set_ellipsize(notification->body, PANGO_ELLIPSIZE_END);
+    pango_layout_set_height(notification->body, -WW_NOTIFY_BODY_LINES);
+
+    if ( ! ww_stack_insert(self->stack, &notification->stack_entry, 0) )
+    {
+        g_object_unref(notification->body);
+        g_object_unref(notification->summary);
+        free(notification->id);
+        free(notification);
+        return NULL;
+    }
+
+    notification->surface = wl_compositor_create_surface(self->client->compositor);
+    if ( self->notification_area != NULL )
+    {
+        notification->notification = zww_notification_area_v2_create_notification(self->notification_area, notification->surface);
+        zww_notification_v2_add_listener(notification->notification, &_ww_notify_notification_listener, notification);
+    }
+    else
+        notification->notification_v1 = zww_notification_area_v1_create_notification(self->notification_area_v1, notification->surface);
+
+    wl_list_insert(&self->notifications, &notification->link);
+    wl_list_insert(self->expiring.prev, &notification->expire_link);
+    wl_list_init(&notification->pending_link);
+    return notification;
+}
+
+static void
+_ww_notify_free(WwNotification *self)
+{
+    wl_list_remove(&self->pending_link);
+    wl_list_remove(&self->expire_link);
+    wl_list_remove(&self->link);
+    ww_stack_remove(self->context->stack, &self->stack_entry);
+
+    if ( self->notification != NULL )
+        zww_notification_v2_destroy(self->notification);
+    else
+        zww_notification_v1_destroy(self->notification_v1);
+    wl_surface_destroy(self->surface);
+    _ww_notify_buffer_free(self);
+
+    g_object_unref(self->body);
+    g_object_unref(self->summary);
+    free(self->id);
+    free(self);
+}
+
+static void
+_ww_notify_place(void *user_data, WwStackEntry *entry)
+{
+    WwNotifyContext *self = user_data;
+    WwNotification *notification = wl_container_of(entry, notification, stack_entry);
+
+    if ( entry->offset < 0 )
+    {
+        if ( ! notification->placed )
+            return;
+        notification->placed = false;
+        notification->dirty = true;
+    }
+    else
+    {
+        notification->x = self->area_width - _ww_notify_get_width(self) - WW_NOTIFY_MARGIN;
+        notification->y = WW_NOTIFY_MARGIN + entry->offset;
+        notification->placed = true;
+    }
+    notification->moved = true;
+    _ww_notify_queue(notification);
+}
+
+/*
+ * Stacks them from the top right corner, only moving those whose position changed
+ * Notifications that do not fit are unmapped rather than moved out of the area
+ * With v2, a re-stack of several goes in one transaction, so it shows in a single frame
+ */
+static void
+_ww_notify_flush(WwNotifyContext *self)
+{
+    struct zww_notification_transaction_v2 *transaction = NULL;
+    WwNotification *notification, *tmp;
+    size_t moves = 0;
+
+    if ( _ww_notify_get_width(self) > 0 )
+        moves = ww_stack_place(self->stack, self->area_height - WW_NOTIFY_MARGIN, _ww_notify_place, self);
+    if ( ( moves > 1 ) && ( self->notification_area != NULL ) )
+        transaction = zww_notification_area_v2_create_transaction(self->notification_area);
+
+    wl_list_for_each_safe(notification, tmp, &self->pending, pending_link)
+    {
+        wl_list_remove(&notification->pending_link);
+        wl_list_init(&notification->pending_link);
+
+        bool moved = notification->moved, commit = false;
+        notification->moved = false;
+        if ( moved && ( transaction != NULL ) )
+            /* Unmapped ones too, so their surface commit waits for the others */
+            zww_notification_transaction_v2_move(transaction, notification->notification, notification->x, notification->y);
+        else if ( moved && notification->placed )
+        {
+            /* Applied on the surface commit */
+            if ( notification->notification != NULL )
+                zww_notification_v2_move(notification->notification, notification->x, notification->y);
+            else
+                zww_notification_v1_move(notification->notification_v1, notification->x, notification->y);
+            commit = true;
+        }
+
+        if ( ! notification->placed )
+        {
+            if ( moved )
+            {
+                wl_surface_attach(notification->surface, NULL, 0, 0);
+                commit = true;
+            }
+        }
+        else if ( notification->dirty && ( ! notification->hidden ) && _ww_notify_draw(notification) )
+            commit = true;
+
+        if ( commit )
+        {
+            wl_surface_commit(notification->surface);
+            ww_stats_committed();
+        }
+    }
+
+    if ( transaction != NULL )
+        zww_notification_transaction_v2_commit(transaction);
+}
+
+static void
+_ww_notify_schedule(WwNotifyContext *self)
+{
+    struct itimerspec its = { .it_value = { 0, 0 } };
+
+    if ( ! wl_list_empty(&self->expiring) )
+    {
+        WwNotification *notification = wl_container_of(self->expiring.next, notification, expire_link);
+        int64_t expire = notification->expire;
+
+        /* 0 would disarm the timer */
+        expire = MAX(expire, 1);
+        its.it_value.tv_sec = expire / 1000000;
+        its.it_value.tv_nsec = ( expire % 1000000 ) * 1000;
+    }
+    timerfd_settime(self->timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static void
+_ww_notify_timer(void *user_data, uint32_t events)
+{
+    WwNotifyContext *self = user_data;
+    WwNotification *notification, *tmp;
+    uint64_t expirations;
+
+    if ( read(self->timer_fd, &expirations, sizeof(expirations)) < 0 )
+        return;
+
+    int64_t now = ww_stats_now();
+    wl_list_for_each_safe(notification, tmp, &self->expiring, expire_link)
+    {
+        if ( notification->expire > now )
+            break;
+        _ww_notify_free(notification);
+    }
+
+    _ww_notify_flush(self);
+    _ww_notify_schedule(self);
+}
+
+/*
+ * A datagram is “<id>\n<summary>[\n<body>]”, creating or updating
+ * the notification, or just “<id>” to close it
+ * An empty id always creates a new notification
+ */
+static void
+_ww_notify_handle_message(WwNotifyContext *self, char *message, int64_t now)
+{
+    WwNotification *notification;
+    char *summary, *body;
+
+    summary = strchr(message, '\n');
+    if ( summary == NULL )
+    {
+        notification = _ww_notify_find(self, message);
+        if ( notification != NULL )
+            _ww_notify_free(notification);
+        return;
+    }
+    *summary++ = '\0';
+
+    body = strchr(summary, '\n');
+    if ( body != NULL )
+        *body++ = '\0';
+    else
+        body = "";
+
+    notification = _ww_notify_find(self, message);
+    if ( notification == NULL )
+        notification = _ww_notify_create(self, message);
+    if ( notification == NULL )
+        return;
+
+    bool changed = _ww_notify_set_text(notification->summary, summary);
+    if ( _ww_notify_set_text(notification->body, body) )
+        changed = true;
+    if ( changed || ( notification->height == 0 ) )
+        _ww_notify_measure(notification);
+
+    notification->expire = now + self->timeout;
+    wl_list_remove(&notification->expire_link);
+    wl_list_insert(self->expiring.prev, &notification->expire_link);
+}
+
+static void
+_ww_notify_receive(void *user_data, uint32_t events)
+{
+    WwNotifyContext *self = user_data;
+    char message[WW_NOTIFY_MESSAGE_SIZE + 1];
+    int64_t now = ww_stats_now();
+    size_t i;
+
+    for ( i = 0 ; i < WW_NOTIFY_BATCH_MAX ; ++i )
+    {
+        ssize_t length = recv(self->socket_fd, message, WW_NOTIFY_MESSAGE_SIZE, MSG_DONTWAIT);
+        if ( length < 0 )
+            break;
+        message[length] = '\0';
+        _ww_notify_handle_message(self, message, now);
+        ww_stats_add(WW_STATS_NOTIFICATIONS, 1);
+    }
+
+    /* The whole batch goes out in one flush */
+    _ww_notify_flush(self);
+    _ww_notify_schedule(self);
+}
+
+static void
+_ww_notify_geometry(void *data, struct zww_notification_area_v2 *notification_area, int32_t width, int32_t height, int32_t scale)
+{
+    WwNotifyContext *self = data;
+    WwNotification *notification;
+    bool resize = ( MIN(self->width, width - 2 * WW_NOTIFY_MARGIN) != _ww_notify_get_width(self) );
+
+    /* Every notification moves sideways */
+    if ( width != self->area_width )
+        ww_stack_invalidate(self->stack);
+
+    self->area_width = width;
+    self->area_height = height;
+    if ( scale != self->scale )
+    {
+        self->scale = scale;
+        resize = true;
+    }
+
+    if ( resize )
+    {
+        wl_list_for_each(notification, &self->notifications, link)
+            _ww_notify_measure(notification);
+    }
+    _ww_notify_flush(self);
+}
+
+static const struct zww_notification_area_v2_listener _ww_notify_notification_area_listener = {
+    .geometry = _ww_notify_geometry,
+};
+
+static void
+_ww_notify_geometry_v1(void *data, struct zww_notification_area_v1 *notification_area, int32_t width, int32_t height, int32_t scale)
+{
+    _ww_notify_geometry(data, NULL, width, height, scale);
+}
+
+static const struct zww_notification_area_v1_listener _ww_notify_notification_area_v1_listener = {
+    .geometry = _ww_notify_geometry_v1,
+};
+
+static void
+_ww_notify_notification_area_bound(void *user_data, void *proxy)
+{
+    zww_notification_area_v2_add_listener(proxy, &_ww_notify_notification_area_listener, user_data);
+}
+
+static void
+_ww_notify_notification_area_v1_bound(void *user_data, void *proxy)
+{
+    zww_notification_area_v1_add_listener(proxy, &_ww_notify_notification_area_v1_listener, user_data);
+}
+
+static const WwClientGlobal _ww_notify_globals[] = {
+    /* The geometry is sent on bind, so we need our listener before any dispatch */
+    { &zww_notification_area_v2_interface, WW_NOTIFICATION_AREA_INTERFACE_VERSION, offsetof(WwNotifyContext, notification_area), (WwClientProxyDestroyFunc) zww_notification_area_v2_destroy, _ww_notify_notification_area_bound, false },
+    { &zww_notification_area_v1_interface, WW_NOTIFICATION_AREA_INTERFACE_VERSION, offsetof(WwNotifyContext, notification_area_v1), (WwClientProxyDestroyFunc) zww_notification_area_v1_destroy, _ww_notify_notification_area_v1_bound, true },
+};
+
+static bool
+_ww_notify_get_address(WwNotifyContext *self, const char *runtime_dir, struct sockaddr_un *address)
+{
+    char path[PATH_MAX];
+    int length;
+
+    if ( self->socket_path == NULL )
+    {
+        if ( runtime_dir == NULL )
+        {
+            errno = ENOENT;
+            return false;
+        }
+        snprintf(path, PATH_MAX, "%s/notify.sock", runtime_dir);
+    }
+
+    address->sun_family = AF_UNIX;
+    length = snprintf(address->sun_path, sizeof(address->sun_path), "%s", ( self->socket_path != NULL ) ? self->socket_path : path);
+    if ( (size_t) length >= sizeof(address->sun_path) )
+    {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    return true;
+}
+
+/* Sends notifications to a running ww-notify as fast as it takes them */
+static int
+_ww_notify_burst_run(WwNotifyContext *self)
+{
+    struct sockaddr_un address;
+    char runtime_dir[PATH_MAX];
+    const char *xdg_runtime_dir = getenv("XDG_RUNTIME_DIR");
+    int fd;
+
+    if ( xdg_runtime_dir != NULL )
+        snprintf(runtime_dir, PATH_MAX, "%s/" PACKAGE_NAME, xdg_runtime_dir);
+    if ( ! _ww_notify_get_address(self, ( xdg_runtime_dir != NULL ) ? runtime_dir : NULL, &address) )
+    {
+        ww_warning("No socket to send to: %s", strerror(errno));
+        return 1;
+    }
+
+    fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if ( fd < 0 )
+        return 2;
+    if ( connect(fd, (struct sockaddr *) &address, sizeof(address)) < 0 )
+    {
+        ww_warning("Couldn’t connect to %s: %s", address.sun_path, strerror(errno));
+        close(fd);
+        return 2;
+    }
+
+    int64_t start = ww_stats_now();
+    unsigned long i;
+    for ( i = 0 ; i < self->burst ; ++i )
+    {
+        char message[128];
+        int length;
+
+        /* A few ids get updated over and over, the rest are new ones */
+        if ( i % 2 == 0 )
+            length = snprintf(message, sizeof(message), "burst-%lu\nBurst %lu\nNotification %lu of %lu", i % 16, i % 16, i, self->burst);
+        else
+            length = snprintf(message, sizeof(message), "\nBurst\nNotification %lu of %lu", i, self->burst);
+
+        /* Blocks while the queue is full, so the rate is the one ww-notify sustains */
+        if ( send(fd, message, length, 0) < 0 )
+        {
+            ww_warning("Couldn’t send notification %lu: %s", i, strerror(errno));
+            break;
+        }
+    }
+    int64_t elapsed = ww_stats_now() - start;
+    close(fd);
+
+    printf("%lu notifications in %" PRId64 " µs, %" PRId64 " per second\n", i, elapsed, ( elapsed > 0 ) ? (int64_t) i * 1000000 / elapsed : 0);
+    return ( i == self->burst ) ? 0 : 2;
+}
+
+static bool
+_ww_notify_socket_init(WwNotifyContext *self)
+{
+    struct sockaddr_un address;
+
+    if ( ! _ww_notify_get_address(self, self->client->runtime_dir, &address) )
+        return false;
+
+    self->socket_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if ( self->socket_fd < 0 )
+        return false;
+
+    unlink(address.sun_path);
+    if ( bind(self->socket_fd, (struct sockaddr *) &address, sizeof(address)) < 0 )
+        return false;
+
+    self->socket_source = ww_loop_add_fd(self->client->loop, self->socket_fd, EPOLLIN, _ww_notify_receive, self);
+    if ( self->socket_source == NULL )
+        return false;
+
+    self->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if ( self->timer_fd < 0 )
+        return false;
+
+    self->timer_source = ww_loop_add_fd(self->client->loop, self->timer_fd, EPOLLIN, _ww_notify_timer, self);
+    return ( self->timer_source != NULL );
+}
+
+typedef struct {
+    size_t moves;
+    size_t restacks;
+    size_t total_moves;
+    size_t transaction_messages;
+} WwNotifyStackBench;
+
+static void
+_ww_notify_stack_bench_place(void *user_data, WwStackEntry *entry)
+{
+    WwNotifyStackBench *self = user_data;
+    ++self->moves;
+}
+
+/* Returns the moves of this change, and counts the messages each protocol version needs */
+static size_t
+_ww_notify_stack_bench_place_all(WwNotifyStackBench *self, WwStack *stack, int32_t limit)
+{
+    self->moves = 0;
+    ww_stack_place(stack, limit, _ww_notify_stack_bench_place, self);
+    if ( self->moves == 0 )
+        return 0;
+
+    ++self->restacks;
+    self->total_moves += self->moves;
+    /* A lone move goes with its surface commit, as in v1 */
+    if ( self->moves > 1 )
+        self->transaction_messages += self->moves + 2;
+    else
+        self->transaction_messages += 2;
+    return self->moves;
+}
+
+/*
+ * Moves sent per change with count notifications, against
+ * the one per placed notification of a full relayout
+ * In v1, each move needs its own surface commit and may show in its own frame
+ * In v2, a transaction carries them all to a single frame
+ */
+static void
+_ww_notify_stack_bench(size_t count, int32_t limit)
+{
+    WwNotifyStackBench bench = { .moves = 0 };
+    WwStack *stack = ww_stack_new();
+    WwStackEntry *entries = ww_new0(WwStackEntry, count);
+    unsigned int seed = 1;
+    size_t placed, i;
+
+    if ( ( stack == NULL ) || ( entries == NULL ) )
+        goto out;
+
+    for ( i = 0 ; i < count ; ++i )
+        ww_stack_insert(stack, &entries[i], 40 + rand_r(&seed) % 60);
+    placed = _ww_notify_stack_bench_place_all(&bench, stack, limit);
+    bench = (WwNotifyStackBench) { .moves = 0 };
+
+    size_t inserts = 0, removes = 0, resizes = 0;
+    int64_t start = ww_stats_now();
+    for ( i = 0 ; i < WW_NOTIFY_STACK_BENCH_CHANGES ; ++i )
+    {
+        WwStackEntry *entry = &entries[rand_r(&seed) % count];
+
+        /* One expires, then a new one comes in */
+        ww_stack_remove(stack, entry);
+        removes += _ww_notify_stack_bench_place_all(&bench, stack, limit);
+
+        ww_stack_insert(stack, entry, 40 + rand_r(&seed) % 60);
+        inserts += _ww_notify_stack_bench_place_all(&bench, stack, limit);
+
+        /* An update changes the body length */
+        entry = &entries[rand_r(&seed) % count];
+        ww_stack_resize(stack, entry, 40 + rand_r(&seed) % 60);
+        resizes += _ww_notify_stack_bench_place_all(&bench, stack, limit);
+    }
+    int64_t elapsed = ww_stats_now() - start;
+
+    printf("%4zu notifications, %zu placed in %" PRId32 " px: %.1f moves per insert, %.1f per remove, %.1f per resize, %.2f µs per change\n",
+        count, placed, limit,
+        (double) inserts / WW_NOTIFY_STACK_BENCH_CHANGES,
+        (double) removes / WW_NOTIFY_STACK_BENCH_CHANGES,
+        (double) resizes / WW_NOTIFY_STACK_BENCH_CHANGES,
+        (double) elapsed / ( 3 * WW_NOTIFY_STACK_BENCH_CHANGES ));
+    if ( bench.restacks > 0 )
+        printf("    per re-stack: v1 %.1f messages in %.1f frames, v2 %.1f messages in 1 frame\n",
+            (double) ( 2 * bench.total_moves ) / bench.restacks,
+            (double) bench.total_moves / bench.restacks,
+            (double) bench.transaction_messages / bench.restacks);
+
+out:
+    free(entries);
+    if ( stack != NULL )
+        ww_stack_free(stack);
+}
+
+enum {
+    WW_NOTIFY_OPTION_BURST = 256,
+    WW_NOTIFY_OPTION_STACK_BENCH,
+};
+
+static const struct option _ww_notify_options[] = {
+    { "burst", required_argument, NULL, WW_NOTIFY_OPTION_BURST },
+    { "stack-bench", no_argument, NULL, WW_NOTIFY_OPTION_STACK_BENCH },
+    { NULL, 0, NULL, 0 },
+};
+
+static void *
+_ww_notify_role_init(int argc, char *argv[], int *status)
+{
+    WwNotifyContext *self;
+
+    self = ww_new0(WwNotifyContext, 1);
+    if ( self == NULL )
+    {
+        *status = 2;
+        return NULL;
+    }
+
+    self->width = WW_NOTIFY_WIDTH;
+    self->timeout = WW_NOTIFY_TIMEOUT;
+    self->scale = 1;
+    self->socket_fd = -1;
+    self->timer_fd = -1;
+    wl_list_init(&self->notifications);
+    wl_list_init(&self->expiring);
+    wl_list_init(&self->pending);
+
+    self->background_colour.r = 0.2;
+    self->background_colour.g = 0.2;
+    self->background_colour.b = 0.2;
+    self->background_colour.a = 1.0;
+    self->text_colour.r = 1.0;
+    self->text_colour.g = 1.0;
+    self->text_colour.b = 1.0;
+    self->text_colour.a = 1.0;
+
+    int arg;
+    while ( ( arg = getopt_long(argc, argv, "b:t:w:T:S:", _ww_notify_options, NULL) ) != -1 )
+    {
+        bool good = false;
+        switch ( arg )
+        {
+        case 'b':
+            if ( _ww_parse_colour(optarg, &self->background_colour) )
+                good = true;
+        break;
+        case 't':
+            if ( _ww_parse_colour(optarg, &self->text_colour) )
+                good = true;
+        break;
+        case 'w':
+        {
+            char *e;
+            errno = 0;
+            self->width = strtol(optarg, &e, 10);
+            if ( ( e != optarg ) && ( errno == 0 ) && ( self->width > 2 * WW_NOTIFY_PADDING ) )
+                good = true;
+        }
+        break;
+        case 'T':
+        {
+            char *e;
+            errno = 0;
+            self->timeout = strtoll(optarg, &e, 10);
+            if ( ( e != optarg ) && ( errno == 0 ) && ( self->timeout > 0 ) )
+                good = true;
+        }
+        break;
+        case 'S':
+            self->socket_path = optarg;
+            good = true;
+        break;
+        case WW_NOTIFY_OPTION_BURST:
+        {
+            char *e;
+            errno = 0;
+            self->burst = strtoul(optarg, &e, 10);
+            if ( ( e != optarg ) && ( errno == 0 ) && ( self->burst > 0 ) )
+                good = true;
+        }
+        break;
+        case WW_NOTIFY_OPTION_STACK_BENCH:
+            self->stack_bench = true;
+            good = true;
+        break;
+        default:
+        break;
+        }
+        if ( ! good )
+        {
+            fprintf(stderr, ""
+                "Usage:"
+                "\n    %s [OPTION...] - Demo client for Wayland Wall notification area protocol"
+                "\n"
+                "\nOptions:"
+                "\n    -b <colour>      Colour to use as background, defaults to #333333"
+                "\n    -t <colour>      Colour to use for the text, defaults to #FFFFFF"
+                "\n    -w <width>       Width of the notifications, defaults to 300"
+                "\n    -T <timeout>     Time before notifications expire in ms, defaults to 5000"
+                "\n    -S <socket>      Socket to receive notifications on, defaults to notify.sock in the runtime directory"
+                "\n"
+                "\nTesting, against a running instance:"
+                "\n    --burst <count>  Send count notifications as fast as they are taken"
+                "\n"
+                "\nWithout a compositor:"
+                "\n    --stack-bench    Print the moves and messages per change with 10, 100 and 1000 notifications"
+                "\n"
+                "\nFormats:"
+                "\n    Colours options supports #RRGGBB(AA) and #RGB(A) formats"
+                "\n    Datagrams on the socket are “<id>\\n<summary>[\\n<body>]” to show"
+                "\n    or update a notification, or “<id>” to close it"
+                "\n    An empty id always creates a new notification"
+                "\n\n", argv[0]);
+            *status = 3;
+            return NULL;
+        }
+    }
+    self->timeout *= 1000;
+
+    if ( self->stack_bench )
+    {
+        static const size_t counts[] = { 10, 100, 1000 };
+        size_t i;
+        for ( i = 0 ; i < sizeof(counts) / sizeof(*counts) ; ++i )
+        {
+            _ww_notify_stack_bench(counts[i], INT32_MAX);
+            _ww_notify_stack_bench(counts[i], WW_NOTIFY_STACK_BENCH_HEIGHT);
+        }
+        *status = 0;
+        free(self);
+        return NULL;
+    }
+
+    if ( self->burst > 0 )
+    {
+        *status = _ww_notify_burst_run(self);
+        free(self);
+        return NULL;
+    }
+
+    /* Shared by all the notifications, so their layouts share the font cache */
+    self->pango_context = pango_context_new();
+    pango_context_set_font_map(self->pango_context, pango_cairo_font_map_get_default());
+    self->summary_font = pango_font_description_from_string("Sans Bold 12");
+    self->body_font = pango_font_description_from_string("Sans 11");
+
+    self->stack = ww_stack_new();
+    if ( self->stack == NULL )
+    {
+        *status = 2;
+        return NULL;
+    }
+
+    return self;
+}
+
+static bool
+_ww_notify_role_attach(void *data, WwClient *client)
+{
+    WwNotifyContext *self = data;
+
+    self->client = client;
+
+    if ( ! _ww_notify_socket_init(self) )
+    {
+        ww_warning("Couldn’t create notification socket: %s", strerror(errno));
+        return false;
+    }
+
+    return ww_client_add_globals(self->client, _ww_notify_globals, sizeof(_ww_notify_globals) / sizeof(*_ww_notify_globals), self);
+}
+
+static int
+_ww_notify_role_start(void *data)
+{
+    WwNotifyContext *self = data;
+
+    if ( self->client->shm == NULL )
+    {
+        ww_warning("No wl_shm interface provided by the compositor");
+        return 4;
+    }
+    if ( ( self->notification_area == NULL ) && ( self->notification_area_v1 == NULL ) )
+    {
+        ww_warning("No ww_notification_area interface provided by the compositor");
+        return 4;
+    }
+
+    return 0;
+}
+
+const WwRole ww_notify_role = {
+    .name = "notify",
+    .init = _ww_notify_role_init,
+    .attach = _ww_notify_role_attach,
+    .start = _ww_notify_role_start,
+};
+
+#ifndef WW_SHELL
+int
+main(int argc, char *argv[])
+{
+    WwRoleInstance instance = { &ww_notify_role, argc, argv, NULL };
+    return ww_role_run("ww-notify", &instance, 1);
+}
+#endif /* ! WW_SHELL */
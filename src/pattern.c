@@ -0,0 +1,437 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "helpers.h"
+
+#include <math.h>
+#include <pthread.h>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif /* __SSE__ */
+
+#include "format.h"
+#include "pattern.h"
+
+/* Rows per band handed to a thread, small enough to balance the load */
+#define WW_PATTERN_BAND_HEIGHT 16
+
+/* We evaluate four pixels at once, one per lane */
+typedef float WwPatternVec __attribute__((vector_size(16)));
+typedef int32_t WwPatternVecInt __attribute__((vector_size(16)));
+typedef uint32_t WwPatternVecUint __attribute__((vector_size(16)));
+
+typedef enum {
+    WW_PATTERN_LINEAR,
+    WW_PATTERN_RADIAL,
+} WwPatternType;
+
+struct _WwPattern {
+    WwPatternType type;
+    float from[3];
+    float to[3];
+    double angle;
+    float noise;
+    size_t thread_count;
+    pthread_t *threads;
+    pthread_mutex_t mutex;
+    pthread_cond_t start_cond;
+    pthread_cond_t done_cond;
+    uint64_t generation;
+    size_t running;
+    bool quit;
+    struct {
+        WwFormat format;
+        uint8_t *data;
+        int32_t width;
+        int32_t height;
+        int32_t stride;
+        float dx;
+        float dy;
+        float t0;
+        float cx;
+        float cy;
+        float inv_radius;
+        float scale[3];
+        int32_t max[3];
+        int32_t band_count;
+        int32_t next_band;
+    } job;
+};
+
+static inline WwPatternVec
+_ww_pattern_vec_sqrt(WwPatternVec v)
+{
+#ifdef __SSE__
+    return (WwPatternVec) _mm_sqrt_ps((__m128) v);
+#else /* ! __SSE__ */
+    for ( int i = 0 ; i < 4 ; ++i )
+        v[i] = sqrtf(v[i]);
+    return v;
+#endif /* ! __SSE__ */
+}
+
+static inline WwPatternVec
+_ww_pattern_vec_clamp01(WwPatternVec v)
+{
+    const WwPatternVec one = { 1.f, 1.f, 1.f, 1.f };
+    WwPatternVecInt m;
+
+    m = v < 0.f;
+    v = (WwPatternVec) ( (WwPatternVecInt) v & ~m );
+    m = v > 1.f;
+    v = (WwPatternVec) ( ( (WwPatternVecInt) v & ~m ) | ( (WwPatternVecInt) one & m ) );
+    return v;
+}
+
+static inline WwPatternVecUint
+_ww_pattern_vec_to_channel(WwPatternVec v, int32_t max)
+{
+    WwPatternVecInt i, m;
+
+    i = __builtin_convertvector(v, WwPatternVecInt);
+    m = i < 0;
+    i &= ~m;
+    m = i > max;
+    i = ( i & ~m ) | ( max & m );
+    return (WwPatternVecUint) i;
+}
+
+/* Cheap integer hash, good enough for film-grain-like noise */
+static inline WwPatternVec
+_ww_pattern_vec_noise(WwPatternVecUint x, uint32_t y)
+{
+    WwPatternVecUint h;
+
+    h = ( x * 0x9e3779b1u ) ^ ( y * 0x85ebca77u );
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+    h *= 0x297a2d39u;
+    h ^= h >> 15;
+
+    return __builtin_convertvector(h >> 8, WwPatternVec) * ( 1.f / ( 1 << 24 ) ) - .5f;
+}
+
+static void
+_ww_pattern_render_line(WwPattern *self, uint8_t *line, int32_t y)
+{
+    const WwPatternVec lane = { .5f, 1.5f, 2.5f, 3.5f };
+    const WwPatternVecUint lane_index = { 0, 1, 2, 3 };
+    WwPatternVec from[3], delta[3];
+    WwPatternVec dither[2];
+    const uint8_t *bayer = ww_format_bayer[y & 7];
+    int32_t width = self->job.width;
+    float fy = y + .5f;
+
+    /* We work directly in the format levels, so that dithering happens at its precision */
+    for ( int c = 0 ; c < 3 ; ++c )
+    {
+        from[c] = (WwPatternVec) { 0.f, 0.f, 0.f, 0.f } + self->from[c] * self->job.scale[c];
+        delta[c] = (WwPatternVec) { 0.f, 0.f, 0.f, 0.f } + ( self->to[c] - self->from[c] ) * self->job.scale[c];
+    }
+    for ( int i = 0 ; i < 2 ; ++i )
+    {
+        for ( int l = 0 ; l < 4 ; ++l )
+            dither[i][l] = bayer[i * 4 + l] / 64.f;
+    }
+
+    for ( int32_t x = 0 ; x < width ; x += 4 )
+    {
+        WwPatternVec fx = lane + (float) x;
+        WwPatternVec t;
+
+        switch ( self->type )
+        {
+        case WW_PATTERN_LINEAR:
+            t = fx * self->job.dx + ( fy * self->job.dy + self->job.t0 );
+        break;
+        case WW_PATTERN_RADIAL:
+        {
+            WwPatternVec ddx = fx - self->job.cx;
+            float ddy = fy - self->job.cy;
+            t = _ww_pattern_vec_sqrt(ddx * ddx + ddy * ddy) * self->job.inv_radius;
+        }
+        break;
+        default:
+            assert(0 && "Should never be reached");
+            t = (WwPatternVec) { 0.f, 0.f, 0.f, 0.f };
+        }
+        t = _ww_pattern_vec_clamp01(t);
+
+        /* The noise is in 8-bits levels, the dither in target levels as truncation happens there */
+        WwPatternVec noise = { 0.f, 0.f, 0.f, 0.f };
+        if ( self->noise > 0 )
+            noise = _ww_pattern_vec_noise(lane_index + (uint32_t) x, y) * self->noise;
+        WwPatternVec offset = dither[( x >> 2 ) & 1];
+
+        WwPatternVecUint r, g, b;
+        r = _ww_pattern_vec_to_channel(from[0] + delta[0] * t + noise * self->job.scale[0] + offset, self->job.max[0]);
+        g = _ww_pattern_vec_to_channel(from[1] + delta[1] * t + noise * self->job.scale[1] + offset, self->job.max[1]);
+        b = _ww_pattern_vec_to_channel(from[2] + delta[2] * t + noise * self->job.scale[2] + offset, self->job.max[2]);
+
+        int32_t count = MIN(width - x, 4);
+        switch ( self->job.format )
+        {
+        case WW_FORMAT_ARGB8888:
+        case WW_FORMAT_XRGB8888:
+        {
+            WwPatternVecUint pixels = 0xff000000u | ( r << 16 ) | ( g << 8 ) | b;
+            memcpy((uint32_t *) line + x, &pixels, count * sizeof(uint32_t));
+        }
+        break;
+        case WW_FORMAT_XRGB2101010:
+        {
+            WwPatternVecUint pixels = 0xc0000000u | ( r << 20 ) | ( g << 10 ) | b;
+            memcpy((uint32_t *) line + x, &pixels, count * sizeof(uint32_t));
+        }
+        break;
+        case WW_FORMAT_RGB565:
+        {
+            WwPatternVecUint pixels = ( r << 11 ) | ( g << 5 ) | b;
+            uint16_t narrow[4] = { pixels[0], pixels[1], pixels[2], pixels[3] };
+            memcpy((uint16_t *) line + x, narrow, count * sizeof(uint16_t));
+        }
+        break;
+        case _WW_FORMAT_SIZE:
+            assert(0 && "Should never be reached");
+        }
+    }
+}
+
+static void
+_ww_pattern_run_bands(WwPattern *self)
+{
+    int32_t band;
+
+    while ( ( band = __atomic_fetch_add(&self->job.next_band, 1, __ATOMIC_RELAXED) ) < self->job.band_count )
+    {
+        int32_t y = band * WW_PATTERN_BAND_HEIGHT;
+        int32_t end = MIN(y + WW_PATTERN_BAND_HEIGHT, self->job.height);
+        for ( ; y < end ; ++y )
+            _ww_pattern_render_line(self, self->job.data + y * self->job.stride, y);
+    }
+}
+
+static void *
+_ww_pattern_thread(void *data)
+{
+    WwPattern *self = data;
+    uint64_t generation = 0;
+
+    pthread_mutex_lock(&self->mutex);
+    for (;;)
+    {
+        while ( ( ! self->quit ) && ( self->generation == generation ) )
+            pthread_cond_wait(&self->start_cond, &self->mutex);
+        if ( self->quit )
+            break;
+        generation = self->generation;
+        pthread_mutex_unlock(&self->mutex);
+
+        _ww_pattern_run_bands(self);
+
+        pthread_mutex_lock(&self->mutex);
+        if ( --self->running == 0 )
+            pthread_cond_signal(&self->done_cond);
+    }
+    pthread_mutex_unlock(&self->mutex);
+
+    return NULL;
+}
+
+static bool
+_ww_pattern_parse(WwPattern *self, char *spec)
+{
+    char *type, *s;
+    WwColour from, to;
+
+    type = spec;
+    s = strchr(spec, ':');
+    if ( s == NULL )
+        return false;
+    *s++ = '\0';
+
+    if ( strcmp(type, "linear") == 0 )
+    {
+        char *e;
+        self->type = WW_PATTERN_LINEAR;
+        self->angle = strtod(s, &e);
+        if ( ( e == s ) || ( *e != ':' ) )
+            return false;
+        s = e + 1;
+    }
+    else if ( strcmp(type, "radial") == 0 )
+        self->type = WW_PATTERN_RADIAL;
+    else
+        return false;
+
+    char *to_spec = strchr(s, ':');
+    if ( to_spec == NULL )
+        return false;
+    *to_spec++ = '\0';
+
+    if ( ( ! _ww_parse_colour(s, &from) ) || ( ! _ww_parse_colour(to_spec, &to) ) )
+        return false;
+
+    self->from[0] = from.r * 0xff;
+    self->from[1] = from.g * 0xff;
+    self->from[2] = from.b * 0xff;
+    self->to[0] = to.r * 0xff;
+    self->to[1] = to.g * 0xff;
+    self->to[2] = to.b * 0xff;
+
+    return true;
+}
+
+WwPattern *
+ww_pattern_new(const char *spec_, double noise, size_t thread_count)
+{
+    WwPattern *self;
+    char *spec;
+
+    self = ww_new0(WwPattern, 1);
+    if ( self == NULL )
+        return NULL;
+
+    spec = strdup(spec_);
+    if ( ( spec == NULL ) || ( ! _ww_pattern_parse(self, spec) ) )
+    {
+        free(spec);
+        free(self);
+        return NULL;
+    }
+    free(spec);
+
+    self->noise = noise;
+
+    if ( thread_count < 1 )
+    {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = ( n > 0 ) ? n : 1;
+    }
+
+    pthread_mutex_init(&self->mutex, NULL);
+    pthread_cond_init(&self->start_cond, NULL);
+    pthread_cond_init(&self->done_cond, NULL);
+
+    /* The rendering thread takes its share of the bands too */
+    self->threads = ww_new0(pthread_t, thread_count - 1);
+    if ( ( self->threads == NULL ) && ( thread_count > 1 ) )
+    {
+        ww_warning("Couldn’t allocate pattern threads, rendering alone: %s", strerror(errno));
+        thread_count = 1;
+    }
+    for ( self->thread_count = 1 ; self->thread_count < thread_count ; ++self->thread_count )
+    {
+        int ret = pthread_create(self->threads + self->thread_count - 1, NULL, _ww_pattern_thread, self);
+        if ( ret != 0 )
+        {
+            ww_warning("Couldn’t create pattern thread: %s", strerror(ret));
+            break;
+        }
+    }
+
+    return self;
+}
+
+void
+ww_pattern_free(WwPattern *self)
+{
+    if ( self == NULL )
+        return;
+
+    pthread_mutex_lock(&self->mutex);
+    self->quit = true;
+    pthread_cond_broadcast(&self->start_cond);
+    pthread_mutex_unlock(&self->mutex);
+
+    size_t i;
+    for ( i = 0 ; i < self->thread_count - 1 ; ++i )
+        pthread_join(self->threads[i], NULL);
+
+    pthread_cond_destroy(&self->done_cond);
+    pthread_cond_destroy(&self->start_cond);
+    pthread_mutex_destroy(&self->mutex);
+
+    free(self->threads);
+    free(self);
+}
+
+void
+ww_pattern_render(WwPattern *self, WwFormat format, uint8_t *data, int32_t width, int32_t height, int32_t stride)
+{
+    const WwFormatInfo *info = ww_format_get_info(format);
+    for ( int c = 0 ; c < 3 ; ++c )
+    {
+        self->job.max[c] = ( 1 << info->bits[c] ) - 1;
+        self->job.scale[c] = self->job.max[c] / 255.f;
+    }
+
+    self->job.format = format;
+    self->job.data = data;
+    self->job.width = width;
+    self->job.height = height;
+    self->job.stride = stride;
+    self->job.band_count = ( height + WW_PATTERN_BAND_HEIGHT - 1 ) / WW_PATTERN_BAND_HEIGHT;
+    self->job.next_band = 0;
+
+    switch ( self->type )
+    {
+    case WW_PATTERN_LINEAR:
+    {
+        /* Project the corners on the gradient axis to find its extent */
+        double a = self->angle * M_PI / 180.;
+        double c = cos(a), s = sin(a);
+        double p[4] = { 0, width * c, height * s, width * c + height * s };
+        double min = p[0], max = p[0];
+        for ( int i = 1 ; i < 4 ; ++i )
+        {
+            min = MIN(min, p[i]);
+            max = MAX(max, p[i]);
+        }
+        double range = ( max > min ) ? ( max - min ) : 1.;
+        self->job.dx = c / range;
+        self->job.dy = s / range;
+        self->job.t0 = -min / range;
+    }
+    break;
+    case WW_PATTERN_RADIAL:
+        self->job.cx = width / 2.f;
+        self->job.cy = height / 2.f;
+        self->job.inv_radius = 1.f / MAX(sqrtf(self->job.cx * self->job.cx + self->job.cy * self->job.cy), 1.f);
+    break;
+    }
+
+    pthread_mutex_lock(&self->mutex);
+    self->running = self->thread_count - 1;
+    ++self->generation;
+    pthread_cond_broadcast(&self->start_cond);
+    pthread_mutex_unlock(&self->mutex);
+
+    _ww_pattern_run_bands(self);
+
+    pthread_mutex_lock(&self->mutex);
+    while ( self->running > 0 )
+        pthread_cond_wait(&self->done_cond, &self->mutex);
+    pthread_mutex_unlock(&self->mutex);
+}
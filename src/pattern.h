@@ -0,0 +1,44 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef __WW_PATTERN_H__
+#define __WW_PATTERN_H__
+
+#include "helpers.h"
+#include "format.h"
+
+typedef struct _WwPattern WwPattern;
+
+/*
+ * Spec is one of:
+ *     linear:<angle>:<colour>:<colour>
+ *     radial:<colour>:<colour>
+ * with angle in degrees, clockwise from left-to-right
+ */
+WwPattern *ww_pattern_new(const char *spec, double noise, size_t thread_count);
+void ww_pattern_free(WwPattern *self);
+
+/* Renders in bands split across the thread pool */
+void ww_pattern_render(WwPattern *self, WwFormat format, uint8_t *data, int32_t width, int32_t height, int32_t stride);
+
+#endif /* __WW_PATTERN_H__ */
@@ -0,0 +1,136 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "helpers.h"
+
+#include <sys/eventfd.h>
+
+#include "queue.h"
+
+struct _WwQueue {
+    int fd;
+    size_t element_size;
+    size_t mask;
+    uint8_t *elements;
+    /* Free-running, each written by one side only */
+    size_t head;
+    size_t tail;
+    bool signaled;
+};
+
+WwQueue *
+ww_queue_new(size_t element_size, size_t capacity)
+{
+    WwQueue *self;
+
+    /* Power of two, so indexes wrap with a mask */
+    assert(( capacity > 0 ) && ( ( capacity & ( capacity - 1 ) ) == 0 ));
+
+    self = ww_new0(WwQueue, 1);
+    if ( self == NULL )
+        return NULL;
+
+    self->element_size = element_size;
+    self->mask = capacity - 1;
+    self->elements = calloc(element_size, capacity);
+    if ( self->elements == NULL )
+    {
+        free(self);
+        return NULL;
+    }
+
+    self->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if ( self->fd < 0 )
+    {
+        ww_warning("Couldn’t create queue eventfd: %s", strerror(errno));
+        free(self->elements);
+        free(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+void
+ww_queue_free(WwQueue *self)
+{
+    close(self->fd);
+    free(self->elements);
+    free(self);
+}
+
+int
+ww_queue_get_fd(WwQueue *self)
+{
+    return self->fd;
+}
+
+bool
+ww_queue_push(WwQueue *self, const void *element)
+{
+    size_t tail = self->tail;
+    size_t head = __atomic_load_n(&self->head, __ATOMIC_ACQUIRE);
+
+    if ( tail - head > self->mask )
+        return false;
+
+    memcpy(self->elements + ( tail & self->mask ) * self->element_size, element, self->element_size);
+    __atomic_store_n(&self->tail, tail + 1, __ATOMIC_SEQ_CST);
+
+    /* Only wake the consumer once per batch */
+    if ( ! __atomic_exchange_n(&self->signaled, true, __ATOMIC_SEQ_CST) )
+    {
+        uint64_t one = 1;
+        if ( write(self->fd, &one, sizeof(one)) < 0 )
+            ww_warning("Couldn’t wake queue consumer: %s", strerror(errno));
+    }
+
+    return true;
+}
+
+bool
+ww_queue_pop(WwQueue *self, void *element)
+{
+    size_t head = self->head;
+    size_t tail = __atomic_load_n(&self->tail, __ATOMIC_ACQUIRE);
+
+    if ( head == tail )
+    {
+        /*
+         * Clear our wake-up, then check again for a push that raced us
+         * A late write only costs a spurious wake-up
+         */
+        uint64_t count;
+        __atomic_store_n(&self->signaled, false, __ATOMIC_SEQ_CST);
+        if ( ( read(self->fd, &count, sizeof(count)) < 0 ) && ( errno != EAGAIN ) )
+            ww_warning("Couldn’t clear queue eventfd: %s", strerror(errno));
+        tail = __atomic_load_n(&self->tail, __ATOMIC_SEQ_CST);
+        if ( head == tail )
+            return false;
+    }
+
+    memcpy(element, self->elements + ( head & self->mask ) * self->element_size, self->element_size);
+    __atomic_store_n(&self->head, head + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
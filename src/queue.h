@@ -0,0 +1,45 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef __WW_QUEUE_H__
+#define __WW_QUEUE_H__
+
+#include "helpers.h"
+
+typedef struct _WwQueue WwQueue;
+
+/*
+ * Lock-free single-producer single-consumer ring of fixed-size elements
+ * The fd is readable while elements are pending, for poll() or ww_loop_add_fd()
+ */
+WwQueue *ww_queue_new(size_t element_size, size_t capacity);
+void ww_queue_free(WwQueue *self);
+int ww_queue_get_fd(WwQueue *self);
+
+/* Producer side, returns false if the ring is full */
+bool ww_queue_push(WwQueue *self, const void *element);
+
+/* Consumer side, pops until empty, the fd is cleared first so no wake-up is lost */
+bool ww_queue_pop(WwQueue *self, void *element);
+
+#endif /* __WW_QUEUE_H__ */
@@ -0,0 +1,92 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "helpers.h"
+
+#include <signal.h>
+#include <pthread.h>
+
+#include "client.h"
+#include "loop.h"
+#include "stats.h"
+#include "role.h"
+
+int
+ww_role_run(const char *name, WwRoleInstance *instances, size_t count)
+{
+    WwClient *client;
+    int status = 0;
+    size_t i;
+
+    ww_stats_start_time = ww_stats_now();
+    setlocale(LC_ALL, "");
+
+    /*
+     * Dumped from the stats signalfd, role init() may start threads
+     * which must inherit the mask so that they never take it
+     */
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+    for ( i = 0 ; i < count ; ++i )
+    {
+        /* Each role has its own argument vector, getopt() must start over */
+        optind = 1;
+        instances[i].data = instances[i].role->init(instances[i].argc, instances[i].argv, &status);
+        if ( instances[i].data == NULL )
+            return status;
+    }
+
+    client = ww_client_new(name);
+    if ( client == NULL )
+        return 2;
+
+    for ( i = 0 ; i < count ; ++i )
+    {
+        if ( ! instances[i].role->attach(instances[i].data, client) )
+            return 2;
+    }
+
+    if ( ! ww_client_connect(client) )
+    {
+        ww_warning("Couldn’t get the compositor globals: %s", strerror(errno));
+        return 2;
+    }
+
+    for ( i = 0 ; i < count ; ++i )
+    {
+        status = instances[i].role->start(instances[i].data);
+        if ( status != 0 )
+        {
+            ww_client_disconnect(client);
+            return status;
+        }
+    }
+
+    if ( ww_loop_run(client->loop) < 0 )
+        ww_warning("Couldn’t dispatch events: %s", strerror(errno));
+
+    return 0;
+}
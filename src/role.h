@@ -0,0 +1,61 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef __WW_ROLE_H__
+#define __WW_ROLE_H__
+
+#include "helpers.h"
+#include "client.h"
+
+/*
+ * A client role, several of them can share one WwClient
+ * init() parses its options, before any connection, and returns NULL
+ * with *status set to the exit status on failure, or once done if the
+ * role needs no compositor for this run
+ * attach() registers globals, listeners and loop sources on the client
+ * start() runs once connected and returns 0 or the exit status
+ */
+typedef struct {
+    const char *name;
+    void *(*init)(int argc, char *argv[], int *status);
+    bool (*attach)(void *data, WwClient *client);
+    int (*start)(void *data);
+} WwRole;
+
+typedef struct {
+    const WwRole *role;
+    int argc;
+    char **argv;
+    void *data;
+} WwRoleInstance;
+
+extern const WwRole ww_background_role;
+extern const WwRole ww_dock_role;
+extern const WwRole ww_launcher_role;
+extern const WwRole ww_notify_role;
+extern const WwRole ww_switcher_role;
+
+/* Runs the roles on one client until the connection ends, name is used for the stats socket */
+int ww_role_run(const char *name, WwRoleInstance *instances, size_t count);
+
+#endif /* __WW_ROLE_H__ */
@@ -0,0 +1,407 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "helpers.h"
+
+#include <ctype.h>
+#include "hash.h"
+#include "search.h"
+
+#define WW_SEARCH_MIN_SIZE 16
+
+/* Longer queries are truncated */
+#define WW_SEARCH_QUERY_MAX 256
+
+/* Sorted ids of the entries containing a trigram */
+typedef struct {
+    uint32_t *ids;
+    size_t count;
+    size_t size;
+} WwSearchPosting;
+
+typedef struct {
+    /* NULL for a free slot */
+    void *data;
+    /* Folded fields, separated by newlines */
+    char *text;
+    /* Sorted and distinct */
+    uint32_t *trigrams;
+    size_t trigram_count;
+} WwSearchSlot;
+
+struct _WwSearch {
+    WwSearchSlot *slots;
+    size_t size;
+    size_t count;
+    uint32_t *free_ids;
+    size_t free_count;
+    size_t free_size;
+    /* Trigram to WwSearchPosting */
+    WwHash postings;
+    /* Valid until the next change, for refining */
+    bool results_valid;
+    char last_query[WW_SEARCH_QUERY_MAX];
+    uint32_t *results;
+    size_t result_count;
+    size_t result_size;
+};
+
+static bool
+_ww_search_grow(void **array, size_t *size, size_t needed, size_t element_size)
+{
+    if ( needed <= *size )
+        return true;
+
+    size_t size_ = MAX(*size, WW_SEARCH_MIN_SIZE);
+    while ( size_ < needed )
+        size_ *= 2;
+
+    void *new_array = realloc(*array, size_ * element_size);
+    if ( new_array == NULL )
+        return false;
+    *array = new_array;
+    *size = size_;
+    return true;
+}
+
+/* Bytes are never 0 in a string, so neither is the key */
+static inline uint32_t
+_ww_search_trigram(const char *s)
+{
+    return (uint32_t) (uint8_t) s[0] << 16 | (uint32_t) (uint8_t) s[1] << 8 | (uint8_t) s[2];
+}
+
+static int
+_ww_search_compare(const void *a_, const void *b_)
+{
+    uint32_t a = *(const uint32_t *) a_, b = *(const uint32_t *) b_;
+    return ( a > b ) - ( a < b );
+}
+
+static size_t
+_ww_search_fold(char *dest, const char *src, size_t size)
+{
+    size_t i;
+    for ( i = 0 ; ( i + 1 < size ) && ( src[i] != '\0' ) ; ++i )
+        dest[i] = ( src[i] == '\n' ) ? ' ' : tolower((unsigned char) src[i]);
+    dest[i] = '\0';
+    return i;
+}
+
+/* Each posting search is a binary search, insert and remove keep the order */
+static size_t
+_ww_search_posting_find(const WwSearchPosting *self, uint32_t id)
+{
+    size_t low = 0, high = self->count;
+    while ( low < high )
+    {
+        size_t middle = low + ( high - low ) / 2;
+        if ( self->ids[middle] < id )
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+static bool
+_ww_search_posting_add(WwSearch *self, uint32_t trigram, uint32_t id)
+{
+    WwSearchPosting *posting = ww_hash_lookup(&self->postings, trigram);
+    if ( posting == NULL )
+    {
+        posting = ww_new0(WwSearchPosting, 1);
+        if ( posting == NULL )
+            return false;
+        if ( ! ww_hash_insert(&self->postings, trigram, posting) )
+        {
+            free(posting);
+            return false;
+        }
+    }
+
+    if ( ! _ww_search_grow((void **) &posting->ids, &posting->size, posting->count + 1, sizeof(uint32_t)) )
+        return false;
+
+    size_t i = _ww_search_posting_find(posting, id);
+    memmove(posting->ids + i + 1, posting->ids + i, ( posting->count - i ) * sizeof(uint32_t));
+    posting->ids[i] = id;
+    ++posting->count;
+    return true;
+}
+
+static void
+_ww_search_posting_remove(WwSearch *self, uint32_t trigram, uint32_t id)
+{
+    WwSearchPosting *posting = ww_hash_lookup(&self->postings, trigram);
+    if ( posting == NULL )
+        return;
+
+    size_t i = _ww_search_posting_find(posting, id);
+    if ( ( i == posting->count ) || ( posting->ids[i] != id ) )
+        return;
+    memmove(posting->ids + i, posting->ids + i + 1, ( posting->count - i - 1 ) * sizeof(uint32_t));
+
+    if ( --posting->count > 0 )
+        return;
+    ww_hash_remove(&self->postings, trigram);
+    free(posting->ids);
+    free(posting);
+}
+
+WwSearch *
+ww_search_new(void)
+{
+    WwSearch *self;
+
+    self = ww_new0(WwSearch, 1);
+    if ( self == NULL )
+        return NULL;
+
+    ww_hash_init(&self->postings);
+
+    return self;
+}
+
+void
+ww_search_free(WwSearch *self)
+{
+    size_t i;
+
+    for ( i = 0 ; i < self->postings.size ; ++i )
+    {
+        WwSearchPosting *posting = self->postings.entries[i].value;
+        if ( self->postings.entries[i].key == 0 )
+            continue;
+        free(posting->ids);
+        free(posting);
+    }
+    ww_hash_clear(&self->postings);
+
+    for ( i = 0 ; i < self->count ; ++i )
+    {
+        free(self->slots[i].trigrams);
+        free(self->slots[i].text);
+    }
+    free(self->slots);
+    free(self->free_ids);
+    free(self->results);
+    free(self);
+}
+
+bool
+ww_search_add(WwSearch *self, void *data, uint32_t *id)
+{
+    if ( self->free_count > 0 )
+        *id = self->free_ids[--self->free_count];
+    else
+    {
+        if ( ! _ww_search_grow((void **) &self->slots, &self->size, self->count + 1, sizeof(WwSearchSlot)) )
+            return false;
+        *id = self->count++;
+    }
+
+    self->slots[*id] = (WwSearchSlot) { .data = data };
+    return true;
+}
+
+void
+ww_search_remove(WwSearch *self, uint32_t id)
+{
+    WwSearchSlot *slot = &self->slots[id];
+    size_t i;
+
+    for ( i = 0 ; i < slot->trigram_count ; ++i )
+        _ww_search_posting_remove(self, slot->trigrams[i], id);
+    free(slot->trigrams);
+    free(slot->text);
+    *slot = (WwSearchSlot) { .data = NULL };
+
+    /* Leaked on failure, the slot just stays unused */
+    if ( _ww_search_grow((void **) &self->free_ids, &self->free_size, self->free_count + 1, sizeof(uint32_t)) )
+        self->free_ids[self->free_count++] = id;
+    self->results_valid = false;
+}
+
+bool
+ww_search_set_fields(WwSearch *self, uint32_t id, const char * const *fields, size_t count)
+{
+    WwSearchSlot *slot = &self->slots[id];
+    size_t length = 0, i;
+
+    for ( i = 0 ; i < count ; ++i )
+        length += ( fields[i] != NULL ) ? strlen(fields[i]) + 1 : 1;
+
+    char *text = malloc(length + 1);
+    uint32_t *trigrams = ( length > 2 ) ? ww_new0(uint32_t, length - 2) : NULL;
+    if ( ( text == NULL ) || ( ( length > 2 ) && ( trigrams == NULL ) ) )
+    {
+        free(trigrams);
+        free(text);
+        return false;
+    }
+
+    char *p = text;
+    for ( i = 0 ; i < count ; ++i )
+    {
+        if ( fields[i] != NULL )
+            p += _ww_search_fold(p, fields[i], SIZE_MAX);
+        *p++ = '\n';
+    }
+    *p = '\0';
+
+    /* Trigrams across fields would never match a query word */
+    size_t trigram_count = 0;
+    for ( p = text ; ( p[0] != '\0' ) && ( p[1] != '\0' ) && ( p[2] != '\0' ) ; ++p )
+    {
+        if ( ( p[0] != '\n' ) && ( p[1] != '\n' ) && ( p[2] != '\n' ) )
+            trigrams[trigram_count++] = _ww_search_trigram(p);
+    }
+    qsort(trigrams, trigram_count, sizeof(uint32_t), _ww_search_compare);
+    size_t distinct = 0;
+    for ( i = 0 ; i < trigram_count ; ++i )
+    {
+        if ( ( distinct == 0 ) || ( trigrams[distinct - 1] != trigrams[i] ) )
+            trigrams[distinct++] = trigrams[i];
+    }
+    trigram_count = distinct;
+
+    /* Both sorted, walk them together */
+    size_t o = 0, n = 0;
+    bool good = true;
+    while ( ( o < slot->trigram_count ) || ( n < trigram_count ) )
+    {
+        if ( ( n == trigram_count ) || ( ( o < slot->trigram_count ) && ( slot->trigrams[o] < trigrams[n] ) ) )
+            _ww_search_posting_remove(self, slot->trigrams[o++], id);
+        else if ( ( o == slot->trigram_count ) || ( trigrams[n] < slot->trigrams[o] ) )
+            good = _ww_search_posting_add(self, trigrams[n++], id) && good;
+        else
+            ++o, ++n;
+    }
+
+    free(slot->trigrams);
+    free(slot->text);
+    slot->text = text;
+    slot->trigrams = trigrams;
+    slot->trigram_count = trigram_count;
+    self->results_valid = false;
+
+    return good;
+}
+
+static bool
+_ww_search_match(const WwSearchSlot *slot, char * const *words, size_t count)
+{
+    size_t i;
+
+    if ( slot->text == NULL )
+        return false;
+
+    for ( i = 0 ; i < count ; ++i )
+    {
+        if ( strstr(slot->text, words[i]) == NULL )
+            return false;
+    }
+    return true;
+}
+
+/* The shortest posting list of any trigram of any word, NULL if the query has no trigram */
+static const WwSearchPosting *
+_ww_search_get_candidates(WwSearch *self, char * const *words, size_t count)
+{
+    static const WwSearchPosting empty = { .count = 0 };
+    const WwSearchPosting *candidates = NULL;
+    size_t i;
+    char *p;
+
+    for ( i = 0 ; i < count ; ++i )
+    {
+        for ( p = words[i] ; ( p[0] != '\0' ) && ( p[1] != '\0' ) && ( p[2] != '\0' ) ; ++p )
+        {
+            const WwSearchPosting *posting = ww_hash_lookup(&self->postings, _ww_search_trigram(p));
+            if ( posting == NULL )
+                return &empty;
+            if ( ( candidates == NULL ) || ( posting->count < candidates->count ) )
+                candidates = posting;
+        }
+    }
+    return candidates;
+}
+
+size_t
+ww_search_query(WwSearch *self, const char *query, WwSearchFunc func, void *user_data)
+{
+    char folded[WW_SEARCH_QUERY_MAX];
+    char *words[WW_SEARCH_QUERY_MAX / 2];
+    size_t count = 0, i;
+
+    size_t length = _ww_search_fold(folded, query, sizeof(folded));
+    bool refine = self->results_valid && ( strncmp(folded, self->last_query, strlen(self->last_query)) == 0 );
+    memcpy(self->last_query, folded, length + 1);
+
+    char *p = folded;
+    while ( *p != '\0' )
+    {
+        while ( *p == ' ' )
+            *p++ = '\0';
+        if ( *p == '\0' )
+            break;
+        words[count++] = p;
+        while ( ( *p != ' ' ) && ( *p != '\0' ) )
+            ++p;
+    }
+
+    size_t result_count = 0;
+    if ( refine )
+    {
+        /* Every word of the previous query is in one of ours, only its results can match */
+        for ( i = 0 ; i < self->result_count ; ++i )
+        {
+            uint32_t id = self->results[i];
+            if ( _ww_search_match(&self->slots[id], words, count) )
+                self->results[result_count++] = id;
+        }
+    }
+    else
+    {
+        const WwSearchPosting *candidates = _ww_search_get_candidates(self, words, count);
+        size_t candidate_count = ( candidates != NULL ) ? candidates->count : self->count;
+
+        self->results_valid = _ww_search_grow((void **) &self->results, &self->result_size, candidate_count, sizeof(uint32_t));
+        if ( ! self->results_valid )
+            return 0;
+
+        for ( i = 0 ; i < candidate_count ; ++i )
+        {
+            uint32_t id = ( candidates != NULL ) ? candidates->ids[i] : i;
+            if ( _ww_search_match(&self->slots[id], words, count) )
+                self->results[result_count++] = id;
+        }
+    }
+    self->result_count = result_count;
+
+    for ( i = 0 ; i < result_count ; ++i )
+        func(user_data, self->slots[self->results[i]].data);
+
+    return result_count;
+}
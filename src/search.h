@@ -0,0 +1,55 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef __WW_SEARCH_H__
+#define __WW_SEARCH_H__
+
+#include "helpers.h"
+
+/*
+ * Entries made of a few text fields, with a trigram index so that
+ * queries only check the entries sharing the rarest trigram of a word
+ * Matching is case-insensitive for ASCII, every space-separated word
+ * of the query must appear in one of the fields
+ */
+typedef struct _WwSearch WwSearch;
+
+typedef void (*WwSearchFunc)(void *user_data, void *data);
+
+WwSearch *ww_search_new(void);
+void ww_search_free(WwSearch *self);
+
+/* The entry matches nothing until its fields are set */
+bool ww_search_add(WwSearch *self, void *data, uint32_t *id);
+void ww_search_remove(WwSearch *self, uint32_t id);
+
+/* Only the trigrams that changed are updated in the index */
+bool ww_search_set_fields(WwSearch *self, uint32_t id, const char * const *fields, size_t count);
+
+/*
+ * Calls func for each matching entry, in id order, returns the count
+ * A query extending the previous one only checks its results
+ */
+size_t ww_search_query(WwSearch *self, const char *query, WwSearchFunc func, void *user_data);
+
+#endif /* __WW_SEARCH_H__ */
@@ -0,0 +1,185 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "helpers.h"
+
+#include <ctype.h>
+#include <libgen.h>
+#include <sys/inotify.h>
+
+#include "loop.h"
+#include "settings.h"
+
+struct _WwSettingsWatch {
+    WwLoopSource *source;
+    int fd;
+    char *name;
+    WwSettingsChangedCallback callback;
+    void *user_data;
+};
+
+static char *
+_ww_settings_strip(char *s)
+{
+    char *e;
+
+    while ( isspace((unsigned char) *s) )
+        ++s;
+    e = s + strlen(s);
+    while ( ( e > s ) && isspace((unsigned char) e[-1]) )
+        --e;
+    *e = '\0';
+
+    return s;
+}
+
+bool
+ww_settings_parse(const char *path, WwSettingsEntryCallback callback, void *user_data)
+{
+    FILE *f;
+
+    f = fopen(path, "re");
+    if ( f == NULL )
+    {
+        ww_warning("Couldn’t open settings file %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    char *line = NULL;
+    size_t size = 0;
+    size_t n = 0;
+    while ( getline(&line, &size, f) >= 0 )
+    {
+        char *key, *value;
+
+        ++n;
+        key = _ww_settings_strip(line);
+        if ( ( *key == '\0' ) || ( *key == '#' ) )
+            continue;
+
+        value = strchr(key, '=');
+        if ( value == NULL )
+        {
+            ww_warning("%s:%zu: Missing '='", path, n);
+            continue;
+        }
+        *value++ = '\0';
+
+        callback(user_data, _ww_settings_strip(key), _ww_settings_strip(value));
+    }
+
+    free(line);
+    fclose(f);
+
+    return true;
+}
+
+static void
+_ww_settings_watch_callback(void *user_data, uint32_t events)
+{
+    WwSettingsWatch *self = user_data;
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool changed = false;
+    ssize_t r;
+
+    /* Editors generate a burst of events, we only reload once for all of them */
+    while ( ( r = read(self->fd, buffer, sizeof(buffer)) ) > 0 )
+    {
+        const struct inotify_event *event;
+        char *p;
+        for ( p = buffer ; p < buffer + r ; p += sizeof(struct inotify_event) + event->len )
+        {
+            event = (const struct inotify_event *) p;
+            if ( ( event->len > 0 ) && ( strcmp(event->name, self->name) == 0 ) )
+                changed = true;
+        }
+    }
+
+    if ( changed )
+        self->callback(self->user_data);
+}
+
+WwSettingsWatch *
+ww_settings_watch_new(WwLoop *loop, const char *path, WwSettingsChangedCallback callback, void *user_data)
+{
+    WwSettingsWatch *self;
+    char *dir_copy, *name_copy;
+
+    self = ww_new0(WwSettingsWatch, 1);
+    if ( self == NULL )
+        return NULL;
+
+    dir_copy = strdup(path);
+    name_copy = strdup(path);
+    if ( ( dir_copy == NULL ) || ( name_copy == NULL ) )
+        goto fail;
+
+    self->name = strdup(basename(name_copy));
+    if ( self->name == NULL )
+        goto fail;
+    self->callback = callback;
+    self->user_data = user_data;
+
+    self->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if ( self->fd < 0 )
+    {
+        ww_warning("Couldn’t create inotify fd: %s", strerror(errno));
+        goto fail;
+    }
+
+    if ( inotify_add_watch(self->fd, dirname(dir_copy), IN_CLOSE_WRITE | IN_MOVED_TO) < 0 )
+    {
+        ww_warning("Couldn’t watch %s: %s", path, strerror(errno));
+        goto fail_fd;
+    }
+
+    self->source = ww_loop_add_fd(loop, self->fd, EPOLLIN, _ww_settings_watch_callback, self);
+    if ( self->source == NULL )
+        goto fail_fd;
+
+    free(name_copy);
+    free(dir_copy);
+
+    return self;
+
+fail_fd:
+    close(self->fd);
+fail:
+    free(name_copy);
+    free(dir_copy);
+    free(self->name);
+    free(self);
+    return NULL;
+}
+
+void
+ww_settings_watch_free(WwSettingsWatch *self)
+{
+    if ( self == NULL )
+        return;
+
+    ww_loop_source_free(self->source);
+    close(self->fd);
+    free(self->name);
+    free(self);
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef __WW_SETTINGS_H__
+#define __WW_SETTINGS_H__
+
+#include "helpers.h"
+#include "loop.h"
+
+typedef struct _WwSettingsWatch WwSettingsWatch;
+
+typedef void (*WwSettingsEntryCallback)(void *user_data, const char *key, const char *value);
+typedef void (*WwSettingsChangedCallback)(void *user_data);
+
+/* Files are made of “key = value” lines, '#' starts a comment line */
+bool ww_settings_parse(const char *path, WwSettingsEntryCallback callback, void *user_data);
+
+/* Watches the directory so that editors replacing the file are caught too */
+WwSettingsWatch *ww_settings_watch_new(WwLoop *loop, const char *path, WwSettingsChangedCallback callback, void *user_data);
+void ww_settings_watch_free(WwSettingsWatch *self);
+
+#endif /* __WW_SETTINGS_H__ */
@@ -0,0 +1,106 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "helpers.h"
+
+#include "role.h"
+
+static const WwRole * const _ww_shell_roles[] = {
+    &ww_background_role,
+    &ww_dock_role,
+    &ww_launcher_role,
+    &ww_notify_role,
+    &ww_switcher_role,
+};
+
+static const WwRole *
+_ww_shell_find_role(const char *name)
+{
+    size_t i;
+    for ( i = 0 ; i < sizeof(_ww_shell_roles) / sizeof(*_ww_shell_roles) ; ++i )
+    {
+        if ( strcmp(_ww_shell_roles[i]->name, name) == 0 )
+            return _ww_shell_roles[i];
+    }
+    return NULL;
+}
+
+static void
+_ww_shell_usage(const char *name)
+{
+    size_t i;
+
+    fprintf(stderr, ""
+        "Usage:"
+        "\n    %s <role> [OPTION...] [-- <role> [OPTION...]...] - Wayland Wall clients in one process"
+        "\n"
+        "\nRoles:", name);
+    for ( i = 0 ; i < sizeof(_ww_shell_roles) / sizeof(*_ww_shell_roles) ; ++i )
+        fprintf(stderr, "\n    %s", _ww_shell_roles[i]->name);
+    fprintf(stderr, ""
+        "\n"
+        "\nRoles take the options of their own client, see “%s <role> --help”"
+        "\n\n", name);
+}
+
+int
+main(int argc, char *argv[])
+{
+    WwRoleInstance *instances;
+    size_t count = 0;
+    int i, start;
+
+    /* At most one role per -- separated segment */
+    instances = ww_new0(WwRoleInstance, argc);
+    if ( instances == NULL )
+        return 2;
+
+    for ( start = i = 1 ; i <= argc ; ++i )
+    {
+        if ( ( i < argc ) && ( strcmp(argv[i], "--") != 0 ) )
+            continue;
+
+        if ( i == start )
+        {
+            _ww_shell_usage(argv[0]);
+            return 1;
+        }
+
+        instances[count].role = _ww_shell_find_role(argv[start]);
+        if ( instances[count].role == NULL )
+        {
+            fprintf(stderr, "Unknown role “%s”\n\n", argv[start]);
+            _ww_shell_usage(argv[0]);
+            return 1;
+        }
+
+        /* Each role sees its name as argv[0], and a NULL-terminated vector */
+        argv[i] = NULL;
+        instances[count].argc = i - start;
+        instances[count].argv = argv + start;
+        ++count;
+        start = i + 1;
+    }
+
+    return ww_role_run("ww-shell", instances, count);
+}
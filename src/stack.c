@@ -0,0 +1,240 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "helpers.h"
+
+#include "stack.h"
+
+#define WW_STACK_MIN_SIZE 16
+
+struct _WwStack {
+    /* By slot, NULL once removed, new entries go right above head */
+    WwStackEntry **entries;
+    /* 1-based Fenwick tree over the sizes by slot */
+    int64_t *tree;
+    size_t size;
+    size_t head;
+    size_t count;
+    /* First slot whose offset may have changed, size if none */
+    size_t changed;
+    /* Past the last slot that may be placed */
+    size_t placed_end;
+    int32_t limit;
+    bool invalidated;
+};
+
+static void
+_ww_stack_tree_add(WwStack *self, size_t slot, int64_t value)
+{
+    size_t i;
+    for ( i = slot + 1 ; i <= self->size ; i += i & -i )
+        self->tree[i] += value;
+}
+
+/* Sum of the sizes of slots before slot */
+static int64_t
+_ww_stack_tree_prefix(const WwStack *self, size_t slot)
+{
+    int64_t sum = 0;
+    size_t i;
+    for ( i = slot ; i > 0 ; i -= i & -i )
+        sum += self->tree[i];
+    return sum;
+}
+
+/* Packs the live entries at the end of a new array, with room above for size - count new ones */
+static bool
+_ww_stack_rebuild(WwStack *self, size_t size)
+{
+    WwStackEntry **entries;
+    int64_t *tree;
+
+    entries = ww_new0(WwStackEntry *, size);
+    tree = ww_new0(int64_t, size + 1);
+    if ( ( entries == NULL ) || ( tree == NULL ) )
+    {
+        free(tree);
+        free(entries);
+        return false;
+    }
+
+    size_t head = size - self->count, slot = head, i;
+    size_t changed = size;
+    for ( i = self->head ; i < self->size ; ++i )
+    {
+        WwStackEntry *entry = self->entries[i];
+        if ( entry == NULL )
+            continue;
+        if ( ( changed == size ) && ( i >= self->changed ) )
+            changed = slot;
+        entry->slot = slot;
+        entries[slot] = entry;
+        tree[slot + 1] += entry->size;
+        ++slot;
+    }
+
+    /* Linear build, each node pushes its sum to its parent */
+    for ( i = 1 ; i <= size ; ++i )
+    {
+        size_t parent = i + ( i & -i );
+        if ( parent <= size )
+            tree[parent] += tree[i];
+    }
+
+    free(self->tree);
+    free(self->entries);
+    self->entries = entries;
+    self->tree = tree;
+    self->size = size;
+    self->head = head;
+    self->changed = changed;
+    self->placed_end = size;
+    return true;
+}
+
+WwStack *
+ww_stack_new(void)
+{
+    WwStack *self;
+
+    self = ww_new0(WwStack, 1);
+    if ( self == NULL )
+        return NULL;
+
+    if ( ! _ww_stack_rebuild(self, WW_STACK_MIN_SIZE) )
+    {
+        free(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+void
+ww_stack_free(WwStack *self)
+{
+    free(self->tree);
+    free(self->entries);
+    free(self);
+}
+
+bool
+ww_stack_insert(WwStack *self, WwStackEntry *entry, int32_t size)
+{
+    if ( ( self->head == 0 ) && ( ! _ww_stack_rebuild(self, MAX(WW_STACK_MIN_SIZE, ( self->count + 1 ) * 2)) ) )
+        return false;
+
+    entry->slot = --self->head;
+    entry->size = size;
+    entry->offset = -1;
+    self->entries[entry->slot] = entry;
+    _ww_stack_tree_add(self, entry->slot, size);
+    ++self->count;
+
+    self->changed = entry->slot;
+    return true;
+}
+
+void
+ww_stack_remove(WwStack *self, WwStackEntry *entry)
+{
+    self->entries[entry->slot] = NULL;
+    _ww_stack_tree_add(self, entry->slot, -entry->size);
+    --self->count;
+    self->changed = MIN(self->changed, entry->slot);
+
+    /* Keep the walk from the changed slot bounded by the live entries */
+    size_t removed = self->size - self->head - self->count;
+    if ( removed > self->count + WW_STACK_MIN_SIZE )
+        _ww_stack_rebuild(self, MAX(WW_STACK_MIN_SIZE, self->count * 2));
+}
+
+void
+ww_stack_resize(WwStack *self, WwStackEntry *entry, int32_t size)
+{
+    if ( entry->size == size )
+        return;
+
+    _ww_stack_tree_add(self, entry->slot, size - entry->size);
+    entry->size = size;
+    self->changed = MIN(self->changed, entry->slot);
+}
+
+int64_t
+ww_stack_get_offset(const WwStack *self, const WwStackEntry *entry)
+{
+    return _ww_stack_tree_prefix(self, entry->slot);
+}
+
+void
+ww_stack_invalidate(WwStack *self)
+{
+    self->changed = self->head;
+    self->placed_end = self->size;
+    self->invalidated = true;
+}
+
+size_t
+ww_stack_place(WwStack *self, int32_t limit, WwStackPlaceFunc func, void *user_data)
+{
+    if ( limit != self->limit )
+    {
+        /* Any placed entry may now be past it, or unplaced ones fit */
+        self->changed = self->head;
+        self->placed_end = self->size;
+        self->limit = limit;
+    }
+
+    size_t slot = self->changed, placed_end = 0, calls = 0;
+    int64_t offset = _ww_stack_tree_prefix(self, slot);
+    bool fits = true;
+
+    for ( ; slot < self->size ; ++slot )
+    {
+        WwStackEntry *entry = self->entries[slot];
+        if ( entry == NULL )
+            continue;
+
+        fits = fits && ( offset + entry->size <= limit );
+        if ( ( ! fits ) && ( slot >= self->placed_end ) )
+            /* Nothing placed further down */
+            break;
+
+        int32_t placed = fits ? offset : -1;
+        if ( fits )
+            placed_end = slot + 1;
+        if ( self->invalidated || ( entry->offset != placed ) )
+        {
+            entry->offset = placed;
+            func(user_data, entry);
+            ++calls;
+        }
+        offset += entry->size;
+    }
+
+    /* Before changed, placed entries did not move */
+    self->placed_end = ( placed_end > 0 ) ? placed_end : MIN(self->placed_end, self->changed);
+    self->changed = self->size;
+    self->invalidated = false;
+    return calls;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef __WW_STACK_H__
+#define __WW_STACK_H__
+
+#include "helpers.h"
+
+/*
+ * Entries stacked top to bottom, newest on top, with their offsets kept
+ * as prefix sums of their sizes in a Fenwick tree
+ * Embed an entry in your struct, the stack never owns it
+ */
+typedef struct {
+    size_t slot;
+    int32_t size;
+    /* From the top of the stack, -1 when not placed */
+    int32_t offset;
+} WwStackEntry;
+
+typedef struct _WwStack WwStack;
+
+/* Called for each entry whose offset changed, offset is -1 past the limit */
+typedef void (*WwStackPlaceFunc)(void *user_data, WwStackEntry *entry);
+
+WwStack *ww_stack_new(void);
+void ww_stack_free(WwStack *self);
+
+bool ww_stack_insert(WwStack *self, WwStackEntry *entry, int32_t size);
+void ww_stack_remove(WwStack *self, WwStackEntry *entry);
+void ww_stack_resize(WwStack *self, WwStackEntry *entry, int32_t size);
+
+/* Offset the entry would be placed at, in O(log n) */
+int64_t ww_stack_get_offset(const WwStack *self, const WwStackEntry *entry);
+
+/* Calls func for every placed entry on the next ww_stack_place() */
+void ww_stack_invalidate(WwStack *self);
+
+/*
+ * Places entries from the first one changed since the last call,
+ * stopping once past the limit and the previously placed ones
+ * Entries stay in one run from the top, those past the limit are unplaced
+ * Returns the number of calls to func
+ */
+size_t ww_stack_place(WwStack *self, int32_t limit, WwStackPlaceFunc func, void *user_data);
+
+#endif /* __WW_STACK_H__ */
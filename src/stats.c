@@ -0,0 +1,273 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "helpers.h"
+
+#include <inttypes.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "loop.h"
+#include "stats.h"
+
+int64_t ww_stats_counters[_WW_STATS_SIZE];
+int64_t ww_stats_histograms[_WW_STATS_HISTOGRAM_SIZE][WW_STATS_HISTOGRAM_BUCKETS];
+int64_t ww_stats_start_time;
+int64_t ww_stats_first_commit_time;
+
+static const char * const _ww_stats_counter_names[_WW_STATS_SIZE] = {
+    [WW_STATS_BYTES_MAPPED] = "bytes-mapped",
+    [WW_STATS_POOLS_CREATED] = "pools-created",
+    [WW_STATS_BUFFERS_CREATED] = "buffers-created",
+    [WW_STATS_BUFFERS_RELEASED] = "buffers-released",
+    [WW_STATS_BUFFERS_HELD] = "buffers-held",
+    [WW_STATS_DRAWS] = "draws",
+    [WW_STATS_COMMITS] = "commits",
+    [WW_STATS_SKIPPED_DRAWS] = "skipped-draws",
+    [WW_STATS_MAX_BUFFER_WAIT] = "max-buffer-wait-us",
+    [WW_STATS_INPUT_EVENTS] = "input-events",
+    [WW_STATS_INPUT_LATENCY] = "input-latency-us",
+    [WW_STATS_MAX_INPUT_LATENCY] = "max-input-latency-us",
+    [WW_STATS_PRESENTED_EARLY] = "presented-early",
+    [WW_STATS_METRIC_SAMPLES] = "metric-samples",
+    [WW_STATS_METRIC_SAMPLE_TIME] = "metric-sample-time-us",
+    [WW_STATS_MAX_METRIC_SAMPLE_TIME] = "max-metric-sample-time-us",
+    [WW_STATS_FEED_UPDATES] = "feed-updates",
+    [WW_STATS_NOTIFICATIONS] = "notifications",
+    [WW_STATS_PREVIEWS_SHOWN] = "previews-shown",
+    [WW_STATS_BYTES_ARGB8888] = "bytes-argb8888",
+    [WW_STATS_BYTES_XRGB8888] = "bytes-xrgb8888",
+    [WW_STATS_BYTES_RGB565] = "bytes-rgb565",
+    [WW_STATS_BYTES_XRGB2101010] = "bytes-xrgb2101010",
+};
+
+static const char * const _ww_stats_histogram_names[_WW_STATS_HISTOGRAM_SIZE] = {
+    [WW_STATS_PRESENT_LATENCY] = "present-latency-us",
+};
+
+struct _WwStats {
+    int signal_fd;
+    WwLoopSource *signal_source;
+    int socket_fd;
+    WwLoopSource *socket_source;
+    struct sockaddr_un address;
+};
+
+int
+ww_stats_format(char *buffer, size_t size)
+{
+    int length = 0;
+
+    WwStatsCounter i;
+    for ( i = 0 ; i < _WW_STATS_SIZE ; ++i )
+    {
+        int r = snprintf(buffer + length, ( (size_t) length < size ) ? ( size - length ) : 0, "%s %" PRId64 "\n", _ww_stats_counter_names[i], __atomic_load_n(&ww_stats_counters[i], __ATOMIC_RELAXED));
+        if ( r < 0 )
+            return r;
+        length += r;
+    }
+
+    /* “name-lt-<bound> count” lines, and “name-ge-<bound> count” for the last bucket */
+    WwStatsHistogram h;
+    for ( h = 0 ; h < _WW_STATS_HISTOGRAM_SIZE ; ++h )
+    {
+        size_t b;
+        for ( b = 0 ; b < WW_STATS_HISTOGRAM_BUCKETS ; ++b )
+        {
+            bool last = ( b == WW_STATS_HISTOGRAM_BUCKETS - 1 );
+            int64_t bound = (int64_t) 1 << ( b + WW_STATS_HISTOGRAM_SHIFT - ( last ? 1 : 0 ) );
+            int r = snprintf(buffer + length, ( (size_t) length < size ) ? ( size - length ) : 0, "%s-%s-%" PRId64 " %" PRId64 "\n", _ww_stats_histogram_names[h], last ? "ge" : "lt", bound, __atomic_load_n(&ww_stats_histograms[h][b], __ATOMIC_RELAXED));
+            if ( r < 0 )
+                return r;
+            length += r;
+        }
+    }
+
+    /* 0 until something is shown */
+    int r = snprintf(buffer + length, ( (size_t) length < size ) ? ( size - length ) : 0, "first-commit-us %" PRId64 "\n", __atomic_load_n(&ww_stats_first_commit_time, __ATOMIC_RELAXED));
+    if ( r < 0 )
+        return r;
+    length += r;
+
+    /* Our buffers live in shared memory, so RSS would count what the compositor holds too */
+    FILE *f = fopen("/proc/self/smaps_rollup", "re");
+    if ( f != NULL )
+    {
+        char line[256];
+        while ( fgets(line, sizeof(line), f) != NULL )
+        {
+            const char *name;
+            size_t kib;
+            if ( sscanf(line, "Pss: %zu kB", &kib) == 1 )
+                name = "pss-bytes";
+            else if ( sscanf(line, "Pss_Shmem: %zu kB", &kib) == 1 )
+                name = "pss-shmem-bytes";
+            else
+                continue;
+            int r = snprintf(buffer + length, ( (size_t) length < size ) ? ( size - length ) : 0, "%s %zu\n", name, kib * 1024);
+            if ( r < 0 )
+            {
+                fclose(f);
+                return r;
+            }
+            length += r;
+        }
+        fclose(f);
+    }
+
+    return length;
+}
+
+static void
+_ww_stats_signal_callback(void *user_data, uint32_t events)
+{
+    WwStats *self = user_data;
+    struct signalfd_siginfo info;
+
+    if ( read(self->signal_fd, &info, sizeof(info)) != sizeof(info) )
+        return;
+
+    char buffer[4096];
+    if ( ww_stats_format(buffer, sizeof(buffer)) > 0 )
+        fputs(buffer, stderr);
+}
+
+static void
+_ww_stats_socket_callback(void *user_data, uint32_t events)
+{
+    WwStats *self = user_data;
+    int fd;
+
+    fd = accept(self->socket_fd, NULL, NULL);
+    if ( fd < 0 )
+        return;
+
+    char buffer[4096];
+    int length = ww_stats_format(buffer, sizeof(buffer));
+    if ( length > 0 )
+    {
+        /* Short enough to fit in the socket buffer */
+        if ( send(fd, buffer, MIN((size_t) length, sizeof(buffer) - 1), MSG_NOSIGNAL | MSG_DONTWAIT) < 0 )
+            ww_warning("Couldn’t send stats: %s", strerror(errno));
+    }
+    close(fd);
+}
+
+static bool
+_ww_stats_signal_init(WwStats *self, WwLoop *loop)
+{
+    sigset_t mask;
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGUSR1);
+    /* Already blocked by ww_role_run() before any thread, for other users */
+    if ( pthread_sigmask(SIG_BLOCK, &mask, NULL) != 0 )
+        return false;
+
+    self->signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if ( self->signal_fd < 0 )
+        return false;
+
+    self->signal_source = ww_loop_add_fd(loop, self->signal_fd, EPOLLIN, _ww_stats_signal_callback, self);
+    return ( self->signal_source != NULL );
+}
+
+static bool
+_ww_stats_socket_init(WwStats *self, WwLoop *loop, const char *runtime_dir, const char *name)
+{
+    self->address.sun_family = AF_UNIX;
+    if ( (size_t) snprintf(self->address.sun_path, sizeof(self->address.sun_path), "%s/%s-%ld.stats", runtime_dir, name, (long) getpid()) >= sizeof(self->address.sun_path) )
+    {
+        self->address.sun_path[0] = '\0';
+        errno = ENAMETOOLONG;
+        return false;
+    }
+
+    self->socket_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if ( self->socket_fd < 0 )
+        return false;
+
+    unlink(self->address.sun_path);
+    if ( bind(self->socket_fd, (struct sockaddr *) &self->address, sizeof(self->address)) < 0 )
+    {
+        self->address.sun_path[0] = '\0';
+        return false;
+    }
+    if ( listen(self->socket_fd, 4) < 0 )
+        return false;
+
+    self->socket_source = ww_loop_add_fd(loop, self->socket_fd, EPOLLIN, _ww_stats_socket_callback, self);
+    return ( self->socket_source != NULL );
+}
+
+WwStats *
+ww_stats_new(WwLoop *loop, const char *runtime_dir, const char *name)
+{
+    WwStats *self;
+
+    self = ww_new0(WwStats, 1);
+    if ( self == NULL )
+        return NULL;
+    self->signal_fd = -1;
+    self->socket_fd = -1;
+
+    if ( ! _ww_stats_signal_init(self, loop) )
+    {
+        ww_warning("Couldn’t watch SIGUSR1: %s", strerror(errno));
+        ww_stats_free(self);
+        return NULL;
+    }
+
+    if ( ! _ww_stats_socket_init(self, loop, runtime_dir, name) )
+    {
+        ww_warning("Couldn’t create stats socket: %s", strerror(errno));
+        ww_stats_free(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+void
+ww_stats_free(WwStats *self)
+{
+    if ( self == NULL )
+        return;
+
+    if ( self->socket_source != NULL )
+        ww_loop_source_free(self->socket_source);
+    if ( self->socket_fd >= 0 )
+        close(self->socket_fd);
+    if ( self->address.sun_path[0] != '\0' )
+        unlink(self->address.sun_path);
+
+    if ( self->signal_source != NULL )
+        ww_loop_source_free(self->signal_source);
+    if ( self->signal_fd >= 0 )
+        close(self->signal_fd);
+
+    free(self);
+}
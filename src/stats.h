@@ -0,0 +1,155 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef __WW_STATS_H__
+#define __WW_STATS_H__
+
+#include "helpers.h"
+#include "loop.h"
+
+#include <time.h>
+
+typedef enum {
+    WW_STATS_BYTES_MAPPED,
+    WW_STATS_POOLS_CREATED,
+    WW_STATS_BUFFERS_CREATED,
+    WW_STATS_BUFFERS_RELEASED,
+    WW_STATS_BUFFERS_HELD,
+    WW_STATS_DRAWS,
+    WW_STATS_COMMITS,
+    WW_STATS_SKIPPED_DRAWS,
+    WW_STATS_MAX_BUFFER_WAIT,
+    WW_STATS_INPUT_EVENTS,
+    WW_STATS_INPUT_LATENCY,
+    WW_STATS_MAX_INPUT_LATENCY,
+    WW_STATS_PRESENTED_EARLY,
+    WW_STATS_METRIC_SAMPLES,
+    WW_STATS_METRIC_SAMPLE_TIME,
+    WW_STATS_MAX_METRIC_SAMPLE_TIME,
+    WW_STATS_FEED_UPDATES,
+    WW_STATS_NOTIFICATIONS,
+    WW_STATS_PREVIEWS_SHOWN,
+    /* Buffer bytes per pixel format, in WwFormat order */
+    WW_STATS_BYTES_ARGB8888,
+    WW_STATS_BYTES_XRGB8888,
+    WW_STATS_BYTES_RGB565,
+    WW_STATS_BYTES_XRGB2101010,
+    _WW_STATS_SIZE,
+} WwStatsCounter;
+
+typedef enum {
+    WW_STATS_PRESENT_LATENCY,
+    _WW_STATS_HISTOGRAM_SIZE,
+} WwStatsHistogram;
+
+/* Bucket i counts values under 2^(i + shift), the last one all the others */
+#define WW_STATS_HISTOGRAM_SHIFT 7
+#define WW_STATS_HISTOGRAM_BUCKETS 16
+
+typedef struct _WwStats WwStats;
+
+extern int64_t ww_stats_counters[_WW_STATS_SIZE];
+extern int64_t ww_stats_histograms[_WW_STATS_HISTOGRAM_SIZE][WW_STATS_HISTOGRAM_BUCKETS];
+/* Set by ww_role_run(), and from it to the first counted commit, in µs */
+extern int64_t ww_stats_start_time;
+extern int64_t ww_stats_first_commit_time;
+
+/* Relaxed atomics, we only want each counter to be consistent with itself */
+static inline void
+ww_stats_add(WwStatsCounter counter, int64_t value)
+{
+    __atomic_fetch_add(&ww_stats_counters[counter], value, __ATOMIC_RELAXED);
+}
+
+static inline void
+ww_stats_max(WwStatsCounter counter, int64_t value)
+{
+    int64_t current = __atomic_load_n(&ww_stats_counters[counter], __ATOMIC_RELAXED);
+    while ( ( current < value ) && ( ! __atomic_compare_exchange_n(&ww_stats_counters[counter], &current, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED) ) );
+}
+
+static inline void
+ww_stats_histogram_add(WwStatsHistogram histogram, int64_t value)
+{
+    size_t bucket = 0;
+    while ( ( bucket < WW_STATS_HISTOGRAM_BUCKETS - 1 ) && ( value >= ( (int64_t) 1 << ( bucket + WW_STATS_HISTOGRAM_SHIFT ) ) ) )
+        ++bucket;
+    __atomic_fetch_add(&ww_stats_histograms[histogram][bucket], 1, __ATOMIC_RELAXED);
+}
+
+/* In µs, for buffer wait times */
+static inline int64_t
+ww_stats_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Counts a wl_surface.commit, the first one of the process is our startup time */
+static inline void
+ww_stats_committed(void)
+{
+    int64_t none = 0;
+
+    ww_stats_add(WW_STATS_COMMITS, 1);
+    if ( __atomic_load_n(&ww_stats_first_commit_time, __ATOMIC_RELAXED) == 0 )
+        __atomic_compare_exchange_n(&ww_stats_first_commit_time, &none, MAX(ww_stats_now() - ww_stats_start_time, 1), false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+/* Records the wait of a buffer attached at the given time */
+static inline void
+ww_stats_buffer_released(int64_t attach_time)
+{
+    ww_stats_add(WW_STATS_BUFFERS_RELEASED, 1);
+    ww_stats_add(WW_STATS_BUFFERS_HELD, -1);
+    ww_stats_max(WW_STATS_MAX_BUFFER_WAIT, ww_stats_now() - attach_time);
+}
+
+/*
+ * Records the delay between an input event and its dispatch,
+ * assuming the compositor uses CLOCK_MONOTONIC in ms as most do
+ */
+static inline void
+ww_stats_input_dispatched(uint32_t time)
+{
+    int64_t latency = ( (uint32_t) ( ww_stats_now() / 1000 ) - time ) * (int64_t) 1000;
+    if ( latency > 1000 * 1000 * 1000 )
+        return;
+
+    ww_stats_add(WW_STATS_INPUT_EVENTS, 1);
+    ww_stats_add(WW_STATS_INPUT_LATENCY, latency);
+    ww_stats_max(WW_STATS_MAX_INPUT_LATENCY, latency);
+}
+
+/* “name value” lines, with the startup time and PSS from /proc, returns the length like snprintf() */
+int ww_stats_format(char *buffer, size_t size);
+
+/*
+ * Dumps the counters on stderr on SIGUSR1 and to any client
+ * connecting to <runtime_dir>/<name>-<pid>.stats
+ */
+WwStats *ww_stats_new(WwLoop *loop, const char *runtime_dir, const char *name);
+void ww_stats_free(WwStats *self);
+
+#endif /* __WW_STATS_H__ */
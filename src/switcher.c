@@ -0,0 +1,1385 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "helpers.h"
+
+#include <inttypes.h>
+#include <getopt.h>
+#include <dirent.h>
+#include "xdg-shell-client-protocol.h"
+#include "viewporter-client-protocol.h"
+#include "window-switcher-unstable-v1-client-protocol.h"
+#include "window-switcher-unstable-v2-client-protocol.h"
+#include "client.h"
+#include "loop.h"
+#include "format.h"
+#include "stats.h"
+#include "role.h"
+#include "search.h"
+#include "desktop.h"
+#include "icons.h"
+
+/* Supported interface versions */
+#define WW_WINDOW_SWITCHER_INTERFACE_VERSION 1
+#define WL_SUBCOMPOSITOR_INTERFACE_VERSION 1
+#define WP_VIEWPORTER_INTERFACE_VERSION 1
+#define XDG_WM_BASE_INTERFACE_VERSION 1
+
+/* The first page is a screenful, the next ones are sent while we paint it */
+#define WW_SWITCHER_PAGE_SIZE 256
+
+/* Longer query lines are cut */
+#define WW_SWITCHER_LINE_SIZE 256
+
+/* In surface coordinates */
+#define WW_SWITCHER_WIDTH 800
+#define WW_SWITCHER_HEIGHT 600
+#define WW_SWITCHER_CELL_WIDTH 240
+#define WW_SWITCHER_CELL_HEIGHT 150
+#define WW_SWITCHER_SPACING 16
+
+/* Icons are cached at this size, as a dock would show them */
+#define WW_SWITCHER_ICON_SIZE 48
+
+/* Pixels per wl_pointer.axis unit */
+#define WW_SWITCHER_SCROLL_SPEED 4
+
+typedef enum {
+    WW_SWITCHER_FIELD_TITLE,
+    WW_SWITCHER_FIELD_APP_ID,
+    WW_SWITCHER_FIELD_WORKSPACE,
+    _WW_SWITCHER_FIELD_SIZE,
+} WwSwitcherField;
+
+typedef struct _WwSwitcherWindow WwSwitcherWindow;
+
+/* A preview slot of the grid, recycled for whichever item takes its place in the ring */
+typedef struct {
+    struct wl_surface *surface;
+    struct wl_subsurface *subsurface;
+    struct wp_viewport *viewport;
+    /* In the items, SIZE_MAX when unmapped */
+    size_t index;
+    WwSwitcherWindow *window;
+    int32_t x;
+    int32_t y;
+} WwSwitcherCell;
+
+typedef struct {
+    WwClient *client;
+    struct zww_window_switcher_v2 *window_switcher;
+    /* Only bound without v2, sending every window at bind and never closing them */
+    struct zww_window_switcher_v1 *window_switcher_v1;
+    struct wl_subcompositor *subcompositor;
+    struct wp_viewporter *viewporter;
+    struct xdg_wm_base *wm_base;
+    WwSearch *search;
+    struct wl_list windows;
+    /* Enumerated windows count down from 0, activated ones count up */
+    int64_t oldest_use;
+    int64_t newest_use;
+    WwLoopSource *input_source;
+    char line[WW_SWITCHER_LINE_SIZE];
+    size_t line_length;
+    unsigned long bench;
+    unsigned long enumerate_bench;
+    unsigned long icon_bench;
+    char query[WW_SWITCHER_LINE_SIZE];
+    /* Windows matching the query, in grid order */
+    WwSwitcherWindow **items;
+    size_t item_count;
+    size_t item_size;
+    bool items_dirty;
+    WwColour background_colour;
+    int32_t cell_width;
+    int32_t cell_height;
+    int32_t prefetch;
+    WwArenaBlock block;
+    struct wl_buffer *background_buffer;
+    struct wl_buffer *cell_buffer;
+    struct wl_surface *surface;
+    struct wp_viewport *viewport;
+    struct xdg_surface *xdg_surface;
+    struct xdg_toplevel *toplevel;
+    struct wl_callback *frame;
+    bool dirty;
+    bool configured;
+    int32_t configured_width;
+    int32_t configured_height;
+    int32_t width;
+    int32_t height;
+    double scroll;
+    int32_t columns;
+    WwSwitcherCell *cells;
+    size_t cell_count;
+} WwSwitcherContext;
+
+struct _WwSwitcherWindow {
+    WwSwitcherContext *context;
+    struct wl_list link;
+    struct zww_window_switcher_window_v2 *window;
+    struct zww_window_switcher_window_v1 *window_v1;
+    uint32_t id;
+    char *fields[_WW_SWITCHER_FIELD_SIZE];
+    bool changed;
+    int64_t used;
+};
+
+static void
+_ww_switcher_items_add(void *user_data, void *data)
+{
+    WwSwitcherContext *self = user_data;
+
+    if ( self->item_count == self->item_size )
+    {
+        size_t size = MAX(self->item_size * 2, 64);
+        WwSwitcherWindow **items = realloc(self->items, size * sizeof(*items));
+        if ( items == NULL )
+            return;
+        self->items = items;
+        self->item_size = size;
+    }
+    self->items[self->item_count++] = data;
+}
+
+static int
+_ww_switcher_items_compare(const void *a_, const void *b_)
+{
+    const WwSwitcherWindow *a = *(WwSwitcherWindow * const *) a_, *b = *(WwSwitcherWindow * const *) b_;
+    return ( a->used < b->used ) - ( a->used > b->used );
+}
+
+/* Most recently used first */
+static void
+_ww_switcher_items_refresh(WwSwitcherContext *self)
+{
+    self->item_count = 0;
+    ww_search_query(self->search, self->query, _ww_switcher_items_add, self);
+    qsort(self->items, self->item_count, sizeof(*self->items), _ww_switcher_items_compare);
+    self->items_dirty = false;
+}
+
+static void
+_ww_switcher_cell_release(WwSwitcherCell *self)
+{
+    if ( self->index == SIZE_MAX )
+        return;
+
+    self->index = SIZE_MAX;
+    self->window = NULL;
+    self->x = INT32_MIN;
+    self->y = INT32_MIN;
+    if ( self->surface == NULL )
+        return;
+
+    wl_surface_attach(self->surface, NULL, 0, 0);
+    wl_surface_commit(self->surface);
+}
+
+/* Only a cell getting another window asks the compositor for a preview */
+static void
+_ww_switcher_cell_assign(WwSwitcherContext *context, WwSwitcherCell *self, size_t index, WwSwitcherWindow *window)
+{
+    bool mapped = ( self->index != SIZE_MAX );
+
+    self->index = index;
+    if ( self->window == window )
+        return;
+    self->window = window;
+    ww_stats_add(WW_STATS_PREVIEWS_SHOWN, 1);
+    if ( self->surface == NULL )
+        return;
+
+    if ( window->window != NULL )
+        zww_window_switcher_window_v2_show(window->window, self->surface, 0, 0, context->cell_width, context->cell_height);
+    else
+        zww_window_switcher_window_v1_show(window->window_v1, self->surface, 0, 0, context->cell_width, context->cell_height);
+    if ( ! mapped )
+    {
+        wl_surface_attach(self->surface, context->cell_buffer, 0, 0);
+        wl_surface_damage(self->surface, 0, 0, INT32_MAX, INT32_MAX);
+    }
+    /* Synchronized, applied with the grid */
+    wl_surface_commit(self->surface);
+}
+
+static void
+_ww_switcher_cell_move(WwSwitcherCell *self, int32_t x, int32_t y)
+{
+    if ( ( self->x == x ) && ( self->y == y ) )
+        return;
+
+    self->x = x;
+    self->y = y;
+    if ( self->surface != NULL )
+        wl_subsurface_set_position(self->subsurface, x, y);
+}
+
+static void
+_ww_switcher_cells_free(WwSwitcherContext *self)
+{
+    size_t i;
+
+    for ( i = 0 ; i < self->cell_count ; ++i )
+    {
+        WwSwitcherCell *cell = &self->cells[i];
+        if ( cell->surface == NULL )
+            continue;
+        wp_viewport_destroy(cell->viewport);
+        wl_subsurface_destroy(cell->subsurface);
+        wl_surface_destroy(cell->surface);
+    }
+    free(self->cells);
+    self->cells = NULL;
+    self->cell_count = 0;
+}
+
+/*
+ * Enough cells for the rows in the viewport, a partial one at each end,
+ * and the prefetch rows on each side, so the ring never wraps on itself
+ */
+static size_t
+_ww_switcher_grid_get_cell_count(WwSwitcherContext *self, int32_t width, int32_t height, int32_t *columns)
+{
+    int32_t column_width = self->cell_width + WW_SWITCHER_SPACING;
+    int32_t row_height = self->cell_height + WW_SWITCHER_SPACING;
+    int32_t c = MAX(1, ( width - WW_SWITCHER_SPACING ) / column_width);
+
+    if ( columns != NULL )
+        *columns = c;
+    return (size_t) c * ( height / row_height + 2 + 2 * self->prefetch );
+}
+
+static bool
+_ww_switcher_grid_resize(WwSwitcherContext *self, int32_t width, int32_t height)
+{
+    self->width = width;
+    self->height = height;
+
+    size_t count = _ww_switcher_grid_get_cell_count(self, width, height, &self->columns);
+    if ( count == self->cell_count )
+        return true;
+
+    _ww_switcher_cells_free(self);
+    self->cells = ww_new0(WwSwitcherCell, count);
+    if ( self->cells == NULL )
+        return false;
+    self->cell_count = count;
+
+    size_t i;
+    for ( i = 0 ; i < count ; ++i )
+    {
+        WwSwitcherCell *cell = &self->cells[i];
+        cell->index = SIZE_MAX;
+        cell->x = INT32_MIN;
+        cell->y = INT32_MIN;
+        if ( self->surface == NULL )
+            continue;
+
+        cell->surface = wl_compositor_create_surface(self->client->compositor);
+        wl_surface_set_user_data(cell->surface, self);
+        cell->subsurface = wl_subcompositor_get_subsurface(self->subcompositor, cell->surface, self->surface);
+        cell->viewport = wp_viewporter_get_viewport(self->viewporter, cell->surface);
+        wp_viewport_set_destination(cell->viewport, self->cell_width, self->cell_height);
+    }
+
+    return true;
+}
+
+/*
+ * Maps the items of the rows in view, plus the prefetch ones, each to the
+ * cell at its index modulo the cell count, unmapping the cells that left
+ * Scrolling only moves cells, so a frame costs the same for any window count
+ */
+static void
+_ww_switcher_grid_update(WwSwitcherContext *self)
+{
+    int32_t column_width = self->cell_width + WW_SWITCHER_SPACING;
+    int32_t row_height = self->cell_height + WW_SWITCHER_SPACING;
+    size_t columns = self->columns, i;
+
+    size_t rows = ( self->item_count + columns - 1 ) / columns;
+    double max_scroll = MAX(0, (int64_t) rows * row_height + WW_SWITCHER_SPACING - self->height);
+    self->scroll = MIN(MAX(self->scroll, 0), max_scroll);
+    int32_t scroll = self->scroll;
+
+    size_t first_row = MAX(scroll / row_height - self->prefetch, 0);
+    size_t last_row = ( scroll + self->height ) / row_height + self->prefetch;
+    size_t first = MIN(first_row * columns, self->item_count);
+    size_t last = MIN(( last_row + 1 ) * columns, self->item_count);
+
+    for ( i = 0 ; i < self->cell_count ; ++i )
+    {
+        WwSwitcherCell *cell = &self->cells[i];
+        if ( ( cell->index < first ) || ( cell->index >= last ) )
+            _ww_switcher_cell_release(cell);
+    }
+
+    for ( i = first ; i < last ; ++i )
+    {
+        WwSwitcherCell *cell = &self->cells[i % self->cell_count];
+        _ww_switcher_cell_assign(self, cell, i, self->items[i]);
+        _ww_switcher_cell_move(cell, WW_SWITCHER_SPACING + ( i % columns ) * column_width, WW_SWITCHER_SPACING + ( i / columns ) * row_height - scroll);
+    }
+}
+
+static void _ww_switcher_redraw(WwSwitcherContext *self);
+
+static void
+_ww_switcher_frame(void *data, struct wl_callback *callback, uint32_t time)
+{
+    WwSwitcherContext *self = data;
+
+    wl_callback_destroy(self->frame);
+    self->frame = NULL;
+
+    if ( ! self->dirty )
+        return;
+    self->dirty = false;
+    _ww_switcher_redraw(self);
+}
+
+static const struct wl_callback_listener _ww_switcher_frame_listener = {
+    .done = _ww_switcher_frame,
+};
+
+/* At most once per frame, changes in between are coalesced */
+static void
+_ww_switcher_redraw(WwSwitcherContext *self)
+{
+    if ( ! self->configured )
+        return;
+    if ( self->frame != NULL )
+    {
+        self->dirty = true;
+        return;
+    }
+
+    if ( self->items_dirty )
+        _ww_switcher_items_refresh(self);
+    _ww_switcher_grid_update(self);
+
+    self->frame = wl_surface_frame(self->surface);
+    wl_callback_add_listener(self->frame, &_ww_switcher_frame_listener, self);
+    wl_surface_commit(self->surface);
+    ww_stats_committed();
+}
+
+static void
+_ww_switcher_window_set_field(WwSwitcherWindow *self, WwSwitcherField field, const char *value)
+{
+    if ( strcmp0(self->fields[field], value) == 0 )
+        return;
+
+    char *copy = strdup(value);
+    if ( copy == NULL )
+        return;
+    free(self->fields[field]);
+    self->fields[field] = copy;
+    self->changed = true;
+}
+
+static void
+_ww_switcher_window_title(void *data, struct zww_window_switcher_window_v2 *window, const char *title)
+{
+    _ww_switcher_window_set_field(data, WW_SWITCHER_FIELD_TITLE, title);
+}
+
+static void
+_ww_switcher_window_app_id(void *data, struct zww_window_switcher_window_v2 *window, const char *app_id)
+{
+    _ww_switcher_window_set_field(data, WW_SWITCHER_FIELD_APP_ID, app_id);
+}
+
+static void
+_ww_switcher_window_workspace(void *data, struct zww_window_switcher_window_v2 *window, const char *workspace)
+{
+    _ww_switcher_window_set_field(data, WW_SWITCHER_FIELD_WORKSPACE, workspace);
+}
+
+/* Only a window whose fields changed gets re-indexed */
+static void
+_ww_switcher_window_done(void *data, struct zww_window_switcher_window_v2 *window)
+{
+    WwSwitcherWindow *self = data;
+
+    if ( ! self->changed )
+        return;
+    self->changed = false;
+
+    if ( ! ww_search_set_fields(self->context->search, self->id, (const char * const *) self->fields, _WW_SWITCHER_FIELD_SIZE) )
+        ww_warning("Couldn’t index window %s: %s", self->fields[WW_SWITCHER_FIELD_TITLE], strerror(errno));
+
+    self->context->items_dirty = true;
+    _ww_switcher_redraw(self->context);
+}
+
+static void
+_ww_switcher_window_activated(void *data, struct zww_window_switcher_window_v2 *window)
+{
+    WwSwitcherWindow *self = data;
+
+    self->used = ++self->context->newest_use;
+    self->context->items_dirty = true;
+    _ww_switcher_redraw(self->context);
+}
+
+static void
+_ww_switcher_window_free(WwSwitcherWindow *self)
+{
+    WwSwitcherContext *context = self->context;
+    size_t i;
+
+    /* A later window could get the same address */
+    for ( i = 0 ; i < context->cell_count ; ++i )
+    {
+        if ( context->cells[i].window == self )
+            _ww_switcher_cell_release(&context->cells[i]);
+    }
+
+    ww_search_remove(context->search, self->id);
+    wl_list_remove(&self->link);
+    if ( self->window != NULL )
+        zww_window_switcher_window_v2_destroy(self->window);
+    if ( self->window_v1 != NULL )
+        zww_window_switcher_window_v1_destroy(self->window_v1);
+    for ( i = 0 ; i < _WW_SWITCHER_FIELD_SIZE ; ++i )
+        free(self->fields[i]);
+    free(self);
+}
+
+static void
+_ww_switcher_window_closed(void *data, struct zww_window_switcher_window_v2 *window)
+{
+    WwSwitcherWindow *self = data;
+    WwSwitcherContext *context = self->context;
+
+    _ww_switcher_window_free(self);
+    context->items_dirty = true;
+    _ww_switcher_redraw(context);
+}
+
+static const struct zww_window_switcher_window_v2_listener _ww_switcher_window_listener = {
+    .title = _ww_switcher_window_title,
+    .app_id = _ww_switcher_window_app_id,
+    .workspace = _ww_switcher_window_workspace,
+    .activated = _ww_switcher_window_activated,
+    .done = _ww_switcher_window_done,
+    .closed = _ww_switcher_window_closed,
+};
+
+/* Windows come most recently used first, new ones will get activated */
+static WwSwitcherWindow *
+_ww_switcher_window_new(WwSwitcherContext *self, struct zww_window_switcher_window_v2 *window)
+{
+    WwSwitcherWindow *switcher_window;
+
+    switcher_window = ww_new0(WwSwitcherWindow, 1);
+    if ( ( switcher_window == NULL ) || ( ! ww_search_add(self->search, switcher_window, &switcher_window->id) ) )
+    {
+        free(switcher_window);
+        return NULL;
+    }
+
+    switcher_window->context = self;
+    switcher_window->window = window;
+    switcher_window->used = self->oldest_use--;
+    wl_list_insert(self->windows.prev, &switcher_window->link);
+
+    return switcher_window;
+}
+
+static void
+_ww_switcher_window(void *data, struct zww_window_switcher_v2 *window_switcher, struct zww_window_switcher_window_v2 *window)
+{
+    WwSwitcherContext *self = data;
+    WwSwitcherWindow *switcher_window;
+
+    switcher_window = _ww_switcher_window_new(self, window);
+    if ( switcher_window == NULL )
+    {
+        zww_window_switcher_window_v2_destroy(window);
+        return;
+    }
+
+    zww_window_switcher_window_v2_add_listener(window, &_ww_switcher_window_listener, switcher_window);
+}
+
+static void
+_ww_switcher_enumerated(void *data, struct zww_window_switcher_v2 *window_switcher, uint32_t remaining)
+{
+    /* Asking only now lets the first page be dispatched, and painted, alone */
+    if ( remaining > 0 )
+        zww_window_switcher_v2_enumerate(window_switcher, WW_SWITCHER_PAGE_SIZE);
+}
+
+static const struct zww_window_switcher_v2_listener _ww_switcher_window_switcher_listener = {
+    .window = _ww_switcher_window,
+    .enumerated = _ww_switcher_enumerated,
+};
+
+static void
+_ww_switcher_window_switcher_bound(void *user_data, void *proxy)
+{
+    WwSwitcherContext *self = user_data;
+
+    zww_window_switcher_v2_add_listener(proxy, &_ww_switcher_window_switcher_listener, self);
+    zww_window_switcher_v2_enumerate(proxy, _ww_switcher_grid_get_cell_count(self, WW_SWITCHER_WIDTH, WW_SWITCHER_HEIGHT, NULL));
+}
+
+static void
+_ww_switcher_window_v1_title(void *data, struct zww_window_switcher_window_v1 *window, const char *title)
+{
+    _ww_switcher_window_set_field(data, WW_SWITCHER_FIELD_TITLE, title);
+}
+
+static void
+_ww_switcher_window_v1_app_id(void *data, struct zww_window_switcher_window_v1 *window, const char *app_id)
+{
+    _ww_switcher_window_set_field(data, WW_SWITCHER_FIELD_APP_ID, app_id);
+}
+
+static void
+_ww_switcher_window_v1_workspace(void *data, struct zww_window_switcher_window_v1 *window, const char *workspace)
+{
+    _ww_switcher_window_set_field(data, WW_SWITCHER_FIELD_WORKSPACE, workspace);
+}
+
+/* Every field is sent again, only those that changed re-index the window */
+static void
+_ww_switcher_window_v1_done(void *data, struct zww_window_switcher_window_v1 *window)
+{
+    _ww_switcher_window_done(data, NULL);
+}
+
+static const struct zww_window_switcher_window_v1_listener _ww_switcher_window_v1_listener = {
+    .title = _ww_switcher_window_v1_title,
+    .app_id = _ww_switcher_window_v1_app_id,
+    .workspace = _ww_switcher_window_v1_workspace,
+    .done = _ww_switcher_window_v1_done,
+};
+
+static void
+_ww_switcher_window_v1(void *data, struct zww_window_switcher_v1 *window_switcher, struct zww_window_switcher_window_v1 *window)
+{
+    WwSwitcherContext *self = data;
+    WwSwitcherWindow *switcher_window;
+
+    switcher_window = _ww_switcher_window_new(self, NULL);
+    if ( switcher_window == NULL )
+    {
+        zww_window_switcher_window_v1_destroy(window);
+        return;
+    }
+
+    switcher_window->window_v1 = window;
+    zww_window_switcher_window_v1_add_listener(window, &_ww_switcher_window_v1_listener, switcher_window);
+}
+
+static const struct zww_window_switcher_v1_listener _ww_switcher_window_switcher_v1_listener = {
+    .window = _ww_switcher_window_v1,
+};
+
+static void
+_ww_switcher_window_switcher_v1_bound(void *user_data, void *proxy)
+{
+    zww_window_switcher_v1_add_listener(proxy, &_ww_switcher_window_switcher_v1_listener, user_data);
+}
+
+static void
+_ww_switcher_wm_base_ping(void *data, struct xdg_wm_base *wm_base, uint32_t serial)
+{
+    xdg_wm_base_pong(wm_base, serial);
+}
+
+static const struct xdg_wm_base_listener _ww_switcher_wm_base_listener = {
+    .ping = _ww_switcher_wm_base_ping,
+};
+
+static void
+_ww_switcher_wm_base_bound(void *user_data, void *proxy)
+{
+    xdg_wm_base_add_listener(proxy, &_ww_switcher_wm_base_listener, user_data);
+}
+
+static const WwClientGlobal _ww_switcher_globals[] = {
+    /* Windows are sent on bind, so we need our listener before any dispatch */
+    { &zww_window_switcher_v2_interface, WW_WINDOW_SWITCHER_INTERFACE_VERSION, offsetof(WwSwitcherContext, window_switcher), (WwClientProxyDestroyFunc) zww_window_switcher_v2_destroy, _ww_switcher_window_switcher_bound, false },
+    { &zww_window_switcher_v1_interface, WW_WINDOW_SWITCHER_INTERFACE_VERSION, offsetof(WwSwitcherContext, window_switcher_v1), (WwClientProxyDestroyFunc) zww_window_switcher_v1_destroy, _ww_switcher_window_switcher_v1_bound, true },
+    WW_CLIENT_GLOBAL(WwSwitcherContext, subcompositor, wl_subcompositor_interface, WL_SUBCOMPOSITOR_INTERFACE_VERSION, wl_subcompositor_destroy),
+    WW_CLIENT_GLOBAL(WwSwitcherContext, viewporter, wp_viewporter_interface, WP_VIEWPORTER_INTERFACE_VERSION, wp_viewporter_destroy),
+    { &xdg_wm_base_interface, XDG_WM_BASE_INTERFACE_VERSION, offsetof(WwSwitcherContext, wm_base), (WwClientProxyDestroyFunc) xdg_wm_base_destroy, _ww_switcher_wm_base_bound, false },
+};
+
+static void
+_ww_switcher_toplevel_configure(void *data, struct xdg_toplevel *toplevel, int32_t width, int32_t height, struct wl_array *states)
+{
+    WwSwitcherContext *self = data;
+
+    self->configured_width = ( width > 0 ) ? width : WW_SWITCHER_WIDTH;
+    self->configured_height = ( height > 0 ) ? height : WW_SWITCHER_HEIGHT;
+}
+
+#ifdef WW_SHELL
+static void
+_ww_switcher_grid_destroy(WwSwitcherContext *self)
+{
+    if ( self->frame != NULL )
+        wl_callback_destroy(self->frame);
+    self->frame = NULL;
+    _ww_switcher_cells_free(self);
+    xdg_toplevel_destroy(self->toplevel);
+    self->toplevel = NULL;
+    xdg_surface_destroy(self->xdg_surface);
+    self->xdg_surface = NULL;
+    wp_viewport_destroy(self->viewport);
+    self->viewport = NULL;
+    wl_surface_destroy(self->surface);
+    self->surface = NULL;
+    self->configured = false;
+    self->dirty = false;
+    self->width = 0;
+    self->height = 0;
+}
+#endif /* WW_SHELL */
+
+static void
+_ww_switcher_toplevel_close(void *data, struct xdg_toplevel *toplevel)
+{
+    WwSwitcherContext *self = data;
+
+#ifdef WW_SHELL
+    /* Closing must not end the other roles */
+    _ww_switcher_grid_destroy(self);
+#else /* ! WW_SHELL */
+    ww_loop_quit(self->client->loop);
+#endif /* ! WW_SHELL */
+}
+
+static const struct xdg_toplevel_listener _ww_switcher_toplevel_listener = {
+    .configure = _ww_switcher_toplevel_configure,
+    .close = _ww_switcher_toplevel_close,
+};
+
+static void
+_ww_switcher_xdg_surface_configure(void *data, struct xdg_surface *xdg_surface, uint32_t serial)
+{
+    WwSwitcherContext *self = data;
+
+    xdg_surface_ack_configure(xdg_surface, serial);
+
+    if ( ( self->configured_width != self->width ) || ( self->configured_height != self->height ) )
+    {
+        if ( ! _ww_switcher_grid_resize(self, self->configured_width, self->configured_height) )
+        {
+            ww_warning("Couldn’t allocate the grid: %s", strerror(errno));
+            return;
+        }
+        wp_viewport_set_destination(self->viewport, self->width, self->height);
+    }
+
+    if ( ! self->configured )
+    {
+        wl_surface_attach(self->surface, self->background_buffer, 0, 0);
+        wl_surface_damage(self->surface, 0, 0, INT32_MAX, INT32_MAX);
+        self->configured = true;
+    }
+
+    /* The ack needs a commit, even if a frame is pending */
+    if ( self->frame != NULL )
+    {
+        if ( self->items_dirty )
+            _ww_switcher_items_refresh(self);
+        _ww_switcher_grid_update(self);
+        wl_surface_commit(self->surface);
+    }
+    else
+        _ww_switcher_redraw(self);
+}
+
+static const struct xdg_surface_listener _ww_switcher_xdg_surface_listener = {
+    .configure = _ww_switcher_xdg_surface_configure,
+};
+
+static void
+_ww_switcher_pointer_axis(void *user_data, struct wl_surface *surface, enum wl_pointer_axis axis, wl_fixed_t value)
+{
+    WwSwitcherContext *self = user_data;
+
+    if ( ( axis != WL_POINTER_AXIS_VERTICAL_SCROLL ) || ( wl_surface_get_user_data(surface) != self ) )
+        return;
+
+    self->scroll += wl_fixed_to_double(value) * WW_SWITCHER_SCROLL_SPEED;
+    _ww_switcher_redraw(self);
+}
+
+static const WwClientListener _ww_switcher_client_listener = {
+    .pointer_axis = _ww_switcher_pointer_axis,
+};
+
+/* The background and the cells are all 1×1 pixels scaled by the viewporter */
+static bool
+_ww_switcher_grid_init(WwSwitcherContext *self)
+{
+    const WwFormatInfo *info = ww_format_get_info(WW_FORMAT_ARGB8888);
+    const WwColour *c = &self->background_colour;
+
+    if ( ! ww_client_shm_alloc(self->client, 2 * sizeof(uint32_t), &self->block) )
+        return false;
+
+    uint32_t *pixels = (uint32_t *) self->block.data;
+    pixels[0] = (uint32_t) ( c->a * 255 ) << 24 | (uint32_t) ( c->r * c->a * 255 ) << 16 | (uint32_t) ( c->g * c->a * 255 ) << 8 | (uint32_t) ( c->b * c->a * 255 );
+    pixels[1] = 0;
+
+    self->background_buffer = ww_arena_create_buffer(self->client->arena, &self->block, 0, 1, 1, sizeof(uint32_t), info->shm_format, NULL);
+    self->cell_buffer = ww_arena_create_buffer(self->client->arena, &self->block, sizeof(uint32_t), 1, 1, sizeof(uint32_t), info->shm_format, NULL);
+    if ( ( self->background_buffer == NULL ) || ( self->cell_buffer == NULL ) )
+        return false;
+
+    self->surface = wl_compositor_create_surface(self->client->compositor);
+    wl_surface_set_user_data(self->surface, self);
+    self->viewport = wp_viewporter_get_viewport(self->viewporter, self->surface);
+    self->xdg_surface = xdg_wm_base_get_xdg_surface(self->wm_base, self->surface);
+    xdg_surface_add_listener(self->xdg_surface, &_ww_switcher_xdg_surface_listener, self);
+    self->toplevel = xdg_surface_get_toplevel(self->xdg_surface);
+    xdg_toplevel_add_listener(self->toplevel, &_ww_switcher_toplevel_listener, self);
+    xdg_toplevel_set_title(self->toplevel, "Windows");
+    xdg_toplevel_set_app_id(self->toplevel, "ww-switcher");
+    wl_surface_commit(self->surface);
+
+    return true;
+}
+
+static void
+_ww_switcher_print(WwSwitcherWindow *window)
+{
+    size_t i;
+
+    for ( i = 0 ; i < _WW_SWITCHER_FIELD_SIZE ; ++i )
+        printf("%s%s", ( i > 0 ) ? "\t" : "", ( window->fields[i] != NULL ) ? window->fields[i] : "");
+    printf("\n");
+}
+
+/*
+ * Each line is the whole query, as typed so far
+ * Only the last complete line of a read is answered, the others are already stale
+ */
+static void
+_ww_switcher_input(void *user_data, uint32_t events)
+{
+    WwSwitcherContext *self = user_data;
+    char buffer[WW_SWITCHER_LINE_SIZE * 4];
+    bool answer = false;
+
+    ssize_t length = read(STDIN_FILENO, buffer, sizeof(buffer));
+    if ( length <= 0 )
+    {
+        if ( ( length < 0 ) && ( ( errno == EINTR ) || ( errno == EAGAIN ) ) )
+            return;
+        ww_loop_source_free(self->input_source);
+        self->input_source = NULL;
+        /* The grid stays until closed */
+        if ( self->surface == NULL )
+            ww_loop_quit(self->client->loop);
+        return;
+    }
+
+    ssize_t i;
+    for ( i = 0 ; i < length ; ++i )
+    {
+        if ( buffer[i] != '\n' )
+        {
+            if ( self->line_length + 1 < WW_SWITCHER_LINE_SIZE )
+                self->line[self->line_length++] = buffer[i];
+            continue;
+        }
+        memcpy(self->query, self->line, self->line_length);
+        self->query[self->line_length] = '\0';
+        self->line_length = 0;
+        answer = true;
+    }
+    if ( ! answer )
+        return;
+
+    _ww_switcher_items_refresh(self);
+    size_t j;
+    for ( j = 0 ; j < self->item_count ; ++j )
+        _ww_switcher_print(self->items[j]);
+    printf("\n");
+    fflush(stdout);
+
+    self->scroll = 0;
+    _ww_switcher_redraw(self);
+}
+
+static const char * const _ww_switcher_bench_words[] = {
+    "inbox", "report", "draft", "music", "player", "terminal", "vim", "build",
+    "review", "meeting", "notes", "budget", "photos", "video", "chat", "project",
+    "wayland", "kernel", "browser", "settings", "download", "invoice", "calendar", "todo",
+};
+
+static const char * const _ww_switcher_bench_app_ids[] = {
+    "org.mozilla.firefox", "org.gnome.Terminal", "org.kde.konsole", "thunderbird",
+    "org.gnome.Nautilus", "mpv", "code", "org.libreoffice.LibreOffice", "gimp", "evince",
+};
+
+static const char * const _ww_switcher_bench_queries[] = {
+    "firefox inbox",
+    "konsole vim",
+    "report 2",
+    "nautilus photos",
+    "zzz",
+};
+
+static void
+_ww_switcher_bench_result(void *user_data, void *data)
+{
+}
+
+static int
+_ww_switcher_bench_compare(const void *a_, const void *b_)
+{
+    int64_t a = *(const int64_t *) a_, b = *(const int64_t *) b_;
+    return ( a > b ) - ( a < b );
+}
+
+/* Scrolls the grid top to bottom, a frame should cost the same for any item count */
+static int
+_ww_switcher_bench_grid(WwSwitcherContext *self)
+{
+    size_t counts[] = { 100, 1000, self->bench }, c, frames;
+    WwSwitcherWindow *windows;
+    int64_t *times;
+
+    windows = ww_new0(WwSwitcherWindow, self->bench);
+    self->items = ww_new0(WwSwitcherWindow *, self->bench);
+    if ( ( windows == NULL ) || ( self->items == NULL ) )
+    {
+        free(windows);
+        return 2;
+    }
+    self->item_size = self->bench;
+    if ( ! _ww_switcher_grid_resize(self, WW_SWITCHER_WIDTH, WW_SWITCHER_HEIGHT) )
+    {
+        free(windows);
+        return 2;
+    }
+
+    for ( c = 0 ; c < sizeof(counts) / sizeof(*counts) ; ++c )
+    {
+        size_t count = MIN(counts[c], self->bench), i;
+        for ( i = 0 ; i < count ; ++i )
+            self->items[i] = &windows[i];
+        self->item_count = count;
+
+        size_t rows = ( count + self->columns - 1 ) / self->columns;
+        double end = (double) rows * ( self->cell_height + WW_SWITCHER_SPACING );
+        frames = end / ( WW_SWITCHER_SCROLL_SPEED * 10 ) + 1;
+        times = ww_new0(int64_t, frames);
+        if ( times == NULL )
+        {
+            free(windows);
+            return 2;
+        }
+
+        for ( i = 0 ; i < self->cell_count ; ++i )
+            _ww_switcher_cell_release(&self->cells[i]);
+        int64_t shown = ww_stats_counters[WW_STATS_PREVIEWS_SHOWN];
+        for ( i = 0 ; i < frames ; ++i )
+        {
+            int64_t start = ww_stats_now();
+            self->scroll = (double) i * WW_SWITCHER_SCROLL_SPEED * 10;
+            _ww_switcher_grid_update(self);
+            times[i] = ww_stats_now() - start;
+        }
+        qsort(times, frames, sizeof(*times), _ww_switcher_bench_compare);
+        printf("%zu items, %zu cells: %zu frames, %.2f previews shown per frame, median %" PRId64 " µs, max %" PRId64 " µs\n", count, self->cell_count, frames, (double) ( ww_stats_counters[WW_STATS_PREVIEWS_SHOWN] - shown ) / frames, times[frames / 2], times[frames - 1]);
+        free(times);
+
+        if ( count == self->bench )
+            break;
+    }
+
+    _ww_switcher_cells_free(self);
+    free(self->items);
+    self->items = NULL;
+    free(windows);
+
+    return 0;
+}
+
+/* Synthetic windows through the same index, typed queries are timed per keystroke */
+static int
+_ww_switcher_bench_run(WwSwitcherContext *self)
+{
+    size_t word_count = sizeof(_ww_switcher_bench_words) / sizeof(*_ww_switcher_bench_words);
+    size_t app_id_count = sizeof(_ww_switcher_bench_app_ids) / sizeof(*_ww_switcher_bench_app_ids);
+    unsigned int seed = 1;
+    int64_t start, elapsed;
+    size_t i, q, k;
+    char title[128], workspace[8];
+    const char *fields[_WW_SWITCHER_FIELD_SIZE] = { title, NULL, workspace };
+
+    start = ww_stats_now();
+    for ( i = 0 ; i < self->bench ; ++i )
+    {
+        uint32_t id;
+        snprintf(title, sizeof(title), "%s %s %u - %s", _ww_switcher_bench_words[rand_r(&seed) % word_count], _ww_switcher_bench_words[rand_r(&seed) % word_count], rand_r(&seed) % 1000, _ww_switcher_bench_words[rand_r(&seed) % word_count]);
+        snprintf(workspace, sizeof(workspace), "%u", 1 + rand_r(&seed) % 9);
+        fields[WW_SWITCHER_FIELD_APP_ID] = _ww_switcher_bench_app_ids[rand_r(&seed) % app_id_count];
+        if ( ( ! ww_search_add(self->search, NULL, &id) ) || ( ! ww_search_set_fields(self->search, id, fields, _WW_SWITCHER_FIELD_SIZE) ) )
+            return 2;
+    }
+    elapsed = ww_stats_now() - start;
+    printf("%lu windows indexed in %" PRId64 " µs\n", self->bench, elapsed);
+
+    /* A title change on each done, as a browser loading pages */
+    size_t updates = MAX(self->bench / 10, 1);
+    start = ww_stats_now();
+    for ( i = 0 ; i < updates ; ++i )
+    {
+        snprintf(title, sizeof(title), "%s %u", _ww_switcher_bench_words[rand_r(&seed) % word_count], rand_r(&seed) % 1000);
+        fields[WW_SWITCHER_FIELD_APP_ID] = _ww_switcher_bench_app_ids[rand_r(&seed) % app_id_count];
+        ww_search_set_fields(self->search, rand_r(&seed) % self->bench, fields, _WW_SWITCHER_FIELD_SIZE);
+    }
+    elapsed = ww_stats_now() - start;
+    printf("%zu updates: %.2f µs per done\n", updates, (double) elapsed / updates);
+
+    for ( q = 0 ; q < sizeof(_ww_switcher_bench_queries) / sizeof(*_ww_switcher_bench_queries) ; ++q )
+    {
+        const char *query = _ww_switcher_bench_queries[q];
+        size_t length = strlen(query), results = 0;
+        int64_t times[WW_SWITCHER_LINE_SIZE];
+        char typed[WW_SWITCHER_LINE_SIZE];
+
+        for ( k = 0 ; k < length ; ++k )
+        {
+            memcpy(typed, query, k + 1);
+            typed[k + 1] = '\0';
+            start = ww_stats_now();
+            results = ww_search_query(self->search, typed, _ww_switcher_bench_result, NULL);
+            times[k] = ww_stats_now() - start;
+        }
+        qsort(times, length, sizeof(*times), _ww_switcher_bench_compare);
+        printf("“%s”: %zu keystrokes, median %" PRId64 " µs, max %" PRId64 " µs, %zu results\n", query, length, times[length / 2], times[length - 1], results);
+    }
+
+    return _ww_switcher_bench_grid(self);
+}
+
+/* Wire size of an event with a string, header included */
+static size_t
+_ww_switcher_bench_string_size(const char *string)
+{
+    return 8 + 4 + ( ( strlen(string) + 1 + 3 ) & ~(size_t) 3 );
+}
+
+/*
+ * A stand-in compositor, calling our handlers with the events of count
+ * windows, returns the wire size of the events
+ */
+static size_t
+_ww_switcher_bench_announce(WwSwitcherContext *self, size_t count, unsigned int *seed)
+{
+    size_t word_count = sizeof(_ww_switcher_bench_words) / sizeof(*_ww_switcher_bench_words);
+    size_t app_id_count = sizeof(_ww_switcher_bench_app_ids) / sizeof(*_ww_switcher_bench_app_ids);
+    size_t bytes = 0, i;
+    char title[128], workspace[8];
+
+    for ( i = 0 ; i < count ; ++i )
+    {
+        WwSwitcherWindow *window = _ww_switcher_window_new(self, NULL);
+        if ( window == NULL )
+            break;
+        snprintf(title, sizeof(title), "%s %s %u - %s", _ww_switcher_bench_words[rand_r(seed) % word_count], _ww_switcher_bench_words[rand_r(seed) % word_count], rand_r(seed) % 1000, _ww_switcher_bench_words[rand_r(seed) % word_count]);
+        snprintf(workspace, sizeof(workspace), "%u", 1 + rand_r(seed) % 9);
+        const char *app_id = _ww_switcher_bench_app_ids[rand_r(seed) % app_id_count];
+
+        _ww_switcher_window_title(window, NULL, title);
+        _ww_switcher_window_app_id(window, NULL, app_id);
+        _ww_switcher_window_workspace(window, NULL, workspace);
+        _ww_switcher_window_done(window, NULL);
+        bytes += 12 + _ww_switcher_bench_string_size(title) + _ww_switcher_bench_string_size(app_id) + _ww_switcher_bench_string_size(workspace) + 8;
+    }
+
+    return bytes;
+}
+
+static void
+_ww_switcher_bench_paint(WwSwitcherContext *self)
+{
+    _ww_switcher_items_refresh(self);
+    _ww_switcher_grid_update(self);
+}
+
+static void
+_ww_switcher_bench_reset(WwSwitcherContext *self)
+{
+    WwSwitcherWindow *window, *tmp;
+
+    wl_list_for_each_safe(window, tmp, &self->windows, link)
+        _ww_switcher_window_free(window);
+    self->oldest_use = 0;
+    self->newest_use = 0;
+}
+
+/* Time to first paint, v1 sending every window at bind, v2 a first page */
+static int
+_ww_switcher_enumerate_bench_run(WwSwitcherContext *self)
+{
+    unsigned int seed = 1;
+    int64_t start, elapsed;
+    size_t bytes, page, sent;
+
+    if ( ! _ww_switcher_grid_resize(self, WW_SWITCHER_WIDTH, WW_SWITCHER_HEIGHT) )
+        return 2;
+
+    start = ww_stats_now();
+    bytes = _ww_switcher_bench_announce(self, self->enumerate_bench, &seed);
+    _ww_switcher_bench_paint(self);
+    elapsed = ww_stats_now() - start;
+    printf("v1: %lu windows, %zu KiB before the first paint, at %" PRId64 " µs\n", self->enumerate_bench, bytes / 1024, elapsed);
+    _ww_switcher_bench_reset(self);
+
+    seed = 1;
+    page = self->cell_count;
+    start = ww_stats_now();
+    bytes = _ww_switcher_bench_announce(self, MIN(page, self->enumerate_bench), &seed) + 12;
+    _ww_switcher_bench_paint(self);
+    elapsed = ww_stats_now() - start;
+    printf("v2: first page of %zu windows, %zu KiB before the first paint, at %" PRId64 " µs\n", page, bytes / 1024, elapsed);
+    for ( sent = page ; sent < self->enumerate_bench ; sent += WW_SWITCHER_PAGE_SIZE )
+    {
+        bytes += _ww_switcher_bench_announce(self, MIN(WW_SWITCHER_PAGE_SIZE, self->enumerate_bench - sent), &seed) + 12;
+        _ww_switcher_bench_paint(self);
+    }
+    elapsed = ww_stats_now() - start;
+    printf("v2: all %lu windows, %zu KiB, painting each page, at %" PRId64 " µs\n", self->enumerate_bench, bytes / 1024, elapsed);
+
+    /* A title change, v1 resends every field */
+    WwSwitcherWindow *window = wl_container_of(self->windows.next, window, link);
+    size_t v1 = _ww_switcher_bench_string_size(window->fields[WW_SWITCHER_FIELD_TITLE]) + _ww_switcher_bench_string_size(window->fields[WW_SWITCHER_FIELD_APP_ID]) + _ww_switcher_bench_string_size(window->fields[WW_SWITCHER_FIELD_WORKSPACE]) + 8;
+    size_t v2 = _ww_switcher_bench_string_size(window->fields[WW_SWITCHER_FIELD_TITLE]) + 8;
+    printf("title change: v1 %zu bytes, v2 %zu bytes\n", v1, v2);
+
+    _ww_switcher_bench_reset(self);
+    _ww_switcher_cells_free(self);
+
+    return 0;
+}
+
+/* The app_ids of the installed .desktop files, as windows would have */
+static size_t
+_ww_switcher_icon_bench_get_app_ids(char **app_ids, size_t count)
+{
+    char **dirs = ww_desktop_get_data_dirs("applications"), **dir;
+    size_t n = 0;
+
+    if ( dirs == NULL )
+        return 0;
+    for ( dir = dirs ; ( n < count ) && ( *dir != NULL ) ; ++dir )
+    {
+        DIR *d = opendir(*dir);
+        struct dirent *e;
+        if ( d == NULL )
+            continue;
+        while ( ( n < count ) && ( ( e = readdir(d) ) != NULL ) )
+        {
+            size_t length = strlen(e->d_name);
+            if ( ( length > 8 ) && ( strcmp(e->d_name + length - 8, ".desktop") == 0 ) && ( ( app_ids[n] = strndup(e->d_name, length - 8) ) != NULL ) )
+                ++n;
+        }
+        closedir(d);
+    }
+    ww_desktop_free_data_dirs(dirs);
+
+    return n;
+}
+
+static void
+_ww_switcher_icon_bench_lookup(const char *name, const char *path, char **app_ids, size_t count, int64_t *times)
+{
+    WwIconCache *cache = ww_icon_cache_new(path, NULL);
+    size_t hits = 0, i;
+    WwIcon icon;
+
+    if ( cache == NULL )
+        return;
+    for ( i = 0 ; i < count ; ++i )
+    {
+        int64_t start = ww_stats_now();
+        if ( ww_icon_cache_lookup(cache, app_ids[i], WW_SWITCHER_ICON_SIZE, &icon) )
+            ++hits;
+        times[i] = ww_stats_now() - start;
+    }
+    ww_icon_cache_free(cache);
+
+    int64_t total = 0;
+    for ( i = 0 ; i < count ; ++i )
+        total += times[i];
+    qsort(times, count, sizeof(*times), _ww_switcher_bench_compare);
+    printf("%s: %zu apps, %zu icons, %" PRId64 " µs total, median %" PRId64 " µs, max %" PRId64 " µs\n", name, count, hits, total, times[count / 2], times[count - 1]);
+}
+
+/* Cold is an empty icon cache file, the system page cache is whatever it is */
+static int
+_ww_switcher_icon_bench_run(WwSwitcherContext *self)
+{
+    char **app_ids = ww_new0(char *, self->icon_bench);
+    int64_t *times = ww_new0(int64_t, self->icon_bench);
+    char path[PATH_MAX];
+    size_t count = 0, i;
+
+    if ( ( app_ids == NULL ) || ( times == NULL ) )
+    {
+        free(times);
+        free(app_ids);
+        return 2;
+    }
+
+    count = _ww_switcher_icon_bench_get_app_ids(app_ids, self->icon_bench);
+    if ( count == 0 )
+        printf("No .desktop file found\n");
+    else
+    {
+        snprintf(path, sizeof(path), "/tmp/ww-switcher-icon-bench-XXXXXX");
+        int fd = mkstemp(path);
+        if ( fd < 0 )
+            ww_warning("Couldn’t create bench icon cache: %s", strerror(errno));
+        else
+        {
+            close(fd);
+            _ww_switcher_icon_bench_lookup("cold", path, app_ids, count, times);
+            _ww_switcher_icon_bench_lookup("warm", path, app_ids, count, times);
+            unlink(path);
+        }
+    }
+
+    for ( i = 0 ; i < count ; ++i )
+        free(app_ids[i]);
+    free(times);
+    free(app_ids);
+
+    return 0;
+}
+
+enum {
+    WW_SWITCHER_OPTION_BENCH = 256,
+    WW_SWITCHER_OPTION_ENUMERATE_BENCH,
+    WW_SWITCHER_OPTION_ICON_BENCH,
+};
+
+static const struct option _ww_switcher_options[] = {
+    { "background", required_argument, NULL, 'b' },
+    { "size", required_argument, NULL, 's' },
+    { "prefetch", required_argument, NULL, 'p' },
+    { "bench", required_argument, NULL, WW_SWITCHER_OPTION_BENCH },
+    { "enumerate-bench", required_argument, NULL, WW_SWITCHER_OPTION_ENUMERATE_BENCH },
+    { "icon-bench", required_argument, NULL, WW_SWITCHER_OPTION_ICON_BENCH },
+    { NULL, 0, NULL, 0 },
+};
+
+static void *
+_ww_switcher_role_init(int argc, char *argv[], int *status)
+{
+    WwSwitcherContext *self;
+
+    self = ww_new0(WwSwitcherContext, 1);
+    if ( self == NULL )
+    {
+        *status = 2;
+        return NULL;
+    }
+
+    wl_list_init(&self->windows);
+    self->background_colour.r = 0.1;
+    self->background_colour.g = 0.1;
+    self->background_colour.b = 0.1;
+    self->background_colour.a = 0.9;
+    self->cell_width = WW_SWITCHER_CELL_WIDTH;
+    self->cell_height = WW_SWITCHER_CELL_HEIGHT;
+    self->prefetch = 1;
+
+    int arg;
+    while ( ( arg = getopt_long(argc, argv, "b:s:p:", _ww_switcher_options, NULL) ) != -1 )
+    {
+        bool good = false;
+        switch ( arg )
+        {
+        case 'b':
+            if ( _ww_parse_colour(optarg, &self->background_colour) )
+                good = true;
+        break;
+        case 's':
+            if ( ( sscanf(optarg, "%dx%d", &self->cell_width, &self->cell_height) == 2 ) && ( self->cell_width > 0 ) && ( self->cell_height > 0 ) )
+                good = true;
+        break;
+        case 'p':
+        {
+            char *e;
+            errno = 0;
+            self->prefetch = strtol(optarg, &e, 10);
+            if ( ( e != optarg ) && ( errno == 0 ) && ( self->prefetch >= 0 ) )
+                good = true;
+        }
+        break;
+        case WW_SWITCHER_OPTION_BENCH:
+        {
+            char *e;
+            errno = 0;
+            self->bench = strtoul(optarg, &e, 10);
+            if ( ( e != optarg ) && ( errno == 0 ) && ( self->bench > 0 ) )
+                good = true;
+        }
+        break;
+        case WW_SWITCHER_OPTION_ENUMERATE_BENCH:
+        {
+            char *e;
+            errno = 0;
+            self->enumerate_bench = strtoul(optarg, &e, 10);
+            if ( ( e != optarg ) && ( errno == 0 ) && ( self->enumerate_bench > 0 ) )
+                good = true;
+        }
+        break;
+        case WW_SWITCHER_OPTION_ICON_BENCH:
+        {
+            char *e;
+            errno = 0;
+            self->icon_bench = strtoul(optarg, &e, 10);
+            if ( ( e != optarg ) && ( errno == 0 ) && ( self->icon_bench > 0 ) )
+                good = true;
+        }
+        break;
+        default:
+        break;
+        }
+        if ( ! good )
+        {
+            fprintf(stderr, ""
+                "Usage:"
+                "\n    %s [OPTION...] - Demo client for Wayland Wall window switcher protocol"
+                "\n"
+                "\nOptions:"
+                "\n    -b, --background <colour>  Background colour (#rrggbb[aa])"
+                "\n    -s, --size <W>x<H>         Preview size, defaults to %dx%d"
+                "\n    -p, --prefetch <rows>      Rows mapped ahead of the scroll, defaults to 1"
+                "\n"
+                "\nWithout a compositor:"
+                "\n    --bench <count>            Index count synthetic windows, time typed queries and grid scrolling"
+                "\n    --enumerate-bench <count>  Time the first paint with count windows, with v1 and v2 enumeration"
+                "\n    --icon-bench <count>       Time icon lookups for count installed applications, cold and warm"
+                "\n"
+                "\nEach line on the standard input is a query, answered with the matching"
+                "\nwindows as “<title>\\t<app_id>\\t<workspace>” lines, then an empty line"
+                "\nAll the words of a query must appear, in any field, ignoring ASCII case"
+                "\n\n", argv[0], WW_SWITCHER_CELL_WIDTH, WW_SWITCHER_CELL_HEIGHT);
+            *status = 3;
+            return NULL;
+        }
+    }
+
+    self->search = ww_search_new();
+    if ( self->search == NULL )
+    {
+        *status = 2;
+        return NULL;
+    }
+
+    if ( ( self->bench > 0 ) || ( self->enumerate_bench > 0 ) || ( self->icon_bench > 0 ) )
+    {
+        if ( self->bench > 0 )
+            *status = _ww_switcher_bench_run(self);
+        else if ( self->enumerate_bench > 0 )
+            *status = _ww_switcher_enumerate_bench_run(self);
+        else
+            *status = _ww_switcher_icon_bench_run(self);
+        free(self->items);
+        ww_search_free(self->search);
+        free(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+static bool
+_ww_switcher_role_attach(void *data, WwClient *client)
+{
+    WwSwitcherContext *self = data;
+
+    self->client = client;
+
+#ifndef WW_SHELL
+    /* A regular file or /dev/null cannot be polled, the grid still works without queries */
+    self->input_source = ww_loop_add_fd(self->client->loop, STDIN_FILENO, EPOLLIN, _ww_switcher_input, self);
+#endif /* ! WW_SHELL */
+
+    if ( ! ww_client_add_globals(self->client, _ww_switcher_globals, sizeof(_ww_switcher_globals) / sizeof(*_ww_switcher_globals), self) )
+        return false;
+    return ww_client_add_listener(self->client, &_ww_switcher_client_listener, self);
+}
+
+static int
+_ww_switcher_role_start(void *data)
+{
+    WwSwitcherContext *self = data;
+
+    if ( ( self->window_switcher == NULL ) && ( self->window_switcher_v1 == NULL ) )
+    {
+        ww_warning("No ww_window_switcher interface provided by the compositor");
+        return 4;
+    }
+
+    /* Still a search backend without it */
+    if ( ( self->client->shm == NULL ) || ( self->subcompositor == NULL ) || ( self->viewporter == NULL ) || ( self->wm_base == NULL ) )
+    {
+        ww_warning("No wl_shm, wl_subcompositor, wp_viewporter or xdg_wm_base interface provided by the compositor, no grid");
+#ifndef WW_SHELL
+        if ( self->input_source == NULL )
+            return 4;
+#endif /* ! WW_SHELL */
+    }
+    else if ( ! _ww_switcher_grid_init(self) )
+    {
+        ww_warning("Couldn’t create the grid: %s", strerror(errno));
+        return 5;
+    }
+
+    return 0;
+}
+
+const WwRole ww_switcher_role = {
+    .name = "switcher",
+    .init = _ww_switcher_role_init,
+    .attach = _ww_switcher_role_attach,
+    .start = _ww_switcher_role_start,
+};
+
+#ifndef WW_SHELL
+int
+main(int argc, char *argv[])
+{
+    WwRoleInstance instance = { &ww_switcher_role, argc, argv, NULL };
+    return ww_role_run("ww-switcher", &instance, 1);
+}
+#endif /* ! WW_SHELL */
@@ -0,0 +1,346 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "helpers.h"
+
+#include <time.h>
+#include <cairo.h>
+#include <pango/pango.h>
+#include <pango/pangocairo.h>
+
+#include "feed.h"
+#include "widget.h"
+
+/* Around the text, in surface coordinates */
+#define WW_WIDGET_PADDING 10
+
+#define WW_WIDGET_SECOND ((int64_t) 1000000)
+
+static void
+_ww_widget_clock_update(WwWidget *self, int64_t now, char *text, size_t size)
+{
+    time_t t = now / WW_WIDGET_SECOND;
+    struct tm tm;
+
+    localtime_r(&t, &tm);
+    if ( strftime(text, size, self->format, &tm) == 0 )
+        text[0] = '\0';
+}
+
+static const WwWidgetInterface _ww_widget_clock_interface = {
+    .update = _ww_widget_clock_update,
+};
+
+/* Only formats showing seconds need to wake up every second */
+static bool
+_ww_widget_clock_has_seconds(const char *format)
+{
+    const char *c;
+    for ( c = strchr(format, '%') ; c != NULL ; c = strchr(c, '%') )
+    {
+        ++c;
+        if ( ( *c == 'E' ) || ( *c == 'O' ) )
+            ++c;
+        if ( *c == '\0' )
+            break;
+        if ( strchr("STscrX+", *c) != NULL )
+            return true;
+        ++c;
+    }
+    return false;
+}
+
+static void
+_ww_widget_load_update(WwWidget *self, int64_t now, char *text, size_t size)
+{
+    double load;
+
+    if ( getloadavg(&load, 1) < 1 )
+        snprintf(text, size, "load ?");
+    else
+        snprintf(text, size, "load %.2f", load);
+}
+
+static const WwWidgetInterface _ww_widget_load_interface = {
+    .update = _ww_widget_load_update,
+};
+
+static void
+_ww_widget_cpu_update(WwWidget *self, int64_t now, char *text, size_t size)
+{
+    const WwMetricsValues *values;
+
+    ww_metrics_sample(self->metrics, now);
+    values = ww_metrics_get_values(self->metrics);
+    if ( values->cpu < 0 )
+        snprintf(text, size, "cpu ?");
+    else
+        snprintf(text, size, "cpu %.0f%%", values->cpu);
+}
+
+static const WwWidgetInterface _ww_widget_cpu_interface = {
+    .update = _ww_widget_cpu_update,
+    .sample = "cpu 100%",
+};
+
+static void
+_ww_widget_memory_update(WwWidget *self, int64_t now, char *text, size_t size)
+{
+    const WwMetricsValues *values;
+
+    ww_metrics_sample(self->metrics, now);
+    values = ww_metrics_get_values(self->metrics);
+    if ( values->memory < 0 )
+        snprintf(text, size, "mem ?");
+    else
+        snprintf(text, size, "mem %.0f%%", values->memory);
+}
+
+static const WwWidgetInterface _ww_widget_memory_interface = {
+    .update = _ww_widget_memory_update,
+    .sample = "mem 100%",
+};
+
+static int
+_ww_widget_format_rate(char *text, size_t size, double rate)
+{
+    static const char units[] = "KMGT";
+    size_t unit;
+
+    if ( rate < 0 )
+        return snprintf(text, size, "?");
+    if ( rate < 1000 )
+        return snprintf(text, size, "%.0fB", rate);
+
+    for ( unit = 0 ; ( rate >= 1000 * 1024 ) && ( unit < sizeof(units) - 2 ) ; ++unit )
+        rate /= 1024;
+    return snprintf(text, size, "%.1f%c", rate / 1024, units[unit]);
+}
+
+static void
+_ww_widget_net_update(WwWidget *self, int64_t now, char *text, size_t size)
+{
+    const WwMetricsValues *values;
+    char rx[16], tx[16];
+
+    ww_metrics_sample(self->metrics, now);
+    values = ww_metrics_get_values(self->metrics);
+    _ww_widget_format_rate(rx, sizeof(rx), values->net_rx);
+    _ww_widget_format_rate(tx, sizeof(tx), values->net_tx);
+    snprintf(text, size, "↓%s ↑%s", rx, tx);
+}
+
+static const WwWidgetInterface _ww_widget_net_interface = {
+    .update = _ww_widget_net_update,
+    .sample = "↓999.9M ↑999.9M",
+};
+
+static void
+_ww_widget_battery_update(WwWidget *self, int64_t now, char *text, size_t size)
+{
+    const WwMetricsValues *values;
+
+    ww_metrics_sample(self->metrics, now);
+    values = ww_metrics_get_values(self->metrics);
+    if ( values->battery < 0 )
+        snprintf(text, size, "bat ?");
+    else
+        snprintf(text, size, "bat %.0f%%%s", values->battery, values->charging ? "+" : "");
+}
+
+static const WwWidgetInterface _ww_widget_battery_interface = {
+    .update = _ww_widget_battery_update,
+    .sample = "bat 100%+",
+};
+
+static const struct {
+    const char *name;
+    const WwWidgetInterface *interface;
+    WwMetricsSource source;
+    int64_t interval;
+} _ww_widget_metrics[] = {
+    { "cpu", &_ww_widget_cpu_interface, WW_METRICS_CPU, WW_WIDGET_SECOND },
+    { "memory", &_ww_widget_memory_interface, WW_METRICS_MEMORY, 5 * WW_WIDGET_SECOND },
+    { "net", &_ww_widget_net_interface, WW_METRICS_NET, WW_WIDGET_SECOND },
+    { "battery", &_ww_widget_battery_interface, WW_METRICS_BATTERY, 30 * WW_WIDGET_SECOND },
+};
+
+/* Texts longer than that are clipped */
+static const WwWidgetInterface _ww_widget_feed_interface = {
+    .sample = "9999999999999999",
+};
+
+static bool
+_ww_widget_parse(WwWidget *self, const char *spec)
+{
+    const char *name = spec, *arg = strchr(spec, ':');
+    size_t length = ( arg != NULL ) ? (size_t) ( arg++ - name ) : strlen(name);
+
+    if ( ( length == strlen("clock") ) && ( strncmp(name, "clock", length) == 0 ) )
+    {
+        if ( arg == NULL )
+            arg = "%Y-%m-%d %T";
+        if ( strlen(arg) >= sizeof(self->format) )
+            return false;
+        strcpy(self->format, arg);
+        self->interface = &_ww_widget_clock_interface;
+        self->interval = _ww_widget_clock_has_seconds(self->format) ? WW_WIDGET_SECOND : 60 * WW_WIDGET_SECOND;
+        return true;
+    }
+
+    if ( ( length == strlen("feed") ) && ( strncmp(name, "feed", length) == 0 ) && ( arg != NULL ) )
+    {
+        char *e;
+        errno = 0;
+        unsigned long segment = strtoul(arg, &e, 10);
+        if ( ( e == arg ) || ( *e != '\0' ) || ( errno != 0 ) || ( segment >= WW_FEED_SEGMENTS ) )
+            return false;
+
+        self->interface = &_ww_widget_feed_interface;
+        self->segment = segment;
+        self->next_update = INT64_MAX;
+        return true;
+    }
+
+    if ( arg != NULL )
+        return false;
+
+    if ( ( length == strlen("load") ) && ( strncmp(name, "load", length) == 0 ) )
+    {
+        self->interface = &_ww_widget_load_interface;
+        self->interval = 5 * WW_WIDGET_SECOND;
+        return true;
+    }
+
+    size_t i;
+    for ( i = 0 ; i < sizeof(_ww_widget_metrics) / sizeof(*_ww_widget_metrics) ; ++i )
+    {
+        if ( ( length != strlen(_ww_widget_metrics[i].name) ) || ( strncmp(name, _ww_widget_metrics[i].name, length) != 0 ) )
+            continue;
+
+        ww_metrics_enable(self->metrics, _ww_widget_metrics[i].source);
+        self->interface = _ww_widget_metrics[i].interface;
+        self->interval = _ww_widget_metrics[i].interval;
+        return true;
+    }
+
+    return false;
+}
+
+/* Digits are the only varying glyphs in our texts, we size the box for their widest */
+static void
+_ww_widget_measure(WwWidget *self)
+{
+    const char *text = ( self->interface->sample != NULL ) ? self->interface->sample : self->text;
+    char sample[WW_WIDGET_TEXT_SIZE];
+    size_t i;
+
+    for ( i = 0 ; text[i] != '\0' ; ++i )
+        sample[i] = ( ( text[i] >= '0' ) && ( text[i] <= '9' ) ) ? '9' : text[i];
+    sample[i] = '\0';
+
+    pango_layout_set_text(self->layout, sample, -1);
+    pango_layout_get_pixel_size(self->layout, &self->natural_width, &self->natural_height);
+    pango_layout_set_text(self->layout, self->text, -1);
+
+    self->natural_width += WW_WIDGET_PADDING;
+    self->natural_height += WW_WIDGET_PADDING;
+}
+
+WwWidget *
+ww_widget_new(const char *spec, WwMetrics *metrics, PangoContext *context, const PangoFontDescription *font)
+{
+    WwWidget *self;
+
+    self = ww_new0(WwWidget, 1);
+    if ( self == NULL )
+        return NULL;
+
+    self->metrics = metrics;
+    self->segment = -1;
+    if ( ! _ww_widget_parse(self, spec) )
+    {
+        ww_warning("Invalid widget: %s", spec);
+        free(self);
+        return NULL;
+    }
+
+    wl_list_init(&self->link);
+    self->layout = pango_layout_new(context);
+    pango_layout_set_font_description(self->layout, font);
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ww_widget_update(self, (int64_t) ts.tv_sec * WW_WIDGET_SECOND + ts.tv_nsec / 1000);
+    _ww_widget_measure(self);
+
+    return self;
+}
+
+void
+ww_widget_free(WwWidget *self)
+{
+    wl_list_remove(&self->link);
+    g_object_unref(self->layout);
+    free(self);
+}
+
+bool
+ww_widget_update(WwWidget *self, int64_t now)
+{
+    char text[WW_WIDGET_TEXT_SIZE];
+
+    if ( ( self->interface->update == NULL ) || ( now < self->next_update ) )
+        return false;
+    self->next_update = ( now / self->interval + 1 ) * self->interval;
+
+    self->interface->update(self, now, text, sizeof(text));
+    if ( strcmp(text, self->text) == 0 )
+        return false;
+
+    strcpy(self->text, text);
+    pango_layout_set_text(self->layout, self->text, -1);
+    return true;
+}
+
+bool
+ww_widget_set_text(WwWidget *self, const char *text)
+{
+    if ( strcmp(text, self->text) == 0 )
+        return false;
+
+    snprintf(self->text, sizeof(self->text), "%s", text);
+    pango_layout_set_text(self->layout, self->text, -1);
+    return true;
+}
+
+void
+ww_widget_draw(WwWidget *self, cairo_t *cr)
+{
+    int32_t width, height;
+
+    pango_layout_get_pixel_size(self->layout, &width, &height);
+    cairo_move_to(cr, self->x + self->width / 2 - width / 2, self->y + self->height / 2 - height / 2);
+    pango_cairo_layout_path(cr, self->layout);
+    cairo_fill(cr);
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef __WW_WIDGET_H__
+#define __WW_WIDGET_H__
+
+#include "helpers.h"
+
+#include <cairo.h>
+#include <pango/pango.h>
+
+#include "metrics.h"
+
+#define WW_WIDGET_TEXT_SIZE 64
+
+typedef struct _WwWidget WwWidget;
+
+typedef struct {
+    /* Writes the text to show at now, in µs of wall-clock time, NULL for pushed texts */
+    void (*update)(WwWidget *self, int64_t now, char *text, size_t size);
+    /* The widest text, or NULL to size the box from the first one */
+    const char *sample;
+} WwWidgetInterface;
+
+struct _WwWidget {
+    const WwWidgetInterface *interface;
+    struct wl_list link;
+    WwMetrics *metrics;
+    /* The feed segment pushed to us, -1 if none */
+    int32_t segment;
+    /* Updates fall on wall-clock multiples of the interval, so widgets sharing a period wake together */
+    int64_t interval;
+    int64_t next_update;
+    /* Box in surface coordinates, set by the layout */
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+    int32_t natural_width;
+    int32_t natural_height;
+    /* Frame number of the last text change, for the owner damage tracking */
+    uint64_t changed;
+    PangoLayout *layout;
+    char text[WW_WIDGET_TEXT_SIZE];
+    char format[WW_WIDGET_TEXT_SIZE];
+};
+
+/*
+ * Spec is one of:
+ *     clock[:<strftime format>]
+ *     load
+ *     cpu
+ *     memory
+ *     net
+ *     battery
+ *     feed:<segment>
+ * Metric widgets all share the same metrics, sampled once per tick
+ */
+WwWidget *ww_widget_new(const char *spec, WwMetrics *metrics, PangoContext *context, const PangoFontDescription *font);
+void ww_widget_free(WwWidget *self);
+
+/* Returns true if the widget was due at now and its text changed */
+bool ww_widget_update(WwWidget *self, int64_t now);
+
+/* For pushed texts, returns true if it changed */
+bool ww_widget_set_text(WwWidget *self, const char *text);
+
+/* Draws the text centred in the box, with the current cairo source */
+void ww_widget_draw(WwWidget *self, cairo_t *cr);
+
+#endif /* __WW_WIDGET_H__ */
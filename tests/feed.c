@@ -0,0 +1,141 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "helpers.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+
+#include "feed.h"
+#include "test.h"
+
+static void *
+_ww_test_feed_connect(void *user_data)
+{
+    return ww_feed_connect(user_data);
+}
+
+static void
+_ww_test_feed_pop_all(WwFeedRing *consumer, int event_fd, uint32_t *popped, uint32_t pushed)
+{
+    WwFeedEntry entry;
+    char text[WW_FEED_TEXT_SIZE];
+    uint64_t count;
+
+    ww_test_assert(( read(event_fd, &count, sizeof(count)) == sizeof(count) ) || ( errno == EAGAIN ));
+    while ( ww_feed_pop(consumer, &entry) )
+    {
+        snprintf(text, sizeof(text), "entry %" PRIu32, *popped);
+        ww_test_assert(entry.segment == *popped % WW_FEED_SEGMENTS);
+        ww_test_assert(strcmp(entry.text, text) == 0);
+        ++*popped;
+    }
+    ww_test_assert(*popped == pushed);
+}
+
+static void
+_ww_test_feed(void)
+{
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    char dir[] = "/tmp/ww-test-feed-XXXXXX";
+    char text[WW_FEED_TEXT_SIZE];
+    WwFeedRing *producer, *consumer;
+    uint32_t pushed = 0, popped = 0;
+    size_t round, i;
+    pthread_t thread;
+    void *result;
+    int socket_fd, event_fd, fd;
+
+    ww_test_assert(mkdtemp(dir) != NULL);
+    snprintf(address.sun_path, sizeof(address.sun_path), "%s/feed", dir);
+    socket_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    ww_test_assert(socket_fd >= 0);
+    ww_test_assert(bind(socket_fd, (struct sockaddr *) &address, sizeof(address)) == 0);
+    ww_test_assert(listen(socket_fd, 1) == 0);
+    event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    ww_test_assert(event_fd >= 0);
+
+    /* The producer waits for the ring while we accept */
+    ww_test_assert(pthread_create(&thread, NULL, _ww_test_feed_connect, address.sun_path) == 0);
+    fd = ww_feed_accept(socket_fd, event_fd, &consumer);
+    ww_test_assert(fd >= 0);
+    ww_test_assert(pthread_join(thread, &result) == 0);
+    producer = result;
+    ww_test_assert(producer != NULL);
+
+    /* Full ring */
+    for ( i = 0 ; i < WW_FEED_CAPACITY ; ++i )
+    {
+        snprintf(text, sizeof(text), "entry %" PRIu32, pushed);
+        ww_test_assert(ww_feed_push(producer, pushed % WW_FEED_SEGMENTS, text));
+        ++pushed;
+    }
+    ww_test_assert(! ww_feed_push(producer, 0, "overflow"));
+    ww_test_assert(ww_test_readable(event_fd));
+    _ww_test_feed_pop_all(consumer, event_fd, &popped, pushed);
+    ww_test_assert(! ww_test_readable(event_fd));
+
+    /* Uneven batches, so the indexes wrap at every position */
+    for ( round = 0 ; round < 50 ; ++round )
+    {
+        size_t count = 1 + ( round * 37 ) % WW_FEED_CAPACITY;
+        for ( i = 0 ; i < count ; ++i )
+        {
+            snprintf(text, sizeof(text), "entry %" PRIu32, pushed);
+            ww_test_assert(ww_feed_push(producer, pushed % WW_FEED_SEGMENTS, text));
+            ++pushed;
+        }
+        /* One wake-up per batch */
+        ww_test_assert(ww_test_readable(event_fd));
+        _ww_test_feed_pop_all(consumer, event_fd, &popped, pushed);
+    }
+
+    /* Too long texts are cut */
+    char long_text[WW_FEED_TEXT_SIZE * 2];
+    WwFeedEntry entry;
+    memset(long_text, 'x', sizeof(long_text) - 1);
+    long_text[sizeof(long_text) - 1] = '\0';
+    ww_test_assert(ww_feed_push(producer, 1, long_text));
+    ww_test_assert(ww_feed_pop(consumer, &entry));
+    ww_test_assert(strlen(entry.text) == WW_FEED_TEXT_SIZE - 1);
+    ww_test_assert(! ww_feed_pop(consumer, &entry));
+
+    ww_feed_ring_free(producer);
+    ww_feed_ring_free(consumer);
+    close(fd);
+    close(event_fd);
+    close(socket_fd);
+    unlink(address.sun_path);
+    rmdir(dir);
+}
+
+int
+main(void)
+{
+    _ww_test_feed();
+
+    return 0;
+}
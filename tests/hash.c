@@ -0,0 +1,131 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "helpers.h"
+
+#include "hash.h"
+#include "test.h"
+
+#define WW_TEST_HASH_COUNT 5000
+
+static uintptr_t keys[WW_TEST_HASH_COUNT];
+static bool present[WW_TEST_HASH_COUNT];
+
+static void *
+_ww_test_hash_value(size_t i)
+{
+    return (void *) ( i + 1 );
+}
+
+/* Every stored key must be found, a hole left by a removal would hide the ones after it */
+static void
+_ww_test_hash_check(const WwHash *hash)
+{
+    size_t count = 0, i;
+
+    for ( i = 0 ; i < WW_TEST_HASH_COUNT ; ++i )
+    {
+        ww_test_assert(ww_hash_lookup(hash, keys[i]) == ( present[i] ? _ww_test_hash_value(i) : NULL ));
+        if ( present[i] )
+            ++count;
+    }
+    ww_test_assert(hash->count == count);
+
+    count = 0;
+    for ( i = 0 ; i < hash->size ; ++i )
+    {
+        if ( hash->entries[i].key == 0 )
+            continue;
+        ww_test_assert(ww_hash_lookup(hash, hash->entries[i].key) == hash->entries[i].value);
+        ++count;
+    }
+    ww_test_assert(hash->count == count);
+}
+
+int
+main(void)
+{
+    uint32_t state = 0x12345678;
+    WwHash hash;
+    size_t i;
+
+    ww_hash_init(&hash);
+    ww_test_assert(ww_hash_lookup(&hash, 1) == NULL);
+    ww_test_assert(ww_hash_remove(&hash, 1) == NULL);
+
+    /* Half small consecutive keys like Wayland names, half pointer-like ones */
+    for ( i = 0 ; i < WW_TEST_HASH_COUNT ; ++i )
+        keys[i] = ( i % 2 ) ? ( i / 2 + 1 ) : ( ( (uintptr_t) ww_test_random(&state) << 4 ) | 0x10 ) + i;
+
+    for ( i = 0 ; i < WW_TEST_HASH_COUNT ; ++i )
+    {
+        ww_test_assert(ww_hash_insert(&hash, keys[i], _ww_test_hash_value(i)));
+        present[i] = true;
+
+        /* Grown by doubling, always under 3/4 load */
+        ww_test_assert(( hash.size & ( hash.size - 1 ) ) == 0);
+        ww_test_assert(hash.count * 4 <= hash.size * 3);
+    }
+    _ww_test_hash_check(&hash);
+
+    /* Inserting again replaces the value */
+    ww_test_assert(ww_hash_insert(&hash, keys[0], NULL));
+    ww_test_assert(ww_hash_lookup(&hash, keys[0]) == NULL);
+    ww_test_assert(hash.count == WW_TEST_HASH_COUNT);
+    ww_test_assert(ww_hash_insert(&hash, keys[0], _ww_test_hash_value(0)));
+
+    /* Random removals and re-insertions, checking the whole table each round */
+    size_t round;
+    for ( round = 0 ; round < 20 ; ++round )
+    {
+        for ( i = 0 ; i < WW_TEST_HASH_COUNT / 10 ; ++i )
+        {
+            size_t k = ww_test_random(&state) % WW_TEST_HASH_COUNT;
+            if ( present[k] )
+            {
+                ww_test_assert(ww_hash_remove(&hash, keys[k]) == _ww_test_hash_value(k));
+                ww_test_assert(ww_hash_remove(&hash, keys[k]) == NULL);
+                present[k] = false;
+            }
+            else
+            {
+                ww_test_assert(ww_hash_insert(&hash, keys[k], _ww_test_hash_value(k)));
+                present[k] = true;
+            }
+        }
+        _ww_test_hash_check(&hash);
+    }
+
+    for ( i = 0 ; i < WW_TEST_HASH_COUNT ; ++i )
+    {
+        if ( present[i] )
+            ww_test_assert(ww_hash_remove(&hash, keys[i]) == _ww_test_hash_value(i));
+        present[i] = false;
+    }
+    _ww_test_hash_check(&hash);
+    ww_test_assert(hash.count == 0);
+
+    ww_hash_clear(&hash);
+
+    return 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/* For memmem() */
+#define _GNU_SOURCE
+
+#include "helpers.h"
+
+#include "match.h"
+#include "test.h"
+
+#define WW_TEST_MATCH_MAX_LENGTH 80
+#define WW_TEST_MATCH_MAX_NEEDLE 20
+
+static ssize_t
+_ww_test_match_memmem(const char *haystack, size_t length, const char *needle, size_t needle_length)
+{
+    const char *found = memmem(haystack, length, needle, needle_length);
+    return ( found != NULL ) ? found - haystack : -1;
+}
+
+/* Exactly the padding after the haystack, so any read past it is caught by sanitizers */
+static char *
+_ww_test_match_haystack(size_t length)
+{
+    char *haystack = malloc(length + WW_MATCH_PADDING);
+    ww_test_assert(haystack != NULL);
+    return haystack;
+}
+
+static void
+_ww_test_match_check(const char *haystack, size_t length, const char *needle, size_t needle_length)
+{
+    ssize_t expected = _ww_test_match_memmem(haystack, length, needle, needle_length);
+    ssize_t found = ww_match_find(haystack, length, needle, needle_length);
+    if ( found != expected )
+        ww_log("FAILED", "length %zu, needle length %zu: %zd instead of %zd", length, needle_length, found, expected);
+    ww_test_assert(found == expected);
+}
+
+int
+main(void)
+{
+    uint32_t state = 0xfeedbeef;
+    char needle[WW_TEST_MATCH_MAX_NEEDLE];
+    size_t length, needle_length, i;
+
+    /* Two letters, so that partial matches are everywhere */
+    for ( length = 0 ; length <= WW_TEST_MATCH_MAX_LENGTH ; ++length )
+    {
+        char *haystack = _ww_test_match_haystack(length);
+
+        for ( needle_length = 0 ; needle_length <= WW_TEST_MATCH_MAX_NEEDLE ; ++needle_length )
+        {
+            size_t round;
+            for ( round = 0 ; round < 20 ; ++round )
+            {
+                for ( i = 0 ; i < length + WW_MATCH_PADDING ; ++i )
+                    haystack[i] = 'a' + ww_test_random(&state) % 2;
+                for ( i = 0 ; i < needle_length ; ++i )
+                    needle[i] = 'a' + ww_test_random(&state) % 2;
+                _ww_test_match_check(haystack, length, needle, needle_length);
+            }
+
+            /* The needle at every position, including cut by the end with its rest in the padding */
+            size_t position;
+            for ( position = 0 ; position <= length ; ++position )
+            {
+                memset(haystack, 'x', length + WW_MATCH_PADDING);
+                memcpy(haystack + position, needle, MIN(needle_length, length + WW_MATCH_PADDING - position));
+                _ww_test_match_check(haystack, length, needle, needle_length);
+            }
+        }
+
+        free(haystack);
+    }
+
+    /* A first and last byte match is not a match */
+    char *haystack = _ww_test_match_haystack(8);
+    memcpy(haystack, "abcXefgh", 8);
+    memset(haystack + 8, 0, WW_MATCH_PADDING);
+    ww_test_assert(ww_match_find(haystack, 8, "abce", 4) == -1);
+    ww_test_assert(ww_match_find(haystack, 8, "fgh", 3) == 5);
+    ww_test_assert(ww_match_find(haystack, 8, "fgh\0", 4) == -1);
+    free(haystack);
+
+    return 0;
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "helpers.h"
+
+#include "queue.h"
+#include "test.h"
+
+#define WW_TEST_QUEUE_CAPACITY 16
+
+typedef struct {
+    uint64_t serial;
+    char padding[20];
+} WwTestQueueElement;
+
+static void
+_ww_test_queue(void)
+{
+    WwTestQueueElement element = { 0 };
+    uint64_t pushed = 0, popped = 0;
+    WwQueue *queue;
+    size_t round, i;
+
+    queue = ww_queue_new(sizeof(WwTestQueueElement), WW_TEST_QUEUE_CAPACITY);
+    ww_test_assert(queue != NULL);
+    ww_test_assert(! ww_queue_pop(queue, &element));
+    ww_test_assert(! ww_test_readable(ww_queue_get_fd(queue)));
+
+    /* Full ring */
+    for ( i = 0 ; i < WW_TEST_QUEUE_CAPACITY ; ++i )
+    {
+        element.serial = pushed++;
+        ww_test_assert(ww_queue_push(queue, &element));
+    }
+    ww_test_assert(! ww_queue_push(queue, &element));
+    ww_test_assert(ww_test_readable(ww_queue_get_fd(queue)));
+
+    while ( ww_queue_pop(queue, &element) )
+        ww_test_assert(element.serial == popped++);
+    ww_test_assert(popped == pushed);
+    ww_test_assert(! ww_test_readable(ww_queue_get_fd(queue)));
+
+    /* Uneven batches, so the indexes wrap at every position */
+    for ( round = 0 ; round < 100 ; ++round )
+    {
+        size_t count = 1 + ( round * 7 ) % WW_TEST_QUEUE_CAPACITY;
+        for ( i = 0 ; i < count ; ++i )
+        {
+            element.serial = pushed++;
+            ww_test_assert(ww_queue_push(queue, &element));
+        }
+        ww_test_assert(ww_test_readable(ww_queue_get_fd(queue)));
+        for ( i = 0 ; i < count / 2 + 1 ; ++i )
+        {
+            ww_test_assert(ww_queue_pop(queue, &element));
+            ww_test_assert(element.serial == popped++);
+        }
+        while ( ww_queue_pop(queue, &element) )
+            ww_test_assert(element.serial == popped++);
+        ww_test_assert(popped == pushed);
+        ww_test_assert(! ww_test_readable(ww_queue_get_fd(queue)));
+    }
+
+    ww_queue_free(queue);
+}
+
+int
+main(void)
+{
+    _ww_test_queue();
+
+    return 0;
+}
@@ -0,0 +1,225 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "helpers.h"
+
+#include <ctype.h>
+
+#include "search.h"
+#include "test.h"
+
+#define WW_TEST_SEARCH_COUNT 400
+#define WW_TEST_SEARCH_FIELDS 3
+#define WW_TEST_SEARCH_FIELD_SIZE 24
+#define WW_TEST_SEARCH_ROUNDS 300
+
+typedef struct {
+    bool live;
+    bool has_fields;
+    uint32_t id;
+    char fields[WW_TEST_SEARCH_FIELDS][WW_TEST_SEARCH_FIELD_SIZE];
+    bool matched;
+} WwTestSearchItem;
+
+static WwTestSearchItem items[WW_TEST_SEARCH_COUNT];
+
+/* A small alphabet, so that trigrams are shared and queries match often */
+static void
+_ww_test_search_random_text(uint32_t *state, char *text, size_t size)
+{
+    static const char alphabet[] = "abcdeABCDE -";
+    size_t length = ww_test_random(state) % size, i;
+
+    for ( i = 0 ; i < length ; ++i )
+        text[i] = alphabet[ww_test_random(state) % ( sizeof(alphabet) - 1 )];
+    text[i] = '\0';
+}
+
+static void
+_ww_test_search_set_fields(WwSearch *search, WwTestSearchItem *item, uint32_t *state)
+{
+    const char *fields[WW_TEST_SEARCH_FIELDS];
+    size_t i;
+
+    for ( i = 0 ; i < WW_TEST_SEARCH_FIELDS ; ++i )
+    {
+        _ww_test_search_random_text(state, item->fields[i], WW_TEST_SEARCH_FIELD_SIZE);
+        fields[i] = item->fields[i];
+    }
+    ww_test_assert(ww_search_set_fields(search, item->id, fields, WW_TEST_SEARCH_FIELDS));
+    item->has_fields = true;
+}
+
+static void
+_ww_test_search_fold(char *dest, const char *source, size_t size)
+{
+    size_t i;
+    for ( i = 0 ; ( i + 1 < size ) && ( source[i] != '\0' ) ; ++i )
+        dest[i] = tolower((unsigned char) source[i]);
+    dest[i] = '\0';
+}
+
+/* Every word of the query in one of the fields */
+static bool
+_ww_test_search_brute_match(const WwTestSearchItem *item, const char *query)
+{
+    char folded[WW_TEST_SEARCH_FIELDS][WW_TEST_SEARCH_FIELD_SIZE];
+    char words[256];
+    char *word, *save;
+    size_t i;
+
+    if ( ! item->has_fields )
+        return false;
+
+    for ( i = 0 ; i < WW_TEST_SEARCH_FIELDS ; ++i )
+        _ww_test_search_fold(folded[i], item->fields[i], sizeof(folded[i]));
+    _ww_test_search_fold(words, query, sizeof(words));
+
+    for ( word = strtok_r(words, " ", &save) ; word != NULL ; word = strtok_r(NULL, " ", &save) )
+    {
+        bool found = false;
+        for ( i = 0 ; ( ! found ) && ( i < WW_TEST_SEARCH_FIELDS ) ; ++i )
+            found = ( strstr(folded[i], word) != NULL );
+        if ( ! found )
+            return false;
+    }
+    return true;
+}
+
+static void
+_ww_test_search_result(void *user_data, void *data)
+{
+    WwTestSearchItem *item = data;
+    uint32_t *last_id = user_data;
+
+    ww_test_assert(item->live);
+    ww_test_assert(! item->matched);
+    /* In id order */
+    ww_test_assert(( *last_id == UINT32_MAX ) || ( item->id > *last_id ));
+    *last_id = item->id;
+    item->matched = true;
+}
+
+static void
+_ww_test_search_check(WwSearch *search, const char *query)
+{
+    uint32_t last_id = UINT32_MAX;
+    size_t count = 0, i;
+
+    for ( i = 0 ; i < WW_TEST_SEARCH_COUNT ; ++i )
+        items[i].matched = false;
+
+    size_t result_count = ww_search_query(search, query, _ww_test_search_result, &last_id);
+
+    for ( i = 0 ; i < WW_TEST_SEARCH_COUNT ; ++i )
+    {
+        if ( ! items[i].live )
+            continue;
+        bool expected = _ww_test_search_brute_match(&items[i], query);
+        if ( items[i].matched != expected )
+            ww_log("FAILED", "query “%s”, fields “%s” “%s” “%s”", query, items[i].fields[0], items[i].fields[1], items[i].fields[2]);
+        ww_test_assert(items[i].matched == expected);
+        if ( expected )
+            ++count;
+    }
+    ww_test_assert(result_count == count);
+}
+
+/* Typed one character at a time, so most queries refine the previous one */
+static void
+_ww_test_search_type(WwSearch *search, const char *query)
+{
+    char prefix[256];
+    size_t length = strlen(query), i;
+
+    for ( i = 0 ; i <= length ; ++i )
+    {
+        memcpy(prefix, query, i);
+        prefix[i] = '\0';
+        _ww_test_search_check(search, prefix);
+    }
+}
+
+int
+main(void)
+{
+    uint32_t state = 0x13579bdf;
+    WwSearch *search;
+    size_t round, i;
+
+    search = ww_search_new();
+    ww_test_assert(search != NULL);
+
+    for ( i = 0 ; i < WW_TEST_SEARCH_COUNT ; ++i )
+    {
+        ww_test_assert(ww_search_add(search, &items[i], &items[i].id));
+        items[i].live = true;
+        /* A few stay without fields, matching nothing */
+        if ( ( i % 17 ) != 0 )
+            _ww_test_search_set_fields(search, &items[i], &state);
+    }
+
+    for ( round = 0 ; round < WW_TEST_SEARCH_ROUNDS ; ++round )
+    {
+        char query[64];
+
+        /* Words from an entry, or random ones which often match nothing */
+        WwTestSearchItem *source = &items[ww_test_random(&state) % WW_TEST_SEARCH_COUNT];
+        if ( source->has_fields && ( ww_test_random(&state) % 2 ) )
+        {
+            const char *field = source->fields[ww_test_random(&state) % WW_TEST_SEARCH_FIELDS];
+            size_t length = strlen(field);
+            size_t start = ( length > 0 ) ? ww_test_random(&state) % length : 0;
+            snprintf(query, sizeof(query), "%.*s", (int) ( ww_test_random(&state) % 8 ), field + start);
+        }
+        else
+            _ww_test_search_random_text(&state, query, 10);
+        _ww_test_search_type(search, query);
+
+        /* Removals, re-additions and field changes between queries */
+        size_t changes = ww_test_random(&state) % 6, c;
+        for ( c = 0 ; c < changes ; ++c )
+        {
+            WwTestSearchItem *item = &items[ww_test_random(&state) % WW_TEST_SEARCH_COUNT];
+            if ( ! item->live )
+            {
+                ww_test_assert(ww_search_add(search, item, &item->id));
+                item->live = true;
+                item->has_fields = false;
+                _ww_test_search_set_fields(search, item, &state);
+            }
+            else if ( ww_test_random(&state) % 3 == 0 )
+            {
+                ww_search_remove(search, item->id);
+                item->live = false;
+            }
+            else
+                _ww_test_search_set_fields(search, item, &state);
+        }
+        _ww_test_search_check(search, query);
+    }
+
+    ww_search_free(search);
+
+    return 0;
+}
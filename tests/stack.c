@@ -0,0 +1,155 @@
+/*
+ * Copyright © 2016 Quentin "Sardem FF7" Glidic
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "helpers.h"
+
+#include "stack.h"
+#include "test.h"
+
+#define WW_TEST_STACK_COUNT 300
+#define WW_TEST_STACK_ROUNDS 2000
+
+typedef struct {
+    WwStackEntry entry;
+    bool live;
+    /* Insertion order, the newest is on top */
+    uint64_t serial;
+    int32_t previous_offset;
+    bool called;
+} WwTestStackItem;
+
+static WwTestStackItem items[WW_TEST_STACK_COUNT];
+
+static void
+_ww_test_stack_place(void *user_data, WwStackEntry *entry)
+{
+    WwTestStackItem *item = wl_container_of(entry, item, entry);
+    ww_test_assert(item->live);
+    ww_test_assert(! item->called);
+    item->called = true;
+}
+
+static int
+_ww_test_stack_compare(const void *a_, const void *b_)
+{
+    const WwTestStackItem *a = *(WwTestStackItem * const *) a_, *b = *(WwTestStackItem * const *) b_;
+    return ( a->serial < b->serial ) - ( a->serial > b->serial );
+}
+
+/* Recomputes every offset from the top and checks the stack agrees */
+static void
+_ww_test_stack_check(WwStack *stack, int32_t limit, bool invalidated)
+{
+    WwTestStackItem *order[WW_TEST_STACK_COUNT];
+    size_t count = 0, i;
+
+    for ( i = 0 ; i < WW_TEST_STACK_COUNT ; ++i )
+    {
+        items[i].called = false;
+        if ( ! items[i].live )
+            continue;
+        items[i].previous_offset = items[i].entry.offset;
+        order[count++] = &items[i];
+    }
+    qsort(order, count, sizeof(*order), _ww_test_stack_compare);
+
+    size_t calls = ww_stack_place(stack, limit, _ww_test_stack_place, NULL);
+
+    int64_t offset = 0;
+    bool fits = true;
+    size_t expected_calls = 0;
+    for ( i = 0 ; i < count ; ++i )
+    {
+        WwTestStackItem *item = order[i];
+        ww_test_assert(ww_stack_get_offset(stack, &item->entry) == offset);
+
+        fits = fits && ( offset + item->entry.size <= limit );
+        int32_t expected = fits ? offset : -1;
+        ww_test_assert(item->entry.offset == expected);
+
+        /* Any move is reported, and only moves unless invalidated */
+        if ( item->previous_offset != expected )
+            ww_test_assert(item->called);
+        else if ( ! invalidated )
+            ww_test_assert(! item->called);
+        if ( item->called )
+            ++expected_calls;
+
+        offset += item->entry.size;
+    }
+    ww_test_assert(calls == expected_calls);
+}
+
+int
+main(void)
+{
+    uint32_t state = 0x2468ace1;
+    uint64_t serial = 0;
+    int32_t limit = 2000;
+    WwStack *stack;
+    size_t round;
+
+    stack = ww_stack_new();
+    ww_test_assert(stack != NULL);
+
+    _ww_test_stack_check(stack, limit, false);
+
+    for ( round = 0 ; round < WW_TEST_STACK_ROUNDS ; ++round )
+    {
+        /* A few changes between two placements, as a notification burst would */
+        size_t changes = 1 + ww_test_random(&state) % 4, c;
+        bool invalidated = false;
+        for ( c = 0 ; c < changes ; ++c )
+        {
+            WwTestStackItem *item = &items[ww_test_random(&state) % WW_TEST_STACK_COUNT];
+            uint32_t action = ww_test_random(&state) % 16;
+            int32_t size = 1 + ww_test_random(&state) % 120;
+
+            if ( ! item->live )
+            {
+                ww_test_assert(ww_stack_insert(stack, &item->entry, size));
+                item->live = true;
+                item->serial = ++serial;
+            }
+            else if ( action < 6 )
+            {
+                ww_stack_remove(stack, &item->entry);
+                item->live = false;
+            }
+            else if ( action < 14 )
+                ww_stack_resize(stack, &item->entry, size);
+            else if ( action < 15 )
+            {
+                ww_stack_invalidate(stack);
+                invalidated = true;
+            }
+            else
+                limit = 500 + ww_test_random(&state) % 3000;
+        }
+        _ww_test_stack_check(stack, limit, invalidated);
+    }
+
+    ww_stack_free(stack);
+
+    return 0;
+}